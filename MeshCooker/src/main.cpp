@@ -0,0 +1,55 @@
+/** \file main.cpp */
+
+#include "rendering/meshFile.hpp"
+#include "rendering/meshBuilder.hpp"
+#include "rendering/meshOptimiser.hpp"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader/tiny_obj_loader.h>
+
+#include <chrono>
+#include <iostream>
+
+// converts an obj model into a cooked mesh file that the renderer maps at load time
+// usage: MeshCooker <input.obj> [output.rmesh]
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: MeshCooker <input.obj> [output" << Rock::MESH_FILE_EXTENSION << "]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string inputPath = argv[1];
+    std::string outputPath = argc > 2 ? argv[2] : Rock::MeshFile::getCookedPath(inputPath);
+
+    try
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        Rock::MeshBuilder::loadObj(inputPath, vertices, indices);
+        float acmrBefore = Rock::MeshOptimiser::analyseVertexCache(indices.data(), indices.size(), vertices.size());
+        Rock::MeshOptimiser::optimise(vertices, indices);
+        float acmrAfter = Rock::MeshOptimiser::analyseVertexCache(indices.data(), indices.size(), vertices.size());
+
+        Rock::MeshFile::write(outputPath, vertices, indices);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        float duration = std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count();
+
+        std::cout << "Cooked " << inputPath << " -> " << outputPath << std::endl;
+        std::cout << "  vertices: " << vertices.size() << ", indices: " << indices.size()
+            << " (" << (vertices.size() <= UINT16_MAX ? 16 : 32) << " bit)" << std::endl;
+        std::cout << "  ACMR: " << acmrBefore << " -> " << acmrAfter << std::endl;
+        std::cout << "  time: " << duration << " ms" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
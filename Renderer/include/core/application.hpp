@@ -10,47 +10,17 @@
 
 #include "core/descriptors.hpp"
 #include "rendering/renderer.hpp"
-
-/* \struct Particle
-*  \brief stores the data sent to the SSBO for each particle: position, velocity and colour; also handles binding and attribute descriptions
-*/
-struct Particle
-{
-    glm::vec2 position;
-    glm::vec2 velocity;
-    glm::vec4 colour;
-
-    static VkVertexInputBindingDescription getBindingDescription()
-    {
-        VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(Particle);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-        return bindingDescription;
-    }
-
-    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions()
-    {
-        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
-
-        VkVertexInputAttributeDescription posAttrib{};
-        posAttrib.binding = 0;
-        posAttrib.location = 0;
-        posAttrib.format = VK_FORMAT_R32G32_SFLOAT;
-        posAttrib.offset = offsetof(Particle, position);
-        attributeDescriptions.push_back(posAttrib);
-
-        VkVertexInputAttributeDescription colAttrib{};
-        colAttrib.binding = 0;
-        colAttrib.location = 1;
-        colAttrib.format = VK_FORMAT_R32G32_SFLOAT;
-        colAttrib.offset = offsetof(Particle, colour);
-        attributeDescriptions.push_back(colAttrib);
-
-        return attributeDescriptions;
-    }
-};
+#include "rendering/meshFile.hpp"
+#include "rendering/meshBuilder.hpp"
+#include "rendering/meshOptimiser.hpp"
+#include "rendering/compactVertex.hpp"
+#include "rendering/culling.hpp"
+#include "core/threadPool.hpp"
+#include "core/frameAllocator.hpp"
+#include "core/frameLimiter.hpp"
+#include "rendering/pipelineCache.hpp"
+#include "rendering/pipelineCompiler.hpp"
+#include "rendering/shaderReloader.hpp"
 
 /* \class Application
 *  \brief provides an application with a window, device, renderer and descriptor manager
@@ -73,9 +43,13 @@ protected:
 	Device* m_device; //!< pointer to the device object
 	Renderer* m_renderer; //!< pointer to the renderer
 	DescriptorManager* m_descriptorManager; //!< descriptor manager
+	ThreadPool m_threadPool; //!< worker threads for per-frame CPU work
+	FrameLimiter m_frameLimiter; //!< caps the frame rate once given a target, before input is polled
 protected:
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
     void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
     void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+    void createDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory); //!< uploads data to a new device local buffer through a staging buffer
+    void loadMeshFile(Rock::RenderComponent& renderComp, const std::string& path); //!< maps a cooked mesh file and uploads its vertex and index data without parsing, quantising the vertices if renderComp uses VertexFormat::Compact
 };
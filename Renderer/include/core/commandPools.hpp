@@ -0,0 +1,38 @@
+/** \file commandPools.hpp */
+
+#pragma once
+
+#include "core/device.hpp"
+
+/* \class CommandPools
+*  \brief a transient command pool for each recording thread and frame in flight, handing out secondary command buffers that are recycled when the frame's pools are reset
+*/
+class CommandPools
+{
+public:
+	CommandPools(Device* device, uint32_t threadCount, uint32_t framesInFlight); //!< constructor
+	~CommandPools(); //!< destructor
+
+	CommandPools(const CommandPools&) = delete; //!< copy constructor
+	CommandPools& operator=(const CommandPools&) = delete; //!< copy assignment
+
+	uint32_t getThreadCount() const { return m_threadCount; } //!< returns the number of recording threads with their own pools
+	void reset(uint32_t frame); //!< resets every pool of a frame; the frame's fence must have signalled
+	VkCommandBuffer acquireSecondary(uint32_t frame, uint32_t thread); //!< returns an unused secondary command buffer from a thread's pool, allocating one if needed; only that thread may call this for its index
+private:
+	/* \struct Pool
+	*  \brief pool owned by a single recording thread and the secondary buffers allocated from it
+	*/
+	struct Pool
+	{
+		VkCommandPool commandPool = VK_NULL_HANDLE; //!< transient command pool
+		std::vector<VkCommandBuffer> secondaries; //!< secondary buffers allocated from the pool
+		size_t used = 0; //!< number of secondaries handed out since the last reset
+	};
+
+	Pool& getPool(uint32_t frame, uint32_t thread) { return m_pools[frame * m_threadCount + thread]; } //!< returns the pool of a thread for a frame
+private:
+	Device* m_device; //!< device object pointer
+	uint32_t m_threadCount; //!< number of recording threads
+	std::vector<Pool> m_pools; //!< frame major pools
+};
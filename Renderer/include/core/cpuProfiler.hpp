@@ -0,0 +1,81 @@
+/** \file cpuProfiler.hpp */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* \class CpuProfiler
+*  \brief records timed zones into a ring buffer per thread that only its owning thread writes, so recording never locks; the zones can be exported as a Chrome trace (chrome://tracing, Perfetto) and the last frame is drawn as a flame graph in the editor
+*/
+class CpuProfiler
+{
+public:
+	static const uint32_t RING_CAPACITY = 16384; //!< zones kept per thread; older zones are overwritten
+
+	/* \struct Zone
+	*  \brief a timed region of one thread
+	*/
+	struct Zone
+	{
+		const char* name; //!< zone name, a string literal
+		uint64_t start; //!< nanoseconds since the profiler started
+		uint64_t end; //!< nanoseconds since the profiler started
+		uint32_t depth; //!< zones open on the thread when this one began
+		uint32_t thread; //!< index of the recording thread, in order of first use
+	};
+
+	/* \class Scope
+	*  \brief records a zone covering its lifetime; use through ROCK_PROFILE_SCOPE so it compiles out when profiling is disabled
+	*/
+	class Scope
+	{
+	public:
+		Scope(const char* name); //!< constructor, starts the zone; name must outlive the profiler, e.g. a string literal
+		~Scope(); //!< destructor, records the zone
+
+		Scope(const Scope&) = delete; //!< copy constructor
+		Scope& operator=(const Scope&) = delete; //!< copy assignment
+	private:
+		const char* m_name; //!< zone name
+		uint64_t m_start; //!< start time
+	};
+
+	static uint64_t now(); //!< returns nanoseconds since the profiler started
+	static void markFrame(); //!< ends the current frame and starts the next, which the flame graph shows once it ends
+	static void getLastFrame(uint64_t& start, uint64_t& end); //!< returns the bounds of the last completed frame, both 0 before one has completed
+	static std::vector<Zone> collect(uint64_t since = 0); //!< copies the zones of every thread ending at or after since, skipping any overwritten while copying
+	static std::string toChromeTrace(const std::vector<Zone>& zones); //!< returns the zones as complete events in the Chrome trace event format
+	static void exportChromeTrace(const std::string& path); //!< writes every recorded zone as a Chrome trace
+private:
+	/* \struct ThreadBuffer
+	*  \brief the zones of one thread; only the owning thread writes zones and the head
+	*/
+	struct ThreadBuffer
+	{
+		uint32_t thread; //!< index of the thread
+		uint32_t depth = 0; //!< zones currently open
+		std::atomic<uint64_t> head{ 0 }; //!< zones ever recorded; the next is written at head % RING_CAPACITY
+		Zone zones[RING_CAPACITY]; //!< ring of recorded zones
+	};
+
+	static ThreadBuffer& getThreadBuffer(); //!< returns the calling thread's buffer, registering it on first use
+	static std::vector<std::unique_ptr<ThreadBuffer>>& getBuffers(); //!< returns every registered buffer; buffers outlive their threads so their zones can still be exported
+};
+
+#ifdef ROCK_PROFILE
+#define ROCK_PROFILE_CONCAT_INNER(a, b) a##b
+#define ROCK_PROFILE_CONCAT(a, b) ROCK_PROFILE_CONCAT_INNER(a, b)
+#define ROCK_PROFILE_SCOPE(name) CpuProfiler::Scope ROCK_PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define ROCK_PROFILE_FUNCTION() ROCK_PROFILE_SCOPE(__FUNCTION__)
+#define ROCK_PROFILE_FRAME() CpuProfiler::markFrame()
+#define ROCK_PROFILE_EXPORT(path) CpuProfiler::exportChromeTrace(path)
+#else
+#define ROCK_PROFILE_SCOPE(name)
+#define ROCK_PROFILE_FUNCTION()
+#define ROCK_PROFILE_FRAME()
+#define ROCK_PROFILE_EXPORT(path)
+#endif
@@ -4,42 +4,117 @@
 
 #include "core/device.hpp"
 
+#include <unordered_map>
+
+/* \class DescriptorLayoutCache
+*  \brief creates each distinct descriptor set layout once and returns the cached handle for any later request with the same bindings
+*/
+class DescriptorLayoutCache
+{
+public:
+	/* \struct LayoutKey
+	*  \brief bindings of a layout sorted by binding index so the same bindings in any order share a layout
+	*/
+	struct LayoutKey
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings; //!< bindings sorted by binding index
+		VkDescriptorSetLayoutCreateFlags flags = 0; //!< layout create flags
+
+		static LayoutKey create(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags = 0); //!< sorts the bindings into a key
+		bool operator==(const LayoutKey& other) const; //!< compares every binding field and the flags
+		size_t hash() const; //!< combines the hash of every binding field and the flags
+	};
+
+	DescriptorLayoutCache(Device* device) : m_device(device) {} //!< constructor
+	~DescriptorLayoutCache(); //!< destructor
+
+	DescriptorLayoutCache(const DescriptorLayoutCache&) = delete; //!< copy constructor
+	DescriptorLayoutCache& operator=(const DescriptorLayoutCache&) = delete; //!< copy assignment
+
+	VkDescriptorSetLayout createDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags = 0); //!< returns the cached layout for the bindings, creating it on first use
+	size_t getLayoutCount() const { return m_layouts.size(); } //!< returns the number of distinct layouts created
+private:
+	struct LayoutHash
+	{
+		size_t operator()(const LayoutKey& key) const { return key.hash(); }
+	}; //!< hashes a LayoutKey for the unordered map
+private:
+	Device* m_device; //!< device object pointer
+	std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutHash> m_layouts; //!< layouts keyed by their sorted bindings
+};
+
+/* \class DescriptorAllocator
+*  \brief allocates descriptor sets from a chain of pools, opening a new pool whenever the current one is exhausted; sets are never freed individually, only by resetting every pool at once
+*/
+class DescriptorAllocator
+{
+public:
+	/* \struct PoolRatio
+	*  \brief number of descriptors of a type reserved in each pool per set it can hold
+	*/
+	struct PoolRatio
+	{
+		VkDescriptorType type; //!< descriptor type
+		float ratio; //!< descriptors of type per set
+	};
+
+	static const uint32_t SETS_PER_POOL = 64; //!< number of sets each pool in the chain can hold
+
+	DescriptorAllocator(Device* device, uint32_t setsPerPool = SETS_PER_POOL); //!< constructor
+	~DescriptorAllocator(); //!< destructor
+
+	DescriptorAllocator(const DescriptorAllocator&) = delete; //!< copy constructor
+	DescriptorAllocator& operator=(const DescriptorAllocator&) = delete; //!< copy assignment
+
+	static std::vector<VkDescriptorPoolSize> getPoolSizes(const std::vector<PoolRatio>& ratios, uint32_t setsPerPool); //!< returns the pool sizes for a pool holding setsPerPool sets, at least one descriptor of each type
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout); //!< allocates a set, chaining a new pool if the current one is out of memory or fragmented
+	void resetPools(); //!< resets every used pool in bulk and returns them to the free list; every set allocated since the last reset becomes invalid
+	size_t getPoolCount() const { return m_usedPools.size() + m_freePools.size(); } //!< returns the number of pools created
+private:
+	VkDescriptorPool grabPool(); //!< takes a pool from the free list or creates a new one
+private:
+	Device* m_device; //!< device object pointer
+	uint32_t m_setsPerPool; //!< number of sets each pool can hold
+	std::vector<PoolRatio> m_ratios; //!< descriptors of each type reserved per set
+	VkDescriptorPool m_currentPool = VK_NULL_HANDLE; //!< pool sets are currently allocated from
+	std::vector<VkDescriptorPool> m_usedPools; //!< pools holding sets allocated since the last reset
+	std::vector<VkDescriptorPool> m_freePools; //!< reset pools ready for reuse
+};
+
 /* \class DescriptorManager
-*  \brief stores the descriptor pool, descriptor set layouts and descriptor sets
+*  \brief stores the layout cache, a persistent allocator and the global descriptor sets
 */
 class DescriptorManager
 {
 public:
-	DescriptorManager(Device* device, uint32_t maxSets) : m_device(device), m_maxSets(maxSets) {} //!< constructor
+	DescriptorManager(Device* device, uint32_t maxSets); //!< constructor
 	~DescriptorManager(); //!< destructor
 
 	DescriptorManager(const DescriptorManager&) = delete; //!< copy constructor
 	DescriptorManager& operator=(const DescriptorManager&) = delete; //!< copy assignment
 public:
-	VkDescriptorPool getDescriptorPool() { return m_descriptorPool; } //!< returns the descriptor pool
 	VkDescriptorSetLayout* getDescriptorSetLayout() { return &m_descriptorSetLayout; } //!< returns a pointer to the descriptor set layout
 	VkDescriptorSetLayoutBinding getDescriptorSetLayoutBinding(uint32_t index) { return m_bindings[index]; } //!< returns the descriptor set layout binding for the input index
 	std::vector<VkDescriptorSet> getDescriptorSets() { return m_descriptorSets; } //!< returns the descriptor sets
-	/// descriptor pool methods
-	void addPoolSize(VkDescriptorType type, uint32_t count); //!< adds a VkDescriptorPoolSize to the pool sizes
-	void buildDescriptorPool(); //!< creates the descriptor pool using m_poolSizes
-	void allocateDescriptorSets(); //!< allocates descriptor sets to the descriptor pool
-	void freeDescriptors() const; //!< frees the descriptors on the destruction of the DescriptorManager
-	void resetDescriptorPool(); //!< resets the descriptor pool
+	DescriptorLayoutCache* getLayoutCache() { return m_layoutCache; } //!< returns the layout cache
+	/// allocation methods
+	VkDescriptorSetLayout createDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings) { return m_layoutCache->createDescriptorSetLayout(bindings); } //!< returns a cached layout for the bindings
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout) { return m_allocator->allocate(layout); } //!< allocates a set that lives as long as the manager
+	void allocateDescriptorSets(); //!< allocates a global descriptor set for each frame in flight
 	/// descriptor set layout methods
 	void addBinding(uint32_t binding, VkDescriptorType type, VkShaderStageFlags flags, uint32_t count = 1, VkSampler* samplers = nullptr); //!< adds a descriptor set layout binding to the vector
 	bool bindingFound(uint32_t index); //!< checks if a binding is already being used
-	void buildDescriptorSetLayout(); //!< creates the descriptor set layout
+	void buildDescriptorSetLayout(); //!< fetches the global descriptor set layout from the cache
 	/// write descriptor set methods
 	void addWriteDescriptorSet(uint32_t binding, VkDescriptorBufferInfo* bufferInfo = nullptr, VkDescriptorImageInfo* imageInfo = nullptr); //!< adds a write descriptor set to the vector
-	void overwrite(uint32_t index); //!< updates the data in the descriptor set
+	void overwrite(uint32_t index); //!< updates the data in the descriptor set and clears the pending writes
 private:
 	Device* m_device; //!< device object pointer
-	VkDescriptorPool m_descriptorPool; //!< handle to the descriptor pool
-	std::vector<VkDescriptorPoolSize> m_poolSizes; //!< vector of the pool sizes
-	VkDescriptorSetLayout m_descriptorSetLayout; //!< descriptor set layout
+	DescriptorLayoutCache* m_layoutCache; //!< layouts shared by every set
+	DescriptorAllocator* m_allocator; //!< allocator for sets that live as long as the manager
+	VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE; //!< global descriptor set layout, owned by the cache
 	std::vector<VkDescriptorSetLayoutBinding> m_bindings; //!< bindings for the descriptor set layout
 	std::vector<VkDescriptorSet> m_descriptorSets; //!< descriptor sets
 	std::vector<VkWriteDescriptorSet> m_descriptorWrites; //!< writes for the descriptor set
-	uint32_t m_maxSets; //< max number of sets for each vector of descriptor sets
+	uint32_t m_maxSets; //!< number of frames in flight, one global set each
 };
@@ -10,6 +10,8 @@
 #include <optional>
 #include <set>
 
+class PipelineCache;
+
 /* \struct SwapChainSupportDetails
 *  \brief stores the capabilities, formats and present modes for the device
 */
@@ -26,12 +28,13 @@ struct SwapChainSupportDetails
 struct QueueFamilyIndices
 {
     std::optional<uint32_t> graphicsFamily; //!< index of physical device queue family supporting VK_QUEUE_GRAPHICS_BIT and VK_QUEUE_COMPUTE_BIT
-    std::optional<uint32_t> presentFamily; //!< index of physical device queue family supporting present
+    std::optional<uint32_t> presentFamily; //!< index of physical device queue family supporting present; the graphics family on a headless device
+    std::optional<uint32_t> computeFamily; //!< index of a queue family supporting VK_QUEUE_COMPUTE_BIT but not graphics, so compute can overlap graphics; the graphics family if there is none
     bool isComplete() const { return graphicsFamily.has_value() && presentFamily.has_value(); } //!< returns if physical device supports graphics, compute and present
 };
 
 /* \class Device
-*  \brief stores the window, surface, instance, debug messenger, command pools, etc.
+*  \brief stores the window, surface, instance, debug messenger, command pools, etc.; a headless device has no window or surface and renders offscreen
 */
 class Device
 {
@@ -43,7 +46,7 @@ public:
 #endif
 
     Device(); //!< default constructor
-    Device(Window* window); //!< constructor
+    Device(Window* window); //!< constructor; a null window creates a headless device without a surface or the swapchain extension, which runs on display-less machines and software rasterisers such as lavapipe
     ~Device(); //!< destructor
     Device(const Device&) = delete; //!< copy constructor
     Device(const Device&&) = delete; //!< move constructor
@@ -70,13 +73,23 @@ private:
 #endif
 public:
     Window* getWindow() const { return m_window; } //!< returns the window object
+    bool isHeadless() const { return m_window == nullptr; } //!< returns if the device has no window or surface to present to
     VkInstance getInstance() const { return m_instance; } //!< returns the vulkan instance
     VkSurfaceKHR getSurface() const { return m_surface; } //!< returns the surface
     VkDevice getDevice() const { return m_device; } //!< returns the device
     VkPhysicalDevice getPhysicalDevice() const { return m_physicalDevice; } //!< returns the device
     VkQueue getGraphicsQueue() const { return m_graphicsQueue; } //!< returns the graphics queue
     VkQueue getPresentQueue() const { return m_presentQueue; } //!< returns the present queue
+    VkQueue getComputeQueue() const { return m_computeQueue; } //!< returns the compute queue, the graphics queue without a dedicated compute family
     VkCommandPool getCommandPool() const { return m_commandPool; } //!< returns the command pool
+    VkCommandPool getComputeCommandPool() const { return m_computeCommandPool; } //!< returns the command pool for the compute queue
+    bool hasAsyncCompute() const { return m_computeFamily != m_graphicsFamily; } //!< returns if compute is submitted to a dedicated queue family that runs alongside graphics
+    PipelineCache* getPipelineCache() const { return m_pipelineCache; } //!< returns the pipeline cache shared by every pipeline on the device
+    const VkPhysicalDeviceFeatures& getEnabledFeatures() const { return m_enabledFeatures; } //!< returns the core features enabled on the device
+    bool supportsDrawIndirectCount() const { return m_drawIndirectCount; } //!< returns if vkCmdDrawIndexedIndirectCount can be used
+    bool supportsBindlessTextures() const { return m_bindlessTextures; } //!< returns if the descriptor indexing features used by TextureTable are enabled
+    bool supportsPresentWait() const { return m_presentWait; } //!< returns if presents can carry an id and be waited on with waitForPresent
+    VkResult waitForPresent(VkSwapchainKHR swapchain, uint64_t presentId, uint64_t timeout) const { return m_waitForPresent(m_device, swapchain, presentId, timeout); } //!< waits until the present with the id, or a later one, has reached the display; requires supportsPresentWait
 
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(m_physicalDevice); } //!< returns the swap chain support
     QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(m_physicalDevice); } //!< returns the queue families
@@ -93,19 +106,22 @@ private:
     void pickPhysicalDevice(); //!< chooses the most suitable GPU with vulkan support
     void createLogicalDevice(); //!< creates the device using the physical device and gets device queues
     void createCommandPool(); //!< creates the command pool
+    void createPipelineCache(); //!< creates the pipeline cache, loading the blob saved by a previous run
 
     bool checkValidationLayerSupport(); //!< checks the validation layer(s) is supported
     void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& ci); //!< populates the create info for the debug messenger
     bool isDeviceSuitable(VkPhysicalDevice device); //!< checks if the input device supports the required extensions and swapchains
     std::vector<const char*> getRequiredExtensions(); //!< returns the required extensions
+    std::vector<const char*> getDeviceExtensions() const; //!< returns the required device extensions, without the swapchain extension when headless
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device); //!< returns the indices of physical device queue families
     bool checkInstanceExtensionSupport(); //!< checks the instance supports all the required extensions
     bool checkDeviceExtensionSupport(VkPhysicalDevice device); //!< checks the device supports all the required extensions
+    bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& extensions); //!< checks the device supports all the given extensions
     SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device); //!< gets swap chain support details for input device
 public:
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties); //!< finds memory index match input properties and filters
     VkSampleCountFlagBits getMaxUsableSampleCount(); //!< returns the maximum samples the physical device can provide
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory); //!< creates buffer, allocates memory and binds with device
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, bool sharedWithCompute = false); //!< creates buffer, allocates memory and binds with device; a buffer shared with compute is concurrent across the graphics and compute families when they differ, so it needs no ownership transfers
     void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size); //!< copies buffer; used for creating staged buffers before copying to buffer array (e.g. ssbos)
     VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features); //!< finds supported format favouring VK_IMAGE_TILING_LINEAR
     void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory); //!< creates an image and binds ith with the device to device memory
@@ -120,5 +136,15 @@ private:
     VkDevice m_device; //!< device
     VkQueue m_graphicsQueue; //!< graphics queue
     VkQueue m_presentQueue; //!< present queue
+    VkQueue m_computeQueue; //!< compute queue
     VkCommandPool m_commandPool; //!< command pool
+    VkCommandPool m_computeCommandPool; //!< command pool for the compute queue
+    uint32_t m_graphicsFamily = 0; //!< graphics queue family index
+    uint32_t m_computeFamily = 0; //!< compute queue family index
+    PipelineCache* m_pipelineCache = nullptr; //!< pipeline cache, saved to disk on destruction
+    VkPhysicalDeviceFeatures m_enabledFeatures{}; //!< core features enabled on the device
+    bool m_drawIndirectCount = false; //!< if the drawIndirectCount feature is enabled
+    bool m_bindlessTextures = false; //!< if the descriptor indexing features for bindless textures are enabled
+    bool m_presentWait = false; //!< if the present id and present wait features are enabled
+    PFN_vkWaitForPresentKHR m_waitForPresent = nullptr; //!< vkWaitForPresentKHR, loaded when present wait is enabled
 };
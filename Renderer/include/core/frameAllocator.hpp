@@ -0,0 +1,45 @@
+/** \file frameAllocator.hpp */
+
+#pragma once
+
+#include "core/device.hpp"
+
+#include <cstring>
+
+/* \class FrameAllocator
+*  \brief a persistently mapped buffer for each frame in flight that per-frame data is bump allocated from; bound once through dynamic descriptors so new data only needs a memcpy and a dynamic offset
+*/
+class FrameAllocator
+{
+public:
+	FrameAllocator(Device* device, VkDeviceSize capacity, uint32_t framesInFlight, VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT); //!< constructor, capacity is the size of each frame's buffer
+	~FrameAllocator(); //!< destructor
+
+	FrameAllocator(const FrameAllocator&) = delete; //!< copy constructor
+	FrameAllocator& operator=(const FrameAllocator&) = delete; //!< copy assignment
+
+	static VkDeviceSize alignUp(VkDeviceSize offset, VkDeviceSize alignment) { return (offset + alignment - 1) & ~(alignment - 1); } //!< rounds offset up to a power of two alignment
+
+	VkBuffer getBuffer(uint32_t frame) const { return m_buffers[frame]; } //!< returns the buffer of a frame
+	VkDeviceSize getCapacity() const { return m_capacity; } //!< returns the size of each frame's buffer
+	VkDeviceSize getAlignment() const { return m_alignment; } //!< returns the alignment of every allocation
+	VkDeviceSize getUsed(uint32_t frame) const { return m_heads[frame]; } //!< returns the bytes allocated from a frame since its last reset
+	void reset(uint32_t frame) { m_heads[frame] = 0; } //!< frees every allocation of a frame; the frame's fence must have signalled
+	VkDeviceSize allocate(uint32_t frame, VkDeviceSize size, void** mapped = nullptr, VkDeviceSize alignment = 0); //!< reserves size bytes in a frame's buffer, returning the offset and optionally the mapped pointer to write to; the offset is aligned to getAlignment or a larger power of two alignment
+	template<typename T>
+	uint32_t push(uint32_t frame, const T& data)
+	{
+		void* mapped;
+		VkDeviceSize offset = allocate(frame, sizeof(T), &mapped);
+		memcpy(mapped, &data, sizeof(T));
+		return static_cast<uint32_t>(offset);
+	} //!< copies data into a frame's buffer, returning the dynamic offset to bind it with
+private:
+	Device* m_device; //!< device object pointer
+	VkDeviceSize m_capacity; //!< size of each frame's buffer
+	VkDeviceSize m_alignment; //!< alignment of every allocation, at least the device's minimum dynamic offset alignment
+	std::vector<VkBuffer> m_buffers; //!< buffer for each frame in flight
+	std::vector<VkDeviceMemory> m_buffersMemory; //!< memory for each buffer
+	std::vector<char*> m_buffersMapped; //!< persistently mapped buffers
+	std::vector<VkDeviceSize> m_heads; //!< bump offset of each frame
+};
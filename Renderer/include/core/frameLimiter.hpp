@@ -0,0 +1,29 @@
+/** \file frameLimiter.hpp */
+
+#pragma once
+
+#include <chrono>
+
+/* \class FrameLimiter
+*  \brief caps the frame rate on the CPU by sleeping for most of the time left in the frame and spinning for the rest, as sleeps wake up late by an amount the limiter measures
+*/
+class FrameLimiter
+{
+public:
+	FrameLimiter(double targetFrameRate = 0.0) { setTargetFrameRate(targetFrameRate); } //!< constructor, uncapped when targetFrameRate is 0
+
+	FrameLimiter(const FrameLimiter&) = delete; //!< copy constructor
+	FrameLimiter& operator=(const FrameLimiter&) = delete; //!< copy assignment
+
+	double getTargetFrameRate() const { return m_targetFrameRate; } //!< returns the frames per second aimed for, 0 if uncapped
+	void setTargetFrameRate(double targetFrameRate); //!< sets the frames per second aimed for, 0 to uncap
+	void wait(); //!< returns once a frame period has passed since the previous frame was due; a frame that ran over starts the next period from now rather than catching up
+private:
+	typedef std::chrono::steady_clock Clock; //!< clock frames are timed with
+
+	double m_targetFrameRate = 0.0; //!< frames per second, 0 if uncapped
+	Clock::duration m_period{ 0 }; //!< time between frames
+	Clock::time_point m_next; //!< time the next frame is due
+	bool m_started = false; //!< if a frame has been timed since the rate was set
+	Clock::duration m_sleepError = std::chrono::milliseconds(1); //!< how late sleeps have recently woken, decaying towards the latest
+};
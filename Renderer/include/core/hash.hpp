@@ -0,0 +1,97 @@
+/** \file hash.hpp */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace Rock
+{
+	namespace detail
+	{
+		inline void hashMultiply(uint64_t& a, uint64_t& b)
+		{
+#if defined(__SIZEOF_INT128__)
+			__uint128_t r = static_cast<__uint128_t>(a) * b;
+			a = static_cast<uint64_t>(r);
+			b = static_cast<uint64_t>(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+			a = _umul128(a, b, &b);
+#else
+			uint64_t ha = a >> 32, hb = b >> 32, la = static_cast<uint32_t>(a), lb = static_cast<uint32_t>(b);
+			uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+			uint64_t lo = t + (rm1 << 32);
+			c += lo < t;
+			uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+			a = lo;
+			b = hi;
+#endif
+		} //!< 64x64 -> 128 bit multiply, returning the low half in a and the high half in b
+
+		inline uint64_t hashMix(uint64_t a, uint64_t b) { hashMultiply(a, b); return a ^ b; } //!< folds a 128 bit product into 64 bits
+		inline uint64_t hashRead8(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; } //!< unaligned 64 bit read
+		inline uint64_t hashRead4(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; } //!< unaligned 32 bit read
+		inline uint64_t hashRead3(const uint8_t* p, size_t k) { return (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[k >> 1]) << 8) | p[k - 1]; } //!< reads 1-3 bytes
+	}
+
+	/* \brief hashes raw bytes with wyhash (final version 4); fast on short keys like vertices and well distributed in every bit
+	*/
+	inline uint64_t hashBytes(const void* key, size_t length, uint64_t seed = 0)
+	{
+		using namespace detail;
+		const uint64_t secret[4] = { 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull };
+		const uint8_t* p = static_cast<const uint8_t*>(key);
+		seed ^= hashMix(seed ^ secret[0], secret[1]);
+
+		uint64_t a, b;
+		if (length <= 16)
+		{
+			if (length >= 4)
+			{
+				a = (hashRead4(p) << 32) | hashRead4(p + ((length >> 3) << 2));
+				b = (hashRead4(p + length - 4) << 32) | hashRead4(p + length - 4 - ((length >> 3) << 2));
+			}
+			else if (length > 0)
+			{
+				a = hashRead3(p, length);
+				b = 0;
+			}
+			else
+				a = b = 0;
+		}
+		else
+		{
+			size_t i = length;
+			if (i > 48)
+			{
+				uint64_t see1 = seed, see2 = seed;
+				do
+				{
+					seed = hashMix(hashRead8(p) ^ secret[1], hashRead8(p + 8) ^ seed);
+					see1 = hashMix(hashRead8(p + 16) ^ secret[2], hashRead8(p + 24) ^ see1);
+					see2 = hashMix(hashRead8(p + 32) ^ secret[3], hashRead8(p + 40) ^ see2);
+					p += 48;
+					i -= 48;
+				} while (i > 48);
+				seed ^= see1 ^ see2;
+			}
+			while (i > 16)
+			{
+				seed = hashMix(hashRead8(p) ^ secret[1], hashRead8(p + 8) ^ seed);
+				i -= 16;
+				p += 16;
+			}
+			a = hashRead8(p + i - 16);
+			b = hashRead8(p + i - 8);
+		}
+
+		a ^= secret[1];
+		b ^= seed;
+		hashMultiply(a, b);
+		return hashMix(a ^ secret[0] ^ length, b ^ secret[1]);
+	}
+}
@@ -0,0 +1,36 @@
+/** \file threadPool.hpp */
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/* \class ThreadPool
+*  \brief fixed set of worker threads that run submitted jobs; used to spread per-frame CPU work such as culling and command recording
+*/
+class ThreadPool
+{
+public:
+	ThreadPool(uint32_t threadCount = 0); //!< constructor, starts threadCount workers (hardware concurrency - 1 when 0)
+	~ThreadPool(); //!< destructor, finishes queued jobs and joins the workers
+
+	ThreadPool(const ThreadPool&) = delete; //!< copy constructor
+	ThreadPool& operator=(const ThreadPool&) = delete; //!< copy assignment
+
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(m_workers.size()); } //!< returns the number of worker threads
+	std::future<void> submit(std::function<void()> job); //!< queues a job and returns a future that is ready once it has run
+	void parallelFor(size_t count, size_t minBatchSize, const std::function<void(size_t begin, size_t end)>& job); //!< splits [0, count) into batches run across the workers and the calling thread; blocks until all are done, and runs every batch on the calling thread when that is one of the pool's workers
+private:
+	void workerLoop(); //!< pops and runs jobs until the pool is stopped
+private:
+	std::vector<std::thread> m_workers; //!< worker threads
+	std::queue<std::packaged_task<void()>> m_jobs; //!< queued jobs
+	std::mutex m_mutex; //!< guards m_jobs and m_stopping
+	std::condition_variable m_condition; //!< signalled when a job is queued or the pool stops
+	bool m_stopping = false; //!< set on destruction to release the workers
+};
@@ -17,18 +17,27 @@ private:
         alignas(16) glm::mat4 proj;
     };
     struct LightUBO {
-        alignas(16) DirectionalLight dLight;
-        alignas(16) PointLight pLights[1];
+        alignas(16) glm::vec3 directionalColour; // the std140 directionalLight struct starts each vec3 on 16 bytes, which DirectionalLight does not
+        alignas(16) glm::vec3 directionalDirection;
     };
     struct ViewUBO {
         alignas(16) glm::vec3 viewPos;
     };
+    static const uint32_t DYNAMIC_SETS = 1; // set 0 holds the UBOs bound with FrameAllocator offsets
 
     void initApplication() override;
     void mainLoop() override;
     void cleanup() override;
     void createDescriptorSetLayouts();
-    void createGraphicsPipeline();
+    std::future<Pipeline*> compileGraphicsPipeline();
+    LayoutOverrides getLayoutOverrides() const;
+    void waitForPipelines();
+    void setPipelineSettings(PipelineSettings& pipelineSettings);
+    void createGpuCulling();
+    std::future<Pipeline*> compileInstancedPipeline();
+    void createShaderReloader();
+    void createLights();
+    void createShadows();
     void loadTexture(entt::entity entity, const char* path);
     void createTextureImageView(entt::entity entity);
     void createTextureSampler(entt::entity entity);
@@ -36,7 +45,6 @@ private:
     void createVertexBuffer(entt::entity entity);
     void createIndexBuffer(entt::entity entity);
     void createUniformBuffers();
-    void createDescriptorPool();
     void createDescriptorSets();
     void createTextureDescriptorSet(entt::entity entity);
 
@@ -45,22 +53,43 @@ private:
 public:
     void drawFrame() override;
 private:
-    Pipeline* m_graphicsPipeline;
+    Pipeline* m_graphicsPipeline = nullptr;
+    std::future<Pipeline*> m_graphicsPipelineFuture; // compiled on the thread pool while textures and models load
     VkSampleCountFlagBits m_msaaSamples = VK_SAMPLE_COUNT_1_BIT; // multisample anti-aliasing
+    bool m_compactVertices = false; // upload CompactVertex data and draw with compact.vert, halving vertex memory and fetch bandwidth
 
     // textures
-    VkDescriptorSetLayout m_textureDescriptorSetLayout;
+    VkDescriptorSetLayout m_textureDescriptorSetLayout; // per-entity texture sets reflected from main.frag, used when bindless textures are unsupported; owned by the layout cache
+    TextureTable* m_textureTable = nullptr; // every texture in one set, indexed per draw
 
-    // camera and light UBOs
-    std::vector<VkBuffer> m_cameraBuffers;
-    std::vector<VkBuffer> m_lightBuffers;
-    std::vector<VkBuffer> m_viewPosBuffers;
-    std::vector<VkDeviceMemory> m_cameraBuffersMemory;
-    std::vector<VkDeviceMemory> m_lightBuffersMemory;
-    std::vector<VkDeviceMemory> m_viewPosBuffersMemory;
-    std::vector<void*> m_cameraBuffersMapped;
-    std::vector<void*> m_lightBuffersMapped;
-    std::vector<void*> m_viewPosBuffersMapped;
+    // camera and light UBOs, bump allocated each frame and bound with dynamic offsets
+    FrameAllocator* m_frameAllocator = nullptr;
+
+    // frustum culling
+    glm::mat4 m_viewProjection{ 1.f };
+    Rock::CullingSystem m_culling;
+    std::vector<entt::entity> m_visibleEntities;
+
+    // GPU occlusion culling
+    bool m_gpuCulling = false; // cull a grid of m_gameObject instances in a compute pass against the frustum and last frame's depth pyramid, drawn with instanced.vert
+    GpuCuller* m_gpuCuller = nullptr;
+    Pipeline* m_instancedPipeline = nullptr;
+    std::future<Pipeline*> m_instancedPipelineFuture;
+
+    // clustered lighting
+    uint32_t m_lightCount = 1024; // point and spot lights circling the scene, binned into view space clusters each frame so a fragment only shades the lights reaching it
+    LightClusterer* m_lightClusterer = nullptr;
+    std::vector<PointLight> m_pointLights;
+    std::vector<SpotLight> m_spotLights;
+    std::vector<LightClusterer::GpuLight> m_gpuLights; // rebuilt each frame from the animated lights
+
+    // cascaded shadow maps
+    uint32_t m_maxShadowCasters = 64; // casters each cascade can draw
+    ShadowMapper* m_shadowMapper = nullptr; // cascades of the directional light, refitted to the camera each frame and sampled by main.frag
+
+    // shader hot reload
+    bool m_shaderHotReload = false; // recompile the engineApp GLSL with glslc from the Vulkan SDK when it changes and swap the rebuilt pipelines in
+    ShaderReloader* m_shaderReloader = nullptr;
 
     entt::registry m_registry;
     entt::entity m_gameObject;
@@ -39,7 +39,6 @@ private:
     void createVertexBuffer(entt::entity entity);
     void createIndexBuffer(entt::entity entity);
     void createUniformBuffers();
-    void createDescriptorPool();
     void createDescriptorSets();
     void createTextureDescriptorSet(entt::entity entity);
 
@@ -66,6 +65,11 @@ private:
     std::vector<void*> m_viewPosBuffersMapped;
 
     GameState m_gameState = gameOver;
+    // frustum culling
+    glm::mat4 m_viewProjection{ 1.f };
+    Rock::CullingSystem m_culling;
+    std::vector<entt::entity> m_visibleEntities;
+
     entt::registry m_registry;
     entt::entity m_floor;
     entt::entity m_player;
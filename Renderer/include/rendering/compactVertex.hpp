@@ -0,0 +1,131 @@
+/** \file compactVertex.hpp */
+
+#pragma once
+
+#include "rendering/renderComponent.hpp"
+
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+/* \struct CompactVertex
+*  \brief 16 byte quantised alternative to Vertex: snorm16 positions relative to the mesh AABB, octahedral snorm16 normals and half float tex coords
+*/
+struct CompactVertex
+{
+    uint16_t pos[4]; //!< R16G16B16A16_SNORM position in [-1, 1] over the mesh AABB; w is padding
+    uint16_t texCoord[2]; //!< R16G16_SFLOAT tex coord
+    uint16_t norm[2]; //!< R16G16_SNORM octahedral encoded normal
+
+    static VkVertexInputBindingDescription getBindingDescription()
+    {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 0;
+        bindingDescription.stride = sizeof(CompactVertex);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+        return bindingDescription;
+    }
+
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions()
+    {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+        VkVertexInputAttributeDescription posAttrib{};
+        posAttrib.binding = 0;
+        posAttrib.location = 0;
+        posAttrib.format = VK_FORMAT_R16G16B16A16_SNORM;
+        posAttrib.offset = offsetof(CompactVertex, pos);
+        attributeDescriptions.push_back(posAttrib);
+
+        VkVertexInputAttributeDescription texCoordAttrib{};
+        texCoordAttrib.binding = 0;
+        texCoordAttrib.location = 1;
+        texCoordAttrib.format = VK_FORMAT_R16G16_SFLOAT;
+        texCoordAttrib.offset = offsetof(CompactVertex, texCoord);
+        attributeDescriptions.push_back(texCoordAttrib);
+
+        VkVertexInputAttributeDescription normAttrib{};
+        normAttrib.binding = 0;
+        normAttrib.location = 2;
+        normAttrib.format = VK_FORMAT_R16G16_SNORM;
+        normAttrib.offset = offsetof(CompactVertex, norm);
+        attributeDescriptions.push_back(normAttrib);
+
+        return attributeDescriptions;
+    }
+
+    static glm::vec2 encodeOctahedral(glm::vec3 normal)
+    {
+        float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (length == 0.f)
+            return glm::vec2(0.f);
+
+        normal /= length;
+        glm::vec2 encoded(normal.x, normal.y);
+        if (normal.z < 0.f)
+        {
+            encoded.x = (1.f - std::abs(normal.y)) * (normal.x >= 0.f ? 1.f : -1.f);
+            encoded.y = (1.f - std::abs(normal.x)) * (normal.y >= 0.f ? 1.f : -1.f);
+        }
+        return encoded;
+    } //!< maps a unit vector onto the octahedron unfolded into [-1, 1]^2
+
+    static glm::vec3 decodeOctahedral(glm::vec2 encoded)
+    {
+        glm::vec3 normal(encoded.x, encoded.y, 1.f - std::abs(encoded.x) - std::abs(encoded.y));
+        float t = std::max(-normal.z, 0.f);
+        normal.x += normal.x >= 0.f ? -t : t;
+        normal.y += normal.y >= 0.f ? -t : t;
+        return glm::normalize(normal);
+    } //!< inverse of encodeOctahedral; matches decodeOctahedral in compact.vert
+
+    static glm::vec3 getQuantisationExtent(const Rock::MeshBounds& bounds)
+    {
+        return glm::max((bounds.max - bounds.min) * 0.5f, glm::vec3(1e-6f));
+    } //!< returns the half extent positions are divided by; clamped so flat meshes do not divide by zero
+
+    static glm::mat4 getDequantiseTransform(const Rock::MeshBounds& bounds)
+    {
+        glm::vec3 centre = (bounds.min + bounds.max) * 0.5f;
+        return glm::scale(glm::translate(glm::mat4(1.f), centre), getQuantisationExtent(bounds));
+    } //!< returns the transform from quantised [-1, 1] positions back to model space
+
+    static CompactVertex encode(const Vertex& vertex, const Rock::MeshBounds& bounds)
+    {
+        glm::vec3 centre = (bounds.min + bounds.max) * 0.5f;
+        glm::vec3 position = (vertex.pos - centre) / getQuantisationExtent(bounds);
+        glm::vec2 normal = encodeOctahedral(vertex.norm);
+
+        CompactVertex compact{};
+        compact.pos[0] = glm::packSnorm1x16(position.x);
+        compact.pos[1] = glm::packSnorm1x16(position.y);
+        compact.pos[2] = glm::packSnorm1x16(position.z);
+        compact.pos[3] = glm::packSnorm1x16(1.f);
+        compact.texCoord[0] = glm::packHalf1x16(vertex.texCoord.x);
+        compact.texCoord[1] = glm::packHalf1x16(vertex.texCoord.y);
+        compact.norm[0] = glm::packSnorm1x16(normal.x);
+        compact.norm[1] = glm::packSnorm1x16(normal.y);
+        return compact;
+    } //!< quantises a vertex against the mesh bounds
+
+    Vertex decode(const Rock::MeshBounds& bounds) const
+    {
+        glm::vec4 position = getDequantiseTransform(bounds) * glm::vec4(glm::unpackSnorm1x16(pos[0]), glm::unpackSnorm1x16(pos[1]), glm::unpackSnorm1x16(pos[2]), 1.f);
+
+        Vertex vertex{};
+        vertex.pos = glm::vec3(position);
+        vertex.texCoord = glm::vec2(glm::unpackHalf1x16(texCoord[0]), glm::unpackHalf1x16(texCoord[1]));
+        vertex.norm = decodeOctahedral(glm::vec2(glm::unpackSnorm1x16(norm[0]), glm::unpackSnorm1x16(norm[1])));
+        return vertex;
+    } //!< reconstructs the vertex the same way the vertex shader does
+
+    static std::vector<CompactVertex> encode(const Vertex* vertices, size_t count, const Rock::MeshBounds& bounds)
+    {
+        std::vector<CompactVertex> compact(count);
+        for (size_t i = 0; i < count; i++)
+            compact[i] = encode(vertices[i], bounds);
+        return compact;
+    } //!< quantises a vertex array against the mesh bounds
+};
+
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex must stay 16 bytes");
@@ -0,0 +1,125 @@
+/** \file culling.hpp */
+
+#pragma once
+
+#include "core/threadPool.hpp"
+#include "rendering/renderComponent.hpp"
+#include "rendering/gpuLayout.hpp"
+#include "components/transformComponent.hpp"
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace Rock
+{
+	/* \struct Frustum
+	*  \brief the six world space planes of a view projection; a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+	*/
+	struct Frustum
+	{
+		glm::vec4 planes[6]; //!< left, right, bottom, top, near, far
+
+		static Frustum fromMatrix(const glm::mat4& viewProjection); //!< extracts normalised planes from a zero to one depth view projection (Gribb and Hartmann)
+		bool intersectsSphere(const glm::vec3& centre, float radius) const; //!< returns false only when the sphere is entirely outside a plane
+	};
+
+	glm::vec4 getWorldSphere(const glm::mat4& model, const MeshBounds& bounds); //!< returns the world space bounding sphere (centre in xyz, radius in w) of mesh bounds under a model transform
+
+	/* \struct GpuInstance
+	*  \brief per instance data read by cull.comp and instanced.vert; std430 layout so it must match both shaders
+	*/
+	struct GpuInstance
+	{
+		glm::mat4 model; //!< model transform
+		glm::vec4 sphere; //!< world space bounding sphere: centre in xyz, radius in w
+		uint32_t indexCount; //!< number of indices drawn for the instance
+		uint32_t firstIndex; //!< first index in the bound index buffer
+		int32_t vertexOffset; //!< value added to each index before fetching a vertex
+		uint32_t textureIndex; //!< index into the bindless texture table, unused without one
+
+		static GpuInstance create(const glm::mat4& model, const MeshBounds& bounds, uint32_t indexCount, uint32_t firstIndex = 0, int32_t vertexOffset = 0, uint32_t textureIndex = 0)
+		{
+			GpuInstance instance{};
+			instance.model = model;
+			instance.sphere = getWorldSphere(model, bounds);
+			instance.indexCount = indexCount;
+			instance.firstIndex = firstIndex;
+			instance.vertexOffset = vertexOffset;
+			instance.textureIndex = textureIndex;
+			return instance;
+		} //!< creates an instance of a mesh, caching its world space bounding sphere
+	};
+
+	static_assert(sizeof(GpuInstance) == 96, "GpuInstance must match the std430 Instance struct in cull.comp and instanced.vert");
+	GPU_LAYOUT_MEMBER(Std430, GpuInstance, model, sphere);
+	GPU_LAYOUT_MEMBER(Std430, GpuInstance, sphere, indexCount);
+	GPU_LAYOUT_MEMBER(Std430, GpuInstance, indexCount, firstIndex);
+	GPU_LAYOUT_MEMBER(Std430, GpuInstance, firstIndex, vertexOffset);
+	GPU_LAYOUT_MEMBER(Std430, GpuInstance, vertexOffset, textureIndex);
+
+	/* \class DepthPyramid
+	*  \brief CPU copy of the hierarchical depth pyramid built by hiz.comp; level 0 is half the depth resolution rounded up to a power of two and each texel stores the farthest depth it covers
+	*/
+	class DepthPyramid
+	{
+	public:
+		static uint32_t getPyramidSize(uint32_t depthSize); //!< returns the level 0 size used for a depth attachment dimension
+		static uint32_t getLevelCount(uint32_t width, uint32_t height); //!< returns the number of levels in a pyramid for a depth attachment of the given size
+
+		void build(const float* depth, uint32_t width, uint32_t height); //!< builds every level from a row major depth buffer
+		uint32_t getDepthWidth() const { return m_depthWidth; } //!< returns the width of the source depth buffer
+		uint32_t getDepthHeight() const { return m_depthHeight; } //!< returns the height of the source depth buffer
+		uint32_t getLevelCount() const { return static_cast<uint32_t>(m_levels.size()); } //!< returns the number of levels
+		uint32_t getLevelWidth(uint32_t level) const { return std::max(1u, m_width >> level); } //!< returns the width of a level
+		uint32_t getLevelHeight(uint32_t level) const { return std::max(1u, m_height >> level); } //!< returns the height of a level
+		float fetch(uint32_t level, uint32_t x, uint32_t y) const { return m_levels[level][y * getLevelWidth(level) + x]; } //!< returns a texel of a level
+	private:
+		uint32_t m_depthWidth = 0; //!< width of the source depth buffer
+		uint32_t m_depthHeight = 0; //!< height of the source depth buffer
+		uint32_t m_width = 0; //!< width of level 0
+		uint32_t m_height = 0; //!< height of level 0
+		std::vector<std::vector<float>> m_levels; //!< row major texels of each level
+	};
+
+	/* \class CullingReference
+	*  \brief CPU implementation of cull.comp, used to check the visible instance count of the GPU culling pass
+	*/
+	class CullingReference
+	{
+	public:
+		static bool projectSphere(const glm::vec3& viewCentre, float radius, float zNear, float p00, float p11, glm::vec4& uvBounds); //!< computes the screen space UV rectangle (min xy, max zw) of a view space sphere; returns false when the sphere crosses the near plane
+		static bool isOccluded(const DepthPyramid& pyramid, const glm::vec4& sphere, const glm::mat4& view, const glm::mat4& projection); //!< tests a world space sphere against the pyramid built with view and projection
+		static uint32_t countVisible(const std::vector<GpuInstance>& instances, const Frustum& frustum, const DepthPyramid* pyramid = nullptr, const glm::mat4& view = glm::mat4(1.f), const glm::mat4& projection = glm::mat4(1.f)); //!< counts instances inside the frustum and, when a pyramid is given, not occluded
+	};
+
+	/* \class CullingSystem
+	*  \brief culls render entities against a frustum using world space bounding spheres stored as SoA so four are tested per SIMD instruction
+	*/
+	class CullingSystem
+	{
+	public:
+		static const size_t PARALLEL_THRESHOLD = 4096; //!< entity count above which cull spreads batches across the thread pool
+
+		CullingSystem() = default; //!< constructor
+
+		CullingSystem(const CullingSystem&) = delete; //!< copy constructor
+		CullingSystem& operator=(const CullingSystem&) = delete; //!< copy assignment
+
+		void gather(entt::registry& registry, const std::vector<entt::entity>& entities); //!< transforms each entity's cached mesh bounds into a world space sphere
+		void cull(const Frustum& frustum, std::vector<entt::entity>& visible, ThreadPool* threadPool = nullptr); //!< fills visible with the gathered entities that intersect the frustum, preserving their order
+		uint32_t getVisibleCount() const { return m_visibleCount; } //!< returns the number of entities that passed the last cull
+		uint32_t getCulledCount() const { return static_cast<uint32_t>(m_entities.size()) - m_visibleCount; } //!< returns the number of entities rejected by the last cull
+	private:
+		void cullRange(const Frustum& frustum, size_t begin, size_t end); //!< writes visibility flags for gathered spheres in [begin, end)
+	private:
+		std::vector<float> m_centreX; //!< world space sphere centre x
+		std::vector<float> m_centreY; //!< world space sphere centre y
+		std::vector<float> m_centreZ; //!< world space sphere centre z
+		std::vector<float> m_radius; //!< world space sphere radius
+		std::vector<entt::entity> m_entities; //!< entities matching the SoA arrays
+		std::vector<uint8_t> m_visibility; //!< per entity result of the last cull
+		uint32_t m_visibleCount = 0; //!< number of visible entities from the last cull
+	};
+}
@@ -0,0 +1,115 @@
+/** \file gpuCuller.hpp */
+
+#pragma once
+
+#include "rendering/pipeline.hpp"
+#include "rendering/swapchain.hpp"
+#include "rendering/culling.hpp"
+
+/* \class GpuCuller
+*  \brief culls instances of a mesh in a compute pass against the frustum and a hierarchical depth pyramid of the previous frame, compacting the survivors into indirect draw commands
+*/
+class GpuCuller
+{
+public:
+	/* \struct CullUniforms
+	*  \brief std140 uniform block read by cull.comp
+	*/
+	struct CullUniforms
+	{
+		glm::mat4 pyramidView; //!< view the depth pyramid was rendered with
+		glm::vec4 frustumPlanes[6]; //!< planes of the current view projection
+		glm::vec4 pyramidProjection; //!< p00, p11, p22 and p32 of the projection the depth pyramid was rendered with
+		glm::vec2 depthSize; //!< size of the depth attachment the pyramid was built from
+		float zNear; //!< near plane of the pyramid projection
+		uint32_t instanceCount; //!< number of instances to cull
+		uint32_t pyramidLevels; //!< number of levels in the depth pyramid
+		uint32_t occlusionEnabled; //!< 0 skips the depth pyramid test
+		uint32_t padding[2]; //!< pads the block to a multiple of 16 bytes
+	};
+
+	static const uint32_t MAX_PYRAMID_LEVELS = 16; //!< enough levels for a 65536 pixel wide depth attachment
+
+	GpuCuller(Device* device, uint32_t maxInstances, VkExtent2D depthExtent, VkSampleCountFlagBits depthSamples, const std::string& shaderDirectory = "./res/shaders/culling/"); //!< constructor
+	~GpuCuller(); //!< destructor
+
+	GpuCuller(const GpuCuller&) = delete; //!< copy constructor
+	GpuCuller& operator=(const GpuCuller&) = delete; //!< copy assignment
+
+	uint32_t getInstanceCount() const { return static_cast<uint32_t>(m_instances.size()); } //!< returns the number of instances being culled
+	const std::vector<Rock::GpuInstance>& getInstances() const { return m_instances; } //!< returns the instances being culled
+	uint32_t getVisibleCount(uint32_t frame) const { return m_readbackMapped[frame][0]; } //!< returns the number of instances drawn by a frame; valid once the frame's fence has signalled
+	uint32_t getFrustumCount(uint32_t frame) const { return m_readbackMapped[frame][1]; } //!< returns the number of instances of a frame inside the frustum, before the occlusion test; valid once the frame's fence has signalled
+	VkDescriptorSetLayout getInstanceDescriptorSetLayout() const { return m_instanceSetLayout; } //!< returns the layout of the set exposing the instance buffer to vertex shaders
+	VkDescriptorSet getInstanceDescriptorSet() const { return m_instanceSet; } //!< returns the set exposing the instance buffer to vertex shaders
+	bool isOcclusionEnabled() const { return m_occlusionEnabled; } //!< returns if instances are tested against the depth pyramid
+	void setOcclusionEnabled(bool enabled) { m_occlusionEnabled = enabled; } //!< enables or disables the depth pyramid test
+	const glm::mat4& getView() const { return m_view; } //!< returns the view used for the frustum test
+	const glm::mat4& getProjection() const { return m_projection; } //!< returns the projection used for the frustum test
+	VkImage getPyramidImage() const { return m_pyramidImage; } //!< returns the depth pyramid image
+	uint32_t getPyramidLevels() const { return m_pyramidLevels; } //!< returns the number of depth pyramid levels
+	VkBuffer getDrawCommandBuffer() const { return m_drawCommandBuffer; } //!< returns the buffer of compacted indirect draw commands; the firstInstance of each is the index of an instance that survived the cull
+	VkBuffer getDrawCountBuffer() const { return m_drawCountBuffer; } //!< returns the buffer holding the number of draw commands
+
+	void setInstances(const std::vector<Rock::GpuInstance>& instances); //!< uploads the instances; must not be called while frames using them are in flight
+	void setCamera(const glm::mat4& view, const glm::mat4& projection) { m_view = view; m_projection = projection; } //!< sets the camera for the next cull
+	void setDepthExtent(VkExtent2D depthExtent); //!< recreates the depth pyramid if the depth attachment changed size; call before importing the pyramid into a render graph
+	void recordCull(VkCommandBuffer commandBuffer, uint32_t frame, VkExtent2D depthExtent); //!< records the cull dispatch; must be outside a render pass, after a barrier making the pyramid readable in VK_IMAGE_LAYOUT_GENERAL and ordering the previous frame's reads of the draw buffers before their writes
+	void recordDraw(VkCommandBuffer commandBuffer); //!< records the indirect draw of the surviving instances; the pipeline, sets and mesh buffers must already be bound
+	void recordDepthPyramid(VkCommandBuffer commandBuffer, VkImageView depthImageView); //!< records the depth pyramid build; the depth attachment must already be in VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, and returning it for the next render pass is left to the caller
+private:
+	void createDescriptorSetLayouts(); //!< creates the cull, pyramid and instance set layouts
+	void createPipelines(const std::string& shaderDirectory); //!< creates the cull and pyramid compute pipelines
+	void createBuffers(); //!< creates the instance, draw command, draw count, uniform and readback buffers
+	void createDescriptorSets(); //!< allocates and writes the cull and instance sets
+	void createDepthPyramid(VkExtent2D depthExtent); //!< creates the pyramid image, its views and sampler and writes the sets that use them
+	void destroyDepthPyramid(); //!< destroys the pyramid image, its views and frees the pyramid sets
+	void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect, uint32_t baseLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess); //!< records an image memory barrier
+private:
+	Device* m_device; //!< device object pointer
+	uint32_t m_maxInstances; //!< capacity of the instance and draw command buffers
+	VkSampleCountFlagBits m_depthSamples; //!< sample count of the depth attachment
+	std::vector<Rock::GpuInstance> m_instances; //!< CPU copy of the uploaded instances
+	bool m_occlusionEnabled = true; //!< if the depth pyramid test is enabled
+
+	Pipeline* m_cullPipeline; //!< cull.comp pipeline
+	Pipeline* m_pyramidPipeline; //!< hiz.comp pipeline
+	Pipeline* m_pyramidMultisamplePipeline; //!< hiz.comp pipeline reading a multisampled depth attachment
+	VkDescriptorSetLayout m_cullSetLayout; //!< layout for cull.comp
+	VkDescriptorSetLayout m_pyramidSetLayout; //!< layout for hiz.comp
+	VkDescriptorSetLayout m_instanceSetLayout; //!< layout for vertex shaders reading the instance buffer
+	VkDescriptorPool m_descriptorPool; //!< pool for every set owned by the culler
+	std::vector<VkDescriptorSet> m_cullSets; //!< cull set for each frame in flight
+	std::vector<VkDescriptorSet> m_pyramidSets; //!< pyramid set for each level
+	VkDescriptorSet m_instanceSet; //!< instance set for vertex shaders
+
+	VkBuffer m_instanceBuffer; //!< device local instances
+	VkDeviceMemory m_instanceBufferMemory; //!< memory for the instance buffer
+	VkBuffer m_drawCommandBuffer; //!< compacted VkDrawIndexedIndirectCommand entries
+	VkDeviceMemory m_drawCommandBufferMemory; //!< memory for the draw command buffer
+	VkBuffer m_drawCountBuffer; //!< number of valid draw commands, followed by the number of instances inside the frustum
+	VkDeviceMemory m_drawCountBufferMemory; //!< memory for the draw count buffer
+	std::vector<VkBuffer> m_uniformBuffers; //!< cull uniforms for each frame in flight
+	std::vector<VkDeviceMemory> m_uniformBuffersMemory; //!< memory for the uniform buffers
+	std::vector<void*> m_uniformBuffersMapped; //!< persistently mapped uniform buffers
+	std::vector<VkBuffer> m_readbackBuffers; //!< host visible copy of the draw and frustum counts for each frame in flight
+	std::vector<VkDeviceMemory> m_readbackBuffersMemory; //!< memory for the readback buffers
+	std::vector<uint32_t*> m_readbackMapped; //!< persistently mapped readback buffers
+
+	VkImage m_pyramidImage = VK_NULL_HANDLE; //!< R32_SFLOAT depth pyramid
+	VkDeviceMemory m_pyramidImageMemory; //!< memory for the depth pyramid
+	VkImageView m_pyramidView; //!< view of every pyramid level, sampled by cull.comp
+	std::vector<VkImageView> m_pyramidLevelViews; //!< view of each pyramid level, used by hiz.comp
+	VkSampler m_pyramidSampler; //!< nearest clamped sampler for texel fetches
+	VkExtent2D m_depthExtent{}; //!< size of the depth attachment the pyramid is built from
+	VkExtent2D m_pyramidExtent{}; //!< size of pyramid level 0
+	uint32_t m_pyramidLevels = 0; //!< number of pyramid levels
+	VkImageView m_depthSourceView = VK_NULL_HANDLE; //!< depth view currently written to the level 0 pyramid set
+	bool m_pyramidValid = false; //!< if the pyramid holds a previous frame's depth
+
+	glm::mat4 m_view{ 1.f }; //!< current view
+	glm::mat4 m_projection{ 1.f }; //!< current projection
+	glm::mat4 m_pyramidCameraView{ 1.f }; //!< view the depth pyramid was rendered with
+	glm::mat4 m_pyramidCameraProjection{ 1.f }; //!< projection the depth pyramid was rendered with
+};
@@ -0,0 +1,62 @@
+/** \file gpuLayout.hpp */
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+/* \namespace GpuLayout
+*  \brief the GLSL buffer layout rules evaluated at compile time, so every C++ mirror of a shader block can assert that each member sits where the shader places it rather than only checking its total size
+*/
+namespace GpuLayout
+{
+	/* \enum Rules
+	*  \brief the layout a block is declared with
+	*/
+	enum class Rules
+	{
+		Std140, //!< uniform blocks; arrays and nested structs are aligned to 16 bytes
+		Std430, //!< storage blocks; as std140 without rounding arrays and structs up to 16 bytes
+		Scalar //!< VK_EXT_scalar_block_layout; every member is aligned to its component type
+	};
+
+	constexpr size_t alignUp(size_t offset, size_t alignment) { return (offset + alignment - 1) / alignment * alignment; } //!< rounds an offset up to a multiple of alignment
+
+	/* \struct Type
+	*  \brief alignment and size of a scalar, vector, matrix or array under a set of layout rules
+	*/
+	template<Rules R, typename T>
+	struct Type
+	{
+		static_assert(sizeof(T) == 4, "Only 32 bit scalars, glm vectors and matrices and arrays of them have a known GLSL layout");
+		static constexpr size_t alignment = 4; //!< base alignment
+		static constexpr size_t size = 4; //!< bytes occupied, excluding any padding before the next member
+	};
+
+	template<Rules R, glm::length_t L, typename T, glm::qualifier Q>
+	struct Type<R, glm::vec<L, T, Q>>
+	{
+		static constexpr size_t alignment = R == Rules::Scalar ? Type<R, T>::alignment : Type<R, T>::alignment * (L == 3 ? 4 : L); //!< a vec3 aligns as a vec4 outside the scalar layout
+		static constexpr size_t size = Type<R, T>::size * L; //!< a vec3 leaves its fourth component free for a following scalar
+	};
+
+	template<Rules R, typename T, size_t N>
+	struct Type<R, T[N]>
+	{
+		static constexpr size_t alignment = R == Rules::Std140 ? alignUp(Type<R, T>::alignment, 16) : Type<R, T>::alignment; //!< alignment of the elements, rounded up to 16 bytes in std140
+		static constexpr size_t stride = alignUp(Type<R, T>::size, alignment); //!< bytes between consecutive elements
+		static constexpr size_t size = stride * N; //!< bytes occupied by every element
+	};
+
+	template<Rules R, glm::length_t C, glm::length_t L, typename T, glm::qualifier Q>
+	struct Type<R, glm::mat<C, L, T, Q>> : Type<R, glm::vec<L, T, Q>[C]> {}; //!< column major matrices lay out as an array of their columns
+
+	template<Rules R, typename Member>
+	constexpr size_t getOffset(size_t previousOffset, size_t previousSize) { return alignUp(previousOffset + previousSize, Type<R, Member>::alignment); } //!< returns where a member is placed after a previous member
+}
+
+#define GPU_LAYOUT_MEMBER(rules, Struct, previous, member) \
+	static_assert(offsetof(Struct, member) == GpuLayout::getOffset<GpuLayout::Rules::rules, decltype(Struct::member)>(offsetof(Struct, previous), GpuLayout::Type<GpuLayout::Rules::rules, decltype(Struct::previous)>::size), \
+		#Struct "::" #member " is not at the offset the " #rules " layout places it after " #previous) //!< asserts that a member directly follows another member as a block with the given rules lays it out
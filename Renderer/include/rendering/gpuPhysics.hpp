@@ -0,0 +1,155 @@
+/** \file gpuPhysics.hpp */
+
+#pragma once
+
+#include "rendering/particleSystem.hpp"
+#include "components/transformComponent.hpp"
+#include "components/colliderComponent.hpp"
+#include "components/rigidbodyComponent.hpp"
+
+#include <entt/entt.hpp>
+#include <glm/glm.hpp>
+
+#include <string>
+
+/* \struct PhysicsSettings
+*  \brief configures the bodies, contacts and bounds of a sphere simulation
+*/
+struct PhysicsSettings
+{
+	uint32_t maxBodies = 1 << 20; //!< capacity of the body buffers
+	uint32_t maxMirrored = 1024; //!< most bodies whose results are copied back for the CPU each step
+	float maxRadius = 0.05f; //!< largest body radius; the hash grid cells are one body diameter wide
+	glm::vec3 gravity{ 0.f, -9.8f, 0.f }; //!< acceleration applied to every dynamic body
+	glm::vec3 boundsMin{ -1.f }; //!< corner of the box the bodies are kept inside
+	glm::vec3 boundsMax{ 1.f }; //!< opposite corner of the box the bodies are kept inside
+	float stiffness = 2000.f; //!< spring constant pushing overlapping bodies apart; the time step must stay well below sqrt(mass / stiffness)
+	float damping = 2.f; //!< dashpot constant opposing the approach speed of touching bodies
+	float restitution = 0.5f; //!< fraction of the normal speed kept when a body bounces off the bounds
+	std::string shaderDirectory = "./res/shaders/physics/"; //!< directory holding the compiled physics shaders
+};
+
+/* \class GpuPhysics
+*  \brief simulates sphere bodies with compute shaders: each step hashes the bodies into a uniform grid, groups them by cell with a counting sort, then resolves each body's contacts with its neighbours and integrates it, reading the previous state and writing the other buffer of a ping-pong pair so the result does not depend on the order bodies are processed in; simulate runs the same step on the CPU as a reference
+*/
+class GpuPhysics
+{
+public:
+	/* \struct Body
+	*  \brief std430 sphere body read and written by the physics shaders
+	*/
+	struct Body
+	{
+		glm::vec3 position; //!< world position of the centre
+		float radius; //!< radius, at most PhysicsSettings::maxRadius
+		glm::vec3 velocity; //!< velocity in units per second
+		float inverseMass; //!< reciprocal of the mass, 0 for a static body
+
+		static Body create(const Rock::TransformComponent& transform, const Rock::SphereComponent& sphere, const Rock::RigidbodyComponent* rigidbody)
+		{
+			Body body{};
+			body.position = transform.m_translation;
+			body.radius = sphere.m_radius;
+			body.velocity = rigidbody ? rigidbody->m_velocity : glm::vec3(0.f);
+			body.inverseMass = rigidbody && rigidbody->m_mass > 0.f ? 1.f / rigidbody->m_mass : 0.f;
+			return body;
+		} //!< creates a body from an entity's components; without a rigidbody the body is static
+	};
+
+	/* \struct PhysicsUniforms
+	*  \brief std140 uniform block read by the physics shaders
+	*/
+	struct PhysicsUniforms
+	{
+		glm::vec4 gravity; //!< acceleration, with the restitution at the bounds in w
+		glm::vec4 boundsMin; //!< lower corner of the bounds, with the cell size in w
+		glm::vec4 boundsMax; //!< upper corner of the bounds, with the contact stiffness in w
+		float damping; //!< dashpot constant of contacts
+		uint32_t bodyCount; //!< number of bodies simulated
+		uint32_t tableSize; //!< buckets in the hash table
+		uint32_t mirrorCount; //!< number of bodies copied back for the CPU
+	};
+
+	/* \struct MirroredBody
+	*  \brief std430 state of a mirrored body copied back for the CPU
+	*/
+	struct MirroredBody
+	{
+		glm::vec4 position; //!< position, w unused
+		glm::vec4 velocity; //!< velocity, w unused
+	};
+
+	static const uint32_t WORKGROUP_SIZE = 256; //!< local size of every physics shader
+	static const uint32_t MAX_BODIES = 1 << 23; //!< keeps the hash table and its scan within a one dimensional dispatch
+
+	GpuPhysics(Device* device, const PhysicsSettings& settings); //!< constructor
+	~GpuPhysics(); //!< destructor
+
+	GpuPhysics(const GpuPhysics&) = delete; //!< copy constructor
+	GpuPhysics& operator=(const GpuPhysics&) = delete; //!< copy assignment
+
+	static uint32_t getTableSize(uint32_t maxBodies); //!< returns the buckets in the hash table, the power of two at or above maxBodies
+	static glm::ivec3 getCell(const glm::vec3& position, const PhysicsSettings& settings) { return glm::ivec3(glm::floor((position - settings.boundsMin) / (2.f * settings.maxRadius))); } //!< returns the grid cell holding a position
+	static uint32_t hashCell(const glm::ivec3& cell, uint32_t tableSize) { return ((static_cast<uint32_t>(cell.x) * 73856093u) ^ (static_cast<uint32_t>(cell.y) * 19349663u) ^ (static_cast<uint32_t>(cell.z) * 83492791u)) % tableSize; } //!< returns the bucket of a cell, matching hashCell in the shaders
+	static void simulate(std::vector<Body>& bodies, const PhysicsSettings& settings, float deltaTime); //!< steps the bodies on the CPU with the same grid, contact model and integration as the shaders
+
+	const PhysicsSettings& getSettings() const { return m_settings; } //!< returns the settings
+	uint32_t getBodyCount() const { return m_bodyCount; } //!< returns the number of bodies simulated
+	void setBodies(const std::vector<Body>& bodies); //!< uploads the bodies, replacing any simulated so far; waits for the device
+	std::vector<Body> getBodies() const; //!< copies the current bodies back; waits for the device
+	void mirror(entt::entity entity, uint32_t body); //!< copies a body's position into the entity's TransformComponent, and its velocity into any RigidbodyComponent, at each syncTransforms; waits for the device
+
+	void recordStep(VkCommandBuffer commandBuffer, float deltaTime); //!< records one step, which may follow other steps in the same command buffer; the time step is a push constant, so nothing is written until submission
+	void step(float deltaTime, uint32_t substeps = 1); //!< records substeps steps of deltaTime each, submits them to the compute queue and waits for them
+	void syncTransforms(entt::registry& registry) const; //!< writes the mirrored bodies of the last finished step into their entities' components
+private:
+	void createDescriptorSetLayout(); //!< creates the set layout shared by every physics shader
+	void createPipelines(); //!< creates the compute pipelines
+	void createBuffers(); //!< creates the body, hash, scan, cursor, sorted, mirror and uniform buffers
+	void createDescriptorSets(); //!< allocates and writes the set of each ping-pong direction
+	void createCommandBuffer(); //!< allocates the command buffer and fence step submits with
+	void writeUniforms(); //!< writes the settings and counts to the uniform buffer; the device must be idle
+	void dispatch(VkCommandBuffer commandBuffer, Pipeline* pipeline, uint32_t groups, const uint32_t* pushConstants = nullptr); //!< binds a compute pipeline and the current direction's set and records a dispatch
+	void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VkAccessFlags srcAccess = VK_ACCESS_SHADER_WRITE_BIT); //!< makes earlier writes visible to the following compute shaders
+private:
+	Device* m_device; //!< device object pointer
+	PhysicsSettings m_settings; //!< settings the buffers were created with
+	uint32_t m_tableSize; //!< buckets in the hash table
+	std::vector<ParticleSystem::ScanLevel> m_scanLevels; //!< levels of the prefix sum over the bucket counts
+	uint32_t m_bodyCount = 0; //!< number of bodies simulated
+	uint32_t m_current = 0; //!< body buffer holding the latest state
+	std::vector<std::pair<entt::entity, uint32_t>> m_mirrored; //!< entities and the bodies copied into them
+	size_t m_gatheredCount = 0; //!< mirrored bodies the last recorded step copies back
+
+	Pipeline* m_hashPipeline; //!< hash.comp pipeline
+	Pipeline* m_scanPipeline; //!< scan.comp pipeline
+	Pipeline* m_scanAddPipeline; //!< scanAdd.comp pipeline
+	Pipeline* m_scatterPipeline; //!< scatter.comp pipeline
+	Pipeline* m_collidePipeline; //!< collide.comp pipeline
+	Pipeline* m_gatherPipeline; //!< gather.comp pipeline
+	VkDescriptorSetLayout m_setLayout; //!< layout shared by every physics shader
+	VkDescriptorPool m_descriptorPool; //!< pool for the sets
+	VkDescriptorSet m_sets[2]; //!< set reading each body buffer and writing the other
+	VkCommandBuffer m_commandBuffer; //!< command buffer step records into
+	VkFence m_fence; //!< signalled when a step submission has finished
+
+	VkBuffer m_bodyBuffers[2]; //!< ping-pong pair of body buffers
+	VkDeviceMemory m_bodyBuffersMemory[2]; //!< memory for the body buffers
+	VkBuffer m_hashBuffer; //!< bucket of each body
+	VkDeviceMemory m_hashBufferMemory; //!< memory for the hash buffer
+	VkBuffer m_scanBuffer; //!< body count of each bucket scanned into the first sorted index of each bucket, followed by the block totals of every scan level
+	VkDeviceMemory m_scanBufferMemory; //!< memory for the scan buffer
+	VkBuffer m_cursorBuffer; //!< bodies placed into each bucket so far by the scatter
+	VkDeviceMemory m_cursorBufferMemory; //!< memory for the cursor buffer
+	VkBuffer m_sortedBuffer; //!< body indices grouped by bucket
+	VkDeviceMemory m_sortedBufferMemory; //!< memory for the sorted buffer
+	VkBuffer m_mirrorIndexBuffer; //!< body index of each mirrored entity
+	VkDeviceMemory m_mirrorIndexBufferMemory; //!< memory for the mirror index buffer
+	void* m_mirrorIndexMapped; //!< persistently mapped mirror index buffer
+	VkBuffer m_mirrorBuffer; //!< state of each mirrored body after the last step
+	VkDeviceMemory m_mirrorBufferMemory; //!< memory for the mirror buffer
+	void* m_mirrorMapped; //!< persistently mapped mirror buffer
+	VkBuffer m_uniformBuffer; //!< uniforms of the steps
+	VkDeviceMemory m_uniformBufferMemory; //!< memory for the uniform buffer
+	void* m_uniformMapped; //!< persistently mapped uniform buffer
+};
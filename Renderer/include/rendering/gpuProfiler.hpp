@@ -0,0 +1,107 @@
+/** \file gpuProfiler.hpp */
+
+#pragma once
+
+#include "core/device.hpp"
+
+#include <string>
+
+/* \class GpuProfiler
+*  \brief times scopes of a frame's command buffer with timestamp queries and counts their work with pipeline statistics queries; each frame in flight has its own query pools, read back without waiting when the frame's slot is next recorded
+*/
+class GpuProfiler
+{
+public:
+	static const uint32_t MAX_SCOPES = 64; //!< scopes recorded per frame; further scopes are ignored
+	static const uint32_t STATISTIC_COUNT = 6; //!< pipeline statistics counted per outermost scope
+	static const VkQueryPipelineStatisticFlags STATISTIC_FLAGS = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT | VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT; //!< statistics counted; results are written in bit order, matching getStatisticName
+
+	/* \struct ScopeResult
+	*  \brief the measurements of one scope of a completed frame
+	*/
+	struct ScopeResult
+	{
+		std::string name; //!< scope name
+		uint32_t depth; //!< nesting depth, 0 for outermost scopes
+		double milliseconds; //!< GPU time between the start and end of the scope
+		bool hasStatistics; //!< if statistics were counted; only outermost scopes on devices with pipelineStatisticsQuery and inheritedQueries count them
+		uint64_t statistics[STATISTIC_COUNT]; //!< counters in the order getStatisticName reports
+	};
+
+	/* \class Scope
+	*  \brief times the commands recorded during its lifetime; a null profiler records nothing
+	*/
+	class Scope
+	{
+	public:
+		Scope(GpuProfiler* profiler, VkCommandBuffer commandBuffer, const std::string& name) : m_profiler(profiler), m_commandBuffer(commandBuffer) { if (m_profiler) m_profiler->beginScope(m_commandBuffer, name); } //!< constructor, begins the scope
+		~Scope() { if (m_profiler) m_profiler->endScope(m_commandBuffer); } //!< destructor, ends the scope
+
+		Scope(const Scope&) = delete; //!< copy constructor
+		Scope& operator=(const Scope&) = delete; //!< copy assignment
+	private:
+		GpuProfiler* m_profiler; //!< profiler the scope is recorded to
+		VkCommandBuffer m_commandBuffer; //!< command buffer the scope is recorded in
+	};
+
+	GpuProfiler(Device* device, uint32_t framesInFlight); //!< constructor
+	~GpuProfiler(); //!< destructor
+
+	GpuProfiler(const GpuProfiler&) = delete; //!< copy constructor
+	GpuProfiler& operator=(const GpuProfiler&) = delete; //!< copy assignment
+
+	static const char* getStatisticName(uint32_t index); //!< returns the name of a pipeline statistic
+	static std::string toCsv(const std::vector<ScopeResult>& results); //!< returns one line per scope with a header row
+	static std::string toJson(const std::vector<ScopeResult>& results); //!< returns an array of scope objects
+
+	bool isEnabled() const { return m_enabled; } //!< returns if scopes are recorded
+	void setEnabled(bool enabled) { m_enabled = enabled && m_timestampsSupported; } //!< enables or disables recording from the next beginFrame; stays disabled on queues without timestamps
+	bool hasStatistics() const { return m_statisticsSupported; } //!< returns if pipeline statistics are counted
+	VkQueryPipelineStatisticFlags getInheritedStatistics() const { return m_statisticsSupported ? STATISTIC_FLAGS : 0; } //!< returns the statistics secondary command buffers must inherit, as a scope's query may be active while they execute
+	const std::vector<ScopeResult>& getResults() const { return m_results; } //!< returns the scopes of the latest completed frame
+	double getFrameMilliseconds() const; //!< returns the summed time of the outermost scopes of the latest completed frame
+
+	void beginFrame(VkCommandBuffer commandBuffer, uint32_t frame); //!< reads back the results the frame's slot recorded last time, then resets its queries and latches whether the frame's scopes are recorded; call after the frame's fence has been waited on, outside a render pass
+	void beginScope(VkCommandBuffer commandBuffer, const std::string& name); //!< writes the start timestamp of a scope; outermost scopes must begin and end on the same side of a render pass
+	void endScope(VkCommandBuffer commandBuffer); //!< writes the end timestamp of the innermost open scope
+	void exportCsv(const std::string& path) const; //!< writes the latest results as CSV
+	void exportJson(const std::string& path) const; //!< writes the latest results as JSON
+private:
+	/* \struct PendingScope
+	*  \brief a scope recorded into a frame whose queries have not been read
+	*/
+	struct PendingScope
+	{
+		std::string name; //!< scope name
+		uint32_t depth; //!< nesting depth
+		uint32_t statisticsQuery; //!< index in the statistics pool, UINT32_MAX if none
+	};
+
+	/* \struct FrameQueries
+	*  \brief the query pools and scopes of one frame in flight
+	*/
+	struct FrameQueries
+	{
+		VkQueryPool timestamps = VK_NULL_HANDLE; //!< start and end timestamp of each scope
+		VkQueryPool statistics = VK_NULL_HANDLE; //!< statistics of each outermost scope
+		std::vector<PendingScope> scopes; //!< scopes recorded since the last reset
+		uint32_t statisticsUsed = 0; //!< statistics queries recorded since the last reset
+	};
+
+	void collect(FrameQueries& queries); //!< replaces the results with the frame's queries if every one is available
+	void writeFile(const std::string& path, const std::string& contents) const; //!< writes an export, throwing if the file cannot be opened
+private:
+	Device* m_device; //!< device object pointer
+	std::vector<FrameQueries> m_frames; //!< queries of each frame in flight
+	uint32_t m_currentFrame = 0; //!< frame scopes are recorded into
+	std::vector<uint32_t> m_openScopes; //!< scope indices of the open scopes, UINT32_MAX for ignored scopes
+	std::vector<ScopeResult> m_results; //!< results of the latest completed frame
+	double m_timestampPeriod; //!< nanoseconds per timestamp tick
+	uint64_t m_timestampMask; //!< valid bits of a timestamp
+	bool m_timestampsSupported; //!< if the graphics queue writes timestamps
+	bool m_statisticsSupported; //!< if pipeline statistics queries and inherited queries are enabled
+	bool m_enabled; //!< if scopes are recorded from the next beginFrame
+	bool m_frameEnabled = false; //!< if the current frame's queries were reset, so its scopes are recorded
+};
@@ -0,0 +1,117 @@
+/** \file lightClusterer.hpp */
+
+#pragma once
+
+#include "rendering/pipeline.hpp"
+#include "rendering/swapchain.hpp"
+#include "rendering/lights.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+
+/* \class LightClusterer
+*  \brief bins point and spot lights into a grid of view space clusters each frame in a compute pass, so a fragment only shades the lights whose range reaches its cluster
+*/
+class LightClusterer
+{
+public:
+	/* \struct GpuLight
+	*  \brief std430 point or spot light read by cluster.comp and the fragment shaders
+	*/
+	struct GpuLight
+	{
+		glm::vec3 position; //!< world position of the light
+		float range; //!< distance beyond which the light contributes nothing
+		glm::vec3 colour; //!< colour of the light
+		float innerCutOffCosine; //!< cosine of the angle a spot light starts to fade at
+		glm::vec3 direction; //!< normalised direction a spot light is pointing
+		float outerCutOffCosine; //!< cosine of the angle a spot light has faded out at
+		glm::vec3 constants; //!< constant, linear and exponential attenuation
+		uint32_t type; //!< POINT or SPOT
+
+		static GpuLight create(const PointLight& light); //!< creates a point light whose range is where its attenuated colour falls below LIGHT_THRESHOLD
+		static GpuLight create(const SpotLight& light); //!< creates a spot light whose range is where its attenuated colour falls below LIGHT_THRESHOLD
+	};
+
+	/* \struct ClusterUniforms
+	*  \brief std140 uniform block read by cluster.comp and the fragment shaders
+	*/
+	struct ClusterUniforms
+	{
+		glm::mat4 inverseProjection; //!< inverse of the projection, taking the near plane back to view space
+		glm::mat4 view; //!< view the clusters are aligned to
+		glm::vec2 screenSize; //!< size of the render target in pixels
+		glm::vec2 tileSize; //!< size of a cluster's screen tile in pixels
+		float zNear; //!< depth of the first slice
+		float zFar; //!< depth of the end of the last slice
+		float sliceScale; //!< GRID_Z / log(zFar / zNear)
+		float sliceBias; //!< -GRID_Z * log(zNear) / log(zFar / zNear), so a depth's slice is floor(log(depth) * sliceScale + sliceBias)
+		glm::uvec4 gridSize; //!< clusters along x, y and z, with the light count in w
+	};
+
+	static const uint32_t POINT = 0; //!< GpuLight::type of a point light
+	static const uint32_t SPOT = 1; //!< GpuLight::type of a spot light
+	static const uint32_t GRID_X = 16; //!< clusters across the screen
+	static const uint32_t GRID_Y = 9; //!< clusters down the screen
+	static const uint32_t GRID_Z = 24; //!< exponentially spaced depth slices
+	static const uint32_t CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z; //!< clusters in the grid
+	static const uint32_t MAX_LIGHTS_PER_CLUSTER = 255; //!< lights listed per cluster; further lights reaching a full cluster are dropped from it
+	static const uint32_t CLUSTER_STRIDE = MAX_LIGHTS_PER_CLUSTER + 1; //!< uints per cluster in the cluster buffer: the light count followed by the light indices
+	static const uint32_t WORKGROUP_SIZE = 128; //!< local size of cluster.comp, one invocation per cluster
+	static constexpr float LIGHT_THRESHOLD = 1.f / 256.f; //!< attenuated intensity treated as no light, the smallest step of an 8 bit colour
+
+	LightClusterer(Device* device, uint32_t maxLights, const std::string& shaderDirectory = "./res/shaders/lighting/"); //!< constructor
+	~LightClusterer(); //!< destructor
+
+	LightClusterer(const LightClusterer&) = delete; //!< copy constructor
+	LightClusterer& operator=(const LightClusterer&) = delete; //!< copy assignment
+
+	static float getRange(const glm::vec3& colour, const glm::vec3& constants); //!< returns the distance at which the brightest channel of colour attenuated by constants falls to LIGHT_THRESHOLD, or FLT_MAX if it never does
+	static glm::vec4 getBoundingSphere(const GpuLight& light); //!< returns the world space sphere enclosing the lit volume: the range sphere of a point light, or the smallest sphere around a spot light's cone
+	static ClusterUniforms createUniforms(const glm::mat4& view, const glm::mat4& projection, VkExtent2D extent, float zNear, float zFar, uint32_t lightCount); //!< returns the uniforms for a camera and render target
+	static void getClusterBounds(const ClusterUniforms& uniforms, uint32_t cluster, glm::vec3& boundsMin, glm::vec3& boundsMax); //!< returns the view space box enclosing a cluster, matching cluster.comp
+	static uint32_t getCluster(const ClusterUniforms& uniforms, const glm::vec2& fragCoord, float viewDepth); //!< returns the cluster of a fragment, matching the fragment shaders
+	static std::vector<uint32_t> assign(const std::vector<GpuLight>& lights, const ClusterUniforms& uniforms); //!< bins the lights on the CPU exactly as cluster.comp, returning the cluster buffer contents with unused slots zeroed
+
+	uint32_t getMaxLights() const { return m_maxLights; } //!< returns the capacity of each frame's light buffer
+	uint32_t getLightCount(uint32_t frame) const { return m_lightCounts[frame]; } //!< returns the number of lights set for a frame
+	VkBuffer getUniformBuffer(uint32_t frame) const { return m_uniformBuffers[frame]; } //!< returns a frame's cluster uniforms
+	VkBuffer getLightBuffer(uint32_t frame) const { return m_lightBuffers[frame]; } //!< returns a frame's lights
+	VkBuffer getClusterBuffer(uint32_t frame) const { return m_clusterBuffers[frame]; } //!< returns a frame's light count and light indices of each cluster
+	VkDeviceSize getLightBufferSize() const { return sizeof(GpuLight) * m_maxLights; } //!< returns the size of each light buffer
+	static VkDeviceSize getClusterBufferSize() { return sizeof(uint32_t) * CLUSTER_STRIDE * CLUSTER_COUNT; } //!< returns the size of each cluster buffer
+
+	void setLights(uint32_t frame, const std::vector<GpuLight>& lights); //!< writes a frame's lights; the frame's fence must have signalled
+	void setCamera(const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar) { m_view = view; m_projection = projection; m_zNear = zNear; m_zFar = zFar; } //!< sets the camera for the next cluster pass
+	void recordCluster(VkCommandBuffer commandBuffer, uint32_t frame, VkExtent2D extent); //!< writes the frame's uniforms and records the binning dispatch; must be outside a render pass, and fragment shader reads of the cluster buffer must wait for it
+	std::vector<uint32_t> readClusters(uint32_t frame) const; //!< copies a frame's cluster buffer back; waits for the device
+private:
+	void createDescriptorSetLayout(); //!< creates the layout of the cluster.comp set
+	void createPipeline(const std::string& shaderDirectory); //!< creates the cluster.comp pipeline
+	void createBuffers(); //!< creates the uniform, light and cluster buffers of each frame in flight
+	void createDescriptorSets(); //!< allocates and writes the set of each frame in flight
+private:
+	Device* m_device; //!< device object pointer
+	uint32_t m_maxLights; //!< capacity of each light buffer
+	std::vector<uint32_t> m_lightCounts; //!< lights set for each frame in flight
+
+	Pipeline* m_clusterPipeline; //!< cluster.comp pipeline
+	VkDescriptorSetLayout m_setLayout; //!< layout for cluster.comp
+	VkDescriptorPool m_descriptorPool; //!< pool for the sets
+	std::vector<VkDescriptorSet> m_sets; //!< cluster.comp set for each frame in flight
+
+	std::vector<VkBuffer> m_uniformBuffers; //!< cluster uniforms for each frame in flight
+	std::vector<VkDeviceMemory> m_uniformBuffersMemory; //!< memory for the uniform buffers
+	std::vector<void*> m_uniformBuffersMapped; //!< persistently mapped uniform buffers
+	std::vector<VkBuffer> m_lightBuffers; //!< lights for each frame in flight
+	std::vector<VkDeviceMemory> m_lightBuffersMemory; //!< memory for the light buffers
+	std::vector<void*> m_lightBuffersMapped; //!< persistently mapped light buffers
+	std::vector<VkBuffer> m_clusterBuffers; //!< light lists written by cluster.comp for each frame in flight
+	std::vector<VkDeviceMemory> m_clusterBuffersMemory; //!< memory for the cluster buffers
+
+	glm::mat4 m_view{ 1.f }; //!< current view
+	glm::mat4 m_projection{ 1.f }; //!< current projection
+	float m_zNear = 0.1f; //!< near plane of the current projection
+	float m_zFar = 10.f; //!< far plane of the current projection
+};
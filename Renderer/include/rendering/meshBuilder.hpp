@@ -0,0 +1,56 @@
+/** \file meshBuilder.hpp */
+
+#pragma once
+
+#include "rendering/renderComponent.hpp"
+
+#include <string>
+#include <vector>
+
+namespace tinyobj
+{
+	struct attrib_t;
+	struct shape_t;
+}
+
+namespace Rock
+{
+	/* \class MeshBuilder
+	*  \brief builds an indexed mesh by deduplicating vertices through a flat open addressing table (linear probing, power of two capacity)
+	*/
+	class MeshBuilder
+	{
+	public:
+		MeshBuilder() = default; //!< default constructor
+		MeshBuilder(size_t indexCount) { reserve(indexCount); } //!< constructor, reserves space for the expected number of indices
+
+		void reserve(size_t indexCount); //!< reserves the index list and sizes the table so indexCount unique vertices fit without rehashing
+		uint32_t addVertex(const Vertex& vertex); //!< appends the index of vertex, adding the vertex if it has not been seen; returns the index
+		void clear(); //!< removes all vertices and indices, keeping the allocations
+
+		const std::vector<Vertex>& getVertices() const { return m_vertices; } //!< returns the unique vertices
+		const std::vector<uint32_t>& getIndices() const { return m_indices; } //!< returns the indices into the unique vertices
+		void build(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices); //!< moves the vertices and indices out and clears the builder
+
+		static void fromObj(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool parallel = true); //!< deduplicates obj data; with parallel each shape is deduplicated on a worker thread before merging
+		static void loadObj(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool parallel = true); //!< parses an obj file and deduplicates its vertices
+	private:
+		/* \struct Slot
+		*  \brief entry in the hash table; the tag holds the upper hash bits so most mismatches are rejected without comparing vertices
+		*/
+		struct Slot
+		{
+			uint32_t tag; //!< upper 32 bits of the vertex hash
+			uint32_t index; //!< index into m_vertices, EMPTY when the slot is unused
+		};
+		static constexpr uint32_t EMPTY = UINT32_MAX; //!< index of an unused slot
+
+		uint32_t insert(const Vertex& vertex); //!< returns the index of vertex, adding it if it has not been seen
+		void rehash(size_t capacity); //!< resizes the table to capacity slots (a power of two) and reinserts the vertices
+
+		std::vector<Vertex> m_vertices; //!< unique vertices in insertion order
+		std::vector<uint32_t> m_indices; //!< indices into m_vertices
+		std::vector<Slot> m_slots; //!< open addressing table
+		size_t m_mask = 0; //!< table capacity - 1
+	};
+}
@@ -0,0 +1,67 @@
+/** \file meshFile.hpp */
+
+#pragma once
+
+#include "rendering/renderComponent.hpp"
+
+#include <string>
+#include <vector>
+
+namespace Rock
+{
+	const uint32_t MESH_FILE_MAGIC = 0x48534D52; //!< 'RMSH' in little endian
+	const uint32_t MESH_FILE_VERSION = 1; //!< bumped whenever the layout of the file changes
+	const char* const MESH_FILE_EXTENSION = ".rmesh"; //!< extension of cooked mesh files
+
+	/* \struct MeshFileHeader
+	*  \brief header at the start of a cooked mesh file; vertex and index data follow at the stored offsets
+	*/
+	struct MeshFileHeader
+	{
+		uint32_t magic; //!< MESH_FILE_MAGIC
+		uint32_t version; //!< MESH_FILE_VERSION
+		uint32_t vertexCount; //!< number of interleaved vertices
+		uint32_t vertexStride; //!< size of a single vertex, must match sizeof(Vertex)
+		uint32_t indexCount; //!< number of indices
+		uint32_t indexSize; //!< size of a single index; 2 for VK_INDEX_TYPE_UINT16 or 4 for VK_INDEX_TYPE_UINT32
+		float boundsMin[3]; //!< minimum corner of the AABB
+		float boundsMax[3]; //!< maximum corner of the AABB
+		float sphereCentre[3]; //!< centre of the bounding sphere
+		float sphereRadius; //!< radius of the bounding sphere
+		uint64_t vertexOffset; //!< offset in bytes from the start of the file to the vertex data
+		uint64_t indexOffset; //!< offset in bytes from the start of the file to the index data
+	};
+	static_assert(sizeof(MeshFileHeader) == 80, "MeshFileHeader layout must not change without bumping MESH_FILE_VERSION");
+
+	/* \class MeshFile
+	*  \brief memory maps a cooked mesh file so its vertex and index data can be copied straight into staging buffers
+	*/
+	class MeshFile
+	{
+	public:
+		MeshFile(const std::string& path); //!< constructor, maps and validates the file
+		~MeshFile(); //!< destructor, unmaps the file
+		MeshFile(const MeshFile&) = delete; //!< copy constructor
+		MeshFile& operator=(const MeshFile&) = delete; //!< copy assignment
+
+		const MeshFileHeader& getHeader() const { return *reinterpret_cast<const MeshFileHeader*>(m_data); } //!< returns the header of the mapped file
+		const void* getVertexData() const { return m_data + getHeader().vertexOffset; } //!< returns a pointer to the mapped vertex data
+		size_t getVertexDataSize() const { return static_cast<size_t>(getHeader().vertexCount) * getHeader().vertexStride; } //!< returns the size of the vertex data in bytes
+		const void* getIndexData() const { return m_data + getHeader().indexOffset; } //!< returns a pointer to the mapped index data
+		size_t getIndexDataSize() const { return static_cast<size_t>(getHeader().indexCount) * getHeader().indexSize; } //!< returns the size of the index data in bytes
+		VkIndexType getIndexType() const { return getHeader().indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32; } //!< returns the index type to bind the index buffer with
+		MeshBounds getBounds() const; //!< returns the bounds stored in the header
+
+		static void write(const std::string& path, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices); //!< cooks vertices and indices into a mesh file, using 16 bit indices when the vertex count allows
+		static std::string getCookedPath(const std::string& path); //!< returns the path with its extension replaced by MESH_FILE_EXTENSION
+		static bool exists(const std::string& path); //!< returns if a file exists at the path
+	private:
+		void validate(const std::string& path) const; //!< throws if the mapped file is not a valid mesh file
+		void unmap(); //!< unmaps the file and closes the handles
+
+		const char* m_data = nullptr; //!< start of the mapped file
+		size_t m_size = 0; //!< size of the mapped file in bytes
+		intptr_t m_fileHandle = -1; //!< file handle (HANDLE on Windows, file descriptor otherwise)
+		intptr_t m_mappingHandle = 0; //!< file mapping handle (Windows only)
+	};
+}
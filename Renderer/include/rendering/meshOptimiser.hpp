@@ -0,0 +1,23 @@
+/** \file meshOptimiser.hpp */
+
+#pragma once
+
+#include "rendering/renderComponent.hpp"
+
+#include <vector>
+
+namespace Rock
+{
+	/* \class MeshOptimiser
+	*  \brief reorders indexed triangle lists for the GPU: post-transform vertex cache, overdraw and vertex fetch locality
+	*/
+	class MeshOptimiser
+	{
+	public:
+		static void optimiseVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount); //!< reorders triangles for the post-transform cache (Forsyth's linear speed algorithm); destination must not alias indices
+		static void optimiseOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold = 1.05f); //!< sorts cache-optimised clusters front to back from the outside in (Sander et al.); threshold bounds how much the ACMR may degrade
+		static size_t optimiseVertexFetch(Vertex* destination, uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount); //!< orders vertices by first use, remaps indices in place and drops unused vertices; returns the new vertex count
+		static float analyseVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16); //!< returns the average cache miss ratio (misses per triangle) of a FIFO cache
+		static void optimise(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices); //!< runs the vertex cache, overdraw and vertex fetch passes in order
+	};
+}
@@ -0,0 +1,59 @@
+/** \file offscreenTarget.hpp */
+
+#pragma once
+
+#include "core/device.hpp"
+
+#include <string>
+
+/* \class OffscreenTarget
+*  \brief colour and depth attachments rendered to in place of a swapchain, with each frame copied into a host visible staging buffer; lets a headless device render and save frames without a window
+*/
+class OffscreenTarget
+{
+public:
+	static const VkFormat COLOUR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM; //!< matches the channel order PngWriter expects, so readbacks need no swizzle
+
+	OffscreenTarget(Device* device, VkExtent2D extent); //!< constructor
+	~OffscreenTarget(); //!< destructor
+
+	OffscreenTarget(const OffscreenTarget&) = delete; //!< copy constructor
+	OffscreenTarget& operator=(const OffscreenTarget&) = delete; //!< copy assignment
+
+	VkRenderPass getRenderPass() const { return m_renderPass; } //!< returns the render pass pipelines drawing into the target are created with
+	VkFramebuffer getFramebuffer() const { return m_framebuffer; } //!< returns the framebuffer of the colour and depth attachments
+	VkExtent2D getExtent() const { return m_extent; } //!< returns the size of the attachments
+	VkFormat getDepthFormat() const { return m_depthFormat; } //!< returns the depth attachment format
+	VkImage getColourImage() const { return m_colourImage; } //!< returns the colour attachment
+	VkImage getDepthImage() const { return m_depthImage; } //!< returns the depth attachment
+	const std::vector<uint8_t>& getPixels() const { return m_pixels; } //!< returns the RGBA8 pixels of the last frame, top row first
+
+	VkCommandBuffer beginFrame(const VkClearColorValue& clearColour = { { 0.f, 0.f, 0.f, 1.f } }); //!< begins the command buffer and the render pass, with the viewport and scissor covering the target
+	const std::vector<uint8_t>& endFrame(); //!< ends the render pass, copies the colour attachment to the staging buffer, submits and waits, then returns the pixels
+	void saveFrame(const std::string& path) const; //!< writes the last frame to a PNG file
+private:
+	void createAttachments(); //!< creates the colour and depth images and views
+	void createRenderPass(); //!< creates the render pass, leaving the colour attachment ready to be copied
+	void createFramebuffer(); //!< creates the framebuffer
+	void createReadback(); //!< creates the staging buffer, command buffer and fence
+private:
+	Device* m_device; //!< device object pointer
+	VkExtent2D m_extent; //!< size of the attachments
+	VkFormat m_depthFormat; //!< depth format
+
+	VkImage m_colourImage; //!< colour attachment
+	VkDeviceMemory m_colourImageMemory; //!< memory for the colour attachment
+	VkImageView m_colourImageView; //!< view of the colour attachment
+	VkImage m_depthImage; //!< depth attachment
+	VkDeviceMemory m_depthImageMemory; //!< memory for the depth attachment
+	VkImageView m_depthImageView; //!< view of the depth attachment
+	VkRenderPass m_renderPass; //!< render pass
+	VkFramebuffer m_framebuffer; //!< framebuffer
+
+	VkBuffer m_stagingBuffer; //!< host visible copy of the colour attachment
+	VkDeviceMemory m_stagingBufferMemory; //!< memory for the staging buffer
+	void* m_stagingMapped; //!< persistently mapped staging buffer
+	VkCommandBuffer m_commandBuffer; //!< command buffer each frame is recorded into
+	VkFence m_fence; //!< signalled when a frame's copy has finished
+	std::vector<uint8_t> m_pixels; //!< pixels of the last frame
+};
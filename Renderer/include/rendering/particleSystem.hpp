@@ -0,0 +1,147 @@
+/** \file particleSystem.hpp */
+
+#pragma once
+
+#include "rendering/pipeline.hpp"
+#include "rendering/swapchain.hpp"
+
+#include <glm/glm.hpp>
+
+/* \struct ParticleSettings
+*  \brief configures the emitter, motion and look of a particle system
+*/
+struct ParticleSettings
+{
+	uint32_t maxParticles = 65536; //!< capacity of the particle buffers; emission stops while every particle is alive
+	float emissionRate = 8192.f; //!< particles emitted per second
+	glm::vec3 emitterPosition{ 0.f }; //!< centre of the spherical emitter
+	float emitterRadius = 0.25f; //!< radius of the spherical emitter
+	glm::vec2 lifetime{ 1.f, 3.f }; //!< range a particle's lifetime in seconds is picked from
+	glm::vec2 speed{ 0.1f, 0.5f }; //!< range a particle's initial speed is picked from, directed away from the emitter centre
+	glm::vec3 gravity{ 0.f }; //!< acceleration applied to every particle
+	glm::vec4 colourMin{ 0.f, 0.f, 0.f, 1.f }; //!< lower bound of the random colour of each particle
+	glm::vec4 colourMax{ 1.f }; //!< upper bound of the random colour of each particle
+	float pointSize = 4.f; //!< size of each point sprite in pixels
+	bool sorted = false; //!< sorts the alive particles back to front each frame for order dependent blending
+};
+
+/* \class ParticleSystem
+*  \brief simulates particles entirely on the GPU: each update simulates, emits into the slots of dead particles, compacts the alive ones with a prefix sum and optionally sorts them by depth, and the draw is driven by the alive count through vkCmdDrawIndirect
+*/
+class ParticleSystem
+{
+public:
+	/* \struct GpuParticle
+	*  \brief std430 particle read and written by the particle shaders; the life and colour are packed so each vec3 is completed by a 32 bit member and the struct holds no padding
+	*/
+	struct GpuParticle
+	{
+		glm::vec3 position; //!< world position
+		uint32_t life; //!< fraction of the lifetime left as unorm16 in the low half, 0 once dead, and the lifetime in seconds as a half float in the high half
+		glm::vec3 velocity; //!< velocity in units per second
+		uint32_t colour; //!< RGBA8 colour the particle was emitted with, as packed by packUnorm4x8
+	};
+
+	/* \struct ParticleUniforms
+	*  \brief std140 uniform block read by the particle shaders
+	*/
+	struct ParticleUniforms
+	{
+		glm::mat4 viewProjection; //!< camera the particles are drawn and sorted with
+		glm::vec4 emitter; //!< emitter centre and radius
+		glm::vec4 gravity; //!< acceleration, with the time step in seconds in w
+		glm::vec4 colourMin; //!< lower bound of the emitted colours
+		glm::vec4 colourMax; //!< upper bound of the emitted colours
+		glm::vec2 lifetime; //!< range of emitted lifetimes
+		glm::vec2 speed; //!< range of emitted speeds
+		uint32_t maxParticles; //!< capacity of the particle buffers
+		uint32_t emitCount; //!< particles to emit this update
+		uint32_t seed; //!< varies the random numbers of each update
+		float pointSize; //!< size of each point sprite in pixels
+	};
+
+	/* \struct ScanLevel
+	*  \brief a range of the scan buffer scanned in blocks, whose block totals are the next level
+	*/
+	struct ScanLevel
+	{
+		uint32_t offset; //!< first element of the level in the scan buffer
+		uint32_t count; //!< number of elements in the level
+	};
+
+	static const uint32_t WORKGROUP_SIZE = 256; //!< local size of the simulate, scan, compact and sort shaders
+	static const uint32_t EMIT_WORKGROUP_SIZE = 64; //!< local size of the emit shader
+	static const uint32_t MAX_PARTICLES = 65535 * WORKGROUP_SIZE; //!< the most particles a one dimensional dispatch is guaranteed to cover
+
+	ParticleSystem(Device* device, const ParticleSettings& settings, uint32_t framesInFlight, VkRenderPass renderPass, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, const std::string& shaderDirectory = "./res/shaders/particles/"); //!< constructor; each of the framesInFlight frames simulates from the particles of the frame before it, and every frame up to Swapchain::MAX_FRAMES_IN_FLIGHT has its own buffers
+	~ParticleSystem(); //!< destructor
+
+	ParticleSystem(const ParticleSystem&) = delete; //!< copy constructor
+	ParticleSystem& operator=(const ParticleSystem&) = delete; //!< copy assignment
+
+	static uint32_t getGroupCount(uint32_t count, uint32_t groupSize) { return (count + groupSize - 1) / groupSize; } //!< returns the workgroups covering count invocations, including a partial last group
+	static std::vector<ScanLevel> getScanLevels(uint32_t count); //!< returns the levels of a prefix sum over count elements, from the elements themselves to a level that fits in one workgroup
+	static std::vector<std::pair<uint32_t, uint32_t>> getSortPasses(uint32_t count); //!< returns the (k, j) pairs of a bitonic sort over count elements, a power of two
+
+	const ParticleSettings& getSettings() const { return m_settings; } //!< returns the settings
+	void setEmitter(const glm::vec3& position, float radius) { m_settings.emitterPosition = position; m_settings.emitterRadius = radius; } //!< moves the emitter
+	void setEmissionRate(float emissionRate) { m_settings.emissionRate = emissionRate; } //!< sets the particles emitted per second
+	void setViewProjection(const glm::mat4& viewProjection) { m_viewProjection = viewProjection; } //!< sets the camera the next update sorts with and the next draw uses
+	void reset() { m_resetPending = true; } //!< kills every particle on the next update
+	void setFramesInFlight(uint32_t framesInFlight); //!< cycles through framesInFlight frames from frame 0 and kills every particle on the next update; the device must be idle
+	Pipeline* getGraphicsPipeline() const { return m_graphicsPipeline; } //!< returns the pipeline drawing the particles as point sprites
+
+	void recordUpdate(VkCommandBuffer commandBuffer, uint32_t frame, float deltaTime); //!< records the update of the frame's particles; must be outside a render pass, and the draw must wait on it through a semaphore or a barrier to the draw indirect stage
+	void recordDraw(VkCommandBuffer commandBuffer, uint32_t frame); //!< records the indirect draw of the frame's alive particles; the graphics pipeline must already be bound
+	std::vector<GpuParticle> readParticles(uint32_t frame) const; //!< copies a frame's particles back; waits for the device
+	std::vector<glm::uvec2> readAliveList(uint32_t frame) const; //!< copies a frame's alive list of depth keys and particle indices back, including the padding of a sorted list; waits for the device
+	VkDrawIndirectCommand readDrawCommand(uint32_t frame) const; //!< copies a frame's draw command, counting its alive particles, back; waits for the device
+private:
+	void createDescriptorSetLayouts(); //!< creates the compute and draw set layouts
+	void createPipelines(const std::string& shaderDirectory); //!< creates the compute pipelines and the point sprite pipeline
+	void createBuffers(); //!< creates the particle, alive list, draw, dead list, counter, scan and uniform buffers
+	void createDescriptorSets(); //!< allocates and writes the compute and draw sets of each frame
+	void writePreviousParticles(); //!< points each frame in the ring at the particles of the frame before it
+	void dispatch(VkCommandBuffer commandBuffer, Pipeline* pipeline, uint32_t frame, uint32_t groups, const uint32_t* pushConstants = nullptr); //!< binds a compute pipeline and the frame's set and records a dispatch
+	void readBuffer(VkBuffer buffer, VkDeviceSize size, void* data) const; //!< copies size bytes of a device local buffer into data; waits for the device
+	void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VkAccessFlags srcAccess = VK_ACCESS_SHADER_WRITE_BIT); //!< makes earlier writes visible to the following compute shaders
+private:
+	Device* m_device; //!< device object pointer
+	ParticleSettings m_settings; //!< current settings
+	uint32_t m_framesInFlight; //!< frames in the ring the simulation steps through
+	uint32_t m_aliveCapacity; //!< entries in each alive list, rounded up to a power of two when sorted
+	std::vector<ScanLevel> m_scanLevels; //!< levels of the prefix sum over the alive flags
+	glm::mat4 m_viewProjection{ 1.f }; //!< camera of the next update
+	float m_emitAccumulator = 0.f; //!< fraction of a particle carried between updates
+	uint32_t m_seed = 0; //!< updates recorded so far
+	bool m_resetPending = true; //!< if the next update clears the particles
+
+	Pipeline* m_simulatePipeline; //!< simulate.comp pipeline
+	Pipeline* m_emitPipeline; //!< emit.comp pipeline
+	Pipeline* m_scanPipeline; //!< scan.comp pipeline
+	Pipeline* m_scanAddPipeline; //!< scanAdd.comp pipeline
+	Pipeline* m_compactPipeline; //!< compact.comp pipeline
+	Pipeline* m_sortPipeline; //!< sort.comp pipeline
+	Pipeline* m_graphicsPipeline; //!< point sprite pipeline
+	VkDescriptorSetLayout m_computeSetLayout; //!< layout shared by every particle compute shader
+	VkDescriptorSetLayout m_drawSetLayout; //!< layout of the point sprite shaders
+	VkDescriptorPool m_descriptorPool; //!< pool for every set owned by the particle system
+	std::vector<VkDescriptorSet> m_computeSets; //!< compute set for each frame
+	std::vector<VkDescriptorSet> m_drawSets; //!< draw set for each frame
+
+	std::vector<VkBuffer> m_particleBuffers; //!< particles of each frame
+	std::vector<VkDeviceMemory> m_particleBuffersMemory; //!< memory for the particle buffers
+	std::vector<VkBuffer> m_aliveBuffers; //!< depth key and index of each alive particle of each frame
+	std::vector<VkDeviceMemory> m_aliveBuffersMemory; //!< memory for the alive lists
+	std::vector<VkBuffer> m_drawBuffers; //!< VkDrawIndirectCommand of each frame, counting its alive particles
+	std::vector<VkDeviceMemory> m_drawBuffersMemory; //!< memory for the draw buffers
+	std::vector<VkBuffer> m_uniformBuffers; //!< uniforms of each frame
+	std::vector<VkDeviceMemory> m_uniformBuffersMemory; //!< memory for the uniform buffers
+	std::vector<void*> m_uniformBuffersMapped; //!< persistently mapped uniform buffers
+	VkBuffer m_deadBuffer; //!< indices of the dead particles after the last update
+	VkDeviceMemory m_deadBufferMemory; //!< memory for the dead list
+	VkBuffer m_counterBuffer; //!< number of dead particles after the last update
+	VkDeviceMemory m_counterBufferMemory; //!< memory for the counter buffer
+	VkBuffer m_scanBuffer; //!< alive flags and the block totals of every scan level
+	VkDeviceMemory m_scanBufferMemory; //!< memory for the scan buffer
+};
@@ -31,32 +31,43 @@ struct PipelineSettings
 	uint32_t subpass = 0; //!< index of subpass in the render pass where this pipeline will be used
 };
 
+/* \struct LayoutOverrides
+*  \brief the parts of a pipeline layout SPIR-V reflection cannot infer: set layouts owned elsewhere and buffers bound with dynamic offsets
+*/
+struct LayoutOverrides
+{
+	std::vector<VkDescriptorSetLayout> setLayouts; //!< layouts used in place of reflection, indexed by set; VK_NULL_HANDLE sets are reflected
+	uint32_t dynamicSets = 0; //!< bit per set whose uniform and storage buffers are bound with dynamic offsets
+};
+
 /* \class Pipeline
-*  \brief stores handle to pipeline object, creates default PipelineSettings, bind pipeline to VK_PIPELINE_BIND_POINT
+*  \brief stores handle to pipeline object, creates default PipelineSettings, bind pipeline to VK_PIPELINE_BIND_POINT; the pipeline and its layout are shared through the device's PipelineCache
 */
 class Pipeline
 {
 public:
-	Pipeline(Device* device, const VkPipelineLayoutCreateInfo ci, const PipelineSettings& settings, const std::string& vertFilepath, const std::string& fragFilepath); //!< graphics pipeline constructor
+	Pipeline(Device* device, const VkPipelineLayoutCreateInfo ci, const PipelineSettings& settings, const std::string& vertFilepath, const std::string& fragFilepath); //!< graphics pipeline constructor; an empty fragFilepath builds a depth only pipeline with no fragment stage
 	Pipeline(Device* device, const VkPipelineLayoutCreateInfo ci, const PipelineSettings& settings, const std::string& compFilepath); //!< compute pipeline constructor
+	Pipeline(Device* device, const PipelineSettings& settings, const std::string& vertFilepath, const std::string& fragFilepath, const LayoutOverrides& overrides = {}); //!< graphics pipeline constructor; the layout is reflected from the shaders
+	Pipeline(Device* device, const std::string& compFilepath, const LayoutOverrides& overrides = {}); //!< compute pipeline constructor; the layout is reflected from the shader
 	~Pipeline(); //!< destructor
 
 	Pipeline(const Pipeline&) = delete; //!< copy constructor
 	Pipeline& operator=(const Pipeline&) = delete; //!< copy assignment
-private:
-	void createGraphicsPipeline(const PipelineSettings& settings, const std::string& vertFilepath, const std::string& fragFilepath); //!< creates the graphics pipeline using the PipelineSettings and vert + frag shaders
-	void createComputePipeline(const PipelineSettings& settings, const std::string& compFilepath); //!< creates the compute pipeline using the PipelineSettings and compute shader
-	VkShaderModule createShaderModule(const std::vector<char>& code); //!< creates shader module from code
-	static std::vector<char> readFile(const std::string& filename); //!< reads code in shader filepath
 public:
 	void bindGraphics(VkCommandBuffer commandBuffer); //!< binds pipeline to VK_PIPELINE_BIND_POINT_GRAPHICS
 	void bindCompute(VkCommandBuffer commandBuffer); //!< binds pipeline to VK_PIPELINE_BIND_POINT_COMPUTE
 	static void defaultPipelineSettings(PipelineSettings& settings); //!< populates referenced PipelineSettings with default data
 	static void enableAlphaBlending(PipelineSettings& settings); //!< adapts referenced PipelineSettings to enable alpha blending
+	static void enableDepthOnly(PipelineSettings& settings); //!< adapts referenced PipelineSettings to a render pass with only a depth attachment: no colour blend attachment and depth tested and written
 	VkPipelineLayout getPipelineLayout() { return m_pipelineLayout; } //!< returns the handle to pipeline layout object
-	void destroyPipelineLayout(); //!< destroys m_pipelineLayout
+	const std::vector<std::string>& getShaderFilepaths() const { return m_shaderFilepaths; } //!< returns the SPIR-V files the pipeline was built from
+	void destroyPipelineLayout(); //!< releases m_pipelineLayout; the cache destroys it once no pipeline uses it
+private:
+	void createReflectedLayout(const LayoutOverrides& overrides); //!< acquires a layout built from the reflected interface of m_shaderFilepaths
 private:
 	Device* m_device; //!< device object pointer
-	VkPipeline m_pipeline; //!< handle to pipeline object
-	VkPipelineLayout m_pipelineLayout; //!< handle to pipeline layout object
+	VkPipeline m_pipeline = VK_NULL_HANDLE; //!< handle to pipeline object
+	VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE; //!< handle to pipeline layout object
+	std::vector<std::string> m_shaderFilepaths; //!< SPIR-V files the pipeline was built from
 };
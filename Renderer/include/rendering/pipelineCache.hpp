@@ -0,0 +1,89 @@
+/** \file pipelineCache.hpp */
+
+#pragma once
+
+#include "rendering/pipeline.hpp"
+#include "rendering/shaderReflection.hpp"
+#include "core/descriptors.hpp"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/* \class PipelineCache
+*  \brief owns the VkPipelineCache persisted to disk between runs, the shader modules loaded from SPIR-V files and their reflection, the descriptor set layouts derived from it and reference counted pipelines and pipeline layouts shared by every Pipeline with identical state; safe to use from several threads, with compilation running outside the lock
+*/
+class PipelineCache
+{
+public:
+	/* \struct Key
+	*  \brief every piece of state that affects a pipeline or pipeline layout, flattened into words so identical state compares and hashes equal
+	*/
+	struct Key
+	{
+		std::vector<uint64_t> words; //!< flattened state
+
+		bool operator==(const Key& other) const { return words == other.words; } //!< compares the flattened state
+		size_t hash() const; //!< combines the hash of every word
+	};
+
+	static const char* DEFAULT_FILEPATH; //!< file the cache blob is loaded from and saved to
+
+	PipelineCache(Device* device, const std::string& filepath = DEFAULT_FILEPATH); //!< constructor; loads the blob from filepath if it was written by the same driver and device
+	~PipelineCache(); //!< destructor; saves the blob and destroys every remaining pipeline, layout and shader module
+
+	PipelineCache(const PipelineCache&) = delete; //!< copy constructor
+	PipelineCache& operator=(const PipelineCache&) = delete; //!< copy assignment
+
+	static bool isCompatible(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties); //!< returns if a cache blob's header matches the vendor, device and pipeline cache UUID
+	static Key getLayoutKey(const VkPipelineLayoutCreateInfo& ci); //!< flattens the set layouts and push constant ranges of a pipeline layout
+	static Key getGraphicsKey(const PipelineSettings& settings, VkPipelineLayout layout, VkShaderModule vertModule, VkShaderModule fragModule); //!< flattens the state of a graphics pipeline
+	static Key getComputeKey(VkPipelineLayout layout, VkShaderModule compModule); //!< flattens the state of a compute pipeline
+
+	VkPipelineCache getPipelineCache() const { return m_pipelineCache; } //!< returns the handle to the pipeline cache
+	bool isWarm() const { return m_loaded; } //!< returns if a blob from a previous run was loaded
+	size_t getPipelineCount() const { return m_pipelines.size(); } //!< returns the number of distinct live pipelines
+
+	VkShaderModule getShaderModule(const std::string& filepath); //!< returns the module for a SPIR-V file, reading it only on first use
+	void invalidateShaderModule(const std::string& filepath); //!< forgets the module and reflection of a SPIR-V file that has been rewritten, so the next pipeline using it reads the new code
+	std::shared_ptr<const ShaderReflection> getReflection(const std::string& filepath); //!< returns the reflected interface of a SPIR-V file, parsing it only on first use
+	ReflectedLayout reflectLayout(const std::vector<std::string>& filepaths, uint32_t dynamicSets = 0); //!< merges the reflected interfaces of the stages of a pipeline
+	VkDescriptorSetLayout getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings); //!< returns the cached set layout for reflected bindings, so every pipeline with the same interface shares one handle and one pipeline layout
+	VkPipelineLayout acquirePipelineLayout(const VkPipelineLayoutCreateInfo& ci); //!< returns a layout matching ci, creating it if no live layout does
+	VkPipeline acquireGraphicsPipeline(const PipelineSettings& settings, VkPipelineLayout layout, const std::string& vertFilepath, const std::string& fragFilepath); //!< returns a graphics pipeline matching the state, creating it if no live pipeline does
+	VkPipeline acquireComputePipeline(VkPipelineLayout layout, const std::string& compFilepath); //!< returns a compute pipeline matching the state, creating it if no live pipeline does
+	void releasePipelineLayout(VkPipelineLayout layout); //!< drops a reference to a layout, destroying it with the last one
+	void releasePipeline(VkPipeline pipeline); //!< drops a reference to a pipeline, destroying it with the last one
+	bool save(); //!< writes the cache blob to disk; returns false if the driver data could not be read or the file could not be written
+private:
+	static std::vector<char> readFile(const std::string& filename); //!< reads a whole binary file
+	VkPipeline insertPipeline(Key&& key, VkPipeline pipeline, VkPipelineLayout layout); //!< stores a newly compiled pipeline, or destroys it if another thread stored the same key first
+	void releaseLayout(VkPipelineLayout layout); //!< drops a reference to a layout; m_mutex must be held
+	struct LayoutEntry
+	{
+		VkPipelineLayout handle; //!< layout handle
+		uint32_t references; //!< number of owners, including every live pipeline created with the layout
+	}; //!< a reference counted pipeline layout
+	struct PipelineEntry
+	{
+		VkPipeline handle; //!< pipeline handle
+		VkPipelineLayout layout; //!< layout the pipeline was created with, kept alive so its handle cannot be reused while the key refers to it
+		uint32_t references; //!< number of owners
+	}; //!< a reference counted pipeline
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const { return key.hash(); }
+	}; //!< hashes a Key for the unordered maps
+private:
+	Device* m_device; //!< device object pointer
+	std::string m_filepath; //!< file the blob is loaded from and saved to
+	VkPipelineCache m_pipelineCache; //!< driver pipeline cache
+	bool m_loaded = false; //!< if a compatible blob was loaded
+	std::mutex m_mutex; //!< guards the maps below; VkPipelineCache is internally synchronised
+	std::unordered_map<std::string, VkShaderModule> m_shaderModules; //!< modules keyed by SPIR-V filepath
+	std::vector<VkShaderModule> m_retiredModules; //!< invalidated modules, kept until destruction so their handles are never reused by a live key
+	std::unordered_map<std::string, std::shared_ptr<const ShaderReflection>> m_reflections; //!< reflected interfaces keyed by SPIR-V filepath
+	DescriptorLayoutCache* m_setLayouts; //!< set layouts built from reflection, alive until destruction so pipeline layout keys never see a reused handle
+	std::unordered_map<Key, LayoutEntry, KeyHash> m_layouts; //!< live layouts keyed by their state
+	std::unordered_map<Key, PipelineEntry, KeyHash> m_pipelines; //!< live pipelines keyed by their state
+};
@@ -0,0 +1,42 @@
+/** \file pipelineCompiler.hpp */
+
+#pragma once
+
+#include "rendering/pipeline.hpp"
+#include "core/threadPool.hpp"
+
+#include <future>
+#include <memory>
+
+/* \class PipelineCompiler
+*  \brief builds pipelines on the thread pool through the device's PipelineCache; each request returns a future so callers wait only for the pipelines they are about to use
+*/
+class PipelineCompiler
+{
+public:
+	PipelineCompiler(Device* device, ThreadPool* threadPool) : m_device(device), m_threadPool(threadPool) {} //!< constructor
+
+	PipelineCompiler(const PipelineCompiler&) = delete; //!< copy constructor
+	PipelineCompiler& operator=(const PipelineCompiler&) = delete; //!< copy assignment
+
+	std::future<Pipeline*> compileGraphics(const VkPipelineLayoutCreateInfo& ci, std::unique_ptr<PipelineSettings> settings, const std::string& vertFilepath, const std::string& fragFilepath); //!< queues a graphics pipeline; settings is heap allocated so its internal pointers stay valid until the job runs
+	std::future<Pipeline*> compileCompute(const VkPipelineLayoutCreateInfo& ci, const std::string& compFilepath); //!< queues a compute pipeline
+	std::future<Pipeline*> compileGraphics(std::unique_ptr<PipelineSettings> settings, const std::string& vertFilepath, const std::string& fragFilepath, const LayoutOverrides& overrides = {}); //!< queues a graphics pipeline whose layout is reflected from its shaders
+	std::future<Pipeline*> compileCompute(const std::string& compFilepath, const LayoutOverrides& overrides = {}); //!< queues a compute pipeline whose layout is reflected from its shader
+private:
+	/* \struct LayoutInfo
+	*  \brief copy of a VkPipelineLayoutCreateInfo and the arrays it points to, owned by a queued job
+	*/
+	struct LayoutInfo
+	{
+		std::vector<VkDescriptorSetLayout> setLayouts; //!< copied set layouts
+		std::vector<VkPushConstantRange> pushConstantRanges; //!< copied push constant ranges
+		VkPipelineLayoutCreateInfo ci; //!< create info pointing at the copied arrays
+	};
+
+	static std::shared_ptr<LayoutInfo> copyLayoutInfo(const VkPipelineLayoutCreateInfo& ci); //!< deep copies ci so the caller's arrays may go out of scope before the job runs
+	std::future<Pipeline*> submit(std::function<Pipeline*()> job); //!< runs job on the thread pool, forwarding its result or exception to the returned future
+private:
+	Device* m_device; //!< device object pointer
+	ThreadPool* m_threadPool; //!< pool the pipelines are built on
+};
@@ -0,0 +1,24 @@
+/** \file pngWriter.hpp */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Rock
+{
+	/* \class PngWriter
+	*  \brief encodes RGBA8 pixels read back from the GPU as PNG files using uncompressed deflate blocks, and compares frames for image-diff tests
+	*/
+	class PngWriter
+	{
+	public:
+		static std::vector<uint8_t> encode(uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba); //!< returns a PNG file of tightly packed RGBA8 rows, top row first
+		static void write(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba); //!< encodes the pixels and writes them to path, throwing if the file cannot be written
+		static size_t countDifferingPixels(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, uint8_t tolerance = 0); //!< returns the number of RGBA8 pixels with a channel differing by more than tolerance; throws if the sizes differ
+	private:
+		static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0); //!< returns the CRC-32 PNG chunks are checked with, continuing from crc
+		static void appendChunk(std::vector<uint8_t>& png, const char type[4], const std::vector<uint8_t>& data); //!< appends a length, type, data and CRC chunk
+	};
+}
@@ -1,12 +1,17 @@
 #pragma once
 
 #include "core/device.hpp"
+#include "core/hash.hpp"
 
 #include <entt/entt.hpp>
 #include <glm/glm.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/hash.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 /* \struct Vertex
 *  \brief stores the data sent to the SSBO for each vertex: position, tex coord and colour; also handles binding and attribute descriptions
 */
@@ -60,20 +65,79 @@ struct Vertex
     }
 };
 
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "Vertex must stay tightly packed for hashing and cooked meshes");
+
 namespace std {
     template<> struct hash<Vertex> {
         size_t operator()(Vertex const& vertex) const {
-            return ((hash<glm::vec3>()(vertex.pos) ^ (hash<glm::vec3>()(vertex.norm) << 1)) >> 1) ^ (hash<glm::vec2>()(vertex.texCoord) << 1);
+            const float values[8] = {
+                vertex.pos.x, vertex.pos.y, vertex.pos.z,
+                vertex.texCoord.x, vertex.texCoord.y,
+                vertex.norm.x, vertex.norm.y, vertex.norm.z
+            };
+            // -0 is folded onto +0 on the bit pattern, so vertices that compare equal hash equally; float arithmetic such as adding 0 can be optimised away under /fp:fast
+            uint32_t data[8];
+            memcpy(data, values, sizeof(data));
+            for (uint32_t& bits : data)
+                if ((bits & 0x7fffffffu) == 0)
+                    bits = 0;
+            return static_cast<size_t>(Rock::hashBytes(data, sizeof(data)));
         }
     };
 }
 
 namespace Rock
 {
+    /* \struct MeshBounds
+    *  \brief stores the axis aligned bounding box and bounding sphere of a mesh in model space
+    */
+    struct MeshBounds
+    {
+        glm::vec3 min{ 0.f }; //!< minimum corner of the AABB
+        glm::vec3 max{ 0.f }; //!< maximum corner of the AABB
+        glm::vec3 centre{ 0.f }; //!< centre of the bounding sphere
+        float radius = 0.f; //!< radius of the bounding sphere
+
+        static MeshBounds calculate(const Vertex* vertices, size_t count)
+        {
+            MeshBounds bounds{};
+            if (count == 0)
+                return bounds;
+
+            bounds.min = bounds.max = vertices[0].pos;
+            for (size_t i = 1; i < count; i++)
+            {
+                bounds.min = glm::min(bounds.min, vertices[i].pos);
+                bounds.max = glm::max(bounds.max, vertices[i].pos);
+            }
+
+            bounds.centre = (bounds.min + bounds.max) * 0.5f;
+            float radiusSquared = 0.f;
+            for (size_t i = 0; i < count; i++)
+            {
+                glm::vec3 offset = vertices[i].pos - bounds.centre;
+                radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+            }
+            bounds.radius = std::sqrt(radiusSquared);
+
+            return bounds;
+        } //!< calculates the AABB and a bounding sphere centred on the AABB from the vertex positions
+    };
+
+    /* \enum VertexFormat
+    *  \brief layout of the data in a render component's vertex buffer
+    */
+    enum class VertexFormat
+    {
+        Full, //!< 32 byte Vertex
+        Compact //!< 16 byte CompactVertex, dequantised with m_dequantise
+    };
+
     struct RenderComponent
     {
         // texture
         VkDescriptorSet descriptorSet;
+        uint32_t m_textureIndex = 0; // slot in the TextureTable when drawing bindless
         uint32_t m_mipLevels;
         VkImage m_textureImage;
         VkDeviceMemory m_textureImageMemory;
@@ -87,5 +151,10 @@ namespace Rock
         VkBuffer m_indexBuffer;
         VkDeviceMemory m_vertexBufferMemory;
         VkDeviceMemory m_indexBufferMemory;
+        uint32_t m_indexCount = 0;
+        VkIndexType m_indexType = VK_INDEX_TYPE_UINT32;
+        MeshBounds m_bounds;
+        VertexFormat m_vertexFormat = VertexFormat::Full;
+        glm::mat4 m_dequantise{ 1.f };
     };
 }
@@ -0,0 +1,214 @@
+/** \file renderGraph.hpp */
+
+#pragma once
+
+#include "core/device.hpp"
+#include "rendering/gpuProfiler.hpp"
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+/* \class RenderGraph
+*  \brief records a frame as passes declaring the resources they read and write; compiling culls passes whose results are never used, places the fewest barriers that order each access after the last conflicting one and aliases transient images whose lifetimes do not overlap into shared memory
+*/
+class RenderGraph
+{
+public:
+	typedef uint32_t Resource; //!< handle to a resource declared since the last reset
+
+	/* \struct Access
+	*  \brief how a pass uses a resource: the pipeline stages, memory accesses and, for images, the layout the pass needs
+	*/
+	struct Access
+	{
+		VkPipelineStageFlags stages; //!< stages that touch the resource
+		VkAccessFlags access; //!< memory accesses made by those stages
+		VkImageLayout layout; //!< layout an image must be in; ignored for buffers
+	};
+
+	static const Access COLOUR_ATTACHMENT; //!< written as a colour attachment
+	static const Access DEPTH_ATTACHMENT; //!< tested and written as a depth attachment
+	static const Access DEPTH_READ_COMPUTE; //!< depth attachment sampled by a compute shader
+	static const Access SAMPLED_FRAGMENT; //!< image sampled by a fragment shader
+	static const Access SAMPLED_COMPUTE; //!< image sampled by a compute shader
+	static const Access STORAGE_READ_COMPUTE; //!< image in VK_IMAGE_LAYOUT_GENERAL read by a compute shader
+	static const Access STORAGE_WRITE_COMPUTE; //!< image in VK_IMAGE_LAYOUT_GENERAL read and written by a compute shader
+	static const Access STORAGE_BUFFER_COMPUTE; //!< buffer read and written by a compute shader
+	static const Access STORAGE_BUFFER_VERTEX; //!< buffer read by a vertex shader
+	static const Access STORAGE_BUFFER_FRAGMENT; //!< buffer read by a fragment shader
+	static const Access INDIRECT_BUFFER; //!< buffer read as indirect draw or dispatch parameters
+	static const Access TRANSFER_SRC; //!< copied from
+	static const Access TRANSFER_DST; //!< copied or filled to
+
+	/* \enum PassType
+	*  \brief the kind of work a pass records
+	*/
+	enum class PassType
+	{
+		Graphics, //!< records render passes
+		Compute, //!< records dispatches
+		Transfer //!< records copies and fills
+	};
+
+	/* \struct ImageDesc
+	*  \brief a transient image created and owned by the graph
+	*/
+	struct ImageDesc
+	{
+		VkExtent2D extent; //!< size of the image
+		VkFormat format; //!< image format
+		VkImageUsageFlags usage; //!< every usage of the image across its passes
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT; //!< aspects barriers and the view cover
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT; //!< sample count
+
+		bool operator==(const ImageDesc& other) const; //!< compares every field
+	};
+
+	/* \struct Barrier
+	*  \brief a dependency placed before a pass, ordering its access to a resource after the previous conflicting accesses
+	*/
+	struct Barrier
+	{
+		Resource resource; //!< resource the barrier applies to
+		VkPipelineStageFlags srcStages; //!< stages that must finish first, 0 for the first use of a resource
+		VkAccessFlags srcAccess; //!< writes made available
+		VkPipelineStageFlags dstStages; //!< stages that wait
+		VkAccessFlags dstAccess; //!< accesses the writes are made visible to
+		VkImageLayout oldLayout; //!< layout before the barrier
+		VkImageLayout newLayout; //!< layout after the barrier
+	};
+
+	/* \class PassBuilder
+	*  \brief declares the resources of the pass being added
+	*/
+	class PassBuilder
+	{
+	public:
+		PassBuilder(RenderGraph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) {} //!< constructor
+
+		void read(Resource resource, const Access& access); //!< declares that the pass reads the resource
+		void write(Resource resource, const Access& access); //!< declares that the pass writes the resource
+		void sideEffect(); //!< keeps the pass even if nothing reads what it writes, e.g. it presents
+	private:
+		RenderGraph& m_graph; //!< graph the pass belongs to
+		uint32_t m_pass; //!< index of the pass
+	};
+
+	RenderGraph(Device* device, uint32_t framesInFlight); //!< constructor; compile never touches the device, so graphs built only to inspect their barriers may pass a null device
+	~RenderGraph(); //!< destructor; destroys the transient images, so the device must be idle
+
+	RenderGraph(const RenderGraph&) = delete; //!< copy constructor
+	RenderGraph& operator=(const RenderGraph&) = delete; //!< copy assignment
+
+	static std::vector<uint32_t> assignAliasSlots(const std::vector<std::pair<uint32_t, uint32_t>>& lifetimes); //!< gives each [first, last] pass interval a memory slot, sharing slots between intervals that do not overlap
+
+	void reset(); //!< forgets the passes and resources of the previous frame; imported resources keep the state the last execute left them in
+	void forgetImports(); //!< forgets the state of every imported resource; call when imported images are destroyed, as a new image may reuse an old handle
+	Resource importImage(const std::string& name, VkImage image, VkImageAspectFlags aspect, uint32_t levels = 1); //!< declares an image owned elsewhere; its first use assumes VK_IMAGE_LAYOUT_UNDEFINED, and barriers cover every array layer
+	Resource importBuffer(const std::string& name, VkBuffer buffer); //!< declares a buffer owned elsewhere
+	Resource createImage(const std::string& name, const ImageDesc& desc); //!< declares a transient image that lives only between its first and last use this frame
+	void addPass(const std::string& name, PassType type, std::function<void(PassBuilder&)> setup, std::function<void(VkCommandBuffer)> execute); //!< adds a pass, calling setup immediately to declare its resources
+	void compile(); //!< culls unused passes, computes the barriers before each pass and assigns transient memory
+	void execute(VkCommandBuffer commandBuffer); //!< creates any transient images, then records each surviving pass after its barriers
+	void setProfiler(GpuProfiler* profiler) { m_profiler = profiler; } //!< times each executed pass as a profiler scope named after it, or none if null
+
+	size_t getPassCount() const { return m_passes.size(); } //!< returns the number of passes added since the last reset
+	bool isCulled(uint32_t pass) const { return m_passes[pass].culled; } //!< returns if compile removed the pass
+	const std::vector<Barrier>& getBarriers(uint32_t pass) const { return m_passes[pass].barriers; } //!< returns the barriers compile placed before the pass
+	uint32_t getAliasSlot(Resource resource) const { return m_resources[resource].slot; } //!< returns the memory slot of a transient image
+	uint32_t getSlotCount() const { return m_slotCount; } //!< returns the number of memory allocations the transient images share
+	VkImage getImage(Resource resource) const; //!< returns the image of a resource; transient images exist once execute has started
+	VkImageView getImageView(Resource resource) const; //!< returns the view of a transient image, valid during execute
+private:
+	/* \struct ResourceState
+	*  \brief the accesses a resource has seen that later accesses may need to wait for
+	*/
+	struct ResourceState
+	{
+		VkPipelineStageFlags srcStages = 0; //!< stages of the last write or layout transition
+		VkAccessFlags srcAccess = 0; //!< writes not yet made available
+		VkPipelineStageFlags readStages = 0; //!< stages that read since then, which a later write must wait for
+		VkPipelineStageFlags visibleStages = 0; //!< stages the last write has been made visible to
+		VkAccessFlags visibleAccess = 0; //!< accesses the last write has been made visible to
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED; //!< current layout
+	};
+
+	/* \struct ResourceEntry
+	*  \brief a resource declared since the last reset
+	*/
+	struct ResourceEntry
+	{
+		std::string name; //!< debug name
+		bool imported; //!< if the resource is owned elsewhere
+		bool isImage; //!< image or buffer
+		VkImage image = VK_NULL_HANDLE; //!< handle of an imported image
+		VkBuffer buffer = VK_NULL_HANDLE; //!< handle of an imported buffer
+		VkImageAspectFlags aspect; //!< aspects covered by barriers
+		uint32_t levels; //!< mip levels covered by barriers
+		ImageDesc desc; //!< description of a transient image
+		uint32_t slot = UINT32_MAX; //!< memory slot of a transient image
+		uint32_t physical = UINT32_MAX; //!< index into m_transients of a transient image
+	};
+
+	/* \struct PassAccess
+	*  \brief one resource used by a pass
+	*/
+	struct PassAccess
+	{
+		Resource resource; //!< resource used
+		Access access; //!< how it is used
+		bool write; //!< if the pass writes it
+	};
+
+	/* \struct Pass
+	*  \brief a unit of recorded work and the resources it uses
+	*/
+	struct Pass
+	{
+		std::string name; //!< debug name
+		PassType type; //!< kind of work
+		std::function<void(VkCommandBuffer)> execute; //!< records the work
+		std::vector<PassAccess> accesses; //!< resources used, one entry per resource
+		bool sideEffect = false; //!< if the pass is kept regardless of readers
+		bool culled = false; //!< if compile removed the pass
+		std::vector<Barrier> barriers; //!< barriers recorded before the pass
+	};
+
+	/* \struct Transient
+	*  \brief a created transient image
+	*/
+	struct Transient
+	{
+		VkImage image; //!< image handle
+		VkImageView view; //!< view of every level
+	};
+
+	std::unordered_map<uint64_t, ResourceState>& getImportedStates(const ResourceEntry& entry) { return entry.isImage ? m_importedImages : m_importedBuffers; } //!< returns the map holding the state of an imported resource
+	static uint64_t getKey(const ResourceEntry& entry); //!< returns the handle of an imported resource as a map key
+	void declare(uint32_t pass, Resource resource, const Access& access, bool write); //!< records an access, merging it with an earlier access of the same resource by the pass
+	void cullPasses(); //!< marks passes that write nothing used later, nothing imported and have no side effect
+	void computeBarriers(); //!< walks the surviving passes in order, placing a barrier wherever an access conflicts with the tracked state
+	void assignMemory(); //!< assigns memory slots to the transient images from their lifetimes
+	void realiseTransients(); //!< creates the transient images and their shared memory, reusing them while the descriptions and slots are unchanged
+	void retireTransients(); //!< queues the current transient images for destruction once the frames in flight have finished
+	void destroyRetired(bool all); //!< destroys retired transient images whose frames have finished, or all of them
+private:
+	Device* m_device; //!< device object pointer
+	uint32_t m_framesInFlight; //!< executions a retired image is kept for
+	GpuProfiler* m_profiler = nullptr; //!< profiler the passes are timed by
+	std::vector<ResourceEntry> m_resources; //!< resources declared since the last reset
+	std::vector<Pass> m_passes; //!< passes added since the last reset
+	uint32_t m_slotCount = 0; //!< memory slots used by the transient images
+	std::unordered_map<uint64_t, ResourceState> m_importedImages; //!< state of each imported image after the last execute, keyed by handle
+	std::unordered_map<uint64_t, ResourceState> m_importedBuffers; //!< state of each imported buffer after the last execute, keyed by handle
+	std::vector<ResourceState> m_finalStates; //!< state of each resource once the compiled passes have run
+	std::vector<VkPipelineStageFlags> m_slotStages; //!< stages of the last use of each memory slot after the last execute, which the next image placed in it must wait for
+	std::vector<VkPipelineStageFlags> m_finalSlotStages; //!< stages of the last use of each memory slot once the compiled passes have run
+
+	std::vector<std::pair<ImageDesc, uint32_t>> m_realised; //!< description and slot of each created transient image
+	std::vector<Transient> m_transients; //!< created transient images
+	std::vector<VkDeviceMemory> m_slotMemory; //!< memory of each slot
+	std::vector<std::pair<std::vector<Transient>, std::vector<VkDeviceMemory>>> m_retired; //!< replaced transient images and memory
+	std::vector<uint32_t> m_retiredFrames; //!< executions left before each retired set is destroyed
+};
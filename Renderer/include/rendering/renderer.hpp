@@ -2,10 +2,19 @@
 
 #pragma once
 
+#include "core/commandPools.hpp"
+#include "core/cpuProfiler.hpp"
+#include "core/threadPool.hpp"
 #include "rendering/lights.hpp"
 #include "rendering/swapchain.hpp"
 #include "rendering/pipeline.hpp"
 #include "rendering/renderComponent.hpp"
+#include "rendering/gpuCuller.hpp"
+#include "rendering/lightClusterer.hpp"
+#include "rendering/shadowMapper.hpp"
+#include "rendering/particleSystem.hpp"
+#include "rendering/renderGraph.hpp"
+#include "rendering/textureTable.hpp"
 #include "window/ui.hpp"
 
 #include <entt/entt.hpp>
@@ -20,45 +29,96 @@
 class Renderer
 {
 public:
-	Renderer(Device* device, VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT, bool resources = false); //!< constructor
+	static const size_t PARALLEL_RECORD_THRESHOLD = 512; //!< entity count above which draws are recorded into secondary command buffers across the thread pool
+	static const size_t MIN_RECORD_BATCH = 128; //!< fewest entities recorded by one thread
+	static const uint64_t PRESENT_WAIT_TIMEOUT = 100000000; //!< nanoseconds beginFrame waits for a present in low latency mode before giving up, e.g. while the window is hidden
+
+	Renderer(Device* device, VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT, bool resources = false, ThreadPool* threadPool = nullptr); //!< constructor; entity draws are only recorded in parallel when a thread pool is given
 	~Renderer(); //!< destructor
 
 	Renderer(const Renderer&) = delete; //!< copy constructor
 	Renderer& operator=(const Renderer&) = delete; //!< copy assignment
 
 	uint32_t getCurrentFrame() { return m_currentFrame; } //!< returns the index of the current frame
+	uint32_t getFramesInFlight() const { return m_framesInFlight; } //!< returns the number of frames the CPU may record ahead of the GPU
+	void setFramesInFlight(uint32_t framesInFlight) { m_requestedFramesInFlight = std::clamp<uint32_t>(framesInFlight, 1, Swapchain::MAX_FRAMES_IN_FLIGHT); } //!< requests cycling through framesInFlight frames, clamped to [1, Swapchain::MAX_FRAMES_IN_FLIGHT]; the end of the frame waits for the device to idle and restarts from frame 0
+	void setFramesInFlightCallback(std::function<void(uint32_t)> callback) { m_framesInFlightCallback = callback; } //!< calls callback with the new count once the frames in flight change, while the device is idle
+	VkPresentModeKHR getPresentMode() const { return m_swapchain->getPresentMode(); } //!< returns the present mode in use
+	void setPresentMode(VkPresentModeKHR presentMode); //!< requests a present mode, applied by recreating the swapchain at the end of the frame; unavailable modes fall back to the closest available
+	bool isLowLatency() const { return m_lowLatency; } //!< returns if beginFrame waits on presents
+	void setLowLatency(bool lowLatency) { m_lowLatency = lowLatency && m_device->supportsPresentWait(); } //!< when present wait is supported, beginFrame waits until at most framesInFlight - 1 presents are queued for the display, so each frame starts closer to being shown
+	void setFrameLimiter(FrameLimiter* frameLimiter) { m_frameLimiter = frameLimiter; } //!< shows the limiter's frame rate cap in the frame pacing panel; not owned
 	void setCurrentFrame(uint32_t newFrame) { m_currentFrame = newFrame; } //!< set the index of the current frame
 	VkSwapchainKHR getSwapchain() { return m_swapchain->getSwapchain(); } //!< returns the current swapchain
 	VkSemaphore& getImageAvailableSemaphore() const { return m_swapchain->getImageAvailableSemaphore(m_currentFrame); } //!< returns the image available semaphore for the current frame from the swapchain
 	VkSemaphore& getGraphicsFinishedSemaphore() const { return m_swapchain->getGraphicsFinishedSemaphore(m_currentFrame); } //!< returns the graphics semaphore for the current frame from the swapchain
 	VkFence& getFence() const { return m_swapchain->getFence(m_currentFrame); } //!< returns the in flight fence for the current frame from the swapchain
 	VkCommandBuffer getCommandBuffer() const { return m_commandBuffers[m_currentFrame]; } //!< returns the graphics command buffer for the current frame
+	VkCommandBuffer getComputeCommandBuffer() const { return m_computeCommandBuffers[m_currentFrame]; } //!< returns the compute command buffer for the current frame
 	VkRenderPass getSwapchainRenderPass() const { return m_swapchain->getRenderPass(); } //!< returns the render pass from the swapchain
 	VkFramebuffer getSwapchainFramebuffer() const { return m_swapchain->getFramebuffer(m_currentFrame); } //!< returns the swapchain framebuffer for the current frame
 	float getSwapchainAspectRatio() const { return static_cast<float>(m_swapchain->getSwapchainExtent().width) / static_cast<float>(m_swapchain->getSwapchainExtent().height); } //!< calculates and returns swapchain aspect ratio
 	VkExtent2D getSwapchainExtent() const { return m_swapchain->getSwapchainExtent(); } //!< returns the swapchain extent
 	uint32_t getSwapchainImageCount() const { return m_swapchain->getImageCount(); } //!< returns the swapchain image count
+	void setCullingStats(uint32_t visible, uint32_t culled) { m_visibleCount = visible; m_culledCount = culled; } //!< sets the entity counts shown in the overlay
+	void setDynamicOffsets(const std::vector<uint32_t>& offsets) { m_dynamicOffsets = offsets; } //!< sets the dynamic offsets used when binding set 0 for the current frame
+	void setTextureTable(TextureTable* textureTable) { m_textureTable = textureTable && textureTable->isBindless() ? textureTable : nullptr; } //!< binds the table as set 1 once per pass and selects each entity's texture by index instead of binding its set
+	GpuProfiler* getGpuProfiler() const { return m_gpuProfiler; } //!< returns the profiler timing the passes of each frame
+	void setGpuCulling(GpuCuller* culler, Pipeline* instancedPipeline, entt::entity mesh); //!< draws the culler's instances of mesh with instancedPipeline after the entities; a null culler disables it; recreates the swapchain when the depth attachment must start or stop being sampled
+	void setLightClusterer(LightClusterer* clusterer) { m_lightClusterer = clusterer; } //!< bins the clusterer's lights for the current frame before the scene pass, which reads the clusters in its fragment shaders; a null clusterer disables it
+	void setShadowMapper(ShadowMapper* shadowMapper) { m_shadowMapper = shadowMapper; } //!< renders the mapper's cascades before the scene pass, which samples them in its fragment shaders; a null mapper disables it
 private:
 	void recreateSwapchain(); //!< recreates the swapchain when the extents change or window is resized
 	void createCommandBuffers(); //!< creates the command buffers for graphics and compute
+	void recordGpuCulledDraw(VkCommandBuffer commandBuffer, entt::registry& m_registry, const std::vector<VkDescriptorSet>& descriptorSets); //!< binds the instanced pipeline and mesh and records the culler's indirect draw
+	void setViewportAndScissor(VkCommandBuffer commandBuffer); //!< sets the dynamic viewport and scissor to the swapchain extent
+	void bindFrameSets(VkCommandBuffer commandBuffer, Pipeline* pipeline, const std::vector<VkDescriptorSet>& descriptorSets); //!< binds set 0 for the current frame with its dynamic offsets, and the texture table as set 1 when drawing bindless
+	void recordEntityDraws(VkCommandBuffer commandBuffer, Pipeline* pipeline, entt::registry& m_registry, const std::vector<entt::entity>& entities, size_t begin, size_t end); //!< records the draws of entities in [begin, end); the pipeline and frame sets must already be bound
+	VkCommandBuffer beginSecondary(uint32_t thread); //!< acquires and begins a secondary command buffer continuing the swapchain render pass from a thread's pool
+	void recordFrameGraph(VkCommandBuffer commandBuffer, std::function<void(VkCommandBuffer)> recordScenePass); //!< records the frame as a render graph: the GPU cull, the light clusters, the shadow cascades, the scene render pass recorded by recordScenePass and the depth pyramid, with the barriers between them
+	void recordScene(VkCommandBuffer commandBuffer, bool parallel, Pipeline* pipeline, entt::registry& m_registry, const std::vector<entt::entity>& entities, const std::vector<VkDescriptorSet>& descriptorSets, std::vector<VkCommandBuffer>& secondaries); //!< records the entity and GPU culled draws inline, or into secondaries recorded across the thread pool when parallel
 public:
 	void beginFrame(); //!< acquires the next swapchain image
 	void endFrame(); //!< queues the retrieved image for rendering
-	void beginSwapchainRenderPass(Pipeline* pipeline, VkCommandBuffer commandBuffer, bool depth = false); //!< sets the render pass info before beginning the pass
+	void beginSwapchainRenderPass(Pipeline* pipeline, VkCommandBuffer commandBuffer, bool depth = false, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE); //!< sets the render pass info before beginning the pass; the pipeline and viewport are only set for inline contents
 	void beginSwapchainRenderPass(VkClearValue& clearColour); //!< sets the render pass info before beginning the pass
-	void recordCommandBuffer(bool compute, Pipeline* pipeline, const uint32_t m_particleCount = 0, std::vector<VkBuffer> shaderStorageBuffers = {}, std::vector<VkDescriptorSet> descriptorSets = {}); //!< begins the current command buffer, binds the relevant pipeline, calls vkDraw or vkDispatch and ends the command buffer
+	void recordCommandBuffer(bool compute, ParticleSystem* particleSystem, float deltaTime = 0.f); //!< records the particle system's update into the current compute command buffer, or its draw into the current graphics command buffer
 	void recordCommandBuffer(Pipeline* pipeline, entt::registry& m_registry, std::vector<entt::entity> entities, std::vector<VkDescriptorSet> descriptorSets); //!< begins the current command buffer, binds the relevant pipeline, calls vkDraw or vkDispatch and ends the command buffer
 	void recordCommandBuffer(Pipeline* pipeline, entt::registry& m_registry, std::vector<entt::entity> entities, std::vector<VkDescriptorSet> descriptorSets, float* m_translate, float* m_rotate, float* m_scale); //!< begins the current command buffer, binds the relevant pipeline, calls vkDraw or vkDispatch and ends the command buffer
-	void submitCommandBuffer(bool compute); //!< submits the current command buffer to a device queue
+	void submitCommandBuffer(bool compute); //!< submits the current compute command buffer to the compute queue, signalling the timeline, or the graphics command buffer waiting on the timeline at the draw indirect stage; submit compute first
 	void submitCommandBuffer(); //!< submits the current command buffer to a device queue
 private:
 	Window* m_window; //!< window object pointer
 	Device* m_device; //!< device object pointer
 	Swapchain* m_swapchain; //!< pointer to active swapchain
 	std::vector<VkCommandBuffer> m_commandBuffers; //!< vector for command buffers
+	std::vector<VkCommandBuffer> m_computeCommandBuffers; //!< command buffers for the compute queue
+	VkSemaphore m_computeTimeline = VK_NULL_HANDLE; //!< timeline semaphore signalled by each compute submission
+	uint64_t m_computeTimelineValue = 0; //!< value signalled by the last compute submission
+	ThreadPool* m_threadPool; //!< worker threads recording secondary command buffers, not owned
+	CommandPools* m_commandPools = nullptr; //!< per thread, per frame pools for secondary command buffers
+	RenderGraph* m_renderGraph = nullptr; //!< graph the scene passes are recorded through, rebuilt each frame
+	GpuProfiler* m_gpuProfiler = nullptr; //!< times the passes of each frame
 
 	uint32_t m_imageIndex; //!< index of next image for present info and framebuffer index
 	uint32_t m_currentFrame = 0; //!< stores the current frame
+	uint32_t m_framesInFlight = 2; //!< frames cycled through, at most Swapchain::MAX_FRAMES_IN_FLIGHT
+	uint32_t m_requestedFramesInFlight = 2; //!< frames cycled through from the end of the current frame
+	std::function<void(uint32_t)> m_framesInFlightCallback; //!< told the new count when the frames in flight change
+	FrameLimiter* m_frameLimiter = nullptr; //!< limiter shown in the frame pacing panel, not owned
+	VkPresentModeKHR m_presentMode; //!< requested present mode
+	bool m_presentModeChanged = false; //!< if the swapchain must be recreated for a new present mode
+	bool m_lowLatency = false; //!< if beginFrame waits on presents
+	uint64_t m_presentId = 0; //!< id of the last present to the current swapchain, 0 before the first or without present wait
 	VkSampleCountFlagBits m_msaaSamples; // multisample anti-aliasing
 	bool m_resources; //!< if the swapchain should create resources
+	uint32_t m_visibleCount = 0; //!< entities that passed frustum culling this frame
+	uint32_t m_culledCount = 0; //!< entities rejected by frustum culling this frame
+	std::vector<uint32_t> m_dynamicOffsets; //!< dynamic offsets for the dynamic buffers in set 0, in binding order
+	TextureTable* m_textureTable = nullptr; //!< bindless texture table, not owned; null draws with a texture set per entity
+	GpuCuller* m_gpuCuller = nullptr; //!< optional GPU culler, not owned
+	Pipeline* m_instancedPipeline = nullptr; //!< pipeline drawing the GPU culled instances, not owned
+	entt::entity m_gpuCulledMesh = entt::null; //!< entity whose mesh and texture are drawn for each GPU culled instance
+	LightClusterer* m_lightClusterer = nullptr; //!< optional light clusterer, not owned
+	ShadowMapper* m_shadowMapper = nullptr; //!< optional shadow mapper, not owned
 };
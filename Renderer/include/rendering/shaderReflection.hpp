@@ -0,0 +1,52 @@
+/** \file shaderReflection.hpp */
+
+#pragma once
+
+#include "core/device.hpp"
+
+#include <vector>
+
+/* \struct ReflectedLayout
+*  \brief descriptor set bindings and push constant range of a set of shader stages, merged so each binding carries every stage that uses it
+*/
+struct ReflectedLayout
+{
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets; //!< bindings of each set index sorted by binding; sets no stage uses are empty
+	VkPushConstantRange pushConstants{}; //!< push constant block of every stage, size 0 if none declares one
+};
+
+/* \class ShaderReflection
+*  \brief reads the descriptor bindings and push constant block a SPIR-V module declares, so pipeline layouts are derived from the shaders rather than written out by hand
+*/
+class ShaderReflection
+{
+public:
+	/* \struct Binding
+	*  \brief a resource variable decorated with a descriptor set and binding
+	*/
+	struct Binding
+	{
+		uint32_t set; //!< descriptor set index
+		uint32_t binding; //!< binding index within the set
+		VkDescriptorType type; //!< descriptor type; uniform and storage buffers are never reported as dynamic
+		uint32_t count; //!< array length, 1 for a single descriptor and 0 for a runtime sized array
+		uint32_t blockSize = 0; //!< bytes a uniform or storage block occupies before any runtime sized array member, 0 for other resources
+		uint32_t arrayStride = 0; //!< stride of the block's trailing runtime sized array, 0 if it has none
+		std::vector<uint32_t> memberOffsets; //!< offset of each member of the struct elements of a trailing runtime sized array, otherwise of each member of the block
+	};
+
+	ShaderReflection(const std::vector<char>& code); //!< constructor; parses the module and throws if it is not SPIR-V
+
+	static ReflectedLayout merge(const std::vector<const ShaderReflection*>& stages, uint32_t dynamicSets = 0); //!< merges the interfaces of several stages; buffers in sets whose bit is in dynamicSets become their dynamic descriptor types
+
+	VkShaderStageFlagBits getStage() const { return m_stage; } //!< returns the stage of the module's entry point
+	const std::vector<Binding>& getBindings() const { return m_bindings; } //!< returns the bindings sorted by set then binding
+	const Binding* findBinding(uint32_t set, uint32_t binding) const; //!< returns the resource at a set and binding, or null if the module declares none
+	uint32_t getPushConstantOffset() const { return m_pushConstantOffset; } //!< returns the offset of the first push constant member
+	uint32_t getPushConstantSize() const { return m_pushConstantSize; } //!< returns the size in bytes of the push constant block from its first member, 0 if there is none
+private:
+	VkShaderStageFlagBits m_stage = VK_SHADER_STAGE_ALL; //!< entry point stage
+	std::vector<Binding> m_bindings; //!< declared resources
+	uint32_t m_pushConstantOffset = 0; //!< offset of the push constant block
+	uint32_t m_pushConstantSize = 0; //!< size of the push constant block
+};
@@ -0,0 +1,68 @@
+/** \file shaderReloader.hpp */
+
+#pragma once
+
+#include "rendering/pipelineCompiler.hpp"
+
+#include <chrono>
+#include <filesystem>
+
+/* \class ShaderReloader
+*  \brief polls GLSL sources for changes, recompiles them to SPIR-V with glslc on the thread pool and swaps the pipelines built from them at a frame boundary; old pipelines are destroyed once every frame in flight that could use them has finished
+*/
+class ShaderReloader
+{
+public:
+	static const uint32_t POLL_INTERVAL_MS = 250; //!< minimum time between checks of the source timestamps
+
+	ShaderReloader(Device* device, ThreadPool* threadPool, uint32_t framesInFlight); //!< constructor
+	~ShaderReloader(); //!< destructor; waits for queued work and destroys retired pipelines, so the device must be idle
+
+	ShaderReloader(const ShaderReloader&) = delete; //!< copy constructor
+	ShaderReloader& operator=(const ShaderReloader&) = delete; //!< copy assignment
+
+	static std::string getCompilerPath(); //!< returns glslc from the Vulkan SDK named by VULKAN_SDK, or glslc on the path
+	static std::string getCompileCommand(const std::string& compiler, const std::string& sourcePath, const std::string& spvPath, const std::string& defines); //!< returns the command line compiling sourcePath to spvPath
+
+	void addShader(const std::string& sourcePath, const std::string& spvPath, const std::string& defines = ""); //!< watches a GLSL source that setup.bat compiles to spvPath with defines
+	void watchPipeline(Pipeline*& pipeline, std::function<std::future<Pipeline*>()> rebuild, std::function<void(Pipeline*)> onSwap = nullptr); //!< rebuilds the pipeline in the slot when one of its SPIR-V files is recompiled; onSwap is called after the slot changes
+	void update(); //!< polls the sources, swaps in finished pipelines and destroys retired ones; call once per frame after the frame's fence has been waited on
+private:
+	/* \struct Shader
+	*  \brief a watched source and the SPIR-V it compiles to
+	*/
+	struct Shader
+	{
+		std::string sourcePath; //!< GLSL source
+		std::string spvPath; //!< SPIR-V output loaded by pipelines
+		std::string defines; //!< -D arguments passed to glslc
+		std::filesystem::file_time_type lastWrite; //!< timestamp of the last compiled source
+		std::future<bool> compile; //!< running compilation, true on success
+	};
+
+	/* \struct WatchedPipeline
+	*  \brief a pipeline slot and how to rebuild it
+	*/
+	struct WatchedPipeline
+	{
+		Pipeline** slot; //!< pointer the owner draws with
+		std::function<std::future<Pipeline*>()> rebuild; //!< queues a rebuild of the pipeline
+		std::function<void(Pipeline*)> onSwap; //!< called with the new pipeline after a swap
+		std::future<Pipeline*> pending; //!< rebuild in progress
+		bool stale = false; //!< a shader changed again while the rebuild was running
+	};
+
+	void poll(); //!< queues a compile for each source written since it was last compiled
+	void rebuildPipelines(const std::vector<std::string>& changed); //!< queues a rebuild of each pipeline using a changed SPIR-V file
+	void retire(Pipeline* pipeline); //!< queues a pipeline for destruction once the frames in flight have finished
+	static bool compileShader(const std::string& compiler, const std::string& sourcePath, const std::string& spvPath, const std::string& defines); //!< runs glslc into a temporary file and renames it over spvPath on success
+private:
+	Device* m_device; //!< device object pointer
+	ThreadPool* m_threadPool; //!< pool compilations and rebuilds run on
+	uint32_t m_framesInFlight; //!< frames a retired pipeline is kept for
+	std::string m_compiler; //!< glslc path
+	std::vector<Shader> m_shaders; //!< watched sources
+	std::vector<WatchedPipeline> m_pipelines; //!< watched pipeline slots
+	std::vector<std::pair<Pipeline*, uint32_t>> m_retired; //!< replaced pipelines and the frames left before they are destroyed
+	std::chrono::steady_clock::time_point m_lastPoll; //!< time of the last timestamp check
+};
@@ -0,0 +1,117 @@
+/** \file shadowMapper.hpp */
+
+#pragma once
+
+#include "rendering/pipeline.hpp"
+#include "rendering/swapchain.hpp"
+#include "rendering/culling.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+
+/* \class ShadowMapper
+*  \brief renders cascaded shadow maps for a directional light: each cascade is fitted to a slice of the camera frustum, snapped to whole texels and drawn with a depth only pipeline, one instanced draw per mesh of the casters culled against it
+*/
+class ShadowMapper
+{
+public:
+	/* \struct Cascade
+	*  \brief the light space projection of one slice of the camera frustum
+	*/
+	struct Cascade
+	{
+		glm::mat4 viewProjection; //!< world to light clip space, depth zero to one
+		float splitDepth; //!< view depth the slice ends at
+		float texelWorldSize; //!< world space width of a shadow map texel
+	};
+
+	/* \struct ShadowUniforms
+	*  \brief std140 uniform block read by main.frag
+	*/
+	struct ShadowUniforms
+	{
+		glm::mat4 viewProjections[4]; //!< Cascade::viewProjection of each cascade
+		glm::vec4 splitDepths; //!< Cascade::splitDepth of each cascade
+		glm::vec4 texelWorldSizes; //!< Cascade::texelWorldSize of each cascade
+		glm::vec4 filtering; //!< x is the size of a texel in uv, y the normal offset in texels and z the PCF radius in texels
+	};
+
+	/* \struct Batch
+	*  \brief an instanced draw of one mesh's casters in a cascade
+	*/
+	struct Batch
+	{
+		VkBuffer vertexBuffer; //!< vertex buffer of the mesh
+		VkBuffer indexBuffer; //!< index buffer of the mesh
+		VkIndexType indexType; //!< type of the indices
+		uint32_t indexCount; //!< indices drawn per instance
+		Rock::VertexFormat vertexFormat; //!< selects the pipeline reading the vertices
+		uint32_t firstInstance; //!< first model matrix of the batch in the instance buffer
+		uint32_t instanceCount; //!< casters drawn
+	};
+
+	static const uint32_t CASCADE_COUNT = 4; //!< cascades, one array layer of the shadow map each
+	static const uint32_t DEFAULT_RESOLUTION = 2048; //!< width and height of each cascade
+
+	ShadowMapper(Device* device, uint32_t maxCasters, uint32_t resolution = DEFAULT_RESOLUTION, const std::string& shaderDirectory = "./res/shaders/shadows/"); //!< constructor
+	~ShadowMapper(); //!< destructor
+
+	ShadowMapper(const ShadowMapper&) = delete; //!< copy constructor
+	ShadowMapper& operator=(const ShadowMapper&) = delete; //!< copy assignment
+
+	static std::vector<float> getSplitDepths(float zNear, float zFar, uint32_t count, float lambda); //!< returns the view depth each cascade ends at, blending logarithmic and uniform splits by lambda
+	static Cascade fitCascade(const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar, float splitNear, float splitFar, const glm::vec3& lightDirection, uint32_t resolution, float casterDistance); //!< fits an orthographic projection around the sphere enclosing a slice of the camera frustum, snapped to whole texels and extended casterDistance towards the light
+	static void batchCasters(entt::registry& registry, const std::vector<entt::entity>& casters, std::vector<glm::mat4>& instances, std::vector<Batch>& batches); //!< appends the model matrix of each caster to instances, grouped into one batch per mesh
+
+	VkImage getImage() const { return m_image; } //!< returns the shadow map, one array layer per cascade
+	VkImageView getImageView() const { return m_arrayView; } //!< returns the view of every cascade sampled by main.frag
+	VkSampler getSampler() const { return m_sampler; } //!< returns the depth comparison sampler
+	uint32_t getResolution() const { return m_resolution; } //!< returns the width and height of each cascade
+	const Cascade& getCascade(uint32_t cascade) const { return m_cascades[cascade]; } //!< returns a cascade fitted by the last update
+	ShadowUniforms getUniforms() const; //!< returns the cascades fitted by the last update for main.frag
+	uint32_t getCasterCount(uint32_t cascade) const { return static_cast<uint32_t>(m_cascadeCasters[cascade].size()); } //!< returns the casters culled against a cascade by the last setCasters
+	uint32_t getBatchCount(uint32_t cascade) const { return static_cast<uint32_t>(m_batches[cascade].size()); } //!< returns the draws recorded for a cascade
+
+	void setSplitLambda(float lambda) { m_splitLambda = lambda; } //!< sets the blend between uniform (0) and logarithmic (1) splits
+	void setCasterDistance(float distance) { m_casterDistance = distance; } //!< sets how far towards the light beyond each slice casters are kept
+	void update(const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar, const glm::vec3& lightDirection); //!< fits the cascades to the camera
+	void setCasters(uint32_t frame, entt::registry& registry, const std::vector<entt::entity>& casters, ThreadPool* threadPool = nullptr); //!< culls the casters against each cascade and writes the frame's instances; the frame's fence must have signalled
+	void recordShadows(VkCommandBuffer commandBuffer, uint32_t frame); //!< records a depth only render pass per cascade; must be outside a render pass, and fragment shader reads of the shadow map must wait for it
+private:
+	void createImage(); //!< creates the shadow map, its views and the comparison sampler
+	void createRenderPass(); //!< creates the depth only render pass and a framebuffer per cascade
+	void createDescriptorSetLayout(); //!< creates the layout of the shadow.vert set
+	void createPipelines(const std::string& shaderDirectory); //!< creates the depth only pipeline for each vertex format
+	void createBuffers(); //!< creates the instance buffer of each frame in flight
+	void createDescriptorSets(); //!< allocates and writes the set of each frame in flight
+private:
+	Device* m_device; //!< device object pointer
+	uint32_t m_maxCasters; //!< casters each cascade can draw
+	uint32_t m_resolution; //!< width and height of each cascade
+	float m_splitLambda = 0.75f; //!< blend between uniform and logarithmic splits
+	float m_casterDistance = 20.f; //!< distance towards the light casters outside a slice are kept from
+
+	VkFormat m_format; //!< depth format of the shadow map
+	VkImage m_image; //!< shadow map, one array layer per cascade
+	VkDeviceMemory m_imageMemory; //!< memory for the shadow map
+	VkImageView m_arrayView; //!< view of every layer
+	VkImageView m_layerViews[CASCADE_COUNT]; //!< view of each layer, attached to its framebuffer
+	VkSampler m_sampler; //!< comparison sampler with linear filtering, so each PCF tap is itself a 2x2 filter
+	VkRenderPass m_renderPass; //!< depth only render pass
+	VkFramebuffer m_framebuffers[CASCADE_COUNT]; //!< framebuffer of each cascade
+
+	Pipeline* m_pipelines[2]; //!< depth only pipeline for full and compact vertices
+	VkDescriptorSetLayout m_setLayout; //!< layout for shadow.vert
+	VkDescriptorPool m_descriptorPool; //!< pool for the sets
+	std::vector<VkDescriptorSet> m_sets; //!< shadow.vert set for each frame in flight
+	std::vector<VkBuffer> m_instanceBuffers; //!< model matrices of each frame in flight
+	std::vector<VkDeviceMemory> m_instanceBuffersMemory; //!< memory for the instance buffers
+	std::vector<void*> m_instanceBuffersMapped; //!< persistently mapped instance buffers
+
+	Cascade m_cascades[CASCADE_COUNT]; //!< cascades fitted by the last update
+	Rock::CullingSystem m_culling; //!< culls the casters against each cascade
+	std::vector<entt::entity> m_cascadeCasters[CASCADE_COUNT]; //!< casters of each cascade from the last setCasters
+	std::vector<glm::mat4> m_instances; //!< model matrices written by the last setCasters
+	std::vector<Batch> m_batches[CASCADE_COUNT]; //!< draws of each cascade from the last setCasters
+};
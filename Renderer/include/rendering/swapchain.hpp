@@ -8,38 +8,41 @@
 #include <memory>
 #include <algorithm>
 
-//#define FRAMERATE_CAP
-
 /* \class Swapchain
 *  \brief handles the swapchain lifecycle including images, image views, image memory, framebuffers and render passes
 */
 class Swapchain
 {
 public:
-	static const int MAX_FRAMES_IN_FLIGHT = 2; //!< static var containing maxmimum number of potential frames in flight
-	Swapchain(Device* device, VkSampleCountFlagBits msaaSamples, bool resources); //!< constructor
-	Swapchain(Device* device, Swapchain* oldSwapchain, VkSampleCountFlagBits msaaSamples); //!< constructor with additional input of previous swapchain
+	static const int MAX_FRAMES_IN_FLIGHT = 3; //!< maximum number of frames in flight; per frame resources are created for this many, and the renderer cycles through as many as it is set to use
+	Swapchain(Device* device, VkSampleCountFlagBits msaaSamples, bool resources, VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR, bool sampledDepth = false); //!< constructor; sampledDepth stores the depth attachment and makes it sampleable, for a depth pyramid
+	Swapchain(Device* device, Swapchain* oldSwapchain, VkSampleCountFlagBits msaaSamples, VkPresentModeKHR presentMode, bool sampledDepth); //!< constructor with additional input of previous swapchain
 	~Swapchain(); //!< destructor
     Swapchain(const Swapchain&) = delete; //!< copy constructor
     Swapchain& operator=(const Swapchain&) = delete; //!< copy assignment
 
+    static VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferred); //!< returns preferred if available, otherwise the closest available mode; FIFO is always available
     VkSwapchainKHR getSwapchain() const { return m_swapchain; } //!< returns the VkSwapchainKHR object
     VkFormat getSwapchainImageFormat() const { return m_swapchainImageFormat; } //!< used to check that new/old swapchains have the same image format
     VkFormat getSwapchainDepthFormat() const { return m_swapchainDepthFormat; } //!< used to check that new/old swapchains have the same depth format
+    VkPresentModeKHR getPresentMode() const { return m_presentMode; } //!< returns the present mode the swapchain was created with
     VkExtent2D getSwapchainExtent() const { return m_swapchainExtent; } //!< returns the swapchain extent (could be different to window due to surface capabilities)
     VkRenderPass getRenderPass() const { return m_renderPass; } //!< returns render pass for the pipeline
+    VkImage getDepthImage() const { return m_depthImage; } //!< returns the depth image resource
+    VkImageView getDepthImageView() const { return m_depthImageView; } //!< returns the image view for the depth image resource
     uint32_t getImageCount() const { return m_swapchainImages.size(); } //!< returns the number of images in swapchain images
     VkFramebuffer getFramebuffer(int index) { return m_swapchainFramebuffers[index]; } //!< returns the framebuffer for the command buffer
     VkSemaphore& getImageAvailableSemaphore(uint32_t currentFrame) { return m_imageAvailableSemaphores[currentFrame]; } //!< image available semaphore getter method for current frame
     VkSemaphore& getGraphicsFinishedSemaphore(uint32_t currentFrame) { return m_graphicsFinishedSemaphores[currentFrame]; } //!< graphics finished semaphore getter method for current frame
     VkFence& getFence(uint32_t currentFrame) { return m_fences[currentFrame]; } //!< in flight fence getter method for current frame
+    bool isDepthSampled() const { return m_sampledDepth; } //!< returns if the depth attachment is stored and can be sampled after the render pass
     bool getResources() const { return m_resources; } //!< returns if the swapchain should create images, image views and image memory for colour and depth
     bool operator!=(const Swapchain* swapchain) const {
         return swapchain->getSwapchainImageFormat() != m_swapchainImageFormat ||
             swapchain->getSwapchainDepthFormat() != m_swapchainDepthFormat;
     } //!< used to check if old/new swapchain support the same image and depth formats
 private:
-    void createSwapchain(VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE); //!< defines and initialises the swapchain
+    void createSwapchain(VkPresentModeKHR presentMode, VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE); //!< defines and initialises the swapchain
     void createImageViews(); //!< creates image views
     void createResources(VkSampleCountFlagBits msaaSamples); //!< creates resources for colour and depth
     void createRenderPass(VkSampleCountFlagBits msaaSamples); //!< creates render pass
@@ -48,13 +51,13 @@ private:
 
     VkFormat findDepthFormat(); //!< finds device supported depth format
     VkSurfaceFormatKHR chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats); //!< chooses best available surface format
-    VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes); //!< chooses best available present mode
     VkExtent2D chooseExtent(const VkSurfaceCapabilitiesKHR& capabilities); //!< determines swapchain extent based on capabilities and window extent
 
     Device* m_device; //!< device object pointer
     VkSwapchainKHR m_swapchain; //!< swapchain object
     VkFormat m_swapchainImageFormat; //!< image format
     VkFormat m_swapchainDepthFormat; //!< depth format
+    VkPresentModeKHR m_presentMode; //!< present mode chosen from the requested one
     VkExtent2D m_swapchainExtent; //!< extent of the swapchain
     VkRenderPass m_renderPass; //!< render pass
     std::vector<VkImage> m_swapchainImages; //!< vector of swapchain images
@@ -74,4 +77,5 @@ private:
     VkImageView m_depthImageView; //!< image view for depth image resource
 
     bool m_resources; //!< bool if the swapchain should create images, image views and image memory for colour and depth
+    bool m_sampledDepth; //!< if the depth attachment is stored and sampleable, for a depth pyramid
 };
@@ -0,0 +1,32 @@
+/** \file textureTable.hpp */
+
+#pragma once
+
+#include "core/device.hpp"
+
+/* \class TextureTable
+*  \brief one descriptor set holding a partially bound array of every texture in the scene, so draws select a texture by index instead of binding a set each; unavailable when the device lacks descriptor indexing
+*/
+class TextureTable
+{
+public:
+	TextureTable(Device* device, uint32_t maxTextures = 1024); //!< constructor, creates nothing when bindless textures are unsupported
+	~TextureTable(); //!< destructor
+
+	TextureTable(const TextureTable&) = delete; //!< copy constructor
+	TextureTable& operator=(const TextureTable&) = delete; //!< copy assignment
+
+	bool isBindless() const { return m_bindless; } //!< returns if the table can be used; callers fall back to a set per texture otherwise
+	uint32_t getTextureCount() const { return m_textureCount; } //!< returns the number of textures added
+	VkDescriptorSetLayout getDescriptorSetLayout() const { return m_descriptorSetLayout; } //!< returns the layout of the table set
+	VkDescriptorSet getDescriptorSet() const { return m_descriptorSet; } //!< returns the table set
+	uint32_t add(VkImageView imageView, VkSampler sampler); //!< writes a texture into the next free slot and returns its index
+private:
+	Device* m_device; //!< device object pointer
+	bool m_bindless; //!< if the device supports the table
+	uint32_t m_maxTextures; //!< size of the sampler array
+	uint32_t m_textureCount = 0; //!< number of slots written
+	VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE; //!< layout with a single update after bind sampler array
+	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE; //!< update after bind pool for the table set
+	VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE; //!< the table set
+};
@@ -2,9 +2,15 @@
 
 #pragma once
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
+#include "core/cpuProfiler.hpp"
 #include "core/device.hpp"
+#include "core/frameLimiter.hpp"
+#include "rendering/gpuProfiler.hpp"
+#include "rendering/swapchain.hpp"
 
 #include "imgui/imgui.h"
 #include "imgui/backends/imgui_impl_glfw.h"
@@ -166,7 +172,7 @@ static void createMainMenuBar(Device* device)
     }
 }
 
-static void createOverlay(float fps)
+static void createOverlay(float fps, uint32_t visible = 0, uint32_t culled = 0)
 {
     ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoDocking | ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoFocusOnAppearing | ImGuiWindowFlags_NoNav;
 
@@ -185,6 +191,151 @@ static void createOverlay(float fps)
     if (ImGui::Begin("FPS overlay", (bool*)true, window_flags))
     {
         ImGui::Text("%.1f FPS (%.3f ms/frame)", fps, 1000.f / fps);
+        if (visible + culled > 0)
+            ImGui::Text("%u visible / %u culled", visible, culled);
         ImGui::End();
     }
 }
+
+static void createGpuProfilerPanel(GpuProfiler* profiler)
+{
+    if (!profiler)
+        return;
+
+    if (ImGui::Begin("GPU profiler"))
+    {
+        bool enabled = profiler->isEnabled();
+        if (ImGui::Checkbox("Enabled", &enabled))
+            profiler->setEnabled(enabled);
+        ImGui::SameLine();
+        if (ImGui::Button("Export CSV"))
+            profiler->exportCsv("gpu_profile.csv");
+        ImGui::SameLine();
+        if (ImGui::Button("Export JSON"))
+            profiler->exportJson("gpu_profile.json");
+        ImGui::Text("%.3f ms GPU", profiler->getFrameMilliseconds());
+
+        int columns = profiler->hasStatistics() ? 2 + GpuProfiler::STATISTIC_COUNT : 2;
+        if (ImGui::BeginTable("scopes", columns, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollX))
+        {
+            ImGui::TableSetupColumn("scope");
+            ImGui::TableSetupColumn("ms");
+            for (int i = 2; i < columns; i++)
+                ImGui::TableSetupColumn(GpuProfiler::getStatisticName(i - 2));
+            ImGui::TableHeadersRow();
+
+            for (const GpuProfiler::ScopeResult& result : profiler->getResults())
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Indent(result.depth * 10.f + 0.01f); // Indent(0) uses the default width
+                ImGui::TextUnformatted(result.name.c_str());
+                ImGui::Unindent(result.depth * 10.f + 0.01f);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", result.milliseconds);
+                for (int i = 2; i < columns; i++)
+                {
+                    ImGui::TableNextColumn();
+                    if (result.hasStatistics)
+                        ImGui::Text("%llu", static_cast<unsigned long long>(result.statistics[i - 2]));
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
+}
+
+static void createFramePacingPanel(VkPresentModeKHR& presentMode, uint32_t& framesInFlight, bool& lowLatency, bool lowLatencySupported, FrameLimiter* frameLimiter)
+{
+    if (ImGui::Begin("Frame pacing"))
+    {
+        const VkPresentModeKHR presentModes[] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR };
+        const char* presentModeNames[] = { "FIFO", "FIFO relaxed", "Mailbox", "Immediate" };
+        int current = 0;
+        for (int i = 0; i < IM_ARRAYSIZE(presentModes); i++)
+            if (presentModes[i] == presentMode)
+                current = i;
+        if (ImGui::Combo("Present mode", &current, presentModeNames, IM_ARRAYSIZE(presentModeNames)))
+            presentMode = presentModes[current];
+
+        int frames = static_cast<int>(framesInFlight);
+        if (ImGui::SliderInt("Frames in flight", &frames, 1, static_cast<int>(Swapchain::MAX_FRAMES_IN_FLIGHT)))
+            framesInFlight = static_cast<uint32_t>(frames);
+
+        // beginFrame can only wait on presents when the device supports present wait
+        ImGui::BeginDisabled(!lowLatencySupported);
+        ImGui::Checkbox("Low latency", &lowLatency);
+        ImGui::EndDisabled();
+
+        if (frameLimiter)
+        {
+            float frameRate = static_cast<float>(frameLimiter->getTargetFrameRate());
+            if (ImGui::InputFloat("Frame rate cap", &frameRate, 10.f, 60.f, "%.0f"))
+                frameLimiter->setTargetFrameRate(std::max(frameRate, 0.f));
+        }
+    }
+    ImGui::End();
+}
+
+static void createCpuProfilerPanel()
+{
+    if (!ImGui::Begin("CPU profiler"))
+    {
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::Button("Export trace"))
+        CpuProfiler::exportChromeTrace("cpu_trace.json");
+
+    uint64_t frameStart, frameEnd;
+    CpuProfiler::getLastFrame(frameStart, frameEnd);
+    if (frameEnd <= frameStart)
+    {
+        ImGui::End();
+        return;
+    }
+    ImGui::SameLine();
+    ImGui::Text("last frame %.3f ms", (frameEnd - frameStart) / 1e6);
+
+    // zones of the last frame, one lane per thread with a row per depth
+    std::vector<CpuProfiler::Zone> zones = CpuProfiler::collect(frameStart);
+    std::vector<uint32_t> laneDepths;
+    for (const CpuProfiler::Zone& zone : zones)
+    {
+        if (zone.start > frameEnd)
+            continue;
+        if (zone.thread >= laneDepths.size())
+            laneDepths.resize(zone.thread + 1, 0);
+        laneDepths[zone.thread] = std::max(laneDepths[zone.thread], zone.depth + 1);
+    }
+    std::vector<uint32_t> laneRows(laneDepths.size() + 1, 0);
+    for (size_t i = 0; i < laneDepths.size(); i++)
+        laneRows[i + 1] = laneRows[i] + laneDepths[i];
+
+    const float rowHeight = ImGui::GetTextLineHeight() + 4.f;
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = std::max(ImGui::GetContentRegionAvail().x, 1.f);
+    float scale = width / static_cast<float>(frameEnd - frameStart);
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImVec2 mouse = ImGui::GetIO().MousePos;
+    for (const CpuProfiler::Zone& zone : zones)
+    {
+        if (zone.start > frameEnd)
+            continue;
+        float x0 = origin.x + (static_cast<float>(zone.start > frameStart ? zone.start - frameStart : 0)) * scale;
+        float x1 = origin.x + std::min(static_cast<float>(zone.end - frameStart) * scale, width);
+        float y0 = origin.y + (laneRows[zone.thread] + zone.depth) * rowHeight;
+        ImVec2 min(x0, y0), max(std::max(x1, x0 + 1.f), y0 + rowHeight - 1.f);
+        ImU32 colour = ImGui::GetColorU32(ImVec4(0.3f + 0.15f * (zone.depth % 4), 0.45f, 0.8f - 0.1f * (zone.depth % 4), 1.f));
+        drawList->AddRectFilled(min, max, colour);
+        drawList->PushClipRect(min, max, true);
+        drawList->AddText(ImVec2(x0 + 2.f, y0 + 2.f), IM_COL32_WHITE, zone.name);
+        drawList->PopClipRect();
+        if (mouse.x >= min.x && mouse.x < max.x && mouse.y >= min.y && mouse.y < max.y)
+            ImGui::SetTooltip("%s\n%.3f ms", zone.name, (zone.end - zone.start) / 1e6);
+    }
+    ImGui::Dummy(ImVec2(width, laneRows.back() * rowHeight));
+    ImGui::End();
+}
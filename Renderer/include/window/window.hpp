@@ -21,6 +21,9 @@ struct WindowSettings
 	bool resizable{ true }; //!< can window be resized
 	bool isVsync{ false }; //!< is vsync enabled
 	bool imguiEnabled{ false }; //!< does the window host imgui
+	uint32_t framesInFlight{ 2 }; //!< frames the renderer records ahead of the GPU, at most Swapchain::MAX_FRAMES_IN_FLIGHT
+	bool lowLatency{ false }; //!< does the renderer wait on presents, when present wait is supported
+	double frameRateCap{ 0.0 }; //!< frames per second the application is limited to, 0 if uncapped
 
 	WindowSettings() { } //!< default constructor
 };
@@ -50,6 +53,10 @@ public:
 	bool getResized() const { return m_resized; } //!< returns bool of if the window was resized
 	void setResized(bool resized) { m_resized = resized; } //!< returns bool of if the window was resized
 	float getAspectRatio() const { return m_settings.aspectRatio; } //!< get window aspect ratio from settings
+	bool isVsync() const { return m_settings.isVsync; } //!< returns if vsync is enabled in the settings
+	uint32_t getFramesInFlight() const { return m_settings.framesInFlight; } //!< returns the frames in flight from the settings
+	bool isLowLatency() const { return m_settings.lowLatency; } //!< returns if low latency is enabled in the settings
+	double getFrameRateCap() const { return m_settings.frameRateCap; } //!< returns the frame rate cap from the settings
 	VkExtent2D getExtent() { return { static_cast<uint32_t>(m_settings.width), static_cast<uint32_t>(m_settings.height) }; } //!< returns the actual extent of the window
 private:
 	GLFWwindow* m_window; //!< glfw window
@@ -0,0 +1,46 @@
+#version 460
+
+// CompactVertex: positions are snorm16 over the mesh AABB, tex coords are half floats and normals are octahedral snorm16
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) in vec2 octNormal;
+
+layout(set = 0, binding = 0) uniform CameraUBO {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} u_camera;
+
+layout(push_constant) uniform pushConstant {
+    mat4 model;
+    mat4 dequantise;
+} ps;
+
+layout(location = 0) out vec3 fragmentPos;
+layout(location = 1) out vec3 vertexNormal;
+layout(location = 2) out vec2 v_texCoord;
+#ifdef BINDLESS
+// bindless draws pass the texture table index as firstInstance
+layout(location = 3) flat out uint v_textureIndex;
+#endif
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 normal = vec3(encoded, 1.f - abs(encoded.x) - abs(encoded.y));
+    float t = max(-normal.z, 0.f);
+    normal.x += normal.x >= 0.f ? -t : t;
+    normal.y += normal.y >= 0.f ? -t : t;
+    return normalize(normal);
+}
+
+void main()
+{
+    vec3 localPos = vec3(ps.dequantise * vec4(position.xyz, 1.f));
+    fragmentPos = vec3(ps.model * vec4(localPos, 1.f));
+    vertexNormal = normalize(mat3(transpose(inverse(ps.model))) * decodeOctahedral(octNormal));
+    v_texCoord = texCoord;
+#ifdef BINDLESS
+    v_textureIndex = gl_InstanceIndex;
+#endif
+    gl_Position = u_camera.proj * u_camera.view * vec4(fragmentPos, 1.f);
+}
@@ -0,0 +1,44 @@
+#version 460
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) in vec3 normal;
+
+layout(set = 0, binding = 0) uniform CameraUBO {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} u_camera;
+
+// written by GpuCuller; the indirect draws set firstInstance to the instance index
+struct Instance {
+    mat4 model;
+    vec4 sphere;
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint textureIndex;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer InstanceSSBO {
+    Instance instances[];
+};
+
+layout(location = 0) out vec3 fragmentPos;
+layout(location = 1) out vec3 vertexNormal;
+layout(location = 2) out vec2 v_texCoord;
+#ifdef BINDLESS
+layout(location = 3) flat out uint v_textureIndex;
+#endif
+
+void main()
+{
+    mat4 model = instances[gl_InstanceIndex].model;
+    fragmentPos = vec3(model * vec4(position, 1.f));
+    vertexNormal = normalize(mat3(transpose(inverse(model))) * normal);
+    v_texCoord = texCoord;
+#ifdef BINDLESS
+    v_textureIndex = instances[gl_InstanceIndex].textureIndex;
+#endif
+    gl_Position = u_camera.proj * u_camera.view * vec4(fragmentPos, 1.f);
+}
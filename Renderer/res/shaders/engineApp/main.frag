@@ -1,4 +1,7 @@
 #version 460
+#ifdef BINDLESS
+#extension GL_EXT_nonuniform_qualifier : require
+#endif
 
 layout(location = 0) out vec4 colour;
 
@@ -12,43 +15,76 @@ struct directionalLight
     vec3 direction;
 };
 
-struct pointLight
+// a point or spot light binned by cluster.comp
+struct light
 {
-    vec3 colour;
     vec3 position;
-    vec3 constants;
-};
-
-struct spotLight
-{
+    float range;
     vec3 colour;
-    vec3 position;
+    float innerCutOff; // cosine
     vec3 direction;
+    float outerCutOff; // cosine
     vec3 constants;
-    float innerCutOff;
-    float outerCutOff;
+    uint type;
 };
 
-const int numPointLights = 1;
+const uint CLUSTER_STRIDE = 256u;
+const uint SPOT = 1u;
+const uint CASCADE_COUNT = 4u;
 
+#ifdef BINDLESS
+// every texture in the scene, indexed per draw
+layout(set = 1, binding = 0) uniform sampler2D u_textures[];
+layout(location = 3) flat in uint v_textureIndex;
+#else
 layout(set = 1, binding = 0) uniform sampler2D u_texture;
+#endif
 
 layout(set = 0, binding = 1) uniform LightUBO {
     directionalLight dLight;
-    pointLight pLights[numPointLights];
 } u_light;
 
 layout(set = 0, binding = 2) uniform ViewUBO {
     vec3 viewPos;
 } u_view;
 
+layout(set = 0, binding = 3) uniform ClusterUBO {
+    mat4 inverseProjection;
+    mat4 view;
+    vec2 screenSize;
+    vec2 tileSize;
+    float zNear;
+    float zFar;
+    float sliceScale;
+    float sliceBias;
+    uvec4 gridSize; // w is the light count
+} u_cluster;
+
+layout(std430, set = 0, binding = 4) readonly buffer LightSSBO {
+    light lights[];
+};
+
+layout(std430, set = 0, binding = 5) readonly buffer ClusterSSBO {
+    uint clusterLights[]; // per cluster, the light count followed by the light indices
+};
+
+layout(set = 0, binding = 6) uniform ShadowUBO {
+    mat4 viewProjections[CASCADE_COUNT];
+    vec4 splitDepths;
+    vec4 texelWorldSizes;
+    vec4 filtering; // x is a texel in uv, y the normal offset in texels and z the PCF radius in texels
+} u_shadow;
+
+layout(set = 0, binding = 7) uniform sampler2DArrayShadow u_shadowMap;
+
 vec3 getDirectionalLight();
 vec3 FresnelSchlick(float cosTheta, vec3 F0);
 float DistributionGGX();
 float GeometrySmith();
 float GeometrySchlickGGX(float Ndot);
-vec3 getPointLight(int index);
-vec3 getSpotLight(int index);
+uint getCluster();
+float getShadow();
+vec3 getLocalLight(uint index);
 
 // global vars
 const float PI = 3.14159265359f;
@@ -71,7 +107,11 @@ vec4 fragPosClipSpace;
 void main()
 {
     vec2 uv = v_texCoord;
+#ifdef BINDLESS
+    albedo = texture(u_textures[nonuniformEXT(v_textureIndex)], uv).rgb;
+#else
     albedo = texture(u_texture, uv).rgb;
+#endif
     N = normalize(vertexNormal);
     V = normalize(u_view.viewPos - fragmentPos);
 
@@ -83,9 +123,12 @@ void main()
     vec3 result = vec3(0.01f, 0.01f, 0.01f);
     result += getDirectionalLight();
 
-    for (int i = 0; i < numPointLights; i++)
+    // only the lights cluster.comp found reaching this fragment's cluster
+    uint cluster = getCluster() * CLUSTER_STRIDE;
+    uint count = clusterLights[cluster];
+    for (uint i = 0u; i < count; i++)
     {
-        result += getPointLight(i);
+        result += getLocalLight(clusterLights[cluster + 1u + i]);
     }
 
     colour = vec4(result, 1.f);
@@ -113,18 +156,61 @@ vec3 getDirectionalLight()
     kD *= 1.f - metallic;
     vec3 diffuse = (kD * albedo / PI) * NdotL;
 
-    return ambient + (diffuse + specular) * u_light.dLight.colour;
+    return ambient + getShadow() * (diffuse + specular) * u_light.dLight.colour;
 }
 
-vec3 getPointLight(int index)
+// fraction of the directional light reaching the fragment, filtered over the cascade covering its view depth
+float getShadow()
 {
-    vec3 ambient = albedo;
+    float viewDepth = -(u_cluster.view * vec4(fragmentPos, 1.f)).z;
+    uint cascade = 0u;
+    while (cascade < CASCADE_COUNT && viewDepth > u_shadow.splitDepths[cascade])
+        cascade++;
+    if (cascade == CASCADE_COUNT)
+        return 1.f;
+
+    // pushing the lookup off the surface by a texel's width keeps grazing surfaces from shadowing themselves
+    vec3 position = fragmentPos + N * (u_shadow.texelWorldSizes[cascade] * u_shadow.filtering.y);
+    vec4 lightClip = u_shadow.viewProjections[cascade] * vec4(position, 1.f);
+    vec2 uv = lightClip.xy * 0.5f + 0.5f;
+
+    int radius = int(u_shadow.filtering.z);
+    float lit = 0.f;
+    for (int y = -radius; y <= radius; y++)
+    {
+        for (int x = -radius; x <= radius; x++)
+        {
+            lit += texture(u_shadowMap, vec4(uv + vec2(x, y) * u_shadow.filtering.x, float(cascade), lightClip.z));
+        }
+    }
+    float taps = float((2 * radius + 1) * (2 * radius + 1));
+    return lit / taps;
+}
 
-    vec3 L = normalize(u_light.pLights[index].position - fragmentPos);
+// must match LightClusterer::getCluster
+uint getCluster()
+{
+    float viewDepth = -(u_cluster.view * vec4(fragmentPos, 1.f)).z;
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / u_cluster.tileSize), u_cluster.gridSize.xy - 1u);
+    int slice = int(floor(log(max(viewDepth, u_cluster.zNear)) * u_cluster.sliceScale + u_cluster.sliceBias));
+    slice = clamp(slice, 0, int(u_cluster.gridSize.z) - 1);
+    return tile.x + u_cluster.gridSize.x * (tile.y + u_cluster.gridSize.y * uint(slice));
+}
+
+vec3 getLocalLight(uint index)
+{
+    light l = lights[index];
+    vec3 L = normalize(l.position - fragmentPos);
     vec3 H = normalize(L + V);
-    float distance = length(u_light.pLights[index].position - fragmentPos);
-    float attenuation = 1.f / (distance * distance);
-    vec3 radiance = u_light.pLights[index].colour * attenuation;
+    float distance = length(l.position - fragmentPos);
+
+    // the attenuation is windowed to reach zero at the range the light was binned with, so it never cuts off at a cluster edge
+    float attenuation = 1.f / (l.constants.x + l.constants.y * distance + l.constants.z * distance * distance);
+    float falloff = clamp(1.f - pow(distance / l.range, 4.f), 0.f, 1.f);
+    attenuation *= falloff * falloff;
+    if (l.type == SPOT)
+        attenuation *= clamp((dot(-L, l.direction) - l.outerCutOff) / max(l.innerCutOff - l.outerCutOff, 0.0001f), 0.f, 1.f);
+    vec3 radiance = l.colour * attenuation;
 
     NdotL = max(dot(N, L), 0.f);
     NdotH = max(dot(N, H), 0.f);
@@ -143,7 +229,7 @@ vec3 getPointLight(int index)
 
     vec3 diffuse = (kD * albedo / PI) * NdotL;
 
-    return ambient + (diffuse + specular) * u_light.pLights[index].colour;
+    return (diffuse + specular) * radiance;
 }
 
 vec3 FresnelSchlick(float cosTheta, vec3 F0)
@@ -17,11 +17,18 @@ layout(push_constant) uniform pushConstant {
 layout(location = 0) out vec3 fragmentPos;
 layout(location = 1) out vec3 vertexNormal;
 layout(location = 2) out vec2 v_texCoord;
+#ifdef BINDLESS
+// bindless draws pass the texture table index as firstInstance
+layout(location = 3) flat out uint v_textureIndex;
+#endif
 
 void main()
 {
     fragmentPos = vec3(ps.model * vec4(position, 1.f));
     vertexNormal = normalize(mat3(transpose(inverse(ps.model))) * normal);
     v_texCoord = texCoord;
+#ifdef BINDLESS
+    v_textureIndex = gl_InstanceIndex;
+#endif
     gl_Position = u_camera.proj * u_camera.view * vec4(fragmentPos, 1.f);
 }
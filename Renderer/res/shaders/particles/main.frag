@@ -0,0 +1,10 @@
+#version 460
+
+layout(location = 0) out vec4 f_colour;
+
+layout(location = 0) in vec4 v_colour;
+
+void main() {
+    vec2 texCoord = gl_PointCoord - vec2(0.5f);
+    f_colour = vec4(v_colour.rgb, v_colour.a * clamp(1.f - 2.f * length(texCoord), 0.f, 1.f));
+}
@@ -0,0 +1,41 @@
+#version 460
+
+// draws each alive particle as a point sprite, fetching it through the alive list
+struct Particle {
+    vec3 position;
+    uint life; // unorm16 fraction of the lifetime left in the low half, 0 once dead, and the lifetime as a half float in the high half
+    vec3 velocity;
+    uint colour; // packUnorm4x8
+};
+
+layout(set = 0, binding = 0) uniform ParticleUBO {
+    mat4 viewProjection;
+    vec4 emitter;
+    vec4 gravity;
+    vec4 colourMin;
+    vec4 colourMax;
+    vec2 lifetime;
+    vec2 speed;
+    uint maxParticles;
+    uint emitCount;
+    uint seed;
+    float pointSize;
+} u_particles;
+
+layout(std430, set = 0, binding = 1) readonly buffer ParticleSSBO {
+    Particle particles[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer AliveSSBO {
+    uvec2 alive[];
+};
+
+layout(location = 0) out vec4 v_colour;
+
+void main() {
+    Particle particle = particles[alive[gl_VertexIndex].y];
+    vec4 colour = unpackUnorm4x8(particle.colour);
+    v_colour = vec4(colour.rgb, colour.a * unpackUnorm2x16(particle.life).x);
+    gl_PointSize = u_particles.pointSize;
+    gl_Position = u_particles.viewProjection * vec4(particle.position, 1.f);
+}
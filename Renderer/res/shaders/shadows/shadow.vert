@@ -0,0 +1,18 @@
+#version 460
+
+// depth only: the pipeline has no fragment stage, so only the position is read and nothing but depth is written
+layout(location = 0) in vec3 position;
+
+// written by ShadowMapper; each instanced draw sets firstInstance to its first caster
+layout(std430, set = 0, binding = 0) readonly buffer InstanceSSBO {
+    mat4 models[];
+};
+
+layout(push_constant) uniform pushConstant {
+    mat4 viewProjection;
+} ps;
+
+void main()
+{
+    gl_Position = ps.viewProjection * models[gl_InstanceIndex] * vec4(position, 1.f);
+}
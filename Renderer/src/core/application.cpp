@@ -113,3 +113,45 @@ void Application::transitionImageLayout(VkImage image, VkFormat format, VkImageL
 
     endSingleTimeCommands(commandBuffer);
 }
+
+void Application::createDeviceLocalBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+{
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    m_device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    void* mapped;
+    vkMapMemory(m_device->getDevice(), stagingBufferMemory, 0, size, 0, &mapped);
+    memcpy(mapped, data, (size_t)size);
+    vkUnmapMemory(m_device->getDevice(), stagingBufferMemory);
+
+    m_device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+
+    m_device->copyBuffer(stagingBuffer, buffer, size);
+
+    vkDestroyBuffer(m_device->getDevice(), stagingBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), stagingBufferMemory, nullptr);
+}
+
+void Application::loadMeshFile(Rock::RenderComponent& renderComp, const std::string& path)
+{
+    ROCK_PROFILE_FUNCTION();
+    // the mapped pages are copied straight into the staging buffers; m_vertices and m_indices stay empty
+    Rock::MeshFile meshFile(path);
+    renderComp.m_bounds = meshFile.getBounds();
+
+    if (renderComp.m_vertexFormat == Rock::VertexFormat::Compact)
+    {
+        std::vector<CompactVertex> vertices = CompactVertex::encode(static_cast<const Vertex*>(meshFile.getVertexData()), meshFile.getHeader().vertexCount, renderComp.m_bounds);
+        createDeviceLocalBuffer(vertices.data(), sizeof(CompactVertex) * vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, renderComp.m_vertexBuffer, renderComp.m_vertexBufferMemory);
+        renderComp.m_dequantise = CompactVertex::getDequantiseTransform(renderComp.m_bounds);
+    }
+    else
+    {
+        createDeviceLocalBuffer(meshFile.getVertexData(), meshFile.getVertexDataSize(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, renderComp.m_vertexBuffer, renderComp.m_vertexBufferMemory);
+    }
+    createDeviceLocalBuffer(meshFile.getIndexData(), meshFile.getIndexDataSize(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, renderComp.m_indexBuffer, renderComp.m_indexBufferMemory);
+
+    renderComp.m_indexCount = meshFile.getHeader().indexCount;
+    renderComp.m_indexType = meshFile.getIndexType();
+}
@@ -0,0 +1,58 @@
+/** \file commandPools.cpp */
+
+#include "core/commandPools.hpp"
+
+CommandPools::CommandPools(Device* device, uint32_t threadCount, uint32_t framesInFlight)
+    : m_device(device), m_threadCount(threadCount)
+{
+    QueueFamilyIndices queueFamilyIndices = m_device->findPhysicalQueueFamilies();
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // buffers are re-recorded every frame and reset together with the pool
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+    m_pools.resize(threadCount * framesInFlight);
+    for (Pool& pool : m_pools)
+    {
+        if (vkCreateCommandPool(m_device->getDevice(), &poolInfo, nullptr, &pool.commandPool) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create thread command pool.");
+    }
+}
+
+CommandPools::~CommandPools()
+{
+    // destroying a pool frees every buffer allocated from it
+    for (Pool& pool : m_pools)
+        vkDestroyCommandPool(m_device->getDevice(), pool.commandPool, nullptr);
+    m_device = nullptr;
+}
+
+void CommandPools::reset(uint32_t frame)
+{
+    for (uint32_t thread = 0; thread < m_threadCount; thread++)
+    {
+        Pool& pool = getPool(frame, thread);
+        vkResetCommandPool(m_device->getDevice(), pool.commandPool, 0);
+        pool.used = 0;
+    }
+}
+
+VkCommandBuffer CommandPools::acquireSecondary(uint32_t frame, uint32_t thread)
+{
+    Pool& pool = getPool(frame, thread);
+    if (pool.used == pool.secondaries.size())
+    {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = pool.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(m_device->getDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate secondary command buffer.");
+        pool.secondaries.push_back(commandBuffer);
+    }
+    return pool.secondaries[pool.used++];
+}
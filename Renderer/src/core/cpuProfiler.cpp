@@ -0,0 +1,134 @@
+/** \file cpuProfiler.cpp */
+
+#include "core/cpuProfiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    std::mutex s_registerMutex; // guards registration and the copying of the buffer list, never recording
+    std::atomic<uint64_t> s_frameStart{ 0 };
+    std::atomic<uint64_t> s_lastFrameStart{ 0 };
+    std::atomic<uint64_t> s_lastFrameEnd{ 0 };
+}
+
+CpuProfiler::Scope::Scope(const char* name) : m_name(name), m_start(now())
+{
+    getThreadBuffer().depth++;
+}
+
+CpuProfiler::Scope::~Scope()
+{
+    uint64_t end = now();
+    ThreadBuffer& buffer = getThreadBuffer();
+    buffer.depth--;
+    uint64_t head = buffer.head.load(std::memory_order_relaxed);
+    buffer.zones[head % RING_CAPACITY] = { m_name, m_start, end, buffer.depth, buffer.thread };
+    buffer.head.store(head + 1, std::memory_order_release); // publishes the zone to collect
+}
+
+uint64_t CpuProfiler::now()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+void CpuProfiler::markFrame()
+{
+    uint64_t time = now();
+    s_lastFrameStart.store(s_frameStart.exchange(time));
+    s_lastFrameEnd.store(time);
+}
+
+void CpuProfiler::getLastFrame(uint64_t& start, uint64_t& end)
+{
+    end = s_lastFrameEnd.load();
+    start = end > 0 ? s_lastFrameStart.load() : 0;
+}
+
+std::vector<CpuProfiler::Zone> CpuProfiler::collect(uint64_t since)
+{
+    std::vector<ThreadBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(s_registerMutex);
+        for (std::unique_ptr<ThreadBuffer>& buffer : getBuffers())
+            buffers.push_back(buffer.get());
+    }
+
+    std::vector<Zone> zones;
+    for (ThreadBuffer* buffer : buffers)
+    {
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+        size_t begin = zones.size();
+        for (uint64_t i = first; i < head; i++)
+            zones.push_back(buffer->zones[i % RING_CAPACITY]);
+
+        // the owning thread kept recording while the ring was copied, so zones it may have overwritten are dropped;
+        // it may also be midway through writing zone after, whose slot holds zone after - RING_CAPACITY
+        uint64_t after = buffer->head.load(std::memory_order_acquire);
+        uint64_t overwritten = after + 1 > RING_CAPACITY ? after + 1 - RING_CAPACITY : 0;
+        if (overwritten > first)
+            zones.erase(zones.begin() + begin, zones.begin() + begin + static_cast<size_t>(std::min(overwritten, head) - first));
+    }
+
+    if (since > 0)
+        zones.erase(std::remove_if(zones.begin(), zones.end(), [since](const Zone& zone) { return zone.end < since; }), zones.end());
+    return zones;
+}
+
+std::string CpuProfiler::toChromeTrace(const std::vector<Zone>& zones)
+{
+    std::ostringstream json;
+    json << "{\"traceEvents\":[";
+    for (size_t i = 0; i < zones.size(); i++)
+    {
+        const Zone& zone = zones[i];
+        json << (i > 0 ? ",\n" : "\n") << "{\"name\":\"";
+        for (const char* c = zone.name; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                json << '\\';
+            json << *c;
+        }
+        // complete events in microseconds; the viewer nests events of a thread by their times
+        json << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":" << zone.start / 1000 << "." << (zone.start % 1000) / 100
+            << ",\"dur\":" << (zone.end - zone.start) / 1000 << "." << ((zone.end - zone.start) % 1000) / 100
+            << ",\"pid\":0,\"tid\":" << zone.thread << "}";
+    }
+    json << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return json.str();
+}
+
+void CpuProfiler::exportChromeTrace(const std::string& path)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open CPU trace export.");
+    file << toChromeTrace(collect());
+}
+
+CpuProfiler::ThreadBuffer& CpuProfiler::getThreadBuffer()
+{
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> lock(s_registerMutex);
+        std::vector<std::unique_ptr<ThreadBuffer>>& buffers = getBuffers();
+        buffers.push_back(std::make_unique<ThreadBuffer>());
+        buffer = buffers.back().get();
+        buffer->thread = static_cast<uint32_t>(buffers.size() - 1);
+    }
+    return *buffer;
+}
+
+std::vector<std::unique_ptr<CpuProfiler::ThreadBuffer>>& CpuProfiler::getBuffers()
+{
+    static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    return buffers;
+}
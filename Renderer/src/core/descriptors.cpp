@@ -2,58 +2,199 @@
 
 #include "core/descriptors.hpp"
 
-DescriptorManager::~DescriptorManager()
+#include <algorithm>
+#include <functional>
+
+namespace
+{
+	void hashCombine(size_t& seed, size_t value)
+	{
+		seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+	}
+}
+
+DescriptorLayoutCache::LayoutKey DescriptorLayoutCache::LayoutKey::create(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags)
+{
+	LayoutKey key;
+	key.bindings = bindings;
+	key.flags = flags;
+	std::sort(key.bindings.begin(), key.bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+	return key;
+}
+
+bool DescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const
+{
+	if (flags != other.flags || bindings.size() != other.bindings.size())
+		return false;
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		const VkDescriptorSetLayoutBinding& a = bindings[i];
+		const VkDescriptorSetLayoutBinding& b = other.bindings[i];
+		if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount ||
+			a.stageFlags != b.stageFlags || a.pImmutableSamplers != b.pImmutableSamplers)
+			return false;
+	}
+	return true;
+}
+
+size_t DescriptorLayoutCache::LayoutKey::hash() const
+{
+	size_t seed = std::hash<uint32_t>()(flags);
+	for (const VkDescriptorSetLayoutBinding& binding : bindings)
+	{
+		hashCombine(seed, std::hash<uint32_t>()(binding.binding));
+		hashCombine(seed, std::hash<uint32_t>()(static_cast<uint32_t>(binding.descriptorType)));
+		hashCombine(seed, std::hash<uint32_t>()(binding.descriptorCount));
+		hashCombine(seed, std::hash<uint32_t>()(binding.stageFlags));
+		hashCombine(seed, std::hash<const void*>()(binding.pImmutableSamplers));
+	}
+	return seed;
+}
+
+DescriptorLayoutCache::~DescriptorLayoutCache()
+{
+	for (auto& layout : m_layouts)
+		vkDestroyDescriptorSetLayout(m_device->getDevice(), layout.second, nullptr);
+	m_device = nullptr;
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::createDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags)
+{
+	LayoutKey key = LayoutKey::create(bindings, flags);
+	auto it = m_layouts.find(key);
+	if (it != m_layouts.end())
+		return it->second;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.flags = flags;
+	layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+	layoutInfo.pBindings = key.bindings.data();
+
+	VkDescriptorSetLayout layout;
+	if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create descriptor set layout.");
+	m_layouts.emplace(std::move(key), layout);
+	return layout;
+}
+
+DescriptorAllocator::DescriptorAllocator(Device* device, uint32_t setsPerPool) : m_device(device), m_setsPerPool(setsPerPool)
+{
+	m_ratios = {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 5.f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2.f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f }
+	};
+}
+
+DescriptorAllocator::~DescriptorAllocator()
 {
-	freeDescriptors();
-	vkDestroyDescriptorSetLayout(m_device->getDevice(), m_descriptorSetLayout, nullptr);
-	vkDestroyDescriptorPool(m_device->getDevice(), m_descriptorPool, nullptr);
+	for (VkDescriptorPool pool : m_usedPools)
+		vkDestroyDescriptorPool(m_device->getDevice(), pool, nullptr);
+	for (VkDescriptorPool pool : m_freePools)
+		vkDestroyDescriptorPool(m_device->getDevice(), pool, nullptr);
 	m_device = nullptr;
 }
 
-void DescriptorManager::addPoolSize(VkDescriptorType type, uint32_t count)
+std::vector<VkDescriptorPoolSize> DescriptorAllocator::getPoolSizes(const std::vector<PoolRatio>& ratios, uint32_t setsPerPool)
 {
-	VkDescriptorPoolSize poolSize{};
-	poolSize.type = type;
-	poolSize.descriptorCount = count;
-	m_poolSizes.push_back(poolSize);
+	std::vector<VkDescriptorPoolSize> sizes;
+	sizes.reserve(ratios.size());
+	for (const PoolRatio& ratio : ratios)
+	{
+		VkDescriptorPoolSize size{};
+		size.type = ratio.type;
+		size.descriptorCount = std::max(1u, static_cast<uint32_t>(ratio.ratio * setsPerPool));
+		sizes.push_back(size);
+	}
+	return sizes;
 }
 
-void DescriptorManager::buildDescriptorPool()
+VkDescriptorPool DescriptorAllocator::grabPool()
 {
+	if (!m_freePools.empty())
+	{
+		VkDescriptorPool pool = m_freePools.back();
+		m_freePools.pop_back();
+		return pool;
+	}
+
+	std::vector<VkDescriptorPoolSize> poolSizes = getPoolSizes(m_ratios, m_setsPerPool);
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-	poolInfo.poolSizeCount = static_cast<uint32_t>(m_poolSizes.size());
-	poolInfo.pPoolSizes = m_poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(m_maxSets * 3);
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = m_setsPerPool;
 
-	if (vkCreateDescriptorPool(m_device->getDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(m_device->getDevice(), &poolInfo, nullptr, &pool) != VK_SUCCESS)
 		throw std::runtime_error("Failed to create descriptor pool.");
+	return pool;
 }
 
-void DescriptorManager::allocateDescriptorSets()
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
 {
-	std::vector<VkDescriptorSetLayout> layouts(m_maxSets, m_descriptorSetLayout);
+	if (m_currentPool == VK_NULL_HANDLE)
+	{
+		m_currentPool = grabPool();
+		m_usedPools.push_back(m_currentPool);
+	}
+
 	VkDescriptorSetAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocInfo.descriptorPool = m_descriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(m_maxSets);
-	allocInfo.pSetLayouts = layouts.data();
+	allocInfo.descriptorPool = m_currentPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
 
-	m_descriptorSets.resize(m_maxSets);
-	if (vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, m_descriptorSets.data()) != VK_SUCCESS)
-		throw std::runtime_error("Failed to allocate descriptor sets.");
+	VkDescriptorSet set;
+	VkResult result = vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, &set);
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+	{
+		// the current pool is full, so chain a fresh one and retry once
+		m_currentPool = grabPool();
+		m_usedPools.push_back(m_currentPool);
+		allocInfo.descriptorPool = m_currentPool;
+		result = vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, &set);
+	}
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate descriptor set.");
+	return set;
 }
 
-void DescriptorManager::freeDescriptors() const
+void DescriptorAllocator::resetPools()
 {
-	if (m_descriptorSets.size() == 0) return;
-	vkFreeDescriptorSets(m_device->getDevice(), m_descriptorPool, static_cast<uint32_t>(m_descriptorSets.size()), m_descriptorSets.data());
+	for (VkDescriptorPool pool : m_usedPools)
+	{
+		vkResetDescriptorPool(m_device->getDevice(), pool, 0);
+		m_freePools.push_back(pool);
+	}
+	m_usedPools.clear();
+	m_currentPool = VK_NULL_HANDLE;
 }
 
-void DescriptorManager::resetDescriptorPool()
+DescriptorManager::DescriptorManager(Device* device, uint32_t maxSets) : m_device(device), m_maxSets(maxSets)
 {
-	vkResetDescriptorPool(m_device->getDevice(), m_descriptorPool, 0);
+	m_layoutCache = new DescriptorLayoutCache(device);
+	m_allocator = new DescriptorAllocator(device);
+}
+
+DescriptorManager::~DescriptorManager()
+{
+	delete m_allocator;
+	m_allocator = nullptr;
+	delete m_layoutCache;
+	m_layoutCache = nullptr;
+	m_device = nullptr;
+}
+
+void DescriptorManager::allocateDescriptorSets()
+{
+	m_descriptorSets.resize(m_maxSets);
+	for (auto& descriptorSet : m_descriptorSets)
+		descriptorSet = m_allocator->allocate(m_descriptorSetLayout);
 }
 
 void DescriptorManager::addBinding(uint32_t index, VkDescriptorType type, VkShaderStageFlags flags, uint32_t count, VkSampler* samplers)
@@ -71,10 +212,7 @@ void DescriptorManager::addBinding(uint32_t index, VkDescriptorType type, VkShad
 
 bool DescriptorManager::bindingFound(uint32_t index)
 {
-	std::vector<VkDescriptorSetLayoutBinding> bindings;
-	bindings = m_bindings;
-
-	for (auto& binding : bindings)
+	for (auto& binding : m_bindings)
 	{
 		if (binding.binding == index)
 			return true;
@@ -84,13 +222,7 @@ bool DescriptorManager::bindingFound(uint32_t index)
 
 void DescriptorManager::buildDescriptorSetLayout()
 {
-	VkDescriptorSetLayoutCreateInfo layoutInfo{};
-	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = static_cast<uint32_t>(m_bindings.size());
-	layoutInfo.pBindings = m_bindings.data();
-
-	if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
-		throw std::runtime_error("Failed to create descriptor set layout.");
+	m_descriptorSetLayout = m_layoutCache->createDescriptorSetLayout(m_bindings);
 }
 
 void DescriptorManager::addWriteDescriptorSet(uint32_t binding, VkDescriptorBufferInfo* bufferInfo, VkDescriptorImageInfo* imageInfo)
@@ -113,12 +245,9 @@ void DescriptorManager::addWriteDescriptorSet(uint32_t binding, VkDescriptorBuff
 
 void DescriptorManager::overwrite(uint32_t index)
 {
-	std::vector<VkWriteDescriptorSet> writes;
 	for (auto& write : m_descriptorWrites)
-	{
 		write.dstSet = m_descriptorSets[index];
-		writes.push_back(write);
-	}
 
-	vkUpdateDescriptorSets(m_device->getDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+	vkUpdateDescriptorSets(m_device->getDevice(), static_cast<uint32_t>(m_descriptorWrites.size()), m_descriptorWrites.data(), 0, nullptr);
+	m_descriptorWrites.clear();
 }
@@ -1,6 +1,7 @@
 /** \file device.cpp */
 
 #include "core/device.hpp"
+#include "rendering/pipelineCache.hpp"
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
     VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData)
@@ -41,7 +42,10 @@ Device::Device(Window* window) : m_window(window)
 
 Device::~Device()
 {
+    delete m_pipelineCache;
+    m_pipelineCache = nullptr;
     vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+    vkDestroyCommandPool(m_device, m_computeCommandPool, nullptr);
     vkDestroyDevice(m_device, nullptr);
     if (enableValidationLayers)
         destroyDebugUtilsMessenger(m_instance, m_debugMessenger, nullptr);
@@ -60,6 +64,7 @@ void Device::initDevice()
     pickPhysicalDevice();
     createLogicalDevice();
     createCommandPool();
+    createPipelineCache();
 }
 
 void Device::createInstance()
@@ -126,6 +131,11 @@ void Device::setupDebugMessenger()
 
 void Device::createSurface()
 {
+    if (isHeadless())
+    {
+        m_surface = VK_NULL_HANDLE;
+        return;
+    }
     m_window->createSurface(m_instance, &m_surface);
 }
 
@@ -158,7 +168,9 @@ void Device::createLogicalDevice()
     QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+    std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.computeFamily.value() };
+    m_graphicsFamily = indices.graphicsFamily.value();
+    m_computeFamily = indices.computeFamily.value();
 
     float queuePriority = 1.f;
     for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -171,16 +183,78 @@ void Device::createLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
-    VkPhysicalDeviceFeatures deviceFeatures{};
-    deviceFeatures.samplerAnisotropy = VK_TRUE;
+    // optional features used by GPU driven rendering are enabled when the device supports them
+    VkPhysicalDeviceVulkan12Features supportedFeatures12{};
+    supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    VkPhysicalDeviceFeatures2 supportedFeatures{};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures.pNext = &supportedFeatures12;
+    VkPhysicalDevicePresentWaitFeaturesKHR supportedPresentWait{};
+    supportedPresentWait.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    VkPhysicalDevicePresentIdFeaturesKHR supportedPresentId{};
+    supportedPresentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    supportedPresentId.pNext = &supportedPresentWait;
+    bool presentWaitExtensions = !isHeadless() && checkDeviceExtensionSupport(m_physicalDevice, { VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME });
+    if (presentWaitExtensions)
+        supportedFeatures12.pNext = &supportedPresentId;
+    vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
+
+    VkPhysicalDeviceVulkan12Features deviceFeatures12{};
+    deviceFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    deviceFeatures12.drawIndirectCount = supportedFeatures12.drawIndirectCount;
+    deviceFeatures12.timelineSemaphore = VK_TRUE; // required by Vulkan 1.2; chains async compute into graphics
+    m_drawIndirectCount = supportedFeatures12.drawIndirectCount == VK_TRUE;
+
+    // bindless textures need a partially bound, runtime sized sampler array that can be written while in use
+    m_bindlessTextures = supportedFeatures12.descriptorIndexing && supportedFeatures12.runtimeDescriptorArray && supportedFeatures12.descriptorBindingPartiallyBound &&
+        supportedFeatures12.shaderSampledImageArrayNonUniformIndexing && supportedFeatures12.descriptorBindingSampledImageUpdateAfterBind;
+    if (m_bindlessTextures)
+    {
+        deviceFeatures12.descriptorIndexing = VK_TRUE;
+        deviceFeatures12.runtimeDescriptorArray = VK_TRUE;
+        deviceFeatures12.descriptorBindingPartiallyBound = VK_TRUE;
+        deviceFeatures12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        deviceFeatures12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    }
+
+    // present wait lets the renderer hold back the CPU until an earlier frame has reached the display
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.pNext = &presentWaitFeatures;
+    m_presentWait = presentWaitExtensions && supportedPresentId.presentId && supportedPresentWait.presentWait;
+    if (m_presentWait)
+    {
+        presentIdFeatures.presentId = VK_TRUE;
+        presentWaitFeatures.presentWait = VK_TRUE;
+        deviceFeatures12.pNext = &presentIdFeatures;
+    }
+
+    VkPhysicalDeviceFeatures2 deviceFeatures{};
+    deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    deviceFeatures.pNext = &deviceFeatures12;
+    deviceFeatures.features.samplerAnisotropy = VK_TRUE;
+    deviceFeatures.features.multiDrawIndirect = supportedFeatures.features.multiDrawIndirect;
+    deviceFeatures.features.drawIndirectFirstInstance = supportedFeatures.features.drawIndirectFirstInstance;
+    deviceFeatures.features.pipelineStatisticsQuery = supportedFeatures.features.pipelineStatisticsQuery;
+    deviceFeatures.features.inheritedQueries = supportedFeatures.features.inheritedQueries;
+    m_enabledFeatures = deviceFeatures.features;
 
     VkDeviceCreateInfo ci{};
     ci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    ci.pNext = &deviceFeatures;
     ci.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     ci.pQueueCreateInfos = queueCreateInfos.data();
-    ci.pEnabledFeatures = &deviceFeatures;
-    ci.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    ci.ppEnabledExtensionNames = deviceExtensions.data();
+    ci.pEnabledFeatures = nullptr; // features are chained through pNext
+    std::vector<const char*> extensions = getDeviceExtensions();
+    if (m_presentWait)
+    {
+        extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    }
+    ci.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    ci.ppEnabledExtensionNames = extensions.data();
     if (enableValidationLayers)
     {
         ci.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -196,6 +270,9 @@ void Device::createLogicalDevice()
 
     vkGetDeviceQueue(m_device, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
     vkGetDeviceQueue(m_device, indices.presentFamily.value(), 0, &m_presentQueue);
+    vkGetDeviceQueue(m_device, indices.computeFamily.value(), 0, &m_computeQueue);
+    if (m_presentWait)
+        m_waitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(m_device, "vkWaitForPresentKHR");
 }
 
 void Device::createCommandPool()
@@ -209,6 +286,15 @@ void Device::createCommandPool()
 
     if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
         throw std::runtime_error("Failed to create command pool.");
+
+    poolInfo.queueFamilyIndex = queueFamilyIndices.computeFamily.value();
+    if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_computeCommandPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create compute command pool.");
+}
+
+void Device::createPipelineCache()
+{
+    m_pipelineCache = new PipelineCache(this);
 }
 
 bool Device::checkValidationLayerSupport()
@@ -252,7 +338,9 @@ bool Device::isDeviceSuitable(VkPhysicalDevice device)
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
     bool swapChainAdequate = false;
-    if (extensionsSupported)
+    if (extensionsSupported && isHeadless())
+        swapChainAdequate = true; // nothing is presented
+    else if (extensionsSupported)
     {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
@@ -263,11 +351,14 @@ bool Device::isDeviceSuitable(VkPhysicalDevice device)
 
 std::vector<const char*> Device::getRequiredExtensions()
 {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char*> extensions;
+    if (!isHeadless())
+    {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (enableValidationLayers)
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -275,6 +366,17 @@ std::vector<const char*> Device::getRequiredExtensions()
     return extensions;
 }
 
+std::vector<const char*> Device::getDeviceExtensions() const
+{
+    std::vector<const char*> extensions;
+    for (const char* extension : deviceExtensions)
+    {
+        if (!isHeadless() || strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) != 0)
+            extensions.push_back(extension);
+    }
+    return extensions;
+}
+
 QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device)
 {
     QueueFamilyIndices indices;
@@ -292,7 +394,10 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device)
             indices.graphicsFamily = i;
 
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
+        if (isHeadless())
+            presentSupport = indices.graphicsFamily.has_value() && indices.graphicsFamily.value() == static_cast<uint32_t>(i); // one queue serves both
+        else
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
 
         if (presentSupport)
             indices.presentFamily = i;
@@ -303,6 +408,18 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device)
         i++;
     }
 
+    // a family without graphics is usually backed by separate hardware queues that run alongside graphics
+    for (uint32_t family = 0; family < queueFamilyCount; family++)
+    {
+        if ((queueFamilies[family].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamilies[family].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+        {
+            indices.computeFamily = family;
+            break;
+        }
+    }
+    if (!indices.computeFamily.has_value())
+        indices.computeFamily = indices.graphicsFamily;
+
     return indices;
 }
 
@@ -324,13 +441,18 @@ bool Device::checkInstanceExtensionSupport()
 }
 
 bool Device::checkDeviceExtensionSupport(VkPhysicalDevice device)
+{
+    return checkDeviceExtensionSupport(device, getDeviceExtensions());
+}
+
+bool Device::checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& extensions)
 {
     uint32_t extensionCount;
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
     for (const auto& extension : availableExtensions)
     {
@@ -395,13 +517,20 @@ VkSampleCountFlagBits Device::getMaxUsableSampleCount()
     return VK_SAMPLE_COUNT_1_BIT;
 }
 
-void Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void Device::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory, bool sharedWithCompute)
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    uint32_t queueFamilies[] = { m_graphicsFamily, m_computeFamily };
+    if (sharedWithCompute && hasAsyncCompute())
+    {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = queueFamilies;
+    }
 
     if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
         throw std::runtime_error("Failed to create buffer.");
@@ -0,0 +1,49 @@
+/** \file frameAllocator.cpp */
+
+#include "core/frameAllocator.hpp"
+
+FrameAllocator::FrameAllocator(Device* device, VkDeviceSize capacity, uint32_t framesInFlight, VkBufferUsageFlags usage)
+    : m_device(device), m_capacity(capacity)
+{
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(m_device->getPhysicalDevice(), &properties);
+    m_alignment = std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+
+    m_buffers.resize(framesInFlight);
+    m_buffersMemory.resize(framesInFlight);
+    m_buffersMapped.resize(framesInFlight);
+    m_heads.resize(framesInFlight, 0);
+
+    for (size_t i = 0; i < framesInFlight; i++)
+    {
+        void* mapped;
+        m_device->createBuffer(m_capacity, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_buffers[i], m_buffersMemory[i]);
+        vkMapMemory(m_device->getDevice(), m_buffersMemory[i], 0, m_capacity, 0, &mapped);
+        m_buffersMapped[i] = static_cast<char*>(mapped);
+    }
+}
+
+FrameAllocator::~FrameAllocator()
+{
+    for (size_t i = 0; i < m_buffers.size(); i++)
+    {
+        vkDestroyBuffer(m_device->getDevice(), m_buffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_buffersMemory[i], nullptr);
+    }
+    m_device = nullptr;
+}
+
+VkDeviceSize FrameAllocator::allocate(uint32_t frame, VkDeviceSize size, void** mapped, VkDeviceSize alignment)
+{
+    if ((alignment & (alignment - 1)) != 0)
+        throw std::runtime_error("Frame allocator alignment must be a power of two.");
+
+    VkDeviceSize offset = alignUp(m_heads[frame], std::max(m_alignment, alignment));
+    if (offset + size > m_capacity)
+        throw std::runtime_error("Frame allocator is out of memory.");
+
+    m_heads[frame] = offset + size;
+    if (mapped != nullptr)
+        *mapped = m_buffersMapped[frame] + offset;
+    return offset;
+}
@@ -0,0 +1,42 @@
+/** \file frameLimiter.cpp */
+
+#include "core/frameLimiter.hpp"
+#include "core/cpuProfiler.hpp"
+
+#include <algorithm>
+#include <thread>
+
+void FrameLimiter::setTargetFrameRate(double targetFrameRate)
+{
+    m_targetFrameRate = std::max(targetFrameRate, 0.0);
+    m_period = m_targetFrameRate > 0.0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_targetFrameRate)) : Clock::duration(0);
+    m_started = false;
+}
+
+void FrameLimiter::wait()
+{
+    if (m_period == Clock::duration(0))
+        return;
+    ROCK_PROFILE_FUNCTION();
+
+    Clock::time_point now = Clock::now();
+    if (!m_started || now >= m_next + m_period)
+    {
+        m_started = true;
+        m_next = now + m_period;
+        return;
+    }
+
+    // sleep until the measured wake up error before the deadline, then spin the rest
+    Clock::duration sleep = m_next - now - m_sleepError;
+    if (sleep > Clock::duration(0))
+    {
+        std::this_thread::sleep_for(sleep);
+        Clock::duration error = Clock::now() - (now + sleep);
+        m_sleepError = std::max(error, m_sleepError - m_sleepError / 16);
+    }
+    while (Clock::now() < m_next)
+        std::this_thread::yield();
+
+    m_next += m_period;
+}
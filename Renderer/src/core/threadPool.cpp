@@ -0,0 +1,92 @@
+/** \file threadPool.cpp */
+
+#include "core/threadPool.hpp"
+
+#include <algorithm>
+
+// the pool whose worker is running on this thread, so nested parallelFor calls run inline rather than waiting on busy workers
+static thread_local const ThreadPool* t_workerPool = nullptr;
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		// hardware_concurrency may report 0 when it cannot tell
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (uint32_t i = 0; i < threadCount; i++)
+		m_workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> job)
+{
+	std::packaged_task<void()> task(std::move(job));
+	std::future<void> future = task.get_future();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push(std::move(task));
+	}
+	m_condition.notify_one();
+	return future;
+}
+
+void ThreadPool::parallelFor(size_t count, size_t minBatchSize, const std::function<void(size_t begin, size_t end)>& job)
+{
+	if (count == 0)
+		return;
+
+	size_t batchCount = std::min<size_t>(m_workers.size() + 1, (count + minBatchSize - 1) / std::max<size_t>(minBatchSize, 1));
+	if (batchCount <= 1 || t_workerPool == this)
+	{
+		job(0, count);
+		return;
+	}
+
+	size_t batchSize = (count + batchCount - 1) / batchCount;
+	std::vector<std::future<void>> futures;
+	futures.reserve(batchCount - 1);
+	for (size_t begin = batchSize; begin < count; begin += batchSize)
+	{
+		size_t end = std::min(begin + batchSize, count);
+		futures.push_back(submit([&job, begin, end]() { job(begin, end); }));
+	}
+
+	// the calling thread takes the first batch instead of idling
+	job(0, std::min(batchSize, count));
+
+	for (std::future<void>& future : futures)
+		future.get();
+}
+
+void ThreadPool::workerLoop()
+{
+	t_workerPool = this;
+	while (true)
+	{
+		std::packaged_task<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+			if (m_stopping && m_jobs.empty())
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop();
+		}
+		job();
+	}
+}
@@ -2,6 +2,8 @@
 
 #include "examples/engineApp.hpp"
 
+#include <random>
+
 //#define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
@@ -13,12 +15,17 @@ void EngineApp::initApplication()
     m_device = new Device();
     m_msaaSamples = m_device->getMaxUsableSampleCount();
     m_descriptorManager = new DescriptorManager(m_device, Swapchain::MAX_FRAMES_IN_FLIGHT);
-    m_renderer = new Renderer(m_device, m_msaaSamples, true);
+    m_renderer = new Renderer(m_device, m_msaaSamples, true, &m_threadPool);
+    m_frameLimiter.setTargetFrameRate(m_device->getWindow()->getFrameRateCap());
+    m_renderer->setFrameLimiter(&m_frameLimiter);
+    m_textureTable = new TextureTable(m_device);
+    m_renderer->setTextureTable(m_textureTable);
 
     createDescriptorSetLayouts();
-    createGraphicsPipeline();
+    m_graphicsPipelineFuture = compileGraphicsPipeline();
+    createLights();
+    createShadows();
     createUniformBuffers();
-    createDescriptorPool();
     createDescriptorSets();
     m_gameObject = m_registry.create();
     m_registry.emplace<Rock::RenderComponent>(m_gameObject);
@@ -32,6 +39,10 @@ void EngineApp::initApplication()
     m_registry.emplace<Rock::OBBComponent>(m_floor, glm::vec3(0.5f));
     loadTexture(m_floor, "./res/textures/cube2.png");
     loadModel(m_floor, "./res/models/cube.obj");
+    if (m_gpuCulling)
+        createGpuCulling();
+    if (m_shaderHotReload)
+        createShaderReloader();
 
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
@@ -39,7 +50,7 @@ void EngineApp::initApplication()
 
     ImGui_ImplGlfw_InitForVulkan(m_device->getWindow()->getWindow(), true);
     ImGui_ImplVulkan_InitInfo info{};
-    info.DescriptorPool = m_descriptorManager->getDescriptorPool();
+    info.DescriptorPoolSize = IMGUI_IMPL_VULKAN_MINIMUM_IMAGE_SAMPLER_POOL_SIZE + 1; // ImGui owns the pool its font set is allocated and freed from
     info.RenderPass = m_renderer->getSwapchainRenderPass();
     info.Device = m_device->getDevice();
     info.PhysicalDevice = m_device->getPhysicalDevice();
@@ -60,6 +71,8 @@ void EngineApp::mainLoop()
 {
     while (!m_device->getWindow()->shouldClose())
     {
+        ROCK_PROFILE_FRAME();
+        m_frameLimiter.wait();
         glfwPollEvents();
         drawFrame();
 
@@ -85,7 +98,22 @@ void EngineApp::cleanup()
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    waitForPipelines();
+    delete m_shaderReloader;
+    m_shaderReloader = nullptr;
     m_graphicsPipeline->destroyPipelineLayout();
+    if (m_gpuCuller)
+    {
+        m_instancedPipeline->destroyPipelineLayout();
+        delete m_instancedPipeline;
+        m_instancedPipeline = nullptr;
+        delete m_gpuCuller;
+        m_gpuCuller = nullptr;
+    }
+    delete m_lightClusterer;
+    m_lightClusterer = nullptr;
+    delete m_shadowMapper;
+    m_shadowMapper = nullptr;
     std::vector<entt::entity> m_gameObjects = { m_gameObject, m_floor };
     for (entt::entity entity : m_gameObjects)
     {
@@ -99,16 +127,10 @@ void EngineApp::cleanup()
         vkFreeMemory(m_device->getDevice(), renderComp.m_vertexBufferMemory, nullptr);
         vkFreeMemory(m_device->getDevice(), renderComp.m_indexBufferMemory, nullptr);
     }
-    for (size_t i = 0; i < Swapchain::MAX_FRAMES_IN_FLIGHT; i++)
-    {
-        vkDestroyBuffer(m_device->getDevice(), m_cameraBuffers[i], nullptr);
-        vkDestroyBuffer(m_device->getDevice(), m_lightBuffers[i], nullptr);
-        vkDestroyBuffer(m_device->getDevice(), m_viewPosBuffers[i], nullptr);
-        vkFreeMemory(m_device->getDevice(), m_cameraBuffersMemory[i], nullptr);
-        vkFreeMemory(m_device->getDevice(), m_lightBuffersMemory[i], nullptr);
-        vkFreeMemory(m_device->getDevice(), m_viewPosBuffersMemory[i], nullptr);
-    }
-    vkDestroyDescriptorSetLayout(m_device->getDevice(), m_textureDescriptorSetLayout, nullptr);
+    delete m_frameAllocator;
+    m_frameAllocator = nullptr;
+    delete m_textureTable;
+    m_textureTable = nullptr;
     delete m_descriptorManager;
     m_descriptorManager = nullptr;
     delete m_graphicsPipeline;
@@ -121,13 +143,23 @@ void EngineApp::cleanup()
 
 void EngineApp::drawFrame()
 {
-    vkWaitForFences(m_device->getDevice(), 1, &m_renderer->getFence(), VK_TRUE, UINT64_MAX);
+    {
+        ROCK_PROFILE_SCOPE("wait for frame fence");
+        vkWaitForFences(m_device->getDevice(), 1, &m_renderer->getFence(), VK_TRUE, UINT64_MAX);
+    }
+    waitForPipelines();
+    if (m_shaderReloader)
+        m_shaderReloader->update();
     m_renderer->beginFrame();
     updateUniformBuffer(m_renderer->getCurrentFrame());
     vkResetFences(m_device->getDevice(), 1, &m_renderer->getFence());
     vkResetCommandBuffer(m_renderer->getCommandBuffer(), 0);
     std::vector<entt::entity> m_gameObjects = { m_gameObject, m_floor };
-    m_renderer->recordCommandBuffer(m_graphicsPipeline, m_registry, m_gameObjects, m_descriptorManager->getDescriptorSets(), m_translate, m_rotate, m_scale);
+    m_culling.gather(m_registry, m_gameObjects);
+    m_culling.cull(Rock::Frustum::fromMatrix(m_viewProjection), m_visibleEntities, &m_threadPool);
+    m_renderer->setCullingStats(m_culling.getVisibleCount(), m_culling.getCulledCount());
+    m_shadowMapper->setCasters(m_renderer->getCurrentFrame(), m_registry, m_gameObjects, &m_threadPool); // casters outside the camera frustum still shadow what is inside it
+    m_renderer->recordCommandBuffer(m_graphicsPipeline, m_registry, m_visibleEntities, m_descriptorManager->getDescriptorSets(), m_translate, m_rotate, m_scale);
     m_renderer->submitCommandBuffer();
 
     m_renderer->endFrame();
@@ -135,46 +167,54 @@ void EngineApp::drawFrame()
 
 void EngineApp::createDescriptorSetLayouts()
 {
-    m_descriptorManager->addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT);
-    m_descriptorManager->addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
-    m_descriptorManager->addBinding(2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT);
+    // every variant of the shaders declares the same set 0, and the per-entity texture set is the non-bindless set 1
+    ReflectedLayout layout = m_device->getPipelineCache()->reflectLayout({ "./res/shaders/engineApp/vert.spv", "./res/shaders/engineApp/frag.spv" }, DYNAMIC_SETS);
+    for (auto& binding : layout.sets[0])
+        m_descriptorManager->addBinding(binding.binding, binding.descriptorType, binding.stageFlags, binding.descriptorCount);
     m_descriptorManager->buildDescriptorSetLayout();
 
-    VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-    samplerLayoutBinding.binding = 0;
-    samplerLayoutBinding.descriptorCount = 1;
-    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerLayoutBinding.pImmutableSamplers = nullptr;
-    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    m_textureDescriptorSetLayout = m_descriptorManager->createDescriptorSetLayout(layout.sets[1]);
+}
+
+std::future<Pipeline*> EngineApp::compileGraphicsPipeline()
+{
+    auto pipelineSettings = std::make_unique<PipelineSettings>();
+    setPipelineSettings(*pipelineSettings);
+
+    // the layout, including the push constant range that grows for compact vertices, is reflected from the shaders
+    LayoutOverrides overrides = getLayoutOverrides();
+    PipelineCompiler compiler(m_device, &m_threadPool);
+    if (m_textureTable->isBindless())
+        return compiler.compileGraphics(std::move(pipelineSettings), m_compactVertices ? "./res/shaders/engineApp/bindlessCompact.spv" : "./res/shaders/engineApp/bindlessVert.spv", "./res/shaders/engineApp/bindlessFrag.spv", overrides);
+    return compiler.compileGraphics(std::move(pipelineSettings), m_compactVertices ? "./res/shaders/engineApp/compact.spv" : "./res/shaders/engineApp/vert.spv", "./res/shaders/engineApp/frag.spv", overrides);
+}
 
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &samplerLayoutBinding;
+LayoutOverrides EngineApp::getLayoutOverrides() const
+{
+    LayoutOverrides overrides;
+    overrides.dynamicSets = DYNAMIC_SETS;
+    if (m_textureTable->isBindless())
+        overrides.setLayouts = { VK_NULL_HANDLE, m_textureTable->getDescriptorSetLayout() }; // the texture array is runtime sized, so its layout comes from the table
+    return overrides;
+}
 
-    if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &m_textureDescriptorSetLayout) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create texture descriptor set layout.");
+void EngineApp::waitForPipelines()
+{
+    // only the first frame blocks here, on whichever pipelines are still compiling
+    if (m_graphicsPipelineFuture.valid())
+        m_graphicsPipeline = m_graphicsPipelineFuture.get();
+    if (m_instancedPipelineFuture.valid())
+    {
+        m_instancedPipeline = m_instancedPipelineFuture.get();
+        m_renderer->setGpuCulling(m_gpuCuller, m_instancedPipeline, m_gameObject);
+    }
 }
 
-void EngineApp::createGraphicsPipeline()
+void EngineApp::setPipelineSettings(PipelineSettings& pipelineSettings)
 {
-    VkPushConstantRange psRange;
-    psRange.offset = 0;
-    psRange.size = sizeof(glm::mat4);
-    psRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-    VkDescriptorSetLayout setLayouts[] = { *m_descriptorManager->getDescriptorSetLayout(), m_textureDescriptorSetLayout };
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 2;
-    pipelineLayoutInfo.pSetLayouts = setLayouts;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &psRange;
-
-    PipelineSettings pipelineSettings{};
     Pipeline::defaultPipelineSettings(pipelineSettings);
-    pipelineSettings.bindingDescription = Vertex::getBindingDescription();
-    pipelineSettings.attributeDescriptions = Vertex::getAttributeDescriptions();
+    pipelineSettings.bindingDescription = m_compactVertices ? CompactVertex::getBindingDescription() : Vertex::getBindingDescription();
+    pipelineSettings.attributeDescriptions = m_compactVertices ? CompactVertex::getAttributeDescriptions() : Vertex::getAttributeDescriptions();
     pipelineSettings.rasteriser.cullMode = VK_CULL_MODE_BACK_BIT;
     pipelineSettings.rasteriser.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; // counter clockwise due to the Y-flip in the projection matrix
     pipelineSettings.multisampling.rasterizationSamples = m_msaaSamples;
@@ -190,12 +230,113 @@ void EngineApp::createGraphicsPipeline()
     pipelineSettings.depthStencil.back = {}; // optional
     pipelineSettings.renderPass = m_renderer->getSwapchainRenderPass();
     pipelineSettings.subpass = 0;
+}
+
+void EngineApp::createGpuCulling()
+{
+    if (m_compactVertices)
+        throw std::runtime_error("GPU culled instances are drawn with instanced.vert, which reads full vertices.");
+
+    const int gridSize = 32;
+    const float spacing = 1.5f;
+    auto& renderComp = m_registry.get<Rock::RenderComponent>(m_gameObject);
+    std::vector<Rock::GpuInstance> instances;
+    instances.reserve(gridSize * gridSize);
+    for (int z = 0; z < gridSize; z++)
+    {
+        for (int x = 0; x < gridSize; x++)
+        {
+            glm::vec3 position((x - gridSize / 2) * spacing, -1.5f, (z - gridSize / 2) * spacing); // below the floor, so part of the grid is hidden behind it
+            instances.push_back(Rock::GpuInstance::create(glm::translate(glm::mat4(1.f), position), renderComp.m_bounds, renderComp.m_indexCount, 0, 0, renderComp.m_textureIndex));
+        }
+    }
+
+    m_gpuCuller = new GpuCuller(m_device, static_cast<uint32_t>(instances.size()), m_renderer->getSwapchainExtent(), m_msaaSamples);
+    m_gpuCuller->setInstances(instances);
+    m_instancedPipelineFuture = compileInstancedPipeline();
+}
 
-    m_graphicsPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, "./res/shaders/engineApp/vert.spv", "./res/shaders/engineApp/frag.spv");
+std::future<Pipeline*> EngineApp::compileInstancedPipeline()
+{
+    auto pipelineSettings = std::make_unique<PipelineSettings>();
+    setPipelineSettings(*pipelineSettings);
+
+    // set 2 is reflected from the instance SSBO in instanced.vert, identical to the layout GpuCuller allocates its set with
+    LayoutOverrides overrides = getLayoutOverrides();
+    PipelineCompiler compiler(m_device, &m_threadPool);
+    if (m_textureTable->isBindless())
+        return compiler.compileGraphics(std::move(pipelineSettings), "./res/shaders/engineApp/instancedBindless.spv", "./res/shaders/engineApp/bindlessFrag.spv", overrides);
+    return compiler.compileGraphics(std::move(pipelineSettings), "./res/shaders/engineApp/instanced.spv", "./res/shaders/engineApp/frag.spv", overrides);
+}
+
+void EngineApp::createShaderReloader()
+{
+    m_shaderReloader = new ShaderReloader(m_device, &m_threadPool, Swapchain::MAX_FRAMES_IN_FLIGHT);
+
+    // the same sources, outputs and defines as the engineApp lines of setup.bat
+    const std::string shaders = "./res/shaders/engineApp/";
+    m_shaderReloader->addShader(shaders + "main.vert", shaders + "vert.spv");
+    m_shaderReloader->addShader(shaders + "main.frag", shaders + "frag.spv");
+    m_shaderReloader->addShader(shaders + "compact.vert", shaders + "compact.spv");
+    m_shaderReloader->addShader(shaders + "instanced.vert", shaders + "instanced.spv");
+    m_shaderReloader->addShader(shaders + "main.vert", shaders + "bindlessVert.spv", "-DBINDLESS");
+    m_shaderReloader->addShader(shaders + "main.frag", shaders + "bindlessFrag.spv", "-DBINDLESS");
+    m_shaderReloader->addShader(shaders + "compact.vert", shaders + "bindlessCompact.spv", "-DBINDLESS");
+    m_shaderReloader->addShader(shaders + "instanced.vert", shaders + "instancedBindless.spv", "-DBINDLESS");
+
+    m_shaderReloader->watchPipeline(m_graphicsPipeline, [this]() { return compileGraphicsPipeline(); });
+    if (m_gpuCuller)
+        m_shaderReloader->watchPipeline(m_instancedPipeline, [this]() { return compileInstancedPipeline(); },
+            [this](Pipeline* pipeline) { m_renderer->setGpuCulling(m_gpuCuller, pipeline, m_gameObject); });
+}
+
+void EngineApp::createLights()
+{
+    // small ranges keep each cluster's list short however many lights there are
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    for (uint32_t i = 0; i < m_lightCount; i++)
+    {
+        float angle = unit(generator) * glm::two_pi<float>();
+        float radius = 0.5f + unit(generator) * 2.5f;
+        glm::vec3 position(cosf(angle) * radius, -0.8f + unit(generator) * 1.8f, sinf(angle) * radius);
+        glm::vec3 colour = glm::vec3(unit(generator), unit(generator), unit(generator)) * 0.5f;
+        glm::vec3 constants(1.f, 0.f, 200.f + unit(generator) * 400.f);
+        if (i % 4 == 3)
+        {
+            SpotLight light;
+            light.colour = colour * 2.f;
+            light.position = position;
+            light.direction = glm::vec3(0.f, -1.f, 0.f);
+            light.constants = constants * 0.25f;
+            light.innerCutOffCosine = cosf(glm::radians(20.f));
+            light.outerCutOffCosine = cosf(glm::radians(30.f));
+            m_spotLights.push_back(light);
+        }
+        else
+        {
+            PointLight light;
+            light.colour = colour;
+            light.position = position;
+            light.constants = constants;
+            m_pointLights.push_back(light);
+        }
+    }
+    m_gpuLights.reserve(m_lightCount);
+
+    m_lightClusterer = new LightClusterer(m_device, m_lightCount);
+    m_renderer->setLightClusterer(m_lightClusterer);
+}
+
+void EngineApp::createShadows()
+{
+    m_shadowMapper = new ShadowMapper(m_device, m_maxShadowCasters);
+    m_renderer->setShadowMapper(m_shadowMapper);
 }
 
 void EngineApp::loadTexture(entt::entity entity, const char* path)
 {
+    ROCK_PROFILE_FUNCTION();
     auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
     int texWidth, texHeight, texChannels;
     stbi_uc* pixels = stbi_load(path, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
@@ -267,54 +408,28 @@ void EngineApp::createTextureSampler(entt::entity entity)
 
 void EngineApp::loadModel(entt::entity entity, const char* path)
 {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
+    ROCK_PROFILE_FUNCTION();
+    auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
+    renderComp.m_vertexFormat = m_compactVertices ? Rock::VertexFormat::Compact : Rock::VertexFormat::Full;
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path))
-        throw std::runtime_error(warn + err);
+    // prefer the cooked mesh written by MeshCooker, falling back to parsing the obj
+    std::string cookedPath = Rock::MeshFile::getCookedPath(path);
+    if (Rock::MeshFile::exists(cookedPath))
+    {
+        loadMeshFile(renderComp, cookedPath);
+        return;
+    }
 
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    Rock::MeshBuilder::loadObj(path, vertices, indices);
+    Rock::MeshOptimiser::optimise(vertices, indices);
 
-    for (const auto& shape : shapes)
-    {
-        for (const auto& index : shape.mesh.indices)
-        {
-            Vertex vertex{};
-
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            vertex.norm = {
-                attrib.normals[3 * index.normal_index + 0],
-                attrib.normals[3 * index.normal_index + 1],
-                attrib.normals[3 * index.normal_index + 2]
-            };
-
-            vertex.texCoord = {
-                attrib.texcoords[2 * index.texcoord_index],
-                1.f - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
-
-            if (uniqueVertices.count(vertex) == 0)
-            {
-                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                vertices.push_back(vertex);
-            }
-
-            indices.push_back(uniqueVertices[vertex]);
-        }
-    }
-
-    auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
     renderComp.m_vertices = vertices;
     renderComp.m_indices = indices;
+    renderComp.m_indexCount = static_cast<uint32_t>(indices.size());
+    renderComp.m_indexType = vertices.size() <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    renderComp.m_bounds = Rock::MeshBounds::calculate(vertices.data(), vertices.size());
 
     createVertexBuffer(entity);
     createIndexBuffer(entity);
@@ -323,77 +438,37 @@ void EngineApp::loadModel(entt::entity entity, const char* path)
 void EngineApp::createVertexBuffer(entt::entity entity)
 {
     auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
-    VkDeviceSize bufferSize = sizeof(Vertex) * renderComp.m_vertices.size();
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    m_device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(m_device->getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, renderComp.m_vertices.data(), (size_t)bufferSize);
-    vkUnmapMemory(m_device->getDevice(), stagingBufferMemory);
-
-    m_device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, renderComp.m_vertexBuffer, renderComp.m_vertexBufferMemory);
-
-    m_device->copyBuffer(stagingBuffer, renderComp.m_vertexBuffer, bufferSize);
-
-    vkDestroyBuffer(m_device->getDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(m_device->getDevice(), stagingBufferMemory, nullptr);
+    if (renderComp.m_vertexFormat == Rock::VertexFormat::Compact)
+    {
+        std::vector<CompactVertex> vertices = CompactVertex::encode(renderComp.m_vertices.data(), renderComp.m_vertices.size(), renderComp.m_bounds);
+        createDeviceLocalBuffer(vertices.data(), sizeof(CompactVertex) * vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, renderComp.m_vertexBuffer, renderComp.m_vertexBufferMemory);
+        renderComp.m_dequantise = CompactVertex::getDequantiseTransform(renderComp.m_bounds);
+    }
+    else
+    {
+        createDeviceLocalBuffer(renderComp.m_vertices.data(), sizeof(Vertex) * renderComp.m_vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, renderComp.m_vertexBuffer, renderComp.m_vertexBufferMemory);
+    }
 }
 
 void EngineApp::createIndexBuffer(entt::entity entity)
 {
     auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
-    VkDeviceSize bufferSize = sizeof(uint32_t) * renderComp.m_indices.size();
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    m_device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(m_device->getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, renderComp.m_indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(m_device->getDevice(), stagingBufferMemory);
-
-    m_device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, renderComp.m_indexBuffer, renderComp.m_indexBufferMemory);
-
-    m_device->copyBuffer(stagingBuffer, renderComp.m_indexBuffer, bufferSize);
-
-    vkDestroyBuffer(m_device->getDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(m_device->getDevice(), stagingBufferMemory, nullptr);
-}
 
-void EngineApp::createUniformBuffers()
-{
-    m_cameraBuffers.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
-    m_lightBuffers.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
-    m_viewPosBuffers.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
-    m_cameraBuffersMemory.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
-    m_lightBuffersMemory.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
-    m_viewPosBuffersMemory.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
-    m_cameraBuffersMapped.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
-    m_lightBuffersMapped.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
-    m_viewPosBuffersMapped.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
-
-    for (size_t i = 0; i < Swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+    if (renderComp.m_indexType == VK_INDEX_TYPE_UINT16)
     {
-        m_device->createBuffer(sizeof(CameraUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_cameraBuffers[i], m_cameraBuffersMemory[i]);
-        vkMapMemory(m_device->getDevice(), m_cameraBuffersMemory[i], 0, sizeof(CameraUBO), 0, &m_cameraBuffersMapped[i]);
-        m_device->createBuffer(sizeof(LightUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_lightBuffers[i], m_lightBuffersMemory[i]);
-        vkMapMemory(m_device->getDevice(), m_lightBuffersMemory[i], 0, sizeof(LightUBO), 0, &m_lightBuffersMapped[i]);
-        m_device->createBuffer(sizeof(ViewUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_viewPosBuffers[i], m_viewPosBuffersMemory[i]);
-        vkMapMemory(m_device->getDevice(), m_viewPosBuffersMemory[i], 0, sizeof(ViewUBO), 0, &m_viewPosBuffersMapped[i]);
+        std::vector<uint16_t> shortIndices(renderComp.m_indices.begin(), renderComp.m_indices.end());
+        createDeviceLocalBuffer(shortIndices.data(), sizeof(uint16_t) * shortIndices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, renderComp.m_indexBuffer, renderComp.m_indexBufferMemory);
+    }
+    else
+    {
+        createDeviceLocalBuffer(renderComp.m_indices.data(), sizeof(uint32_t) * renderComp.m_indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, renderComp.m_indexBuffer, renderComp.m_indexBufferMemory);
     }
 }
 
-void EngineApp::createDescriptorPool()
+void EngineApp::createUniformBuffers()
 {
-    m_descriptorManager->addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, static_cast<uint32_t>(Swapchain::MAX_FRAMES_IN_FLIGHT));
-    m_descriptorManager->addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, static_cast<uint32_t>(Swapchain::MAX_FRAMES_IN_FLIGHT));
-    m_descriptorManager->addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, static_cast<uint32_t>(Swapchain::MAX_FRAMES_IN_FLIGHT));
-    m_descriptorManager->addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(Swapchain::MAX_FRAMES_IN_FLIGHT * 2 + 1));
-    m_descriptorManager->buildDescriptorPool();
+    m_frameAllocator = new FrameAllocator(m_device, 64 * 1024, Swapchain::MAX_FRAMES_IN_FLIGHT);
 }
 
 void EngineApp::createDescriptorSets()
@@ -403,26 +478,63 @@ void EngineApp::createDescriptorSets()
     for (size_t i = 0; i < Swapchain::MAX_FRAMES_IN_FLIGHT; i++)
     {
         VkDescriptorBufferInfo cameraBufferInfo{};
-        cameraBufferInfo.buffer = m_cameraBuffers[i];
+        cameraBufferInfo.buffer = m_frameAllocator->getBuffer(i);
         cameraBufferInfo.offset = 0;
         cameraBufferInfo.range = sizeof(CameraUBO);
 
         m_descriptorManager->addWriteDescriptorSet(0, &cameraBufferInfo, nullptr);
 
         VkDescriptorBufferInfo lightBufferInfo{};
-        lightBufferInfo.buffer = m_lightBuffers[i];
+        lightBufferInfo.buffer = m_frameAllocator->getBuffer(i);
         lightBufferInfo.offset = 0;
         lightBufferInfo.range = sizeof(LightUBO);
 
         m_descriptorManager->addWriteDescriptorSet(1, &lightBufferInfo, nullptr);
 
         VkDescriptorBufferInfo viewPosBufferInfo{};
-        viewPosBufferInfo.buffer = m_viewPosBuffers[i];
+        viewPosBufferInfo.buffer = m_frameAllocator->getBuffer(i);
         viewPosBufferInfo.offset = 0;
         viewPosBufferInfo.range = sizeof(ViewUBO);
 
         m_descriptorManager->addWriteDescriptorSet(2, &viewPosBufferInfo, nullptr);
 
+        // the cluster buffers are per frame rather than bump allocated, so their dynamic offsets are always 0
+        VkDescriptorBufferInfo clusterUniformBufferInfo{};
+        clusterUniformBufferInfo.buffer = m_lightClusterer->getUniformBuffer(static_cast<uint32_t>(i));
+        clusterUniformBufferInfo.offset = 0;
+        clusterUniformBufferInfo.range = sizeof(LightClusterer::ClusterUniforms);
+
+        m_descriptorManager->addWriteDescriptorSet(3, &clusterUniformBufferInfo, nullptr);
+
+        VkDescriptorBufferInfo lightsBufferInfo{};
+        lightsBufferInfo.buffer = m_lightClusterer->getLightBuffer(static_cast<uint32_t>(i));
+        lightsBufferInfo.offset = 0;
+        lightsBufferInfo.range = m_lightClusterer->getLightBufferSize();
+
+        m_descriptorManager->addWriteDescriptorSet(4, &lightsBufferInfo, nullptr);
+
+        VkDescriptorBufferInfo clusterBufferInfo{};
+        clusterBufferInfo.buffer = m_lightClusterer->getClusterBuffer(static_cast<uint32_t>(i));
+        clusterBufferInfo.offset = 0;
+        clusterBufferInfo.range = LightClusterer::getClusterBufferSize();
+
+        m_descriptorManager->addWriteDescriptorSet(5, &clusterBufferInfo, nullptr);
+
+        VkDescriptorBufferInfo shadowBufferInfo{};
+        shadowBufferInfo.buffer = m_frameAllocator->getBuffer(i);
+        shadowBufferInfo.offset = 0;
+        shadowBufferInfo.range = sizeof(ShadowMapper::ShadowUniforms);
+
+        m_descriptorManager->addWriteDescriptorSet(6, &shadowBufferInfo, nullptr);
+
+        // the render graph leaves the shadow map in this layout for the scene pass
+        VkDescriptorImageInfo shadowMapInfo{};
+        shadowMapInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        shadowMapInfo.imageView = m_shadowMapper->getImageView();
+        shadowMapInfo.sampler = m_shadowMapper->getSampler();
+
+        m_descriptorManager->addWriteDescriptorSet(7, nullptr, &shadowMapInfo);
+
         m_descriptorManager->overwrite(i);
     }
 }
@@ -430,15 +542,13 @@ void EngineApp::createDescriptorSets()
 void EngineApp::createTextureDescriptorSet(entt::entity entity)
 {
     auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
+    if (m_textureTable->isBindless())
+    {
+        renderComp.m_textureIndex = m_textureTable->add(renderComp.m_textureImageView, renderComp.m_textureSampler);
+        return;
+    }
 
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_descriptorManager->getDescriptorPool();
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &m_textureDescriptorSetLayout;
-
-    if (vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, &renderComp.descriptorSet) != VK_SUCCESS)
-        throw std::runtime_error("Failed to allocate descriptor set.");
+    renderComp.descriptorSet = m_descriptorManager->allocate(m_textureDescriptorSetLayout);
 
     VkDescriptorImageInfo imageInfo{};
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -468,19 +578,39 @@ void EngineApp::updateUniformBuffer(uint32_t currentImage)
     u_camera.view = glm::lookAt(glm::vec3(2.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
     u_camera.proj = glm::perspective(glm::radians(45.f), m_renderer->getSwapchainAspectRatio(), 0.1f, 10.f);
     u_camera.proj[1][1] *= -1.f; // image would be renderered upside down otherwise due to glm being originally designed for OpenGL where the Y coord is inverted
-    memcpy(m_cameraBuffersMapped[currentImage], &u_camera, sizeof(u_camera));
+    m_viewProjection = u_camera.proj * u_camera.view;
+    if (m_gpuCuller)
+        m_gpuCuller->setCamera(u_camera.view, u_camera.proj);
 
     LightUBO u_light{};
-    u_light.dLight.colour = glm::vec3(1.f, 1.f, 0.f);
-    u_light.dLight.direction = glm::vec3(-1.f, -1.f, -1.f);
-    u_light.pLights[0].colour = glm::vec3(0.f, 0.f, 0.f);
-    u_light.pLights[0].position = glm::vec3(1.f, 1.f, 1.f);
-    u_light.pLights[0].constants = glm::vec3(1.f, 0.1f, 0.01f);
-    memcpy(m_lightBuffersMapped[currentImage], &u_light, sizeof(u_light));
+    u_light.directionalColour = glm::vec3(1.f, 1.f, 0.f);
+    u_light.directionalDirection = glm::vec3(-1.f, -1.f, -1.f);
+
+    // the lights circle the centre, alternate point lights the other way round, so every frame rebins them
+    glm::mat4 orbit = glm::rotate(glm::mat4(1.f), time * 0.5f, glm::vec3(0.f, 1.f, 0.f));
+    m_gpuLights.clear();
+    for (size_t i = 0; i < m_pointLights.size(); i++)
+    {
+        PointLight light = m_pointLights[i];
+        light.position = glm::vec3((i % 2 ? orbit : glm::transpose(orbit)) * glm::vec4(light.position, 1.f));
+        m_gpuLights.push_back(LightClusterer::GpuLight::create(light));
+    }
+    for (const SpotLight& spotLight : m_spotLights)
+    {
+        SpotLight light = spotLight;
+        light.position = glm::vec3(orbit * glm::vec4(light.position, 1.f));
+        m_gpuLights.push_back(LightClusterer::GpuLight::create(light));
+    }
+    m_lightClusterer->setLights(currentImage, m_gpuLights);
+    m_lightClusterer->setCamera(u_camera.view, u_camera.proj, 0.1f, 10.f);
+    m_shadowMapper->update(u_camera.view, u_camera.proj, 0.1f, 10.f, u_light.directionalDirection);
 
     ViewUBO u_viewPos{};
     u_viewPos.viewPos = glm::vec3(2.f, 2.f, 2.f);
-    memcpy(m_viewPosBuffersMapped[currentImage], &u_viewPos, sizeof(u_viewPos));
+
+    // the descriptors always point at the start of the frame's buffer, so the offsets are the only per-frame binding work
+    m_frameAllocator->reset(currentImage);
+    m_renderer->setDynamicOffsets({ m_frameAllocator->push(currentImage, u_camera), m_frameAllocator->push(currentImage, u_light), m_frameAllocator->push(currentImage, u_viewPos), 0, 0, 0, m_frameAllocator->push(currentImage, m_shadowMapper->getUniforms()) });
 }
 
 void EngineApp::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
@@ -13,12 +13,13 @@ void GameApp::initApplication()
     m_device = new Device();
     m_msaaSamples = m_device->getMaxUsableSampleCount();
     m_descriptorManager = new DescriptorManager(m_device, Swapchain::MAX_FRAMES_IN_FLIGHT);
-    m_renderer = new Renderer(m_device, m_msaaSamples, true);
+    m_renderer = new Renderer(m_device, m_msaaSamples, true, &m_threadPool);
+    m_frameLimiter.setTargetFrameRate(m_device->getWindow()->getFrameRateCap());
+    m_renderer->setFrameLimiter(&m_frameLimiter);
 
     createDescriptorSetLayouts();
     createGraphicsPipeline();
     createUniformBuffers();
-    createDescriptorPool();
     createDescriptorSets();
     m_floor = m_registry.create();
     m_registry.emplace<Rock::RenderComponent>(m_floor);
@@ -58,6 +59,8 @@ void GameApp::mainLoop()
 {
     while (!m_device->getWindow()->shouldClose())
     {
+        ROCK_PROFILE_FRAME();
+        m_frameLimiter.wait();
         glfwPollEvents();
         drawFrame();
 
@@ -112,6 +115,7 @@ void GameApp::mainLoop()
                 transformComp.recalculate();
             }
 
+            ROCK_PROFILE_SCOPE("physics");
             for (entt::entity entity : m_cubes)
             {
                 auto& transformComp = m_registry.get<Rock::TransformComponent>(entity);
@@ -150,6 +154,7 @@ void GameApp::mainLoop()
     }
 
     vkDeviceWaitIdle(m_device->getDevice());
+    ROCK_PROFILE_EXPORT("cpu_trace.json");
 }
 
 void GameApp::cleanup()
@@ -179,7 +184,6 @@ void GameApp::cleanup()
         vkFreeMemory(m_device->getDevice(), m_lightBuffersMemory[i], nullptr);
         vkFreeMemory(m_device->getDevice(), m_viewPosBuffersMemory[i], nullptr);
     }
-    vkDestroyDescriptorSetLayout(m_device->getDevice(), m_textureDescriptorSetLayout, nullptr);
     delete m_descriptorManager;
     m_descriptorManager = nullptr;
     delete m_graphicsPipeline;
@@ -192,14 +196,20 @@ void GameApp::cleanup()
 
 void GameApp::drawFrame()
 {
-    vkWaitForFences(m_device->getDevice(), 1, &m_renderer->getFence(), VK_TRUE, UINT64_MAX);
+    {
+        ROCK_PROFILE_SCOPE("wait for frame fence");
+        vkWaitForFences(m_device->getDevice(), 1, &m_renderer->getFence(), VK_TRUE, UINT64_MAX);
+    }
     m_renderer->beginFrame();
     updateUniformBuffer(m_renderer->getCurrentFrame());
     vkResetFences(m_device->getDevice(), 1, &m_renderer->getFence());
     vkResetCommandBuffer(m_renderer->getCommandBuffer(), 0);
     m_cubes.push_back(m_floor); m_cubes.push_back(m_player);
-    m_renderer->recordCommandBuffer(m_graphicsPipeline, m_registry, m_cubes, m_descriptorManager->getDescriptorSets());
+    m_culling.gather(m_registry, m_cubes);
     m_cubes.pop_back(); m_cubes.pop_back();
+    m_culling.cull(Rock::Frustum::fromMatrix(m_viewProjection), m_visibleEntities, &m_threadPool);
+    m_renderer->setCullingStats(m_culling.getVisibleCount(), m_culling.getCulledCount());
+    m_renderer->recordCommandBuffer(m_graphicsPipeline, m_registry, m_visibleEntities, m_descriptorManager->getDescriptorSets());
     m_renderer->submitCommandBuffer();
 
     m_renderer->endFrame();
@@ -219,13 +229,7 @@ void GameApp::createDescriptorSetLayouts()
     samplerLayoutBinding.pImmutableSamplers = nullptr;
     samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &samplerLayoutBinding;
-
-    if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &m_textureDescriptorSetLayout) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create texture descriptor set layout.");
+    m_textureDescriptorSetLayout = m_descriptorManager->createDescriptorSetLayout({ samplerLayoutBinding });
 }
 
 void GameApp::createGraphicsPipeline()
@@ -269,6 +273,7 @@ void GameApp::createGraphicsPipeline()
 
 void GameApp::loadTexture(entt::entity entity, const char* path)
 {
+    ROCK_PROFILE_FUNCTION();
     auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
     int texWidth, texHeight, texChannels;
     stbi_uc* pixels = stbi_load(path, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
@@ -340,54 +345,27 @@ void GameApp::createTextureSampler(entt::entity entity)
 
 void GameApp::loadModel(entt::entity entity, const char* path)
 {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
+    ROCK_PROFILE_FUNCTION();
+    auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
 
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path))
-        throw std::runtime_error(warn + err);
+    // prefer the cooked mesh written by MeshCooker, falling back to parsing the obj
+    std::string cookedPath = Rock::MeshFile::getCookedPath(path);
+    if (Rock::MeshFile::exists(cookedPath))
+    {
+        loadMeshFile(renderComp, cookedPath);
+        return;
+    }
 
-    std::unordered_map<Vertex, uint32_t> uniqueVertices{};
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    Rock::MeshBuilder::loadObj(path, vertices, indices);
+    Rock::MeshOptimiser::optimise(vertices, indices);
 
-    for (const auto& shape : shapes)
-    {
-        for (const auto& index : shape.mesh.indices)
-        {
-            Vertex vertex{};
-
-            vertex.pos = {
-                attrib.vertices[3 * index.vertex_index + 0],
-                attrib.vertices[3 * index.vertex_index + 1],
-                attrib.vertices[3 * index.vertex_index + 2]
-            };
-
-            vertex.norm = {
-                attrib.normals[3 * index.normal_index + 0],
-                attrib.normals[3 * index.normal_index + 1],
-                attrib.normals[3 * index.normal_index + 2]
-            };
-
-            vertex.texCoord = {
-                attrib.texcoords[2 * index.texcoord_index],
-                1.f - attrib.texcoords[2 * index.texcoord_index + 1]
-            };
-
-            if (uniqueVertices.count(vertex) == 0)
-            {
-                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-                vertices.push_back(vertex);
-            }
-
-            indices.push_back(uniqueVertices[vertex]);
-        }
-    }
-
-    auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
     renderComp.m_vertices = vertices;
     renderComp.m_indices = indices;
+    renderComp.m_indexCount = static_cast<uint32_t>(indices.size());
+    renderComp.m_indexType = vertices.size() <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    renderComp.m_bounds = Rock::MeshBounds::calculate(vertices.data(), vertices.size());
 
     createVertexBuffer(entity);
     createIndexBuffer(entity);
@@ -418,23 +396,16 @@ void GameApp::createVertexBuffer(entt::entity entity)
 void GameApp::createIndexBuffer(entt::entity entity)
 {
     auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
-    VkDeviceSize bufferSize = sizeof(uint32_t) * renderComp.m_indices.size();
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    m_device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-    void* data;
-    vkMapMemory(m_device->getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, renderComp.m_indices.data(), (size_t)bufferSize);
-    vkUnmapMemory(m_device->getDevice(), stagingBufferMemory);
-
-    m_device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, renderComp.m_indexBuffer, renderComp.m_indexBufferMemory);
-
-    m_device->copyBuffer(stagingBuffer, renderComp.m_indexBuffer, bufferSize);
-
-    vkDestroyBuffer(m_device->getDevice(), stagingBuffer, nullptr);
-    vkFreeMemory(m_device->getDevice(), stagingBufferMemory, nullptr);
+    if (renderComp.m_indexType == VK_INDEX_TYPE_UINT16)
+    {
+        std::vector<uint16_t> shortIndices(renderComp.m_indices.begin(), renderComp.m_indices.end());
+        createDeviceLocalBuffer(shortIndices.data(), sizeof(uint16_t) * shortIndices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, renderComp.m_indexBuffer, renderComp.m_indexBufferMemory);
+    }
+    else
+    {
+        createDeviceLocalBuffer(renderComp.m_indices.data(), sizeof(uint32_t) * renderComp.m_indices.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, renderComp.m_indexBuffer, renderComp.m_indexBufferMemory);
+    }
 }
 
 void GameApp::createUniformBuffers()
@@ -460,15 +431,6 @@ void GameApp::createUniformBuffers()
     }
 }
 
-void GameApp::createDescriptorPool()
-{
-    m_descriptorManager->addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, static_cast<uint32_t>(Swapchain::MAX_FRAMES_IN_FLIGHT));
-    m_descriptorManager->addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, static_cast<uint32_t>(Swapchain::MAX_FRAMES_IN_FLIGHT));
-    m_descriptorManager->addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, static_cast<uint32_t>(Swapchain::MAX_FRAMES_IN_FLIGHT));
-    m_descriptorManager->addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(Swapchain::MAX_FRAMES_IN_FLIGHT * 2 + 1));
-    m_descriptorManager->buildDescriptorPool();
-}
-
 void GameApp::createDescriptorSets()
 {
     m_descriptorManager->allocateDescriptorSets();
@@ -504,14 +466,7 @@ void GameApp::createTextureDescriptorSet(entt::entity entity)
 {
     auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
 
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = m_descriptorManager->getDescriptorPool();
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &m_textureDescriptorSetLayout;
-
-    if (vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, &renderComp.descriptorSet) != VK_SUCCESS)
-        throw std::runtime_error("Failed to allocate descriptor set.");
+    renderComp.descriptorSet = m_descriptorManager->allocate(m_textureDescriptorSetLayout);
 
     VkDescriptorImageInfo imageInfo{};
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -537,6 +492,7 @@ void GameApp::updateUniformBuffer(uint32_t currentImage)
     u_camera.proj = glm::perspective(glm::radians(45.f), m_renderer->getSwapchainAspectRatio(), 0.1f, 1000.f);
     u_camera.proj[1][1] *= -1.f; // image would be renderered upside down otherwise due to glm being originally designed for OpenGL where the Y coord is inverted
     memcpy(m_cameraBuffersMapped[currentImage], &u_camera, sizeof(u_camera));
+    m_viewProjection = u_camera.proj * u_camera.view;
 
     LightUBO u_light{};
     u_light.dLight.colour = glm::vec3(1.f, 1.f, 0.f);
@@ -0,0 +1,260 @@
+/** \file culling.cpp */
+
+#include "rendering/culling.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ROCK_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+namespace Rock
+{
+    Frustum Frustum::fromMatrix(const glm::mat4& viewProjection)
+    {
+        // glm is column major so row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+        auto row = [&viewProjection](int i) { return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]); };
+        glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+        Frustum frustum{};
+        frustum.planes[0] = r3 + r0;
+        frustum.planes[1] = r3 - r0;
+        frustum.planes[2] = r3 + r1;
+        frustum.planes[3] = r3 - r1;
+        frustum.planes[4] = r2; // depth is zero to one (GLM_FORCE_DEPTH_ZERO_TO_ONE) so the near plane is z >= 0
+        frustum.planes[5] = r3 - r2;
+
+        for (glm::vec4& plane : frustum.planes)
+        {
+            float length = glm::length(glm::vec3(plane));
+            if (length > 0.f)
+                plane /= length;
+        }
+        return frustum;
+    }
+
+    bool Frustum::intersectsSphere(const glm::vec3& centre, float radius) const
+    {
+        for (const glm::vec4& plane : planes)
+            if (glm::dot(glm::vec3(plane), centre) + plane.w < -radius)
+                return false;
+        return true;
+    }
+
+    glm::vec4 getWorldSphere(const glm::mat4& model, const MeshBounds& bounds)
+    {
+        glm::vec4 centre = model * glm::vec4(bounds.centre, 1.f);
+        float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+        return glm::vec4(glm::vec3(centre), bounds.radius * scale);
+    }
+
+    uint32_t DepthPyramid::getPyramidSize(uint32_t depthSize)
+    {
+        uint32_t half = (depthSize + 1) / 2;
+        uint32_t size = 1;
+        while (size < half)
+            size <<= 1;
+        return size;
+    }
+
+    uint32_t DepthPyramid::getLevelCount(uint32_t width, uint32_t height)
+    {
+        uint32_t size = std::max(getPyramidSize(width), getPyramidSize(height));
+        uint32_t levels = 1;
+        while (size > 1)
+        {
+            size >>= 1;
+            levels++;
+        }
+        return levels;
+    }
+
+    void DepthPyramid::build(const float* depth, uint32_t width, uint32_t height)
+    {
+        m_depthWidth = width;
+        m_depthHeight = height;
+        m_width = getPyramidSize(width);
+        m_height = getPyramidSize(height);
+        m_levels.assign(getLevelCount(width, height), {});
+
+        // same reduction as hiz.comp: each texel keeps the farthest of the 2x2 texels below it, clamping reads at the edges
+        const float* source = depth;
+        uint32_t sourceWidth = width, sourceHeight = height;
+        for (uint32_t level = 0; level < m_levels.size(); level++)
+        {
+            uint32_t levelWidth = getLevelWidth(level), levelHeight = getLevelHeight(level);
+            std::vector<float>& texels = m_levels[level];
+            texels.resize(static_cast<size_t>(levelWidth) * levelHeight);
+
+            for (uint32_t y = 0; y < levelHeight; y++)
+            {
+                for (uint32_t x = 0; x < levelWidth; x++)
+                {
+                    uint32_t x0 = std::min(2 * x, sourceWidth - 1), x1 = std::min(2 * x + 1, sourceWidth - 1);
+                    uint32_t y0 = std::min(2 * y, sourceHeight - 1), y1 = std::min(2 * y + 1, sourceHeight - 1);
+                    texels[y * levelWidth + x] = std::max({ source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1], source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1] });
+                }
+            }
+
+            source = texels.data();
+            sourceWidth = levelWidth;
+            sourceHeight = levelHeight;
+        }
+    }
+
+    bool CullingReference::projectSphere(const glm::vec3& viewCentre, float radius, float zNear, float p00, float p11, glm::vec4& uvBounds)
+    {
+        // the view looks down -z; work with the distance in front of the camera
+        float z = -viewCentre.z;
+        if (z - radius < zNear)
+            return false;
+
+        // tangent lines from the eye to the sphere in the xz and yz planes (Mara and McGuire, "2D Polyhedral Bounds of a Clipped, Perspective-Projected 3D Sphere")
+        float tx = std::sqrt(viewCentre.x * viewCentre.x + z * z - radius * radius);
+        float minX = (tx * viewCentre.x - radius * z) / (tx * z + radius * viewCentre.x);
+        float maxX = (tx * viewCentre.x + radius * z) / (tx * z - radius * viewCentre.x);
+
+        float ty = std::sqrt(viewCentre.y * viewCentre.y + z * z - radius * radius);
+        float minY = (ty * viewCentre.y - radius * z) / (ty * z + radius * viewCentre.y);
+        float maxY = (ty * viewCentre.y + radius * z) / (ty * z - radius * viewCentre.y);
+
+        // p11 is negative when the projection is flipped for Vulkan, so order the y bounds after scaling
+        glm::vec4 ndc(minX * p00, std::min(minY * p11, maxY * p11), maxX * p00, std::max(minY * p11, maxY * p11));
+        uvBounds = ndc * 0.5f + 0.5f;
+        return true;
+    }
+
+    bool CullingReference::isOccluded(const DepthPyramid& pyramid, const glm::vec4& sphere, const glm::mat4& view, const glm::mat4& projection)
+    {
+        glm::vec3 centre = glm::vec3(view * glm::vec4(glm::vec3(sphere), 1.f));
+        float radius = sphere.w;
+        float zNear = projection[3][2] / projection[2][2];
+
+        glm::vec4 uv;
+        if (!CullingReference::projectSphere(centre, radius, zNear, projection[0][0], projection[1][1], uv))
+            return false;
+        uv = glm::clamp(uv, glm::vec4(0.f), glm::vec4(1.f));
+
+        // pick the level where the footprint covers at most 2x2 texels
+        float width = (uv.z - uv.x) * pyramid.getDepthWidth();
+        float height = (uv.w - uv.y) * pyramid.getDepthHeight();
+        int level = std::max(0, static_cast<int>(std::ceil(std::log2(std::max({ width, height, 1.f })))) - 1);
+        level = std::min(level, static_cast<int>(pyramid.getLevelCount()) - 1);
+
+        float texelSize = static_cast<float>(2u << level);
+        uint32_t levelWidth = pyramid.getLevelWidth(level), levelHeight = pyramid.getLevelHeight(level);
+        uint32_t x0 = std::min(static_cast<uint32_t>(uv.x * pyramid.getDepthWidth() / texelSize), levelWidth - 1);
+        uint32_t x1 = std::min(static_cast<uint32_t>(uv.z * pyramid.getDepthWidth() / texelSize), levelWidth - 1);
+        uint32_t y0 = std::min(static_cast<uint32_t>(uv.y * pyramid.getDepthHeight() / texelSize), levelHeight - 1);
+        uint32_t y1 = std::min(static_cast<uint32_t>(uv.w * pyramid.getDepthHeight() / texelSize), levelHeight - 1);
+        float farthest = std::max({ pyramid.fetch(level, x0, y0), pyramid.fetch(level, x1, y0), pyramid.fetch(level, x0, y1), pyramid.fetch(level, x1, y1) });
+
+        // depth of the sphere's nearest point
+        float nearestZ = centre.z + radius;
+        float nearestDepth = (projection[2][2] * nearestZ + projection[3][2]) / -nearestZ;
+        return nearestDepth > farthest;
+    }
+
+    uint32_t CullingReference::countVisible(const std::vector<GpuInstance>& instances, const Frustum& frustum, const DepthPyramid* pyramid, const glm::mat4& view, const glm::mat4& projection)
+    {
+        uint32_t visible = 0;
+        for (const GpuInstance& instance : instances)
+        {
+            if (!frustum.intersectsSphere(glm::vec3(instance.sphere), instance.sphere.w))
+                continue;
+            if (pyramid && isOccluded(*pyramid, instance.sphere, view, projection))
+                continue;
+            visible++;
+        }
+        return visible;
+    }
+
+    void CullingSystem::gather(entt::registry& registry, const std::vector<entt::entity>& entities)
+    {
+        size_t count = entities.size();
+        // pad to a multiple of four so the SIMD loop never needs a tail
+        size_t padded = (count + 3) & ~static_cast<size_t>(3);
+        m_centreX.resize(padded);
+        m_centreY.resize(padded);
+        m_centreZ.resize(padded);
+        m_radius.resize(padded);
+        m_entities = entities;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            const RenderComponent& renderComp = registry.get<RenderComponent>(entities[i]);
+            glm::vec4 sphere = getWorldSphere(registry.get<TransformComponent>(entities[i]).m_transform, renderComp.m_bounds);
+
+            m_centreX[i] = sphere.x;
+            m_centreY[i] = sphere.y;
+            m_centreZ[i] = sphere.z;
+            m_radius[i] = sphere.w;
+        }
+        for (size_t i = count; i < padded; i++)
+        {
+            m_centreX[i] = m_centreY[i] = m_centreZ[i] = 0.f;
+            m_radius[i] = -1.f;
+        }
+    }
+
+    void CullingSystem::cull(const Frustum& frustum, std::vector<entt::entity>& visible, ThreadPool* threadPool)
+    {
+        size_t count = m_entities.size();
+        m_visibility.assign(m_radius.size(), 0);
+
+        if (threadPool && count >= PARALLEL_THRESHOLD)
+        {
+            // batches stay multiples of four so each SIMD group is owned by one thread
+            threadPool->parallelFor(m_radius.size() / 4, PARALLEL_THRESHOLD / 16,
+                [this, &frustum](size_t begin, size_t end) { cullRange(frustum, begin * 4, end * 4); });
+        }
+        else
+            cullRange(frustum, 0, m_radius.size());
+
+        visible.clear();
+        visible.reserve(count);
+        for (size_t i = 0; i < count; i++)
+            if (m_visibility[i])
+                visible.push_back(m_entities[i]);
+        m_visibleCount = static_cast<uint32_t>(visible.size());
+    }
+
+    void CullingSystem::cullRange(const Frustum& frustum, size_t begin, size_t end)
+    {
+#ifdef ROCK_CULLING_SSE
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (int p = 0; p < 6; p++)
+        {
+            planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+            planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+            planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+            planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+        }
+
+        for (size_t i = begin; i < end; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(&m_centreX[i]);
+            __m128 y = _mm_loadu_ps(&m_centreY[i]);
+            __m128 z = _mm_loadu_ps(&m_centreZ[i]);
+            __m128 r = _mm_loadu_ps(&m_radius[i]);
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), r);
+
+            // padding spheres have a negative radius and so always fail this
+            __m128 inside = _mm_cmpge_ps(r, _mm_setzero_ps());
+            for (int p = 0; p < 6; p++)
+            {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)), _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            m_visibility[i + 0] = static_cast<uint8_t>(mask & 1);
+            m_visibility[i + 1] = static_cast<uint8_t>((mask >> 1) & 1);
+            m_visibility[i + 2] = static_cast<uint8_t>((mask >> 2) & 1);
+            m_visibility[i + 3] = static_cast<uint8_t>((mask >> 3) & 1);
+        }
+#else
+        for (size_t i = begin; i < end; i++)
+            m_visibility[i] = m_radius[i] >= 0.f && frustum.intersectsSphere(glm::vec3(m_centreX[i], m_centreY[i], m_centreZ[i]), m_radius[i]);
+#endif
+    }
+}
@@ -0,0 +1,480 @@
+/** \file gpuCuller.cpp */
+
+#include "rendering/gpuCuller.hpp"
+#include "rendering/gpuLayout.hpp"
+
+static_assert(sizeof(GpuCuller::CullUniforms) == 208, "CullUniforms must match the std140 CullUBO block in cull.comp");
+GPU_LAYOUT_MEMBER(Std140, GpuCuller::CullUniforms, pyramidView, frustumPlanes);
+GPU_LAYOUT_MEMBER(Std140, GpuCuller::CullUniforms, frustumPlanes, pyramidProjection);
+GPU_LAYOUT_MEMBER(Std140, GpuCuller::CullUniforms, pyramidProjection, depthSize);
+GPU_LAYOUT_MEMBER(Std140, GpuCuller::CullUniforms, depthSize, zNear);
+GPU_LAYOUT_MEMBER(Std140, GpuCuller::CullUniforms, zNear, instanceCount);
+GPU_LAYOUT_MEMBER(Std140, GpuCuller::CullUniforms, instanceCount, pyramidLevels);
+GPU_LAYOUT_MEMBER(Std140, GpuCuller::CullUniforms, pyramidLevels, occlusionEnabled);
+
+GpuCuller::GpuCuller(Device* device, uint32_t maxInstances, VkExtent2D depthExtent, VkSampleCountFlagBits depthSamples, const std::string& shaderDirectory)
+    : m_device(device), m_maxInstances(maxInstances), m_depthSamples(depthSamples)
+{
+    if (!m_device->getEnabledFeatures().multiDrawIndirect || !m_device->getEnabledFeatures().drawIndirectFirstInstance)
+        throw std::runtime_error("GPU culling requires the multiDrawIndirect and drawIndirectFirstInstance features.");
+
+    createDescriptorSetLayouts();
+    createPipelines(shaderDirectory);
+    createBuffers();
+    createDescriptorSets();
+    createDepthPyramid(depthExtent);
+}
+
+GpuCuller::~GpuCuller()
+{
+    destroyDepthPyramid();
+
+    vkDestroyBuffer(m_device->getDevice(), m_instanceBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_instanceBufferMemory, nullptr);
+    vkDestroyBuffer(m_device->getDevice(), m_drawCommandBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_drawCommandBufferMemory, nullptr);
+    vkDestroyBuffer(m_device->getDevice(), m_drawCountBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_drawCountBufferMemory, nullptr);
+    for (size_t i = 0; i < Swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyBuffer(m_device->getDevice(), m_uniformBuffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_uniformBuffersMemory[i], nullptr);
+        vkDestroyBuffer(m_device->getDevice(), m_readbackBuffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_readbackBuffersMemory[i], nullptr);
+    }
+
+    vkDestroyDescriptorPool(m_device->getDevice(), m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device->getDevice(), m_cullSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device->getDevice(), m_pyramidSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device->getDevice(), m_instanceSetLayout, nullptr);
+
+    m_cullPipeline->destroyPipelineLayout();
+    m_pyramidPipeline->destroyPipelineLayout();
+    m_pyramidMultisamplePipeline->destroyPipelineLayout();
+    delete m_cullPipeline;
+    m_cullPipeline = nullptr;
+    delete m_pyramidPipeline;
+    m_pyramidPipeline = nullptr;
+    delete m_pyramidMultisamplePipeline;
+    m_pyramidMultisamplePipeline = nullptr;
+    m_device = nullptr;
+}
+
+void GpuCuller::setInstances(const std::vector<Rock::GpuInstance>& instances)
+{
+    if (instances.size() > m_maxInstances)
+        throw std::runtime_error("Too many instances for the GPU culler.");
+
+    m_instances = instances;
+    if (instances.empty())
+        return;
+
+    VkDeviceSize bufferSize = sizeof(Rock::GpuInstance) * instances.size();
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    m_device->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(m_device->getDevice(), stagingBufferMemory, 0, bufferSize, 0, &data);
+    memcpy(data, instances.data(), static_cast<size_t>(bufferSize));
+    vkUnmapMemory(m_device->getDevice(), stagingBufferMemory);
+
+    m_device->copyBuffer(stagingBuffer, m_instanceBuffer, bufferSize);
+
+    vkDestroyBuffer(m_device->getDevice(), stagingBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), stagingBufferMemory, nullptr);
+}
+
+void GpuCuller::setDepthExtent(VkExtent2D depthExtent)
+{
+    if (depthExtent.width == m_depthExtent.width && depthExtent.height == m_depthExtent.height)
+        return;
+
+    // the swapchain was resized; nothing may still be using the old pyramid
+    vkDeviceWaitIdle(m_device->getDevice());
+    destroyDepthPyramid();
+    createDepthPyramid(depthExtent);
+}
+
+void GpuCuller::recordCull(VkCommandBuffer commandBuffer, uint32_t frame, VkExtent2D depthExtent)
+{
+    setDepthExtent(depthExtent);
+
+    CullUniforms uniforms{};
+    uniforms.pyramidView = m_pyramidCameraView;
+    Rock::Frustum frustum = Rock::Frustum::fromMatrix(m_projection * m_view);
+    for (int i = 0; i < 6; i++)
+        uniforms.frustumPlanes[i] = frustum.planes[i];
+    uniforms.pyramidProjection = glm::vec4(m_pyramidCameraProjection[0][0], m_pyramidCameraProjection[1][1], m_pyramidCameraProjection[2][2], m_pyramidCameraProjection[3][2]);
+    uniforms.depthSize = glm::vec2(static_cast<float>(m_depthExtent.width), static_cast<float>(m_depthExtent.height));
+    uniforms.zNear = m_pyramidValid ? m_pyramidCameraProjection[3][2] / m_pyramidCameraProjection[2][2] : 0.f;
+    uniforms.instanceCount = getInstanceCount();
+    uniforms.pyramidLevels = m_pyramidLevels;
+    uniforms.occlusionEnabled = m_occlusionEnabled && m_pyramidValid ? 1 : 0;
+    memcpy(m_uniformBuffersMapped[frame], &uniforms, sizeof(uniforms));
+
+    vkCmdFillBuffer(commandBuffer, m_drawCountBuffer, 0, VK_WHOLE_SIZE, 0);
+    if (!m_device->supportsDrawIndirectCount())
+        vkCmdFillBuffer(commandBuffer, m_drawCommandBuffer, 0, VK_WHOLE_SIZE, 0); // zeroed commands past the visible count draw nothing
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    if (!m_instances.empty())
+    {
+        m_cullPipeline->bindCompute(commandBuffer);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline->getPipelineLayout(), 0, 1, &m_cullSets[frame], 0, nullptr);
+        vkCmdDispatch(commandBuffer, (getInstanceCount() + 63) / 64, 1, 1);
+    }
+
+    // the readback copy stays inside the pass; the render graph orders the indirect draw after it
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = 2 * sizeof(uint32_t);
+    vkCmdCopyBuffer(commandBuffer, m_drawCountBuffer, m_readbackBuffers[frame], 1, &copyRegion);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuCuller::recordDraw(VkCommandBuffer commandBuffer)
+{
+    if (m_instances.empty())
+        return;
+
+    if (m_device->supportsDrawIndirectCount())
+        vkCmdDrawIndexedIndirectCount(commandBuffer, m_drawCommandBuffer, 0, m_drawCountBuffer, 0, getInstanceCount(), sizeof(VkDrawIndexedIndirectCommand));
+    else
+        vkCmdDrawIndexedIndirect(commandBuffer, m_drawCommandBuffer, 0, getInstanceCount(), sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void GpuCuller::recordDepthPyramid(VkCommandBuffer commandBuffer, VkImageView depthImageView)
+{
+    if (depthImageView != m_depthSourceView)
+    {
+        // the swapchain was recreated, which waits for the device, so the level 0 set is not in use
+        VkDescriptorImageInfo sourceInfo{};
+        sourceInfo.sampler = m_pyramidSampler;
+        sourceInfo.imageView = depthImageView;
+        sourceInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = m_pyramidSets[0];
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.descriptorCount = 1;
+        write.pImageInfo = &sourceInfo;
+        vkUpdateDescriptorSets(m_device->getDevice(), 1, &write, 0, nullptr);
+        m_depthSourceView = depthImageView;
+    }
+
+    VkExtent2D sourceSize = m_depthExtent;
+    for (uint32_t level = 0; level < m_pyramidLevels; level++)
+    {
+        Pipeline* pipeline = level == 0 && m_depthSamples != VK_SAMPLE_COUNT_1_BIT ? m_pyramidMultisamplePipeline : m_pyramidPipeline;
+        pipeline->bindCompute(commandBuffer);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 0, 1, &m_pyramidSets[level], 0, nullptr);
+
+        VkExtent2D levelSize = { std::max(1u, m_pyramidExtent.width >> level), std::max(1u, m_pyramidExtent.height >> level) };
+        int32_t pushConstants[5] = { static_cast<int32_t>(sourceSize.width), static_cast<int32_t>(sourceSize.height), static_cast<int32_t>(levelSize.width), static_cast<int32_t>(levelSize.height), static_cast<int32_t>(m_depthSamples) };
+        vkCmdPushConstants(commandBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), pushConstants);
+        vkCmdDispatch(commandBuffer, (levelSize.width + 7) / 8, (levelSize.height + 7) / 8, 1);
+
+        // the next level reads what was just written; the render graph orders the next frame's cull after the last level
+        if (level + 1 < m_pyramidLevels)
+            imageBarrier(commandBuffer, m_pyramidImage, VK_IMAGE_ASPECT_COLOR_BIT, level, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+        sourceSize = levelSize;
+    }
+
+    m_pyramidCameraView = m_view;
+    m_pyramidCameraProjection = m_projection;
+    m_pyramidValid = true;
+}
+
+void GpuCuller::createDescriptorSetLayouts()
+{
+    VkDescriptorSetLayoutBinding cullBindings[5]{};
+    cullBindings[0] = { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    cullBindings[1] = { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    cullBindings[2] = { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    cullBindings[3] = { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    cullBindings[4] = { 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+
+    VkDescriptorSetLayoutBinding pyramidBindings[2]{};
+    pyramidBindings[0] = { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    pyramidBindings[1] = { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+
+    VkDescriptorSetLayoutBinding instanceBinding = { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr };
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 5;
+    layoutInfo.pBindings = cullBindings;
+    if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &m_cullSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create cull descriptor set layout.");
+
+    layoutInfo.bindingCount = 2;
+    layoutInfo.pBindings = pyramidBindings;
+    if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &m_pyramidSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create depth pyramid descriptor set layout.");
+
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &instanceBinding;
+    if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &m_instanceSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create instance descriptor set layout.");
+}
+
+void GpuCuller::createPipelines(const std::string& shaderDirectory)
+{
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_cullSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 0; // optional
+    pipelineLayoutInfo.pPushConstantRanges = nullptr; // optional
+
+    PipelineSettings pipelineSettings{};
+    m_cullPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "cull.spv");
+
+    VkPushConstantRange psRange;
+    psRange.offset = 0;
+    psRange.size = 5 * sizeof(int32_t);
+    psRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    pipelineLayoutInfo.pSetLayouts = &m_pyramidSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &psRange;
+    m_pyramidPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "hiz.spv");
+    m_pyramidMultisamplePipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "hizMultisample.spv");
+}
+
+void GpuCuller::createBuffers()
+{
+    m_device->createBuffer(sizeof(Rock::GpuInstance) * m_maxInstances, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_instanceBuffer, m_instanceBufferMemory);
+    m_device->createBuffer(sizeof(VkDrawIndexedIndirectCommand) * m_maxInstances, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_drawCommandBuffer, m_drawCommandBufferMemory);
+    m_device->createBuffer(2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_drawCountBuffer, m_drawCountBufferMemory);
+
+    m_uniformBuffers.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_uniformBuffersMemory.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_uniformBuffersMapped.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_readbackBuffers.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_readbackBuffersMemory.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_readbackMapped.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+
+    for (size_t i = 0; i < Swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        m_device->createBuffer(sizeof(CullUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_uniformBuffers[i], m_uniformBuffersMemory[i]);
+        vkMapMemory(m_device->getDevice(), m_uniformBuffersMemory[i], 0, sizeof(CullUniforms), 0, &m_uniformBuffersMapped[i]);
+
+        void* readback;
+        m_device->createBuffer(2 * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_readbackBuffers[i], m_readbackBuffersMemory[i]);
+        vkMapMemory(m_device->getDevice(), m_readbackBuffersMemory[i], 0, 2 * sizeof(uint32_t), 0, &readback);
+        m_readbackMapped[i] = static_cast<uint32_t*>(readback);
+        m_readbackMapped[i][0] = 0;
+        m_readbackMapped[i][1] = 0;
+    }
+}
+
+void GpuCuller::createDescriptorSets()
+{
+    uint32_t frames = static_cast<uint32_t>(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frames },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frames * 3 + 1 },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frames + MAX_PYRAMID_LEVELS },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_PYRAMID_LEVELS }
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT; // pyramid sets are reallocated when the swapchain is resized
+    poolInfo.poolSizeCount = 4;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = frames + MAX_PYRAMID_LEVELS + 1;
+    if (vkCreateDescriptorPool(m_device->getDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create GPU culling descriptor pool.");
+
+    std::vector<VkDescriptorSetLayout> layouts(frames, m_cullSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = frames;
+    allocInfo.pSetLayouts = layouts.data();
+    m_cullSets.resize(frames);
+    if (vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, m_cullSets.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate cull descriptor sets.");
+
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_instanceSetLayout;
+    if (vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, &m_instanceSet) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate instance descriptor set.");
+
+    VkDescriptorBufferInfo instanceInfo{ m_instanceBuffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo drawCommandInfo{ m_drawCommandBuffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo drawCountInfo{ m_drawCountBuffer, 0, VK_WHOLE_SIZE };
+
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.dstSet = m_instanceSet;
+    write.dstBinding = 0;
+    write.pBufferInfo = &instanceInfo;
+    vkUpdateDescriptorSets(m_device->getDevice(), 1, &write, 0, nullptr);
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        VkDescriptorBufferInfo uniformInfo{ m_uniformBuffers[i], 0, sizeof(CullUniforms) };
+        VkWriteDescriptorSet writes[4]{};
+        VkDescriptorBufferInfo* infos[4] = { &uniformInfo, &instanceInfo, &drawCommandInfo, &drawCountInfo };
+        for (uint32_t binding = 0; binding < 4; binding++)
+        {
+            writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[binding].dstSet = m_cullSets[i];
+            writes[binding].dstBinding = binding;
+            writes[binding].descriptorCount = 1;
+            writes[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[binding].pBufferInfo = infos[binding];
+        }
+        vkUpdateDescriptorSets(m_device->getDevice(), 4, writes, 0, nullptr);
+    }
+}
+
+void GpuCuller::createDepthPyramid(VkExtent2D depthExtent)
+{
+    m_depthExtent = depthExtent;
+    m_pyramidExtent = { Rock::DepthPyramid::getPyramidSize(depthExtent.width), Rock::DepthPyramid::getPyramidSize(depthExtent.height) };
+    m_pyramidLevels = std::min(Rock::DepthPyramid::getLevelCount(depthExtent.width, depthExtent.height), MAX_PYRAMID_LEVELS);
+
+    m_device->createImage(m_pyramidExtent.width, m_pyramidExtent.height, m_pyramidLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_pyramidImage, m_pyramidImageMemory);
+    m_pyramidView = m_device->createImageView(m_pyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, m_pyramidLevels);
+
+    m_pyramidLevelViews.resize(m_pyramidLevels);
+    for (uint32_t level = 0; level < m_pyramidLevels; level++)
+    {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = m_pyramidImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R32_SFLOAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = level;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(m_device->getDevice(), &viewInfo, nullptr, &m_pyramidLevelViews[level]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create depth pyramid level view.");
+    }
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = static_cast<float>(m_pyramidLevels);
+    if (vkCreateSampler(m_device->getDevice(), &samplerInfo, nullptr, &m_pyramidSampler) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create depth pyramid sampler.");
+
+    std::vector<VkDescriptorSetLayout> layouts(m_pyramidLevels, m_pyramidSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = m_pyramidLevels;
+    allocInfo.pSetLayouts = layouts.data();
+    m_pyramidSets.resize(m_pyramidLevels);
+    if (vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, m_pyramidSets.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate depth pyramid descriptor sets.");
+
+    // level 0 reads the depth attachment, written in recordDepthPyramid; every other level reads the level above it
+    for (uint32_t level = 0; level < m_pyramidLevels; level++)
+    {
+        VkDescriptorImageInfo sourceInfo{ m_pyramidSampler, level > 0 ? m_pyramidLevelViews[level - 1] : VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL };
+        VkDescriptorImageInfo destinationInfo{ VK_NULL_HANDLE, m_pyramidLevelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+
+        VkWriteDescriptorSet writes[2]{};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = m_pyramidSets[level];
+        writes[0].dstBinding = 1;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[0].pImageInfo = &destinationInfo;
+        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstSet = m_pyramidSets[level];
+        writes[1].dstBinding = 0;
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[1].pImageInfo = &sourceInfo;
+        vkUpdateDescriptorSets(m_device->getDevice(), level > 0 ? 2 : 1, writes, 0, nullptr);
+    }
+
+    VkDescriptorImageInfo pyramidInfo{ m_pyramidSampler, m_pyramidView, VK_IMAGE_LAYOUT_GENERAL };
+    for (VkDescriptorSet cullSet : m_cullSets)
+    {
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = cullSet;
+        write.dstBinding = 4;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo = &pyramidInfo;
+        vkUpdateDescriptorSets(m_device->getDevice(), 1, &write, 0, nullptr);
+    }
+
+    m_depthSourceView = VK_NULL_HANDLE;
+    m_pyramidValid = false;
+}
+
+void GpuCuller::destroyDepthPyramid()
+{
+    if (m_pyramidImage == VK_NULL_HANDLE)
+        return;
+
+    vkFreeDescriptorSets(m_device->getDevice(), m_descriptorPool, static_cast<uint32_t>(m_pyramidSets.size()), m_pyramidSets.data());
+    m_pyramidSets.clear();
+    vkDestroySampler(m_device->getDevice(), m_pyramidSampler, nullptr);
+    for (VkImageView view : m_pyramidLevelViews)
+        vkDestroyImageView(m_device->getDevice(), view, nullptr);
+    m_pyramidLevelViews.clear();
+    vkDestroyImageView(m_device->getDevice(), m_pyramidView, nullptr);
+    vkDestroyImage(m_device->getDevice(), m_pyramidImage, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_pyramidImageMemory, nullptr);
+    m_pyramidImage = VK_NULL_HANDLE;
+}
+
+void GpuCuller::imageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect, uint32_t baseLevel, uint32_t levelCount, VkImageLayout oldLayout, VkImageLayout newLayout,
+    VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = aspect;
+    barrier.subresourceRange.baseMipLevel = baseLevel;
+    barrier.subresourceRange.levelCount = levelCount;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
@@ -0,0 +1,502 @@
+/** \file gpuPhysics.cpp */
+
+#include "rendering/gpuPhysics.hpp"
+#include "rendering/gpuLayout.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static_assert(sizeof(GpuPhysics::Body) == 32, "Body must match the std430 Body struct in the physics shaders");
+GPU_LAYOUT_MEMBER(Std430, GpuPhysics::Body, position, radius);
+GPU_LAYOUT_MEMBER(Std430, GpuPhysics::Body, radius, velocity);
+GPU_LAYOUT_MEMBER(Std430, GpuPhysics::Body, velocity, inverseMass);
+
+static_assert(sizeof(GpuPhysics::PhysicsUniforms) == 64, "PhysicsUniforms must match the std140 PhysicsUBO block in the physics shaders");
+GPU_LAYOUT_MEMBER(Std140, GpuPhysics::PhysicsUniforms, gravity, boundsMin);
+GPU_LAYOUT_MEMBER(Std140, GpuPhysics::PhysicsUniforms, boundsMin, boundsMax);
+GPU_LAYOUT_MEMBER(Std140, GpuPhysics::PhysicsUniforms, boundsMax, damping);
+GPU_LAYOUT_MEMBER(Std140, GpuPhysics::PhysicsUniforms, damping, bodyCount);
+GPU_LAYOUT_MEMBER(Std140, GpuPhysics::PhysicsUniforms, bodyCount, tableSize);
+GPU_LAYOUT_MEMBER(Std140, GpuPhysics::PhysicsUniforms, tableSize, mirrorCount);
+
+static_assert(sizeof(GpuPhysics::MirroredBody) == 32, "MirroredBody must match the std430 MirroredBody struct in gather.comp");
+
+namespace
+{
+    const uint32_t NO_SUMS = UINT32_MAX; //!< tells scan.comp the level is the last and has no block totals to write
+    const uint32_t BINDING_COUNT = 9; //!< 0 uniforms, 1 bodies, 2 next bodies, 3 hashes, 4 scan, 5 cursors, 6 sorted, 7 mirror indices, 8 mirrored bodies
+}
+
+GpuPhysics::GpuPhysics(Device* device, const PhysicsSettings& settings)
+    : m_device(device), m_settings(settings)
+{
+    if (m_settings.maxBodies == 0 || m_settings.maxBodies > MAX_BODIES)
+        throw std::runtime_error("Physics capacity must be between 1 and MAX_BODIES.");
+    if (m_settings.maxRadius <= 0.f)
+        throw std::runtime_error("Physics bodies must have a positive maximum radius.");
+
+    m_tableSize = getTableSize(m_settings.maxBodies);
+    m_scanLevels = ParticleSystem::getScanLevels(m_tableSize + 1);
+
+    createDescriptorSetLayout();
+    createPipelines();
+    createBuffers();
+    createDescriptorSets();
+    createCommandBuffer();
+    writeUniforms();
+}
+
+GpuPhysics::~GpuPhysics()
+{
+    vkDestroyFence(m_device->getDevice(), m_fence, nullptr);
+    vkFreeCommandBuffers(m_device->getDevice(), m_device->getComputeCommandPool(), 1, &m_commandBuffer);
+
+    for (int i = 0; i < 2; i++)
+    {
+        vkDestroyBuffer(m_device->getDevice(), m_bodyBuffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_bodyBuffersMemory[i], nullptr);
+    }
+    vkDestroyBuffer(m_device->getDevice(), m_hashBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_hashBufferMemory, nullptr);
+    vkDestroyBuffer(m_device->getDevice(), m_scanBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_scanBufferMemory, nullptr);
+    vkDestroyBuffer(m_device->getDevice(), m_cursorBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_cursorBufferMemory, nullptr);
+    vkDestroyBuffer(m_device->getDevice(), m_sortedBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_sortedBufferMemory, nullptr);
+    vkDestroyBuffer(m_device->getDevice(), m_mirrorIndexBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_mirrorIndexBufferMemory, nullptr);
+    vkDestroyBuffer(m_device->getDevice(), m_mirrorBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_mirrorBufferMemory, nullptr);
+    vkDestroyBuffer(m_device->getDevice(), m_uniformBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_uniformBufferMemory, nullptr);
+
+    vkDestroyDescriptorPool(m_device->getDevice(), m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device->getDevice(), m_setLayout, nullptr);
+
+    for (Pipeline** pipeline : { &m_hashPipeline, &m_scanPipeline, &m_scanAddPipeline, &m_scatterPipeline, &m_collidePipeline, &m_gatherPipeline })
+    {
+        (*pipeline)->destroyPipelineLayout();
+        delete *pipeline;
+        *pipeline = nullptr;
+    }
+    m_device = nullptr;
+}
+
+uint32_t GpuPhysics::getTableSize(uint32_t maxBodies)
+{
+    uint32_t tableSize = 1;
+    while (tableSize < maxBodies)
+        tableSize <<= 1;
+    return tableSize;
+}
+
+void GpuPhysics::simulate(std::vector<Body>& bodies, const PhysicsSettings& settings, float deltaTime)
+{
+    uint32_t tableSize = getTableSize(settings.maxBodies);
+    uint32_t count = static_cast<uint32_t>(bodies.size());
+
+    // the counting sort of hash.comp, scan.comp and scatter.comp: count the bodies in each bucket, scan the counts into the first sorted index of each bucket, then place each body
+    std::vector<uint32_t> hashes(count);
+    std::vector<uint32_t> starts(tableSize + 1, 0);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        hashes[i] = hashCell(getCell(bodies[i].position, settings), tableSize);
+        starts[hashes[i]]++;
+    }
+    uint32_t total = 0;
+    for (uint32_t& start : starts)
+    {
+        uint32_t bucketCount = start;
+        start = total;
+        total += bucketCount;
+    }
+    std::vector<uint32_t> cursors(tableSize, 0);
+    std::vector<uint32_t> sorted(count);
+    for (uint32_t i = 0; i < count; i++)
+        sorted[starts[hashes[i]] + cursors[hashes[i]]++] = i;
+
+    // collide.comp: every body reads only the previous state, so the bodies may be stepped in any order
+    std::vector<Body> next = bodies;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const Body& body = bodies[i];
+        if (body.inverseMass == 0.f)
+            continue;
+
+        glm::vec3 force(0.f);
+        glm::ivec3 cell = getCell(body.position, settings);
+        for (int z = -1; z <= 1; z++)
+            for (int y = -1; y <= 1; y++)
+                for (int x = -1; x <= 1; x++)
+                {
+                    glm::ivec3 neighbour = cell + glm::ivec3(x, y, z);
+                    uint32_t bucket = hashCell(neighbour, tableSize);
+                    for (uint32_t slot = starts[bucket]; slot < starts[bucket + 1]; slot++)
+                    {
+                        // distant cells share buckets, so only bodies really in the neighbouring cell are tested, and each only once
+                        uint32_t j = sorted[slot];
+                        const Body& other = bodies[j];
+                        if (j == i || getCell(other.position, settings) != neighbour)
+                            continue;
+                        glm::vec3 offset = body.position - other.position;
+                        float distanceSquared = glm::dot(offset, offset);
+                        float radii = body.radius + other.radius;
+                        if (distanceSquared >= radii * radii || distanceSquared == 0.f)
+                            continue;
+                        float distance = std::sqrt(distanceSquared);
+                        glm::vec3 normal = offset / distance;
+                        float approach = glm::dot(other.velocity - body.velocity, normal);
+                        force += normal * std::max(settings.stiffness * (radii - distance) + settings.damping * approach, 0.f);
+                    }
+                }
+
+        Body& result = next[i];
+        result.velocity += (settings.gravity + force * body.inverseMass) * deltaTime;
+        result.position += result.velocity * deltaTime;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float low = settings.boundsMin[axis] + body.radius;
+            float high = settings.boundsMax[axis] - body.radius;
+            if (result.position[axis] < low)
+            {
+                result.position[axis] = low;
+                if (result.velocity[axis] < 0.f)
+                    result.velocity[axis] *= -settings.restitution;
+            }
+            else if (result.position[axis] > high)
+            {
+                result.position[axis] = high;
+                if (result.velocity[axis] > 0.f)
+                    result.velocity[axis] *= -settings.restitution;
+            }
+        }
+    }
+    bodies.swap(next);
+}
+
+void GpuPhysics::setBodies(const std::vector<Body>& bodies)
+{
+    if (bodies.size() > m_settings.maxBodies)
+        throw std::runtime_error("More bodies than the physics capacity.");
+    for (const Body& body : bodies)
+        if (body.radius > m_settings.maxRadius)
+            throw std::runtime_error("Body radius is larger than the physics maximum radius.");
+
+    vkDeviceWaitIdle(m_device->getDevice());
+    m_bodyCount = static_cast<uint32_t>(bodies.size());
+    m_current = 0;
+    m_gatheredCount = 0;
+    writeUniforms();
+    if (bodies.empty())
+        return;
+
+    VkDeviceSize size = sizeof(Body) * bodies.size();
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    m_device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    void* data;
+    vkMapMemory(m_device->getDevice(), stagingBufferMemory, 0, size, 0, &data);
+    memcpy(data, bodies.data(), static_cast<size_t>(size));
+    vkUnmapMemory(m_device->getDevice(), stagingBufferMemory);
+
+    m_device->copyBuffer(stagingBuffer, m_bodyBuffers[m_current], size);
+
+    vkDestroyBuffer(m_device->getDevice(), stagingBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), stagingBufferMemory, nullptr);
+}
+
+std::vector<GpuPhysics::Body> GpuPhysics::getBodies() const
+{
+    std::vector<Body> bodies(m_bodyCount);
+    if (bodies.empty())
+        return bodies;
+
+    vkDeviceWaitIdle(m_device->getDevice());
+    VkDeviceSize size = sizeof(Body) * bodies.size();
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    m_device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    m_device->copyBuffer(m_bodyBuffers[m_current], stagingBuffer, size);
+
+    void* data;
+    vkMapMemory(m_device->getDevice(), stagingBufferMemory, 0, size, 0, &data);
+    memcpy(bodies.data(), data, static_cast<size_t>(size));
+    vkUnmapMemory(m_device->getDevice(), stagingBufferMemory);
+
+    vkDestroyBuffer(m_device->getDevice(), stagingBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), stagingBufferMemory, nullptr);
+    return bodies;
+}
+
+void GpuPhysics::mirror(entt::entity entity, uint32_t body)
+{
+    if (m_mirrored.size() >= m_settings.maxMirrored)
+        throw std::runtime_error("More mirrored bodies than the physics mirror capacity.");
+    if (body >= m_settings.maxBodies)
+        throw std::runtime_error("Mirrored body is outside the physics capacity.");
+
+    vkDeviceWaitIdle(m_device->getDevice());
+    static_cast<uint32_t*>(m_mirrorIndexMapped)[m_mirrored.size()] = body;
+    m_mirrored.push_back({ entity, body });
+    writeUniforms();
+}
+
+void GpuPhysics::recordStep(VkCommandBuffer commandBuffer, float deltaTime)
+{
+    if (m_bodyCount == 0)
+        return;
+
+    // the previous step read the buffers cleared here and wrote the body buffer read here
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdFillBuffer(commandBuffer, m_scanBuffer, 0, VK_WHOLE_SIZE, 0);
+    vkCmdFillBuffer(commandBuffer, m_cursorBuffer, 0, VK_WHOLE_SIZE, 0);
+    computeBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    uint32_t bodyGroups = ParticleSystem::getGroupCount(m_bodyCount, WORKGROUP_SIZE);
+    dispatch(commandBuffer, m_hashPipeline, bodyGroups);
+    computeBarrier(commandBuffer);
+
+    // exclusive prefix sum of the bucket counts, with one extra bucket so each bucket's bodies end where the next bucket's start
+    for (size_t level = 0; level < m_scanLevels.size(); level++)
+    {
+        uint32_t sums = level + 1 < m_scanLevels.size() ? m_scanLevels[level + 1].offset : NO_SUMS;
+        uint32_t pushConstants[4] = { m_scanLevels[level].offset, sums, m_scanLevels[level].count, 0 };
+        dispatch(commandBuffer, m_scanPipeline, ParticleSystem::getGroupCount(m_scanLevels[level].count, WORKGROUP_SIZE), pushConstants);
+        computeBarrier(commandBuffer);
+    }
+    for (size_t level = m_scanLevels.size() - 1; level-- > 0;)
+    {
+        uint32_t pushConstants[4] = { m_scanLevels[level].offset, m_scanLevels[level + 1].offset, m_scanLevels[level].count, 0 };
+        dispatch(commandBuffer, m_scanAddPipeline, ParticleSystem::getGroupCount(m_scanLevels[level].count, WORKGROUP_SIZE), pushConstants);
+        computeBarrier(commandBuffer);
+    }
+
+    dispatch(commandBuffer, m_scatterPipeline, bodyGroups);
+    computeBarrier(commandBuffer);
+
+    uint32_t pushConstants[4] = {};
+    memcpy(pushConstants, &deltaTime, sizeof(float));
+    dispatch(commandBuffer, m_collidePipeline, bodyGroups, pushConstants);
+
+    m_gatheredCount = m_mirrored.size();
+    if (m_gatheredCount > 0)
+    {
+        computeBarrier(commandBuffer);
+        dispatch(commandBuffer, m_gatherPipeline, ParticleSystem::getGroupCount(static_cast<uint32_t>(m_gatheredCount), WORKGROUP_SIZE));
+
+        VkMemoryBarrier hostBarrier{};
+        hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+    }
+    m_current ^= 1;
+}
+
+void GpuPhysics::step(float deltaTime, uint32_t substeps)
+{
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(m_commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin recording physics command buffer.");
+    for (uint32_t i = 0; i < substeps; i++)
+        recordStep(m_commandBuffer, deltaTime);
+    if (vkEndCommandBuffer(m_commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to record physics command buffer.");
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_commandBuffer;
+
+    vkResetFences(m_device->getDevice(), 1, &m_fence);
+    if (vkQueueSubmit(m_device->getComputeQueue(), 1, &submitInfo, m_fence) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit physics command buffer.");
+    vkWaitForFences(m_device->getDevice(), 1, &m_fence, VK_TRUE, UINT64_MAX);
+}
+
+void GpuPhysics::syncTransforms(entt::registry& registry) const
+{
+    const MirroredBody* mirrored = static_cast<const MirroredBody*>(m_mirrorMapped);
+    for (size_t i = 0; i < m_gatheredCount; i++)
+    {
+        entt::entity entity = m_mirrored[i].first;
+        auto& transformComp = registry.get<Rock::TransformComponent>(entity);
+        transformComp.m_translation = glm::vec3(mirrored[i].position);
+        transformComp.recalculate();
+        if (auto* rigidbodyComp = registry.try_get<Rock::RigidbodyComponent>(entity))
+            rigidbodyComp->m_velocity = glm::vec3(mirrored[i].velocity);
+    }
+}
+
+void GpuPhysics::dispatch(VkCommandBuffer commandBuffer, Pipeline* pipeline, uint32_t groups, const uint32_t* pushConstants)
+{
+    pipeline->bindCompute(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 0, 1, &m_sets[m_current], 0, nullptr);
+    if (pushConstants)
+        vkCmdPushConstants(commandBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, 4 * sizeof(uint32_t), pushConstants);
+    vkCmdDispatch(commandBuffer, groups, 1, 1);
+}
+
+void GpuPhysics::computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuPhysics::createDescriptorSetLayout()
+{
+    VkDescriptorSetLayoutBinding bindings[BINDING_COUNT]{};
+    for (uint32_t binding = 0; binding < BINDING_COUNT; binding++)
+        bindings[binding] = { binding, binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = BINDING_COUNT;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &m_setLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create physics descriptor set layout.");
+}
+
+void GpuPhysics::createPipelines()
+{
+    // the scan stages take their ranges and collide its time step as push constants; the other stages share the layout and ignore them
+    VkPushConstantRange psRange;
+    psRange.offset = 0;
+    psRange.size = 4 * sizeof(uint32_t);
+    psRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &psRange;
+
+    PipelineSettings pipelineSettings{};
+    m_hashPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, m_settings.shaderDirectory + "hash.spv");
+    m_scanPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, m_settings.shaderDirectory + "scan.spv");
+    m_scanAddPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, m_settings.shaderDirectory + "scanAdd.spv");
+    m_scatterPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, m_settings.shaderDirectory + "scatter.spv");
+    m_collidePipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, m_settings.shaderDirectory + "collide.spv");
+    m_gatherPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, m_settings.shaderDirectory + "gather.spv");
+}
+
+void GpuPhysics::createBuffers()
+{
+    // the body buffers are concurrent across the graphics and compute families, so steps may run on an async compute queue while uploads and readbacks copy on the graphics queue
+    VkDeviceSize bodySize = sizeof(Body) * m_settings.maxBodies;
+    for (int i = 0; i < 2; i++)
+        m_device->createBuffer(bodySize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_bodyBuffers[i], m_bodyBuffersMemory[i], true);
+
+    const ParticleSystem::ScanLevel& top = m_scanLevels.back();
+    m_device->createBuffer(sizeof(uint32_t) * m_settings.maxBodies, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_hashBuffer, m_hashBufferMemory);
+    m_device->createBuffer(sizeof(uint32_t) * (top.offset + top.count), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_scanBuffer, m_scanBufferMemory);
+    m_device->createBuffer(sizeof(uint32_t) * m_tableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_cursorBuffer, m_cursorBufferMemory);
+    m_device->createBuffer(sizeof(uint32_t) * m_settings.maxBodies, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_sortedBuffer, m_sortedBufferMemory);
+
+    // only the mirrored bodies are copied back each step, into memory the CPU reads in place
+    VkDeviceSize mirrorCapacity = std::max(m_settings.maxMirrored, 1u);
+    m_device->createBuffer(sizeof(uint32_t) * mirrorCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_mirrorIndexBuffer, m_mirrorIndexBufferMemory, true);
+    vkMapMemory(m_device->getDevice(), m_mirrorIndexBufferMemory, 0, VK_WHOLE_SIZE, 0, &m_mirrorIndexMapped);
+    m_device->createBuffer(sizeof(MirroredBody) * mirrorCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_mirrorBuffer, m_mirrorBufferMemory, true);
+    vkMapMemory(m_device->getDevice(), m_mirrorBufferMemory, 0, VK_WHOLE_SIZE, 0, &m_mirrorMapped);
+
+    m_device->createBuffer(sizeof(PhysicsUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_uniformBuffer, m_uniformBufferMemory, true);
+    vkMapMemory(m_device->getDevice(), m_uniformBufferMemory, 0, sizeof(PhysicsUniforms), 0, &m_uniformMapped);
+}
+
+void GpuPhysics::createDescriptorSets()
+{
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * (BINDING_COUNT - 1) }
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = 2;
+    if (vkCreateDescriptorPool(m_device->getDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create physics descriptor pool.");
+
+    VkDescriptorSetLayout layouts[2] = { m_setLayout, m_setLayout };
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 2;
+    allocInfo.pSetLayouts = layouts;
+    if (vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, m_sets) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate physics descriptor sets.");
+
+    VkDescriptorBufferInfo uniformInfo{ m_uniformBuffer, 0, sizeof(PhysicsUniforms) };
+    VkDescriptorBufferInfo hashInfo{ m_hashBuffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo scanInfo{ m_scanBuffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo cursorInfo{ m_cursorBuffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo sortedInfo{ m_sortedBuffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo mirrorIndexInfo{ m_mirrorIndexBuffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo mirrorInfo{ m_mirrorBuffer, 0, VK_WHOLE_SIZE };
+
+    for (int i = 0; i < 2; i++)
+    {
+        // each set steps from one body buffer into the other
+        VkDescriptorBufferInfo bodyInfo{ m_bodyBuffers[i], 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo nextInfo{ m_bodyBuffers[1 - i], 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo* infos[BINDING_COUNT] = { &uniformInfo, &bodyInfo, &nextInfo, &hashInfo, &scanInfo, &cursorInfo, &sortedInfo, &mirrorIndexInfo, &mirrorInfo };
+
+        VkWriteDescriptorSet writes[BINDING_COUNT]{};
+        for (uint32_t binding = 0; binding < BINDING_COUNT; binding++)
+        {
+            writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[binding].dstSet = m_sets[i];
+            writes[binding].dstBinding = binding;
+            writes[binding].descriptorCount = 1;
+            writes[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[binding].pBufferInfo = infos[binding];
+        }
+        vkUpdateDescriptorSets(m_device->getDevice(), BINDING_COUNT, writes, 0, nullptr);
+    }
+}
+
+void GpuPhysics::createCommandBuffer()
+{
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_device->getComputeCommandPool();
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(m_device->getDevice(), &allocInfo, &m_commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate physics command buffer.");
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(m_device->getDevice(), &fenceInfo, nullptr, &m_fence) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create physics fence.");
+}
+
+void GpuPhysics::writeUniforms()
+{
+    PhysicsUniforms uniforms{};
+    uniforms.gravity = glm::vec4(m_settings.gravity, m_settings.restitution);
+    uniforms.boundsMin = glm::vec4(m_settings.boundsMin, 2.f * m_settings.maxRadius);
+    uniforms.boundsMax = glm::vec4(m_settings.boundsMax, m_settings.stiffness);
+    uniforms.damping = m_settings.damping;
+    uniforms.bodyCount = m_bodyCount;
+    uniforms.tableSize = m_tableSize;
+    uniforms.mirrorCount = static_cast<uint32_t>(m_mirrored.size());
+    memcpy(m_uniformMapped, &uniforms, sizeof(uniforms));
+}
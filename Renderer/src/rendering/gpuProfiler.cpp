@@ -0,0 +1,253 @@
+/** \file gpuProfiler.cpp */
+
+#include "rendering/gpuProfiler.hpp"
+
+#include <fstream>
+#include <sstream>
+
+GpuProfiler::GpuProfiler(Device* device, uint32_t framesInFlight) : m_device(device)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_device->getPhysicalDevice(), &properties);
+    m_timestampPeriod = properties.limits.timestampPeriod;
+
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_device->getPhysicalDevice(), &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_device->getPhysicalDevice(), &queueFamilyCount, queueFamilies.data());
+    uint32_t validBits = queueFamilies[m_device->findPhysicalQueueFamilies().graphicsFamily.value()].timestampValidBits;
+    m_timestampMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+    m_timestampsSupported = validBits > 0;
+    // a scope around executed secondaries keeps its statistics query active while they run, which needs inheritedQueries
+    m_statisticsSupported = m_device->getEnabledFeatures().pipelineStatisticsQuery == VK_TRUE && m_device->getEnabledFeatures().inheritedQueries == VK_TRUE;
+    m_enabled = m_timestampsSupported;
+
+    m_frames.resize(framesInFlight);
+    for (FrameQueries& queries : m_frames)
+    {
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = MAX_SCOPES * 2;
+        if (vkCreateQueryPool(m_device->getDevice(), &poolInfo, nullptr, &queries.timestamps) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create timestamp query pool.");
+
+        if (!m_statisticsSupported)
+            continue;
+        poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        poolInfo.queryCount = MAX_SCOPES;
+        poolInfo.pipelineStatistics = STATISTIC_FLAGS;
+        if (vkCreateQueryPool(m_device->getDevice(), &poolInfo, nullptr, &queries.statistics) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create pipeline statistics query pool.");
+    }
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (FrameQueries& queries : m_frames)
+    {
+        vkDestroyQueryPool(m_device->getDevice(), queries.timestamps, nullptr);
+        vkDestroyQueryPool(m_device->getDevice(), queries.statistics, nullptr);
+    }
+    m_device = nullptr;
+}
+
+const char* GpuProfiler::getStatisticName(uint32_t index)
+{
+    static const char* names[STATISTIC_COUNT] = {
+        "input assembly vertices",
+        "input assembly primitives",
+        "vertex shader invocations",
+        "clipping primitives",
+        "fragment shader invocations",
+        "compute shader invocations"
+    };
+    return index < STATISTIC_COUNT ? names[index] : "";
+}
+
+std::string GpuProfiler::toCsv(const std::vector<ScopeResult>& results)
+{
+    std::ostringstream csv;
+    csv << "scope,depth,milliseconds";
+    for (uint32_t i = 0; i < STATISTIC_COUNT; i++)
+        csv << "," << getStatisticName(i);
+    csv << "\n";
+
+    for (const ScopeResult& result : results)
+    {
+        // names are quoted in case one contains a separator, with quotes inside doubled
+        csv << "\"";
+        for (char c : result.name)
+            csv << (c == '"' ? "\"\"" : std::string(1, c));
+        csv << "\"," << result.depth << "," << result.milliseconds;
+        for (uint32_t i = 0; i < STATISTIC_COUNT; i++)
+        {
+            csv << ",";
+            if (result.hasStatistics)
+                csv << result.statistics[i];
+        }
+        csv << "\n";
+    }
+    return csv.str();
+}
+
+std::string GpuProfiler::toJson(const std::vector<ScopeResult>& results)
+{
+    std::ostringstream json;
+    json << "[";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const ScopeResult& result = results[i];
+        json << (i > 0 ? ",\n" : "\n") << "  { \"scope\": \"";
+        for (char c : result.name)
+        {
+            if (c == '"' || c == '\\')
+                json << '\\';
+            json << c;
+        }
+        json << "\", \"depth\": " << result.depth << ", \"milliseconds\": " << result.milliseconds;
+        if (result.hasStatistics)
+        {
+            json << ", \"statistics\": {";
+            for (uint32_t j = 0; j < STATISTIC_COUNT; j++)
+                json << (j > 0 ? ", \"" : " \"") << getStatisticName(j) << "\": " << result.statistics[j];
+            json << " }";
+        }
+        json << " }";
+    }
+    json << (results.empty() ? "]\n" : "\n]\n");
+    return json.str();
+}
+
+double GpuProfiler::getFrameMilliseconds() const
+{
+    double milliseconds = 0.0;
+    for (const ScopeResult& result : m_results)
+    {
+        if (result.depth == 0)
+            milliseconds += result.milliseconds;
+    }
+    return milliseconds;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    m_currentFrame = frame;
+    FrameQueries& queries = m_frames[frame];
+    collect(queries);
+    queries.scopes.clear();
+    queries.statisticsUsed = 0;
+    m_openScopes.clear();
+    // toggling the profiler mid frame only takes effect here, so scopes never write to queries that were not reset
+    m_frameEnabled = m_enabled;
+    if (!m_frameEnabled)
+        return;
+
+    vkCmdResetQueryPool(commandBuffer, queries.timestamps, 0, MAX_SCOPES * 2);
+    if (m_statisticsSupported)
+        vkCmdResetQueryPool(commandBuffer, queries.statistics, 0, MAX_SCOPES);
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const std::string& name)
+{
+    FrameQueries& queries = m_frames[m_currentFrame];
+    if (!m_frameEnabled || queries.scopes.size() >= MAX_SCOPES)
+    {
+        m_openScopes.push_back(UINT32_MAX); // keeps endScope balanced
+        return;
+    }
+
+    uint32_t index = static_cast<uint32_t>(queries.scopes.size());
+    uint32_t depth = static_cast<uint32_t>(m_openScopes.size());
+    // statistics queries of one type cannot nest, so only outermost scopes count them
+    uint32_t statisticsQuery = m_statisticsSupported && m_openScopes.empty() ? queries.statisticsUsed++ : UINT32_MAX;
+    queries.scopes.push_back({ name, depth, statisticsQuery });
+    m_openScopes.push_back(index);
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries.timestamps, index * 2);
+    if (statisticsQuery != UINT32_MAX)
+        vkCmdBeginQuery(commandBuffer, queries.statistics, statisticsQuery, 0);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer)
+{
+    if (m_openScopes.empty())
+        throw std::runtime_error("GPU profiler scope ended without being begun.");
+    uint32_t index = m_openScopes.back();
+    m_openScopes.pop_back();
+    if (index == UINT32_MAX)
+        return;
+
+    FrameQueries& queries = m_frames[m_currentFrame];
+    if (queries.scopes[index].statisticsQuery != UINT32_MAX)
+        vkCmdEndQuery(commandBuffer, queries.statistics, queries.scopes[index].statisticsQuery);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries.timestamps, index * 2 + 1);
+}
+
+void GpuProfiler::exportCsv(const std::string& path) const
+{
+    writeFile(path, toCsv(m_results));
+}
+
+void GpuProfiler::exportJson(const std::string& path) const
+{
+    writeFile(path, toJson(m_results));
+}
+
+void GpuProfiler::collect(FrameQueries& queries)
+{
+    if (queries.scopes.empty())
+        return;
+
+    // each query is followed by its availability, so a frame still executing is skipped rather than waited for
+    uint32_t timestampCount = static_cast<uint32_t>(queries.scopes.size()) * 2;
+    std::vector<uint64_t> timestamps(timestampCount * 2);
+    VkResult result = vkGetQueryPoolResults(m_device->getDevice(), queries.timestamps, 0, timestampCount, timestamps.size() * sizeof(uint64_t), timestamps.data(),
+        sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS)
+        return;
+
+    const uint32_t statisticsStride = STATISTIC_COUNT + 1;
+    std::vector<uint64_t> statistics(queries.statisticsUsed * statisticsStride);
+    if (queries.statisticsUsed > 0)
+    {
+        result = vkGetQueryPoolResults(m_device->getDevice(), queries.statistics, 0, queries.statisticsUsed, statistics.size() * sizeof(uint64_t), statistics.data(),
+            sizeof(uint64_t) * statisticsStride, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (result != VK_SUCCESS)
+            return;
+    }
+
+    std::vector<ScopeResult> results;
+    results.reserve(queries.scopes.size());
+    for (size_t i = 0; i < queries.scopes.size(); i++)
+    {
+        const PendingScope& scope = queries.scopes[i];
+        if (timestamps[i * 4 + 1] == 0 || timestamps[i * 4 + 3] == 0)
+            return;
+
+        ScopeResult scopeResult{};
+        scopeResult.name = scope.name;
+        scopeResult.depth = scope.depth;
+        uint64_t ticks = ((timestamps[i * 4 + 2] & m_timestampMask) - (timestamps[i * 4] & m_timestampMask)) & m_timestampMask;
+        scopeResult.milliseconds = static_cast<double>(ticks) * m_timestampPeriod / 1e6;
+        scopeResult.hasStatistics = scope.statisticsQuery != UINT32_MAX;
+        if (scopeResult.hasStatistics)
+        {
+            const uint64_t* values = &statistics[scope.statisticsQuery * statisticsStride];
+            if (values[STATISTIC_COUNT] == 0)
+                return;
+            for (uint32_t j = 0; j < STATISTIC_COUNT; j++)
+                scopeResult.statistics[j] = values[j];
+        }
+        results.push_back(scopeResult);
+    }
+    m_results = std::move(results);
+}
+
+void GpuProfiler::writeFile(const std::string& path, const std::string& contents) const
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open GPU profile export.");
+    file << contents;
+}
@@ -0,0 +1,340 @@
+/** \file lightClusterer.cpp */
+
+#include "rendering/lightClusterer.hpp"
+#include "rendering/gpuLayout.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+static_assert(sizeof(LightClusterer::GpuLight) == 64, "GpuLight must match the std430 Light struct in cluster.comp and main.frag");
+GPU_LAYOUT_MEMBER(Std430, LightClusterer::GpuLight, position, range);
+GPU_LAYOUT_MEMBER(Std430, LightClusterer::GpuLight, range, colour);
+GPU_LAYOUT_MEMBER(Std430, LightClusterer::GpuLight, colour, innerCutOffCosine);
+GPU_LAYOUT_MEMBER(Std430, LightClusterer::GpuLight, innerCutOffCosine, direction);
+GPU_LAYOUT_MEMBER(Std430, LightClusterer::GpuLight, direction, outerCutOffCosine);
+GPU_LAYOUT_MEMBER(Std430, LightClusterer::GpuLight, outerCutOffCosine, constants);
+GPU_LAYOUT_MEMBER(Std430, LightClusterer::GpuLight, constants, type);
+
+static_assert(sizeof(LightClusterer::ClusterUniforms) == 176, "ClusterUniforms must match the std140 ClusterUBO block in cluster.comp and main.frag");
+GPU_LAYOUT_MEMBER(Std140, LightClusterer::ClusterUniforms, inverseProjection, view);
+GPU_LAYOUT_MEMBER(Std140, LightClusterer::ClusterUniforms, view, screenSize);
+GPU_LAYOUT_MEMBER(Std140, LightClusterer::ClusterUniforms, screenSize, tileSize);
+GPU_LAYOUT_MEMBER(Std140, LightClusterer::ClusterUniforms, tileSize, zNear);
+GPU_LAYOUT_MEMBER(Std140, LightClusterer::ClusterUniforms, zNear, zFar);
+GPU_LAYOUT_MEMBER(Std140, LightClusterer::ClusterUniforms, zFar, sliceScale);
+GPU_LAYOUT_MEMBER(Std140, LightClusterer::ClusterUniforms, sliceScale, sliceBias);
+GPU_LAYOUT_MEMBER(Std140, LightClusterer::ClusterUniforms, sliceBias, gridSize);
+
+static_assert(LightClusterer::CLUSTER_COUNT % LightClusterer::WORKGROUP_SIZE == 0, "cluster.comp has no bounds check, so every workgroup must be full");
+
+LightClusterer::GpuLight LightClusterer::GpuLight::create(const PointLight& light)
+{
+    GpuLight gpuLight{};
+    gpuLight.position = light.position;
+    gpuLight.range = getRange(light.colour, light.constants);
+    gpuLight.colour = light.colour;
+    gpuLight.innerCutOffCosine = -1.f;
+    gpuLight.direction = glm::vec3(0.f, 0.f, -1.f);
+    gpuLight.outerCutOffCosine = -1.f;
+    gpuLight.constants = light.constants;
+    gpuLight.type = POINT;
+    return gpuLight;
+}
+
+LightClusterer::GpuLight LightClusterer::GpuLight::create(const SpotLight& light)
+{
+    GpuLight gpuLight{};
+    gpuLight.position = light.position;
+    gpuLight.range = getRange(light.colour, light.constants);
+    gpuLight.colour = light.colour;
+    gpuLight.innerCutOffCosine = light.innerCutOffCosine;
+    gpuLight.direction = glm::normalize(light.direction);
+    gpuLight.outerCutOffCosine = light.outerCutOffCosine;
+    gpuLight.constants = light.constants;
+    gpuLight.type = SPOT;
+    return gpuLight;
+}
+
+LightClusterer::LightClusterer(Device* device, uint32_t maxLights, const std::string& shaderDirectory)
+    : m_device(device), m_maxLights(maxLights)
+{
+    if (m_maxLights == 0)
+        throw std::runtime_error("Light clusterer capacity must be at least one light.");
+
+    m_lightCounts.resize(Swapchain::MAX_FRAMES_IN_FLIGHT, 0);
+    createDescriptorSetLayout();
+    createPipeline(shaderDirectory);
+    createBuffers();
+    createDescriptorSets();
+}
+
+LightClusterer::~LightClusterer()
+{
+    for (size_t i = 0; i < Swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyBuffer(m_device->getDevice(), m_uniformBuffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_uniformBuffersMemory[i], nullptr);
+        vkDestroyBuffer(m_device->getDevice(), m_lightBuffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_lightBuffersMemory[i], nullptr);
+        vkDestroyBuffer(m_device->getDevice(), m_clusterBuffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_clusterBuffersMemory[i], nullptr);
+    }
+
+    vkDestroyDescriptorPool(m_device->getDevice(), m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device->getDevice(), m_setLayout, nullptr);
+
+    m_clusterPipeline->destroyPipelineLayout();
+    delete m_clusterPipeline;
+    m_clusterPipeline = nullptr;
+    m_device = nullptr;
+}
+
+float LightClusterer::getRange(const glm::vec3& colour, const glm::vec3& constants)
+{
+    float intensity = std::max(std::max(colour.r, colour.g), colour.b);
+    if (intensity <= 0.f)
+        return 0.f;
+
+    // solve constant + linear * d + exponential * d^2 = intensity / threshold for d
+    float c = constants.x - intensity / LIGHT_THRESHOLD;
+    if (c >= 0.f)
+        return 0.f;
+    if (constants.z > 0.f)
+        return (-constants.y + std::sqrt(constants.y * constants.y - 4.f * constants.z * c)) / (2.f * constants.z);
+    if (constants.y > 0.f)
+        return -c / constants.y;
+    return FLT_MAX;
+}
+
+glm::vec4 LightClusterer::getBoundingSphere(const GpuLight& light)
+{
+    if (light.type != SPOT || light.outerCutOffCosine <= 0.f)
+        return glm::vec4(light.position, light.range);
+
+    float cosine = light.outerCutOffCosine;
+    float sine = std::sqrt(1.f - cosine * cosine);
+    if (cosine < std::sqrt(0.5f))
+        return glm::vec4(light.position + light.direction * (light.range * cosine), light.range * sine); // wider than 45 degrees: the sphere through the rim of the cap holds the apex
+    float radius = light.range / (2.f * cosine);
+    return glm::vec4(light.position + light.direction * radius, radius); // narrower: the sphere through the apex and the rim
+}
+
+LightClusterer::ClusterUniforms LightClusterer::createUniforms(const glm::mat4& view, const glm::mat4& projection, VkExtent2D extent, float zNear, float zFar, uint32_t lightCount)
+{
+    ClusterUniforms uniforms{};
+    uniforms.inverseProjection = glm::inverse(projection);
+    uniforms.view = view;
+    uniforms.screenSize = glm::vec2(static_cast<float>(extent.width), static_cast<float>(extent.height));
+    uniforms.tileSize = glm::vec2(std::ceil(uniforms.screenSize.x / GRID_X), std::ceil(uniforms.screenSize.y / GRID_Y));
+    uniforms.zNear = zNear;
+    uniforms.zFar = zFar;
+    float logRatio = std::log(zFar / zNear);
+    uniforms.sliceScale = GRID_Z / logRatio;
+    uniforms.sliceBias = -(GRID_Z * std::log(zNear)) / logRatio;
+    uniforms.gridSize = glm::uvec4(GRID_X, GRID_Y, GRID_Z, lightCount);
+    return uniforms;
+}
+
+void LightClusterer::getClusterBounds(const ClusterUniforms& uniforms, uint32_t cluster, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+    uint32_t x = cluster % uniforms.gridSize.x;
+    uint32_t y = cluster / uniforms.gridSize.x % uniforms.gridSize.y;
+    uint32_t z = cluster / (uniforms.gridSize.x * uniforms.gridSize.y);
+    float sliceNear = std::exp((static_cast<float>(z) - uniforms.sliceBias) / uniforms.sliceScale);
+    float sliceFar = std::exp((static_cast<float>(z + 1) - uniforms.sliceBias) / uniforms.sliceScale);
+    glm::vec2 pixelMin = glm::vec2(static_cast<float>(x), static_cast<float>(y)) * uniforms.tileSize;
+    glm::vec2 pixelMax = glm::min(pixelMin + uniforms.tileSize, uniforms.screenSize);
+
+    // the tile's corners on the near plane, pushed out along their rays to the slice's depths
+    boundsMin = glm::vec3(FLT_MAX);
+    boundsMax = glm::vec3(-FLT_MAX);
+    for (int corner = 0; corner < 4; corner++)
+    {
+        glm::vec2 pixel((corner & 1) ? pixelMax.x : pixelMin.x, (corner & 2) ? pixelMax.y : pixelMin.y);
+        glm::vec4 onNear = uniforms.inverseProjection * glm::vec4(pixel / uniforms.screenSize * 2.f - 1.f, 0.f, 1.f);
+        glm::vec3 ray = glm::vec3(onNear) / onNear.w;
+        for (float depth : { sliceNear, sliceFar })
+        {
+            glm::vec3 point = ray * (depth / -ray.z);
+            boundsMin = glm::min(boundsMin, point);
+            boundsMax = glm::max(boundsMax, point);
+        }
+    }
+}
+
+uint32_t LightClusterer::getCluster(const ClusterUniforms& uniforms, const glm::vec2& fragCoord, float viewDepth)
+{
+    glm::uvec2 tile = glm::min(glm::uvec2(fragCoord / uniforms.tileSize), glm::uvec2(uniforms.gridSize.x - 1, uniforms.gridSize.y - 1));
+    int slice = static_cast<int>(std::floor(std::log(std::max(viewDepth, uniforms.zNear)) * uniforms.sliceScale + uniforms.sliceBias));
+    slice = std::clamp(slice, 0, static_cast<int>(uniforms.gridSize.z) - 1);
+    return tile.x + uniforms.gridSize.x * (tile.y + uniforms.gridSize.y * static_cast<uint32_t>(slice));
+}
+
+std::vector<uint32_t> LightClusterer::assign(const std::vector<GpuLight>& lights, const ClusterUniforms& uniforms)
+{
+    std::vector<glm::vec4> spheres(lights.size());
+    for (size_t i = 0; i < lights.size(); i++)
+    {
+        glm::vec4 sphere = getBoundingSphere(lights[i]);
+        spheres[i] = glm::vec4(glm::vec3(uniforms.view * glm::vec4(glm::vec3(sphere), 1.f)), sphere.w);
+    }
+
+    std::vector<uint32_t> clusters(static_cast<size_t>(CLUSTER_STRIDE) * CLUSTER_COUNT, 0);
+    for (uint32_t cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+    {
+        glm::vec3 boundsMin, boundsMax;
+        getClusterBounds(uniforms, cluster, boundsMin, boundsMax);
+
+        uint32_t* list = &clusters[static_cast<size_t>(cluster) * CLUSTER_STRIDE];
+        for (uint32_t i = 0; i < lights.size() && list[0] < MAX_LIGHTS_PER_CLUSTER; i++)
+        {
+            glm::vec3 offset = glm::clamp(glm::vec3(spheres[i]), boundsMin, boundsMax) - glm::vec3(spheres[i]);
+            if (glm::dot(offset, offset) < spheres[i].w * spheres[i].w)
+                list[1 + list[0]++] = i;
+        }
+    }
+    return clusters;
+}
+
+void LightClusterer::setLights(uint32_t frame, const std::vector<GpuLight>& lights)
+{
+    if (lights.size() > m_maxLights)
+        throw std::runtime_error("Too many lights for the light clusterer.");
+
+    if (!lights.empty())
+        memcpy(m_lightBuffersMapped[frame], lights.data(), sizeof(GpuLight) * lights.size());
+    m_lightCounts[frame] = static_cast<uint32_t>(lights.size());
+}
+
+void LightClusterer::recordCluster(VkCommandBuffer commandBuffer, uint32_t frame, VkExtent2D extent)
+{
+    ClusterUniforms uniforms = createUniforms(m_view, m_projection, extent, m_zNear, m_zFar, m_lightCounts[frame]);
+    memcpy(m_uniformBuffersMapped[frame], &uniforms, sizeof(uniforms));
+
+    m_clusterPipeline->bindCompute(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_clusterPipeline->getPipelineLayout(), 0, 1, &m_sets[frame], 0, nullptr);
+    vkCmdDispatch(commandBuffer, CLUSTER_COUNT / WORKGROUP_SIZE, 1, 1);
+}
+
+std::vector<uint32_t> LightClusterer::readClusters(uint32_t frame) const
+{
+    std::vector<uint32_t> clusters(static_cast<size_t>(CLUSTER_STRIDE) * CLUSTER_COUNT);
+
+    vkDeviceWaitIdle(m_device->getDevice());
+    VkDeviceSize size = getClusterBufferSize();
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    m_device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    m_device->copyBuffer(m_clusterBuffers[frame], stagingBuffer, size);
+
+    void* data;
+    vkMapMemory(m_device->getDevice(), stagingBufferMemory, 0, size, 0, &data);
+    memcpy(clusters.data(), data, static_cast<size_t>(size));
+    vkUnmapMemory(m_device->getDevice(), stagingBufferMemory);
+
+    vkDestroyBuffer(m_device->getDevice(), stagingBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), stagingBufferMemory, nullptr);
+    return clusters;
+}
+
+void LightClusterer::createDescriptorSetLayout()
+{
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    bindings[0] = { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    bindings[1] = { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+    bindings[2] = { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings;
+    if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &m_setLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create light cluster descriptor set layout.");
+}
+
+void LightClusterer::createPipeline(const std::string& shaderDirectory)
+{
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 0; // optional
+    pipelineLayoutInfo.pPushConstantRanges = nullptr; // optional
+
+    PipelineSettings pipelineSettings{};
+    m_clusterPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "cluster.spv");
+}
+
+void LightClusterer::createBuffers()
+{
+    m_uniformBuffers.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_uniformBuffersMemory.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_uniformBuffersMapped.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_lightBuffers.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_lightBuffersMemory.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_lightBuffersMapped.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_clusterBuffers.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_clusterBuffersMemory.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+
+    // the lights change every frame, so each frame writes its own host visible copy rather than staging them
+    for (size_t i = 0; i < Swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        m_device->createBuffer(sizeof(ClusterUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_uniformBuffers[i], m_uniformBuffersMemory[i]);
+        vkMapMemory(m_device->getDevice(), m_uniformBuffersMemory[i], 0, sizeof(ClusterUniforms), 0, &m_uniformBuffersMapped[i]);
+
+        m_device->createBuffer(getLightBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_lightBuffers[i], m_lightBuffersMemory[i]);
+        vkMapMemory(m_device->getDevice(), m_lightBuffersMemory[i], 0, getLightBufferSize(), 0, &m_lightBuffersMapped[i]);
+
+        m_device->createBuffer(getClusterBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_clusterBuffers[i], m_clusterBuffersMemory[i]);
+    }
+}
+
+void LightClusterer::createDescriptorSets()
+{
+    uint32_t frames = static_cast<uint32_t>(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frames },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frames * 2 }
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = frames;
+    if (vkCreateDescriptorPool(m_device->getDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create light cluster descriptor pool.");
+
+    std::vector<VkDescriptorSetLayout> layouts(frames, m_setLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = frames;
+    allocInfo.pSetLayouts = layouts.data();
+    m_sets.resize(frames);
+    if (vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, m_sets.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate light cluster descriptor sets.");
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        VkDescriptorBufferInfo uniformInfo{ m_uniformBuffers[i], 0, sizeof(ClusterUniforms) };
+        VkDescriptorBufferInfo lightInfo{ m_lightBuffers[i], 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo clusterInfo{ m_clusterBuffers[i], 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo* infos[3] = { &uniformInfo, &lightInfo, &clusterInfo };
+
+        VkWriteDescriptorSet writes[3]{};
+        for (uint32_t binding = 0; binding < 3; binding++)
+        {
+            writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[binding].dstSet = m_sets[i];
+            writes[binding].dstBinding = binding;
+            writes[binding].descriptorCount = 1;
+            writes[binding].descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[binding].pBufferInfo = infos[binding];
+        }
+        vkUpdateDescriptorSets(m_device->getDevice(), 3, writes, 0, nullptr);
+    }
+}
@@ -0,0 +1,187 @@
+/** \file meshBuilder.cpp */
+
+#include "rendering/meshBuilder.hpp"
+
+#include <tiny_obj_loader/tiny_obj_loader.h>
+
+#include <atomic>
+#include <thread>
+
+namespace Rock
+{
+    namespace
+    {
+        size_t nextPowerOfTwo(size_t value)
+        {
+            size_t result = 16;
+            while (result < value)
+                result <<= 1;
+            return result;
+        }
+
+        Vertex readVertex(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index)
+        {
+            Vertex vertex{};
+
+            vertex.pos = {
+                attrib.vertices[3 * index.vertex_index + 0],
+                attrib.vertices[3 * index.vertex_index + 1],
+                attrib.vertices[3 * index.vertex_index + 2]
+            };
+
+            if (index.normal_index >= 0)
+            {
+                vertex.norm = {
+                    attrib.normals[3 * index.normal_index + 0],
+                    attrib.normals[3 * index.normal_index + 1],
+                    attrib.normals[3 * index.normal_index + 2]
+                };
+            }
+
+            if (index.texcoord_index >= 0)
+            {
+                vertex.texCoord = {
+                    attrib.texcoords[2 * index.texcoord_index],
+                    1.f - attrib.texcoords[2 * index.texcoord_index + 1]
+                };
+            }
+
+            return vertex;
+        }
+    }
+
+    void MeshBuilder::reserve(size_t indexCount)
+    {
+        m_indices.reserve(indexCount);
+        // keep the load factor at or below a half even if every index is a unique vertex
+        size_t capacity = nextPowerOfTwo(indexCount * 2);
+        if (capacity > m_slots.size())
+            rehash(capacity);
+    }
+
+    uint32_t MeshBuilder::addVertex(const Vertex& vertex)
+    {
+        uint32_t index = insert(vertex);
+        m_indices.push_back(index);
+        return index;
+    }
+
+    void MeshBuilder::clear()
+    {
+        m_vertices.clear();
+        m_indices.clear();
+        std::fill(m_slots.begin(), m_slots.end(), Slot{ 0, EMPTY });
+    }
+
+    void MeshBuilder::build(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        vertices = std::move(m_vertices);
+        indices = std::move(m_indices);
+        m_vertices.clear();
+        m_indices.clear();
+        m_slots.clear();
+        m_mask = 0;
+    }
+
+    uint32_t MeshBuilder::insert(const Vertex& vertex)
+    {
+        if ((m_vertices.size() + 1) * 2 > m_slots.size())
+            rehash(nextPowerOfTwo((m_vertices.size() + 1) * 2));
+
+        uint64_t hash = std::hash<Vertex>()(vertex);
+        uint32_t tag = static_cast<uint32_t>(hash >> 32);
+        for (size_t slot = hash & m_mask;; slot = (slot + 1) & m_mask)
+        {
+            Slot& entry = m_slots[slot];
+            if (entry.index == EMPTY)
+            {
+                entry.tag = tag;
+                entry.index = static_cast<uint32_t>(m_vertices.size());
+                m_vertices.push_back(vertex);
+                return entry.index;
+            }
+            if (entry.tag == tag && m_vertices[entry.index] == vertex)
+                return entry.index;
+        }
+    }
+
+    void MeshBuilder::rehash(size_t capacity)
+    {
+        m_slots.assign(capacity, Slot{ 0, EMPTY });
+        m_mask = capacity - 1;
+
+        for (uint32_t i = 0; i < m_vertices.size(); i++)
+        {
+            uint64_t hash = std::hash<Vertex>()(m_vertices[i]);
+            size_t slot = hash & m_mask;
+            while (m_slots[slot].index != EMPTY)
+                slot = (slot + 1) & m_mask;
+            m_slots[slot] = { static_cast<uint32_t>(hash >> 32), i };
+        }
+    }
+
+    void MeshBuilder::fromObj(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool parallel)
+    {
+        size_t indexCount = 0;
+        for (const auto& shape : shapes)
+            indexCount += shape.mesh.indices.size();
+
+        MeshBuilder builder(indexCount);
+        size_t threadCount = std::min<size_t>(shapes.size(), std::max(1u, std::thread::hardware_concurrency()));
+
+        if (!parallel || threadCount < 2)
+        {
+            for (const auto& shape : shapes)
+                for (const auto& index : shape.mesh.indices)
+                    builder.addVertex(readVertex(attrib, index));
+
+            builder.build(vertices, indices);
+            return;
+        }
+
+        // deduplicate each shape independently, then merge the (much smaller) unique sets in shape order
+        std::vector<MeshBuilder> shapeBuilders(shapes.size());
+        std::atomic<size_t> nextShape{ 0 };
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threadCount; t++)
+        {
+            workers.emplace_back([&]()
+            {
+                for (size_t s = nextShape++; s < shapes.size(); s = nextShape++)
+                {
+                    MeshBuilder& shapeBuilder = shapeBuilders[s];
+                    shapeBuilder.reserve(shapes[s].mesh.indices.size());
+                    for (const auto& index : shapes[s].mesh.indices)
+                        shapeBuilder.addVertex(readVertex(attrib, index));
+                }
+            });
+        }
+        for (auto& worker : workers)
+            worker.join();
+
+        std::vector<uint32_t> remap;
+        for (const MeshBuilder& shapeBuilder : shapeBuilders)
+        {
+            remap.resize(shapeBuilder.m_vertices.size());
+            for (size_t i = 0; i < remap.size(); i++)
+                remap[i] = builder.insert(shapeBuilder.m_vertices[i]);
+            for (uint32_t index : shapeBuilder.m_indices)
+                builder.m_indices.push_back(remap[index]);
+        }
+
+        builder.build(vertices, indices);
+    }
+
+    void MeshBuilder::loadObj(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool parallel)
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+            throw std::runtime_error(warn + err);
+
+        fromObj(attrib, shapes, vertices, indices, parallel);
+    }
+}
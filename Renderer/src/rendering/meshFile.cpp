@@ -0,0 +1,191 @@
+/** \file meshFile.cpp */
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "rendering/meshFile.hpp"
+
+#include <fstream>
+
+namespace Rock
+{
+    MeshFile::MeshFile(const std::string& path)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("Failed to open mesh file.");
+        m_fileHandle = reinterpret_cast<intptr_t>(file);
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+        {
+            unmap();
+            throw std::runtime_error("Failed to read mesh file size.");
+        }
+        m_size = static_cast<size_t>(size.QuadPart);
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr)
+        {
+            unmap();
+            throw std::runtime_error("Failed to create mesh file mapping.");
+        }
+        m_mappingHandle = reinterpret_cast<intptr_t>(mapping);
+
+        m_data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        int file = open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            throw std::runtime_error("Failed to open mesh file.");
+        m_fileHandle = file;
+
+        struct stat info;
+        if (fstat(file, &info) != 0)
+        {
+            unmap();
+            throw std::runtime_error("Failed to read mesh file size.");
+        }
+        m_size = static_cast<size_t>(info.st_size);
+
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+        m_data = data == MAP_FAILED ? nullptr : static_cast<const char*>(data);
+#endif
+        if (m_data == nullptr)
+        {
+            unmap();
+            throw std::runtime_error("Failed to map mesh file.");
+        }
+
+        try
+        {
+            validate(path);
+        }
+        catch (...)
+        {
+            unmap();
+            throw;
+        }
+    }
+
+    MeshFile::~MeshFile()
+    {
+        unmap();
+    }
+
+    void MeshFile::validate(const std::string& path) const
+    {
+        if (m_size < sizeof(MeshFileHeader))
+            throw std::runtime_error("Mesh file is too small: " + path);
+
+        const MeshFileHeader& header = getHeader();
+        if (header.magic != MESH_FILE_MAGIC)
+            throw std::runtime_error("Not a mesh file: " + path);
+        if (header.version != MESH_FILE_VERSION)
+            throw std::runtime_error("Mesh file version mismatch, re-run MeshCooker: " + path);
+        if (header.vertexStride != sizeof(Vertex))
+            throw std::runtime_error("Mesh file vertex layout does not match Vertex, re-run MeshCooker: " + path);
+        if (header.indexSize != sizeof(uint16_t) && header.indexSize != sizeof(uint32_t))
+            throw std::runtime_error("Mesh file has an invalid index size: " + path);
+        if (header.vertexOffset + getVertexDataSize() > m_size || header.indexOffset + getIndexDataSize() > m_size)
+            throw std::runtime_error("Mesh file is truncated: " + path);
+    }
+
+    void MeshFile::unmap()
+    {
+#ifdef _WIN32
+        if (m_data != nullptr)
+            UnmapViewOfFile(m_data);
+        if (m_mappingHandle != 0)
+            CloseHandle(reinterpret_cast<HANDLE>(m_mappingHandle));
+        if (m_fileHandle != -1)
+            CloseHandle(reinterpret_cast<HANDLE>(m_fileHandle));
+#else
+        if (m_data != nullptr)
+            munmap(const_cast<char*>(m_data), m_size);
+        if (m_fileHandle != -1)
+            close(static_cast<int>(m_fileHandle));
+#endif
+        m_data = nullptr;
+        m_size = 0;
+        m_fileHandle = -1;
+        m_mappingHandle = 0;
+    }
+
+    MeshBounds MeshFile::getBounds() const
+    {
+        const MeshFileHeader& header = getHeader();
+
+        MeshBounds bounds{};
+        bounds.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+        bounds.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+        bounds.centre = glm::vec3(header.sphereCentre[0], header.sphereCentre[1], header.sphereCentre[2]);
+        bounds.radius = header.sphereRadius;
+        return bounds;
+    }
+
+    void MeshFile::write(const std::string& path, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+    {
+        MeshBounds bounds = MeshBounds::calculate(vertices.data(), vertices.size());
+        bool shortIndices = vertices.size() <= UINT16_MAX;
+
+        MeshFileHeader header{};
+        header.magic = MESH_FILE_MAGIC;
+        header.version = MESH_FILE_VERSION;
+        header.vertexCount = static_cast<uint32_t>(vertices.size());
+        header.vertexStride = sizeof(Vertex);
+        header.indexCount = static_cast<uint32_t>(indices.size());
+        header.indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+        for (int i = 0; i < 3; i++)
+        {
+            header.boundsMin[i] = bounds.min[i];
+            header.boundsMax[i] = bounds.max[i];
+            header.sphereCentre[i] = bounds.centre[i];
+        }
+        header.sphereRadius = bounds.radius;
+        header.vertexOffset = sizeof(MeshFileHeader);
+        header.indexOffset = header.vertexOffset + static_cast<uint64_t>(vertices.size()) * sizeof(Vertex);
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            throw std::runtime_error("Failed to create mesh file: " + path);
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+        if (shortIndices)
+        {
+            std::vector<uint16_t> shortData(indices.begin(), indices.end());
+            file.write(reinterpret_cast<const char*>(shortData.data()), shortData.size() * sizeof(uint16_t));
+        }
+        else
+        {
+            file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(uint32_t));
+        }
+
+        if (!file.good())
+            throw std::runtime_error("Failed to write mesh file: " + path);
+    }
+
+    std::string MeshFile::getCookedPath(const std::string& path)
+    {
+        size_t extension = path.find_last_of('.');
+        size_t separator = path.find_last_of("/\\");
+        if (extension == std::string::npos || (separator != std::string::npos && extension < separator))
+            return path + MESH_FILE_EXTENSION;
+        return path.substr(0, extension) + MESH_FILE_EXTENSION;
+    }
+
+    bool MeshFile::exists(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return file.is_open();
+    }
+}
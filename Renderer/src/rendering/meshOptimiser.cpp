@@ -0,0 +1,309 @@
+/** \file meshOptimiser.cpp */
+
+#include "rendering/meshOptimiser.hpp"
+
+namespace Rock
+{
+    namespace
+    {
+        // tuning constants from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+        const uint32_t CACHE_SIZE = 32;
+        const float CACHE_DECAY_POWER = 1.5f;
+        const float LAST_TRIANGLE_SCORE = 0.75f;
+        const float VALENCE_BOOST_SCALE = 2.f;
+        const float VALENCE_BOOST_POWER = 0.5f;
+        const uint32_t INVALID = UINT32_MAX;
+
+        float vertexScore(int cachePosition, uint32_t remainingValence)
+        {
+            if (remainingValence == 0)
+                return -1.f;
+
+            float score = 0.f;
+            if (cachePosition >= 0)
+            {
+                if (cachePosition < 3)
+                    score = LAST_TRIANGLE_SCORE;
+                else
+                    score = std::pow(1.f - static_cast<float>(cachePosition - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+
+            return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingValence), -VALENCE_BOOST_POWER);
+        }
+
+        // FIFO cache simulated with timestamps; a vertex is resident while time - stamp <= cacheSize
+        struct FifoCache
+        {
+            std::vector<uint32_t> stamps;
+            uint32_t size;
+            uint32_t time;
+
+            FifoCache(size_t vertexCount, uint32_t cacheSize) : stamps(vertexCount, 0), size(cacheSize), time(cacheSize + 1) {}
+
+            uint32_t access(uint32_t vertex)
+            {
+                if (time - stamps[vertex] > size)
+                {
+                    stamps[vertex] = time++;
+                    return 1;
+                }
+                return 0;
+            }
+
+            uint32_t accessTriangle(const uint32_t* triangle) { return access(triangle[0]) + access(triangle[1]) + access(triangle[2]); }
+            void flush() { time += size + 1; }
+        };
+    }
+
+    void MeshOptimiser::optimiseVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+    {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+            return;
+
+        // triangle adjacency per vertex; the first remaining[v] entries of each list are the triangles not yet emitted
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++)
+            remaining[indices[i]]++;
+
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] = offsets[v] + remaining[v];
+
+        std::vector<uint32_t> adjacency(triangleCount * 3);
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (uint32_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = t;
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            vertexScores[v] = vertexScore(-1, remaining[v]);
+
+        std::vector<float> triangleScores(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        for (size_t t = 0; t < triangleCount; t++)
+            triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+        std::vector<uint32_t> cache, nextCache;
+        cache.reserve(CACHE_SIZE + 3);
+        nextCache.reserve(CACHE_SIZE + 3);
+
+        uint32_t bestTriangle = static_cast<uint32_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+        size_t inputCursor = 0;
+
+        for (size_t output = 0; output < triangleCount; output++)
+        {
+            if (bestTriangle == INVALID)
+            {
+                // nothing in the cache has live triangles left; restart from the next unemitted triangle
+                while (emitted[inputCursor])
+                    inputCursor++;
+                bestTriangle = static_cast<uint32_t>(inputCursor);
+            }
+
+            const uint32_t* triangle = &indices[bestTriangle * 3];
+            destination[output * 3 + 0] = triangle[0];
+            destination[output * 3 + 1] = triangle[1];
+            destination[output * 3 + 2] = triangle[2];
+            emitted[bestTriangle] = true;
+
+            for (int k = 0; k < 3; k++)
+            {
+                uint32_t v = triangle[k];
+                uint32_t* list = &adjacency[offsets[v]];
+                for (uint32_t i = 0; i < remaining[v]; i++)
+                {
+                    if (list[i] == bestTriangle)
+                    {
+                        std::swap(list[i], list[remaining[v] - 1]);
+                        break;
+                    }
+                }
+                remaining[v]--;
+            }
+
+            // move the triangle's vertices to the front of the LRU cache
+            nextCache.clear();
+            nextCache.insert(nextCache.end(), triangle, triangle + 3);
+            for (uint32_t v : cache)
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+                    nextCache.push_back(v);
+
+            for (size_t i = CACHE_SIZE; i < nextCache.size(); i++)
+                cachePosition[nextCache[i]] = -1;
+            if (nextCache.size() > CACHE_SIZE)
+                nextCache.resize(CACHE_SIZE);
+            for (size_t i = 0; i < nextCache.size(); i++)
+                cachePosition[nextCache[i]] = static_cast<int>(i);
+
+            // rescore vertices that entered, moved in or left the cache and propagate the change to their live triangles
+            auto rescore = [&](uint32_t v)
+            {
+                float score = vertexScore(cachePosition[v], remaining[v]);
+                float delta = score - vertexScores[v];
+                vertexScores[v] = score;
+                for (uint32_t i = 0; i < remaining[v]; i++)
+                    triangleScores[adjacency[offsets[v] + i]] += delta;
+            };
+            for (uint32_t v : cache)
+                if (cachePosition[v] == -1)
+                    rescore(v);
+            for (uint32_t v : nextCache)
+                rescore(v);
+            cache.swap(nextCache);
+
+            bestTriangle = INVALID;
+            float bestScore = -1.f;
+            for (uint32_t v : cache)
+            {
+                for (uint32_t i = 0; i < remaining[v]; i++)
+                {
+                    uint32_t t = adjacency[offsets[v] + i];
+                    if (triangleScores[t] > bestScore)
+                    {
+                        bestScore = triangleScores[t];
+                        bestTriangle = t;
+                    }
+                }
+            }
+        }
+    }
+
+    void MeshOptimiser::optimiseOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount, float threshold)
+    {
+        const uint32_t cacheSize = 16;
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+            return;
+
+        // hard boundaries: triangles where every vertex misses, i.e. the cache has restarted anyway
+        std::vector<size_t> hardClusters;
+        FifoCache cache(vertexCount, cacheSize);
+        for (size_t t = 0; t < triangleCount; t++)
+            if (cache.accessTriangle(&indices[t * 3]) == 3)
+                hardClusters.push_back(t);
+        hardClusters.push_back(triangleCount);
+
+        // soft boundaries: split a hard cluster wherever restarting the cache keeps the ACMR within threshold of the whole cluster
+        std::vector<size_t> clusters;
+        for (size_t c = 0; c + 1 < hardClusters.size(); c++)
+        {
+            size_t start = hardClusters[c], end = hardClusters[c + 1];
+
+            cache.flush();
+            uint32_t clusterMisses = 0;
+            for (size_t t = start; t < end; t++)
+                clusterMisses += cache.accessTriangle(&indices[t * 3]);
+            float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+            cache.flush();
+            clusters.push_back(start);
+            size_t softStart = start;
+            uint32_t misses = 0;
+            for (size_t t = start; t < end; t++)
+            {
+                misses += cache.accessTriangle(&indices[t * 3]);
+                if (t + 1 < end && static_cast<float>(misses) / static_cast<float>(t - softStart + 1) <= clusterThreshold)
+                {
+                    clusters.push_back(t + 1);
+                    softStart = t + 1;
+                    misses = 0;
+                    cache.flush();
+                }
+            }
+        }
+        size_t clusterCount = clusters.size();
+        clusters.push_back(triangleCount);
+
+        // sort key: how far the cluster faces outwards from the mesh centroid, so outer clusters draw first and occlude the rest
+        std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.f));
+        std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.f));
+        std::vector<float> areas(clusterCount, 0.f);
+        glm::vec3 meshCentroid(0.f);
+        float meshArea = 0.f;
+
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+            {
+                const glm::vec3& a = vertices[indices[t * 3 + 0]].pos;
+                const glm::vec3& b = vertices[indices[t * 3 + 1]].pos;
+                const glm::vec3& p = vertices[indices[t * 3 + 2]].pos;
+                glm::vec3 normal = glm::cross(b - a, p - a);
+                float area = glm::length(normal);
+
+                centroids[c] += (a + b + p) * (area / 3.f);
+                normals[c] += normal;
+                areas[c] += area;
+            }
+            meshCentroid += centroids[c];
+            meshArea += areas[c];
+        }
+        if (meshArea > 0.f)
+            meshCentroid /= meshArea;
+
+        std::vector<float> keys(clusterCount, 0.f);
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            float length = glm::length(normals[c]);
+            if (areas[c] > 0.f && length > 0.f)
+                keys[c] = glm::dot(centroids[c] / areas[c] - meshCentroid, normals[c] / length);
+        }
+
+        std::vector<uint32_t> order(clusterCount);
+        for (uint32_t c = 0; c < clusterCount; c++)
+            order[c] = c;
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t l, uint32_t r) { return keys[l] > keys[r]; });
+
+        size_t output = 0;
+        for (uint32_t c : order)
+            for (size_t i = clusters[c] * 3; i < clusters[c + 1] * 3; i++)
+                destination[output++] = indices[i];
+    }
+
+    size_t MeshOptimiser::optimiseVertexFetch(Vertex* destination, uint32_t* indices, size_t indexCount, const Vertex* vertices, size_t vertexCount)
+    {
+        std::vector<uint32_t> remap(vertexCount, INVALID);
+        uint32_t next = 0;
+
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            uint32_t& index = remap[indices[i]];
+            if (index == INVALID)
+            {
+                index = next++;
+                destination[index] = vertices[indices[i]];
+            }
+            indices[i] = index;
+        }
+
+        return next;
+    }
+
+    float MeshOptimiser::analyseVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+    {
+        size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0)
+            return 0.f;
+
+        FifoCache cache(vertexCount, cacheSize);
+        uint32_t misses = 0;
+        for (size_t t = 0; t < triangleCount; t++)
+            misses += cache.accessTriangle(&indices[t * 3]);
+
+        return static_cast<float>(misses) / static_cast<float>(triangleCount);
+    }
+
+    void MeshOptimiser::optimise(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        std::vector<uint32_t> cacheOrder(indices.size());
+        optimiseVertexCache(cacheOrder.data(), indices.data(), indices.size(), vertices.size());
+        optimiseOverdraw(indices.data(), cacheOrder.data(), indices.size(), vertices.data(), vertices.size());
+
+        std::vector<Vertex> fetchOrder(vertices.size());
+        fetchOrder.resize(optimiseVertexFetch(fetchOrder.data(), indices.data(), indices.size(), vertices.data(), vertices.size()));
+        vertices.swap(fetchOrder);
+    }
+}
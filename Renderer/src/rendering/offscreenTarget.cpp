@@ -0,0 +1,227 @@
+/** \file offscreenTarget.cpp */
+
+#include "rendering/offscreenTarget.hpp"
+#include "rendering/pngWriter.hpp"
+
+#include <cstring>
+
+OffscreenTarget::OffscreenTarget(Device* device, VkExtent2D extent) : m_device(device), m_extent(extent)
+{
+    m_depthFormat = m_device->findSupportedFormat({ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT },
+        VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    createAttachments();
+    createRenderPass();
+    createFramebuffer();
+    createReadback();
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+    vkDestroyFence(m_device->getDevice(), m_fence, nullptr);
+    vkFreeCommandBuffers(m_device->getDevice(), m_device->getCommandPool(), 1, &m_commandBuffer);
+    vkUnmapMemory(m_device->getDevice(), m_stagingBufferMemory);
+    vkDestroyBuffer(m_device->getDevice(), m_stagingBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_stagingBufferMemory, nullptr);
+    vkDestroyFramebuffer(m_device->getDevice(), m_framebuffer, nullptr);
+    vkDestroyRenderPass(m_device->getDevice(), m_renderPass, nullptr);
+    vkDestroyImageView(m_device->getDevice(), m_depthImageView, nullptr);
+    vkDestroyImage(m_device->getDevice(), m_depthImage, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_depthImageMemory, nullptr);
+    vkDestroyImageView(m_device->getDevice(), m_colourImageView, nullptr);
+    vkDestroyImage(m_device->getDevice(), m_colourImage, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_colourImageMemory, nullptr);
+    m_device = nullptr;
+}
+
+VkCommandBuffer OffscreenTarget::beginFrame(const VkClearColorValue& clearColour)
+{
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(m_commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin recording offscreen command buffer.");
+
+    VkClearValue clearValues[2]{};
+    clearValues[0].color = clearColour;
+    clearValues[1].depthStencil = { 1.f, 0 };
+
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = m_renderPass;
+    renderPassInfo.framebuffer = m_framebuffer;
+    renderPassInfo.renderArea.offset = { 0, 0 };
+    renderPassInfo.renderArea.extent = m_extent;
+    renderPassInfo.clearValueCount = 2;
+    renderPassInfo.pClearValues = clearValues;
+    vkCmdBeginRenderPass(m_commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+    VkViewport viewport{};
+    viewport.x = 0.f;
+    viewport.y = 0.f;
+    viewport.width = static_cast<float>(m_extent.width);
+    viewport.height = static_cast<float>(m_extent.height);
+    viewport.minDepth = 0.f;
+    viewport.maxDepth = 1.f;
+
+    VkRect2D scissor{};
+    scissor.offset = { 0, 0 };
+    scissor.extent = m_extent;
+
+    vkCmdSetViewport(m_commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(m_commandBuffer, 0, 1, &scissor);
+    return m_commandBuffer;
+}
+
+const std::vector<uint8_t>& OffscreenTarget::endFrame()
+{
+    vkCmdEndRenderPass(m_commandBuffer);
+
+    // the render pass leaves the colour attachment in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, and its external dependency orders the copy after the writes
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0; // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = { m_extent.width, m_extent.height, 1 };
+    vkCmdCopyImageToBuffer(m_commandBuffer, m_colourImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_stagingBuffer, 1, &region);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    if (vkEndCommandBuffer(m_commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to record offscreen command buffer.");
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_commandBuffer;
+
+    vkResetFences(m_device->getDevice(), 1, &m_fence);
+    if (vkQueueSubmit(m_device->getGraphicsQueue(), 1, &submitInfo, m_fence) != VK_SUCCESS)
+        throw std::runtime_error("Failed to submit offscreen command buffer.");
+    vkWaitForFences(m_device->getDevice(), 1, &m_fence, VK_TRUE, UINT64_MAX);
+
+    memcpy(m_pixels.data(), m_stagingMapped, m_pixels.size());
+    return m_pixels;
+}
+
+void OffscreenTarget::saveFrame(const std::string& path) const
+{
+    Rock::PngWriter::write(path, m_extent.width, m_extent.height, m_pixels);
+}
+
+void OffscreenTarget::createAttachments()
+{
+    m_device->createImage(m_extent.width, m_extent.height, 1, VK_SAMPLE_COUNT_1_BIT, COLOUR_FORMAT, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_colourImage, m_colourImageMemory);
+    m_colourImageView = m_device->createImageView(m_colourImage, COLOUR_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+    m_device->createImage(m_extent.width, m_extent.height, 1, VK_SAMPLE_COUNT_1_BIT, m_depthFormat, VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
+    m_depthImageView = m_device->createImageView(m_depthImage, m_depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+}
+
+void OffscreenTarget::createRenderPass()
+{
+    VkAttachmentDescription attachments[2]{};
+    attachments[0].format = COLOUR_FORMAT;
+    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    attachments[1].format = m_depthFormat;
+    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colourAttachmentRef{ 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkAttachmentReference depthAttachmentRef{ 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colourAttachmentRef;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    // frames are submitted one at a time, but the previous frame's copy must still finish before the attachments are cleared again
+    VkSubpassDependency dependencies[2]{};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 2;
+    renderPassInfo.pAttachments = attachments;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 2;
+    renderPassInfo.pDependencies = dependencies;
+
+    if (vkCreateRenderPass(m_device->getDevice(), &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create offscreen render pass.");
+}
+
+void OffscreenTarget::createFramebuffer()
+{
+    VkImageView attachments[] = { m_colourImageView, m_depthImageView };
+
+    VkFramebufferCreateInfo framebufferInfo{};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = m_renderPass;
+    framebufferInfo.attachmentCount = 2;
+    framebufferInfo.pAttachments = attachments;
+    framebufferInfo.width = m_extent.width;
+    framebufferInfo.height = m_extent.height;
+    framebufferInfo.layers = 1;
+
+    if (vkCreateFramebuffer(m_device->getDevice(), &framebufferInfo, nullptr, &m_framebuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create offscreen framebuffer.");
+}
+
+void OffscreenTarget::createReadback()
+{
+    m_pixels.resize(static_cast<size_t>(m_extent.width) * m_extent.height * 4);
+    m_device->createBuffer(m_pixels.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        m_stagingBuffer, m_stagingBufferMemory);
+    vkMapMemory(m_device->getDevice(), m_stagingBufferMemory, 0, m_pixels.size(), 0, &m_stagingMapped);
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_device->getCommandPool();
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(m_device->getDevice(), &allocInfo, &m_commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate offscreen command buffer.");
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(m_device->getDevice(), &fenceInfo, nullptr, &m_fence) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create offscreen fence.");
+}
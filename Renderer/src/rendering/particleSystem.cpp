@@ -0,0 +1,431 @@
+/** \file particleSystem.cpp */
+
+#include "rendering/particleSystem.hpp"
+#include "rendering/gpuLayout.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+static_assert(sizeof(ParticleSystem::GpuParticle) == 32, "GpuParticle must match the std430 Particle struct in the particle shaders");
+GPU_LAYOUT_MEMBER(Std430, ParticleSystem::GpuParticle, position, life);
+GPU_LAYOUT_MEMBER(Std430, ParticleSystem::GpuParticle, life, velocity);
+GPU_LAYOUT_MEMBER(Std430, ParticleSystem::GpuParticle, velocity, colour);
+
+static_assert(sizeof(ParticleSystem::ParticleUniforms) == 160, "ParticleUniforms must match the std140 ParticleUBO block in the particle shaders");
+GPU_LAYOUT_MEMBER(Std140, ParticleSystem::ParticleUniforms, viewProjection, emitter);
+GPU_LAYOUT_MEMBER(Std140, ParticleSystem::ParticleUniforms, emitter, gravity);
+GPU_LAYOUT_MEMBER(Std140, ParticleSystem::ParticleUniforms, gravity, colourMin);
+GPU_LAYOUT_MEMBER(Std140, ParticleSystem::ParticleUniforms, colourMin, colourMax);
+GPU_LAYOUT_MEMBER(Std140, ParticleSystem::ParticleUniforms, colourMax, lifetime);
+GPU_LAYOUT_MEMBER(Std140, ParticleSystem::ParticleUniforms, lifetime, speed);
+GPU_LAYOUT_MEMBER(Std140, ParticleSystem::ParticleUniforms, speed, maxParticles);
+GPU_LAYOUT_MEMBER(Std140, ParticleSystem::ParticleUniforms, maxParticles, emitCount);
+GPU_LAYOUT_MEMBER(Std140, ParticleSystem::ParticleUniforms, emitCount, seed);
+GPU_LAYOUT_MEMBER(Std140, ParticleSystem::ParticleUniforms, seed, pointSize);
+
+namespace
+{
+    const uint32_t NO_SUMS = UINT32_MAX; //!< tells scan.comp the level is the last and has no block totals to write
+    const uint32_t SORT_PADDING = 0x7F7FFFFF; //!< FLT_MAX; fills the unused alive entries so they sort after every particle
+}
+
+ParticleSystem::ParticleSystem(Device* device, const ParticleSettings& settings, uint32_t framesInFlight, VkRenderPass renderPass, VkSampleCountFlagBits samples, const std::string& shaderDirectory)
+    : m_device(device), m_settings(settings), m_framesInFlight(std::clamp<uint32_t>(framesInFlight, 1, Swapchain::MAX_FRAMES_IN_FLIGHT))
+{
+    if (m_settings.maxParticles == 0 || m_settings.maxParticles > MAX_PARTICLES)
+        throw std::runtime_error("Particle system capacity must be between 1 and MAX_PARTICLES.");
+
+    m_aliveCapacity = m_settings.maxParticles;
+    if (m_settings.sorted)
+    {
+        m_aliveCapacity = 1;
+        while (m_aliveCapacity < m_settings.maxParticles)
+            m_aliveCapacity <<= 1;
+    }
+    m_scanLevels = getScanLevels(m_settings.maxParticles);
+
+    createDescriptorSetLayouts();
+    createPipelines(shaderDirectory);
+
+    PipelineSettings pipelineSettings{};
+    Pipeline::defaultPipelineSettings(pipelineSettings);
+    pipelineSettings.bindingDescription = {}; // particles are fetched from the storage buffers
+    pipelineSettings.inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    pipelineSettings.multisampling.rasterizationSamples = samples;
+    Pipeline::enableAlphaBlending(pipelineSettings);
+    pipelineSettings.renderPass = renderPass;
+    pipelineSettings.subpass = 0;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_drawSetLayout;
+    m_graphicsPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "vert.spv", shaderDirectory + "frag.spv");
+
+    createBuffers();
+    createDescriptorSets();
+}
+
+ParticleSystem::~ParticleSystem()
+{
+    for (size_t i = 0; i < Swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyBuffer(m_device->getDevice(), m_particleBuffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_particleBuffersMemory[i], nullptr);
+        vkDestroyBuffer(m_device->getDevice(), m_aliveBuffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_aliveBuffersMemory[i], nullptr);
+        vkDestroyBuffer(m_device->getDevice(), m_drawBuffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_drawBuffersMemory[i], nullptr);
+        vkDestroyBuffer(m_device->getDevice(), m_uniformBuffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_uniformBuffersMemory[i], nullptr);
+    }
+    vkDestroyBuffer(m_device->getDevice(), m_deadBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_deadBufferMemory, nullptr);
+    vkDestroyBuffer(m_device->getDevice(), m_counterBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_counterBufferMemory, nullptr);
+    vkDestroyBuffer(m_device->getDevice(), m_scanBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_scanBufferMemory, nullptr);
+
+    vkDestroyDescriptorPool(m_device->getDevice(), m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device->getDevice(), m_computeSetLayout, nullptr);
+    vkDestroyDescriptorSetLayout(m_device->getDevice(), m_drawSetLayout, nullptr);
+
+    for (Pipeline** pipeline : { &m_simulatePipeline, &m_emitPipeline, &m_scanPipeline, &m_scanAddPipeline, &m_compactPipeline, &m_sortPipeline, &m_graphicsPipeline })
+    {
+        (*pipeline)->destroyPipelineLayout();
+        delete *pipeline;
+        *pipeline = nullptr;
+    }
+    m_device = nullptr;
+}
+
+std::vector<ParticleSystem::ScanLevel> ParticleSystem::getScanLevels(uint32_t count)
+{
+    // each level holds one total per workgroup of the level below, until a single workgroup scans the whole level
+    std::vector<ScanLevel> levels = { { 0, count } };
+    while (levels.back().count > WORKGROUP_SIZE)
+    {
+        const ScanLevel& previous = levels.back();
+        levels.push_back({ previous.offset + previous.count, getGroupCount(previous.count, WORKGROUP_SIZE) });
+    }
+    return levels;
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> ParticleSystem::getSortPasses(uint32_t count)
+{
+    std::vector<std::pair<uint32_t, uint32_t>> passes;
+    for (uint32_t k = 2; k <= count; k <<= 1)
+        for (uint32_t j = k >> 1; j > 0; j >>= 1)
+            passes.push_back({ k, j });
+    return passes;
+}
+
+void ParticleSystem::recordUpdate(VkCommandBuffer commandBuffer, uint32_t frame, float deltaTime)
+{
+    m_emitAccumulator += m_settings.emissionRate * deltaTime;
+    float emitted = std::floor(m_emitAccumulator);
+    m_emitAccumulator -= emitted;
+    uint32_t emitCount = static_cast<uint32_t>(std::min(emitted, static_cast<float>(m_settings.maxParticles)));
+
+    ParticleUniforms uniforms{};
+    uniforms.viewProjection = m_viewProjection;
+    uniforms.emitter = glm::vec4(m_settings.emitterPosition, m_settings.emitterRadius);
+    uniforms.gravity = glm::vec4(m_settings.gravity, deltaTime);
+    uniforms.colourMin = m_settings.colourMin;
+    uniforms.colourMax = m_settings.colourMax;
+    uniforms.lifetime = m_settings.lifetime;
+    uniforms.speed = m_settings.speed;
+    uniforms.maxParticles = m_settings.maxParticles;
+    uniforms.emitCount = emitCount;
+    uniforms.seed = m_seed++;
+    uniforms.pointSize = m_settings.pointSize;
+    memcpy(m_uniformBuffersMapped[frame], &uniforms, sizeof(uniforms));
+
+    // the previous update read and wrote the dead list, counter and scan buffer on this queue; the particle buffers written here were last read by a frame the caller has waited for
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    // a reset simulates from dead particles with an empty dead list; compact then fills the list, so emission resumes on the next update
+    uint32_t reset[4] = { m_resetPending ? 1u : 0u, 0, 0, 0 };
+    if (m_resetPending)
+        vkCmdFillBuffer(commandBuffer, m_counterBuffer, 0, VK_WHOLE_SIZE, 0);
+    if (m_settings.sorted)
+        vkCmdFillBuffer(commandBuffer, m_aliveBuffers[frame], 0, VK_WHOLE_SIZE, SORT_PADDING);
+    if (m_resetPending || m_settings.sorted)
+        computeBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    m_resetPending = false;
+
+    uint32_t particleGroups = getGroupCount(m_settings.maxParticles, WORKGROUP_SIZE);
+    dispatch(commandBuffer, m_simulatePipeline, frame, particleGroups, reset);
+    computeBarrier(commandBuffer);
+
+    if (emitCount > 0)
+    {
+        dispatch(commandBuffer, m_emitPipeline, frame, getGroupCount(emitCount, EMIT_WORKGROUP_SIZE));
+        computeBarrier(commandBuffer);
+    }
+
+    // exclusive prefix sum of the alive flags: scan each level in blocks, then add the scanned block totals back down
+    for (size_t level = 0; level < m_scanLevels.size(); level++)
+    {
+        uint32_t sums = level + 1 < m_scanLevels.size() ? m_scanLevels[level + 1].offset : NO_SUMS;
+        uint32_t pushConstants[4] = { m_scanLevels[level].offset, sums, m_scanLevels[level].count, 0 };
+        dispatch(commandBuffer, m_scanPipeline, frame, getGroupCount(m_scanLevels[level].count, WORKGROUP_SIZE), pushConstants);
+        computeBarrier(commandBuffer);
+    }
+    for (size_t level = m_scanLevels.size() - 1; level-- > 0;)
+    {
+        uint32_t pushConstants[4] = { m_scanLevels[level].offset, m_scanLevels[level + 1].offset, m_scanLevels[level].count, 0 };
+        dispatch(commandBuffer, m_scanAddPipeline, frame, getGroupCount(m_scanLevels[level].count, WORKGROUP_SIZE), pushConstants);
+        computeBarrier(commandBuffer);
+    }
+
+    dispatch(commandBuffer, m_compactPipeline, frame, particleGroups);
+
+    if (m_settings.sorted)
+    {
+        for (auto& pass : getSortPasses(m_aliveCapacity))
+        {
+            computeBarrier(commandBuffer);
+            uint32_t pushConstants[4] = { pass.first, pass.second, m_aliveCapacity, 0 };
+            dispatch(commandBuffer, m_sortPipeline, frame, getGroupCount(m_aliveCapacity, WORKGROUP_SIZE), pushConstants);
+        }
+    }
+}
+
+std::vector<ParticleSystem::GpuParticle> ParticleSystem::readParticles(uint32_t frame) const
+{
+    std::vector<GpuParticle> particles(m_settings.maxParticles);
+    readBuffer(m_particleBuffers[frame], sizeof(GpuParticle) * particles.size(), particles.data());
+    return particles;
+}
+
+std::vector<glm::uvec2> ParticleSystem::readAliveList(uint32_t frame) const
+{
+    std::vector<glm::uvec2> alive(m_aliveCapacity);
+    readBuffer(m_aliveBuffers[frame], sizeof(glm::uvec2) * alive.size(), alive.data());
+    return alive;
+}
+
+VkDrawIndirectCommand ParticleSystem::readDrawCommand(uint32_t frame) const
+{
+    VkDrawIndirectCommand command{};
+    readBuffer(m_drawBuffers[frame], sizeof(command), &command);
+    return command;
+}
+
+void ParticleSystem::readBuffer(VkBuffer buffer, VkDeviceSize size, void* data) const
+{
+    vkDeviceWaitIdle(m_device->getDevice());
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    m_device->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+    m_device->copyBuffer(buffer, stagingBuffer, size);
+
+    void* mapped;
+    vkMapMemory(m_device->getDevice(), stagingBufferMemory, 0, size, 0, &mapped);
+    memcpy(data, mapped, static_cast<size_t>(size));
+    vkUnmapMemory(m_device->getDevice(), stagingBufferMemory);
+
+    vkDestroyBuffer(m_device->getDevice(), stagingBuffer, nullptr);
+    vkFreeMemory(m_device->getDevice(), stagingBufferMemory, nullptr);
+}
+
+void ParticleSystem::recordDraw(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline->getPipelineLayout(), 0, 1, &m_drawSets[frame], 0, nullptr);
+    vkCmdDrawIndirect(commandBuffer, m_drawBuffers[frame], 0, 1, sizeof(VkDrawIndirectCommand));
+}
+
+void ParticleSystem::dispatch(VkCommandBuffer commandBuffer, Pipeline* pipeline, uint32_t frame, uint32_t groups, const uint32_t* pushConstants)
+{
+    pipeline->bindCompute(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 0, 1, &m_computeSets[frame], 0, nullptr);
+    if (pushConstants)
+        vkCmdPushConstants(commandBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, 4 * sizeof(uint32_t), pushConstants);
+    vkCmdDispatch(commandBuffer, groups, 1, 1);
+}
+
+void ParticleSystem::computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, srcStage, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ParticleSystem::createDescriptorSetLayouts()
+{
+    // 0 uniforms, 1 previous particles, 2 particles, 3 dead list, 4 scan, 5 alive list, 6 draw command, 7 dead count
+    VkDescriptorSetLayoutBinding computeBindings[8]{};
+    for (uint32_t binding = 0; binding < 8; binding++)
+        computeBindings[binding] = { binding, binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+
+    // 0 uniforms, 1 particles, 2 alive list
+    VkDescriptorSetLayoutBinding drawBindings[3]{};
+    drawBindings[0] = { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr };
+    drawBindings[1] = { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr };
+    drawBindings[2] = { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr };
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 8;
+    layoutInfo.pBindings = computeBindings;
+    if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &m_computeSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create particle compute descriptor set layout.");
+
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = drawBindings;
+    if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &m_drawSetLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create particle draw descriptor set layout.");
+}
+
+void ParticleSystem::createPipelines(const std::string& shaderDirectory)
+{
+    // the scan and sort stages take their ranges as push constants; the other stages share the layout and ignore them
+    VkPushConstantRange psRange;
+    psRange.offset = 0;
+    psRange.size = 4 * sizeof(uint32_t);
+    psRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_computeSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &psRange;
+
+    PipelineSettings pipelineSettings{};
+    m_simulatePipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "simulate.spv");
+    m_emitPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "emit.spv");
+    m_scanPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "scan.spv");
+    m_scanAddPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "scanAdd.spv");
+    m_compactPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "compact.spv");
+    m_sortPipeline = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "sort.spv");
+}
+
+void ParticleSystem::createBuffers()
+{
+    // buffers the draw reads are concurrent across the graphics and compute families, so the update can run on an async compute queue
+    VkDeviceSize particleSize = sizeof(GpuParticle) * m_settings.maxParticles;
+    VkDeviceSize aliveSize = 2 * sizeof(uint32_t) * m_aliveCapacity;
+
+    // every frame the renderer can cycle through has its buffers, so the frames in flight can change without recreating them
+    const uint32_t frames = Swapchain::MAX_FRAMES_IN_FLIGHT;
+    m_particleBuffers.resize(frames);
+    m_particleBuffersMemory.resize(frames);
+    m_aliveBuffers.resize(frames);
+    m_aliveBuffersMemory.resize(frames);
+    m_drawBuffers.resize(frames);
+    m_drawBuffersMemory.resize(frames);
+    m_uniformBuffers.resize(frames);
+    m_uniformBuffersMemory.resize(frames);
+    m_uniformBuffersMapped.resize(frames);
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        m_device->createBuffer(particleSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_particleBuffers[i], m_particleBuffersMemory[i], true);
+        m_device->createBuffer(aliveSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_aliveBuffers[i], m_aliveBuffersMemory[i], true);
+        m_device->createBuffer(sizeof(VkDrawIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_drawBuffers[i], m_drawBuffersMemory[i], true);
+        m_device->createBuffer(sizeof(ParticleUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_uniformBuffers[i], m_uniformBuffersMemory[i], true);
+        vkMapMemory(m_device->getDevice(), m_uniformBuffersMemory[i], 0, sizeof(ParticleUniforms), 0, &m_uniformBuffersMapped[i]);
+    }
+
+    const ScanLevel& top = m_scanLevels.back();
+    m_device->createBuffer(sizeof(uint32_t) * m_settings.maxParticles, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_deadBuffer, m_deadBufferMemory);
+    m_device->createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_counterBuffer, m_counterBufferMemory);
+    m_device->createBuffer(sizeof(uint32_t) * (top.offset + top.count), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_scanBuffer, m_scanBufferMemory);
+}
+
+void ParticleSystem::createDescriptorSets()
+{
+    const uint32_t frames = Swapchain::MAX_FRAMES_IN_FLIGHT;
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frames * 2 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frames * 9 }
+    };
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    poolInfo.maxSets = frames * 2;
+    if (vkCreateDescriptorPool(m_device->getDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create particle descriptor pool.");
+
+    std::vector<VkDescriptorSetLayout> layouts(frames, m_computeSetLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = frames;
+    allocInfo.pSetLayouts = layouts.data();
+    m_computeSets.resize(frames);
+    if (vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, m_computeSets.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate particle compute descriptor sets.");
+
+    layouts.assign(frames, m_drawSetLayout);
+    m_drawSets.resize(frames);
+    if (vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, m_drawSets.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate particle draw descriptor sets.");
+
+    VkDescriptorBufferInfo deadInfo{ m_deadBuffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo scanInfo{ m_scanBuffer, 0, VK_WHOLE_SIZE };
+    VkDescriptorBufferInfo counterInfo{ m_counterBuffer, 0, VK_WHOLE_SIZE };
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        // the previous particles are written by writePreviousParticles once the ring length is known
+        VkDescriptorBufferInfo uniformInfo{ m_uniformBuffers[i], 0, sizeof(ParticleUniforms) };
+        VkDescriptorBufferInfo previousInfo{ m_particleBuffers[i], 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo particleInfo{ m_particleBuffers[i], 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo aliveInfo{ m_aliveBuffers[i], 0, VK_WHOLE_SIZE };
+        VkDescriptorBufferInfo drawInfo{ m_drawBuffers[i], 0, VK_WHOLE_SIZE };
+
+        VkDescriptorBufferInfo* computeInfos[8] = { &uniformInfo, &previousInfo, &particleInfo, &deadInfo, &scanInfo, &aliveInfo, &drawInfo, &counterInfo };
+        VkDescriptorBufferInfo* drawInfos[3] = { &uniformInfo, &particleInfo, &aliveInfo };
+
+        VkWriteDescriptorSet writes[11]{};
+        for (uint32_t binding = 0; binding < 11; binding++)
+        {
+            bool compute = binding < 8;
+            writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[binding].dstSet = compute ? m_computeSets[i] : m_drawSets[i];
+            writes[binding].dstBinding = compute ? binding : binding - 8;
+            writes[binding].descriptorCount = 1;
+            writes[binding].descriptorType = writes[binding].dstBinding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[binding].pBufferInfo = compute ? computeInfos[binding] : drawInfos[binding - 8];
+        }
+        vkUpdateDescriptorSets(m_device->getDevice(), 11, writes, 0, nullptr);
+    }
+    writePreviousParticles();
+}
+
+void ParticleSystem::writePreviousParticles()
+{
+    for (size_t i = 0; i < m_framesInFlight; i++)
+    {
+        // each frame simulates from the particles of the frame before it in the ring
+        VkDescriptorBufferInfo previousInfo{ m_particleBuffers[(i + m_framesInFlight - 1) % m_framesInFlight], 0, VK_WHOLE_SIZE };
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = m_computeSets[i];
+        write.dstBinding = 1;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &previousInfo;
+        vkUpdateDescriptorSets(m_device->getDevice(), 1, &write, 0, nullptr);
+    }
+}
+
+void ParticleSystem::setFramesInFlight(uint32_t framesInFlight)
+{
+    m_framesInFlight = std::clamp<uint32_t>(framesInFlight, 1, Swapchain::MAX_FRAMES_IN_FLIGHT);
+    writePreviousParticles();
+    // the dead list matches the last frame written, which the new ring need not simulate from next
+    reset();
+}
@@ -1,149 +1,42 @@
 /** \file pipeline.cpp */
 
 #include "rendering/pipeline.hpp"
+#include "rendering/pipelineCache.hpp"
+
+#include <algorithm>
 
 Pipeline::Pipeline(Device* device, const VkPipelineLayoutCreateInfo ci, const PipelineSettings& settings, const std::string& vertFilepath, const std::string& fragFilepath)
-	: m_device(device)
+	: m_device(device), m_shaderFilepaths(fragFilepath.empty() ? std::vector<std::string>{ vertFilepath } : std::vector<std::string>{ vertFilepath, fragFilepath })
 {
-    if (vkCreatePipelineLayout(m_device->getDevice(), &ci, nullptr, &m_pipelineLayout) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create pipeline layout.");
-
-	createGraphicsPipeline(settings, vertFilepath, fragFilepath);
+    m_pipelineLayout = m_device->getPipelineCache()->acquirePipelineLayout(ci);
+    m_pipeline = m_device->getPipelineCache()->acquireGraphicsPipeline(settings, m_pipelineLayout, vertFilepath, fragFilepath);
 }
 
 Pipeline::Pipeline(Device* device, const VkPipelineLayoutCreateInfo ci, const PipelineSettings& settings, const std::string& compFilepath)
-	: m_device(device)
-{
-    if (vkCreatePipelineLayout(m_device->getDevice(), &ci, nullptr, &m_pipelineLayout) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create pipeline layout.");
-
-	createComputePipeline(settings, compFilepath);
-}
-
-Pipeline::~Pipeline()
+	: m_device(device), m_shaderFilepaths({ compFilepath })
 {
-    vkDestroyPipeline(m_device->getDevice(), m_pipeline, nullptr);
-	m_device = nullptr;
+    m_pipelineLayout = m_device->getPipelineCache()->acquirePipelineLayout(ci);
+    m_pipeline = m_device->getPipelineCache()->acquireComputePipeline(m_pipelineLayout, compFilepath);
 }
 
-void Pipeline::createGraphicsPipeline(const PipelineSettings& settings, const std::string& vertFilepath, const std::string& fragFilepath)
+Pipeline::Pipeline(Device* device, const PipelineSettings& settings, const std::string& vertFilepath, const std::string& fragFilepath, const LayoutOverrides& overrides)
+	: m_device(device), m_shaderFilepaths(fragFilepath.empty() ? std::vector<std::string>{ vertFilepath } : std::vector<std::string>{ vertFilepath, fragFilepath })
 {
-    std::vector<char> vertShaderCode = readFile(vertFilepath);
-    std::vector<char> fragShaderCode = readFile(fragFilepath);
-
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-    vertShaderCode = std::vector<char>();
-    fragShaderCode = std::vector<char>();
-
-    VkPipelineShaderStageCreateInfo shaderStages[2];
-    // vert shader stage info
-    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStages[0].module = vertShaderModule;
-    shaderStages[0].pName = "main"; // function to invoke; i.e. entrypoint
-    shaderStages[0].flags = 0; // optional
-    shaderStages[0].pNext = nullptr; // optional
-    shaderStages[0].pSpecializationInfo = nullptr; // optional
-    // frag shader stage info
-    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStages[1].module = fragShaderModule;
-    shaderStages[1].pName = "main"; // function to invoke; i.e. entrypoint
-    shaderStages[1].flags = 0; // optional
-    shaderStages[1].pNext = nullptr; // optional
-    shaderStages[1].pSpecializationInfo = nullptr; // optional
-
-    auto& bindingDescription = settings.bindingDescription;
-    auto& attributeDescriptions = settings.attributeDescriptions;
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &settings.inputAssembly;
-    pipelineInfo.pViewportState = &settings.viewportState;
-    pipelineInfo.pRasterizationState = &settings.rasteriser;
-    pipelineInfo.pMultisampleState = &settings.multisampling;
-    pipelineInfo.pDepthStencilState = &settings.depthStencil;
-    pipelineInfo.pColorBlendState = &settings.colourBlending;
-    pipelineInfo.pDynamicState = &settings.dynamicState;
-    pipelineInfo.layout = m_pipelineLayout;
-    pipelineInfo.renderPass = settings.renderPass;
-    pipelineInfo.subpass = settings.subpass;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-    pipelineInfo.basePipelineIndex = -1; // optional
-
-    if (vkCreateGraphicsPipelines(m_device->getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create graphics pipeline.");
-
-    vkDestroyShaderModule(m_device->getDevice(), vertShaderModule, nullptr);
-    vkDestroyShaderModule(m_device->getDevice(), fragShaderModule, nullptr);
-}
-
-void Pipeline::createComputePipeline(const PipelineSettings& settings, const std::string& compFilepath)
-{
-    std::vector<char> compShaderCode = readFile(compFilepath);
-
-    VkShaderModule compShaderModule = createShaderModule(compShaderCode);
-    compShaderCode = std::vector<char>();
-
-    VkPipelineShaderStageCreateInfo compShaderStageInfo{};
-    compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    compShaderStageInfo.module = compShaderModule;
-    compShaderStageInfo.pName = "main";
-    compShaderStageInfo.flags = 0; // optional
-    compShaderStageInfo.pNext = nullptr; // optional
-    compShaderStageInfo.pSpecializationInfo = nullptr; // optional
-
-    VkComputePipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    pipelineInfo.layout = m_pipelineLayout;
-    pipelineInfo.stage = compShaderStageInfo;
-
-    if (vkCreateComputePipelines(m_device->getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_pipeline) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create compute pipeline.");
-
-    vkDestroyShaderModule(m_device->getDevice(), compShaderModule, nullptr);
+    createReflectedLayout(overrides);
+    m_pipeline = m_device->getPipelineCache()->acquireGraphicsPipeline(settings, m_pipelineLayout, vertFilepath, fragFilepath);
 }
 
-VkShaderModule Pipeline::createShaderModule(const std::vector<char>& code)
+Pipeline::Pipeline(Device* device, const std::string& compFilepath, const LayoutOverrides& overrides)
+	: m_device(device), m_shaderFilepaths({ compFilepath })
 {
-    VkShaderModuleCreateInfo ci{};
-    ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    ci.codeSize = code.size();
-    ci.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-    VkShaderModule shaderModule;
-    if (vkCreateShaderModule(m_device->getDevice(), &ci, nullptr, &shaderModule) != VK_SUCCESS)
-        throw std::runtime_error("Failed to create shader module.");
-
-    return shaderModule;
+    createReflectedLayout(overrides);
+    m_pipeline = m_device->getPipelineCache()->acquireComputePipeline(m_pipelineLayout, compFilepath);
 }
 
-std::vector<char> Pipeline::readFile(const std::string& filename)
+Pipeline::~Pipeline()
 {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-
-    if (!file.is_open())
-        throw std::runtime_error("Failed to open file.");
-
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(fileSize);
-
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
-
-    return buffer;
+    m_device->getPipelineCache()->releasePipeline(m_pipeline);
+	m_device = nullptr;
 }
 
 void Pipeline::bindGraphics(VkCommandBuffer commandBuffer)
@@ -230,7 +123,58 @@ void Pipeline::enableAlphaBlending(PipelineSettings& settings)
     settings.colourBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
 }
 
+void Pipeline::enableDepthOnly(PipelineSettings& settings)
+{
+    settings.colourBlending.attachmentCount = 0;
+    settings.colourBlending.pAttachments = nullptr;
+
+    settings.depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    settings.depthStencil.depthTestEnable = VK_TRUE;
+    settings.depthStencil.depthWriteEnable = VK_TRUE;
+    settings.depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    settings.depthStencil.depthBoundsTestEnable = VK_FALSE;
+    settings.depthStencil.minDepthBounds = 0.f; // optional
+    settings.depthStencil.maxDepthBounds = 1.f; // optional
+    settings.depthStencil.stencilTestEnable = VK_FALSE;
+    settings.depthStencil.front = {}; // optional
+    settings.depthStencil.back = {}; // optional
+}
+
+void Pipeline::createReflectedLayout(const LayoutOverrides& overrides)
+{
+    PipelineCache* cache = m_device->getPipelineCache();
+    ReflectedLayout reflected = cache->reflectLayout(m_shaderFilepaths, overrides.dynamicSets);
+
+    std::vector<VkDescriptorSetLayout> setLayouts(std::max(reflected.sets.size(), overrides.setLayouts.size()), VK_NULL_HANDLE);
+    for (size_t set = 0; set < setLayouts.size(); set++)
+    {
+        if (set < overrides.setLayouts.size() && overrides.setLayouts[set] != VK_NULL_HANDLE)
+        {
+            setLayouts[set] = overrides.setLayouts[set];
+            continue;
+        }
+        // sets skipped by every stage get an empty layout, as a pipeline layout cannot contain null handles
+        std::vector<VkDescriptorSetLayoutBinding> bindings = set < reflected.sets.size() ? reflected.sets[set] : std::vector<VkDescriptorSetLayoutBinding>();
+        for (auto& binding : bindings)
+        {
+            if (binding.descriptorCount == 0)
+                throw std::runtime_error("Runtime sized descriptor arrays need their set layout passed in LayoutOverrides.");
+        }
+        setLayouts[set] = cache->getDescriptorSetLayout(bindings);
+    }
+
+    VkPipelineLayoutCreateInfo ci{};
+    ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    ci.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    ci.pSetLayouts = setLayouts.data();
+    ci.pushConstantRangeCount = reflected.pushConstants.size > 0 ? 1 : 0;
+    ci.pPushConstantRanges = &reflected.pushConstants;
+    m_pipelineLayout = cache->acquirePipelineLayout(ci);
+}
+
 void Pipeline::destroyPipelineLayout()
 {
-    vkDestroyPipelineLayout(m_device->getDevice(), m_pipelineLayout, nullptr);
+    if (m_pipelineLayout == VK_NULL_HANDLE) return;
+    m_device->getPipelineCache()->releasePipelineLayout(m_pipelineLayout);
+    m_pipelineLayout = VK_NULL_HANDLE;
 }
@@ -0,0 +1,464 @@
+/** \file pipelineCache.cpp */
+
+#include "rendering/pipelineCache.hpp"
+
+#include <cstring>
+#include <functional>
+
+namespace
+{
+    void appendFloat(std::vector<uint64_t>& words, float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        words.push_back(bits);
+    }
+
+    template<typename Handle>
+    void appendHandle(std::vector<uint64_t>& words, Handle handle)
+    {
+        uint64_t bits = 0;
+        memcpy(&bits, &handle, sizeof(handle));
+        words.push_back(bits);
+    }
+
+    void appendStencil(std::vector<uint64_t>& words, const VkStencilOpState& state)
+    {
+        words.insert(words.end(), { static_cast<uint64_t>(state.failOp), static_cast<uint64_t>(state.passOp), static_cast<uint64_t>(state.depthFailOp),
+            static_cast<uint64_t>(state.compareOp), state.compareMask, state.writeMask, state.reference });
+    }
+
+    uint32_t readWord(const std::vector<char>& data, size_t offset)
+    {
+        uint32_t word;
+        memcpy(&word, data.data() + offset, sizeof(word));
+        return word;
+    }
+}
+
+const char* PipelineCache::DEFAULT_FILEPATH = "./pipelineCache.bin";
+
+size_t PipelineCache::Key::hash() const
+{
+    size_t seed = words.size();
+    for (uint64_t word : words)
+        seed ^= std::hash<uint64_t>()(word) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    return seed;
+}
+
+PipelineCache::PipelineCache(Device* device, const std::string& filepath) : m_device(device), m_filepath(filepath)
+{
+    m_setLayouts = new DescriptorLayoutCache(device);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_device->getPhysicalDevice(), &properties);
+
+    std::vector<char> data;
+    try
+    {
+        data = readFile(m_filepath);
+    }
+    catch (const std::runtime_error&)
+    {
+        // no blob on the first run; the cache starts empty
+    }
+    m_loaded = isCompatible(data, properties); // a blob from a different driver or device is a cache miss, not an error; isWarm reports it
+
+    VkPipelineCacheCreateInfo ci{};
+    ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    ci.initialDataSize = m_loaded ? data.size() : 0;
+    ci.pInitialData = m_loaded ? data.data() : nullptr;
+
+    if (vkCreatePipelineCache(m_device->getDevice(), &ci, nullptr, &m_pipelineCache) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create pipeline cache.");
+}
+
+PipelineCache::~PipelineCache()
+{
+    save(); // failing to persist the blob only costs the next run a cold start
+    for (auto& pipeline : m_pipelines)
+        vkDestroyPipeline(m_device->getDevice(), pipeline.second.handle, nullptr);
+    for (auto& layout : m_layouts)
+        vkDestroyPipelineLayout(m_device->getDevice(), layout.second.handle, nullptr);
+    for (auto& shaderModule : m_shaderModules)
+        vkDestroyShaderModule(m_device->getDevice(), shaderModule.second, nullptr);
+    for (VkShaderModule shaderModule : m_retiredModules)
+        vkDestroyShaderModule(m_device->getDevice(), shaderModule, nullptr);
+    delete m_setLayouts;
+    m_setLayouts = nullptr;
+    vkDestroyPipelineCache(m_device->getDevice(), m_pipelineCache, nullptr);
+    m_device = nullptr;
+}
+
+bool PipelineCache::isCompatible(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties)
+{
+    // VkPipelineCacheHeaderVersionOne: header size, header version, vendor ID, device ID and the pipeline cache UUID
+    const size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+    if (data.size() < headerSize)
+        return false;
+    if (readWord(data, 0) < headerSize || readWord(data, 4) != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+        return false;
+    if (readWord(data, 8) != properties.vendorID || readWord(data, 12) != properties.deviceID)
+        return false;
+    return memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+PipelineCache::Key PipelineCache::getLayoutKey(const VkPipelineLayoutCreateInfo& ci)
+{
+    Key key;
+    key.words.push_back(ci.setLayoutCount);
+    for (uint32_t i = 0; i < ci.setLayoutCount; i++)
+        appendHandle(key.words, ci.pSetLayouts[i]);
+    key.words.push_back(ci.pushConstantRangeCount);
+    for (uint32_t i = 0; i < ci.pushConstantRangeCount; i++)
+        key.words.insert(key.words.end(), { ci.pPushConstantRanges[i].stageFlags, ci.pPushConstantRanges[i].offset, ci.pPushConstantRanges[i].size });
+    return key;
+}
+
+PipelineCache::Key PipelineCache::getGraphicsKey(const PipelineSettings& settings, VkPipelineLayout layout, VkShaderModule vertModule, VkShaderModule fragModule)
+{
+    Key key;
+    std::vector<uint64_t>& words = key.words;
+    appendHandle(words, layout);
+    appendHandle(words, vertModule);
+    appendHandle(words, fragModule);
+    appendHandle(words, settings.renderPass);
+    words.push_back(settings.subpass);
+
+    words.insert(words.end(), { settings.bindingDescription.binding, settings.bindingDescription.stride, static_cast<uint64_t>(settings.bindingDescription.inputRate) });
+    words.push_back(settings.attributeDescriptions.size());
+    for (auto& attribute : settings.attributeDescriptions)
+        words.insert(words.end(), { attribute.location, attribute.binding, static_cast<uint64_t>(attribute.format), attribute.offset });
+
+    words.insert(words.end(), { static_cast<uint64_t>(settings.inputAssembly.topology), settings.inputAssembly.primitiveRestartEnable });
+    words.insert(words.end(), { settings.viewportState.viewportCount, settings.viewportState.scissorCount });
+
+    const VkPipelineRasterizationStateCreateInfo& rasteriser = settings.rasteriser;
+    words.insert(words.end(), { rasteriser.depthClampEnable, rasteriser.rasterizerDiscardEnable, static_cast<uint64_t>(rasteriser.polygonMode),
+        rasteriser.cullMode, static_cast<uint64_t>(rasteriser.frontFace), rasteriser.depthBiasEnable });
+    appendFloat(words, rasteriser.depthBiasConstantFactor);
+    appendFloat(words, rasteriser.depthBiasClamp);
+    appendFloat(words, rasteriser.depthBiasSlopeFactor);
+    appendFloat(words, rasteriser.lineWidth);
+
+    const VkPipelineMultisampleStateCreateInfo& multisampling = settings.multisampling;
+    words.insert(words.end(), { static_cast<uint64_t>(multisampling.rasterizationSamples), multisampling.sampleShadingEnable,
+        multisampling.alphaToCoverageEnable, multisampling.alphaToOneEnable });
+    appendFloat(words, multisampling.minSampleShading);
+    words.push_back(multisampling.pSampleMask != nullptr ? *multisampling.pSampleMask : UINT64_MAX);
+
+    const VkPipelineDepthStencilStateCreateInfo& depthStencil = settings.depthStencil;
+    words.insert(words.end(), { depthStencil.depthTestEnable, depthStencil.depthWriteEnable, static_cast<uint64_t>(depthStencil.depthCompareOp),
+        depthStencil.depthBoundsTestEnable, depthStencil.stencilTestEnable });
+    appendStencil(words, depthStencil.front);
+    appendStencil(words, depthStencil.back);
+    appendFloat(words, depthStencil.minDepthBounds);
+    appendFloat(words, depthStencil.maxDepthBounds);
+
+    const VkPipelineColorBlendStateCreateInfo& colourBlending = settings.colourBlending;
+    words.insert(words.end(), { colourBlending.logicOpEnable, static_cast<uint64_t>(colourBlending.logicOp), colourBlending.attachmentCount });
+    for (uint32_t i = 0; i < colourBlending.attachmentCount; i++)
+    {
+        const VkPipelineColorBlendAttachmentState& attachment = colourBlending.pAttachments[i];
+        words.insert(words.end(), { attachment.blendEnable, static_cast<uint64_t>(attachment.srcColorBlendFactor), static_cast<uint64_t>(attachment.dstColorBlendFactor),
+            static_cast<uint64_t>(attachment.colorBlendOp), static_cast<uint64_t>(attachment.srcAlphaBlendFactor), static_cast<uint64_t>(attachment.dstAlphaBlendFactor),
+            static_cast<uint64_t>(attachment.alphaBlendOp), attachment.colorWriteMask });
+    }
+    for (float constant : colourBlending.blendConstants)
+        appendFloat(words, constant);
+
+    words.push_back(settings.dynamicState.dynamicStateCount);
+    for (uint32_t i = 0; i < settings.dynamicState.dynamicStateCount; i++)
+        words.push_back(static_cast<uint64_t>(settings.dynamicState.pDynamicStates[i]));
+    return key;
+}
+
+PipelineCache::Key PipelineCache::getComputeKey(VkPipelineLayout layout, VkShaderModule compModule)
+{
+    Key key;
+    appendHandle(key.words, layout);
+    appendHandle(key.words, compModule);
+    return key;
+}
+
+VkShaderModule PipelineCache::getShaderModule(const std::string& filepath)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_shaderModules.find(filepath);
+        if (it != m_shaderModules.end())
+            return it->second;
+    }
+
+    std::vector<char> code = readFile(filepath);
+    VkShaderModuleCreateInfo ci{};
+    ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    ci.codeSize = code.size();
+    ci.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(m_device->getDevice(), &ci, nullptr, &shaderModule) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shader module.");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto inserted = m_shaderModules.emplace(filepath, shaderModule);
+    if (!inserted.second)
+        vkDestroyShaderModule(m_device->getDevice(), shaderModule, nullptr); // another thread loaded the file first
+    return inserted.first->second;
+}
+
+void PipelineCache::invalidateShaderModule(const std::string& filepath)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_reflections.erase(filepath);
+    auto it = m_shaderModules.find(filepath);
+    if (it == m_shaderModules.end())
+        return;
+    m_retiredModules.push_back(it->second);
+    m_shaderModules.erase(it);
+}
+
+std::shared_ptr<const ShaderReflection> PipelineCache::getReflection(const std::string& filepath)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_reflections.find(filepath);
+        if (it != m_reflections.end())
+            return it->second;
+    }
+
+    auto reflection = std::make_shared<const ShaderReflection>(readFile(filepath));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_reflections.emplace(filepath, reflection).first->second;
+}
+
+ReflectedLayout PipelineCache::reflectLayout(const std::vector<std::string>& filepaths, uint32_t dynamicSets)
+{
+    std::vector<std::shared_ptr<const ShaderReflection>> reflections;
+    std::vector<const ShaderReflection*> stages;
+    for (const std::string& filepath : filepaths)
+    {
+        reflections.push_back(getReflection(filepath));
+        stages.push_back(reflections.back().get());
+    }
+    return ShaderReflection::merge(stages, dynamicSets);
+}
+
+VkDescriptorSetLayout PipelineCache::getDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_setLayouts->createDescriptorSetLayout(bindings);
+}
+
+VkPipelineLayout PipelineCache::acquirePipelineLayout(const VkPipelineLayoutCreateInfo& ci)
+{
+    Key key = getLayoutKey(ci);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_layouts.find(key);
+    if (it != m_layouts.end())
+    {
+        it->second.references++;
+        return it->second.handle;
+    }
+
+    VkPipelineLayout layout;
+    if (vkCreatePipelineLayout(m_device->getDevice(), &ci, nullptr, &layout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create pipeline layout.");
+    m_layouts.emplace(std::move(key), LayoutEntry{ layout, 1 });
+    return layout;
+}
+
+VkPipeline PipelineCache::acquireGraphicsPipeline(const PipelineSettings& settings, VkPipelineLayout layout, const std::string& vertFilepath, const std::string& fragFilepath)
+{
+    VkShaderModule vertShaderModule = getShaderModule(vertFilepath);
+    VkShaderModule fragShaderModule = fragFilepath.empty() ? VK_NULL_HANDLE : getShaderModule(fragFilepath); // depth only pipelines have no fragment stage
+    Key key = getGraphicsKey(settings, layout, vertShaderModule, fragShaderModule);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_pipelines.find(key);
+        if (it != m_pipelines.end())
+        {
+            it->second.references++;
+            return it->second.handle;
+        }
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStages[2];
+    // vert shader stage info
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main"; // function to invoke; i.e. entrypoint
+    shaderStages[0].flags = 0; // optional
+    shaderStages[0].pNext = nullptr; // optional
+    shaderStages[0].pSpecializationInfo = nullptr; // optional
+    // frag shader stage info
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main"; // function to invoke; i.e. entrypoint
+    shaderStages[1].flags = 0; // optional
+    shaderStages[1].pNext = nullptr; // optional
+    shaderStages[1].pSpecializationInfo = nullptr; // optional
+
+    auto& bindingDescription = settings.bindingDescription;
+    auto& attributeDescriptions = settings.attributeDescriptions;
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = fragShaderModule != VK_NULL_HANDLE ? 2 : 1;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &settings.inputAssembly;
+    pipelineInfo.pViewportState = &settings.viewportState;
+    pipelineInfo.pRasterizationState = &settings.rasteriser;
+    pipelineInfo.pMultisampleState = &settings.multisampling;
+    pipelineInfo.pDepthStencilState = &settings.depthStencil;
+    pipelineInfo.pColorBlendState = &settings.colourBlending;
+    pipelineInfo.pDynamicState = &settings.dynamicState;
+    pipelineInfo.layout = layout;
+    pipelineInfo.renderPass = settings.renderPass;
+    pipelineInfo.subpass = settings.subpass;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1; // optional
+
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(m_device->getDevice(), m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create graphics pipeline.");
+    return insertPipeline(std::move(key), pipeline, layout);
+}
+
+VkPipeline PipelineCache::acquireComputePipeline(VkPipelineLayout layout, const std::string& compFilepath)
+{
+    VkShaderModule compShaderModule = getShaderModule(compFilepath);
+    Key key = getComputeKey(layout, compShaderModule);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_pipelines.find(key);
+        if (it != m_pipelines.end())
+        {
+            it->second.references++;
+            return it->second.handle;
+        }
+    }
+
+    VkPipelineShaderStageCreateInfo compShaderStageInfo{};
+    compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    compShaderStageInfo.module = compShaderModule;
+    compShaderStageInfo.pName = "main";
+    compShaderStageInfo.flags = 0; // optional
+    compShaderStageInfo.pNext = nullptr; // optional
+    compShaderStageInfo.pSpecializationInfo = nullptr; // optional
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = layout;
+    pipelineInfo.stage = compShaderStageInfo;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(m_device->getDevice(), m_pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create compute pipeline.");
+    return insertPipeline(std::move(key), pipeline, layout);
+}
+
+VkPipeline PipelineCache::insertPipeline(Key&& key, VkPipeline pipeline, VkPipelineLayout layout)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pipelines.find(key);
+    if (it != m_pipelines.end())
+    {
+        // another thread compiled the same state while this one was compiling; keep theirs
+        vkDestroyPipeline(m_device->getDevice(), pipeline, nullptr);
+        it->second.references++;
+        return it->second.handle;
+    }
+
+    for (auto& entry : m_layouts)
+    {
+        if (entry.second.handle == layout)
+            entry.second.references++;
+    }
+    m_pipelines.emplace(std::move(key), PipelineEntry{ pipeline, layout, 1 });
+    return pipeline;
+}
+
+void PipelineCache::releaseLayout(VkPipelineLayout layout)
+{
+    for (auto it = m_layouts.begin(); it != m_layouts.end(); ++it)
+    {
+        if (it->second.handle != layout)
+            continue;
+        if (--it->second.references == 0)
+        {
+            vkDestroyPipelineLayout(m_device->getDevice(), layout, nullptr);
+            m_layouts.erase(it);
+        }
+        return;
+    }
+}
+
+void PipelineCache::releasePipelineLayout(VkPipelineLayout layout)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    releaseLayout(layout);
+}
+
+void PipelineCache::releasePipeline(VkPipeline pipeline)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = m_pipelines.begin(); it != m_pipelines.end(); ++it)
+    {
+        if (it->second.handle != pipeline)
+            continue;
+        if (--it->second.references == 0)
+        {
+            VkPipelineLayout layout = it->second.layout;
+            vkDestroyPipeline(m_device->getDevice(), pipeline, nullptr);
+            m_pipelines.erase(it);
+            releaseLayout(layout);
+        }
+        return;
+    }
+}
+
+bool PipelineCache::save()
+{
+    size_t size = 0;
+    if (vkGetPipelineCacheData(m_device->getDevice(), m_pipelineCache, &size, nullptr) != VK_SUCCESS)
+        return false;
+    if (size == 0)
+        return true;
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(m_device->getDevice(), m_pipelineCache, &size, data.data()) != VK_SUCCESS)
+        return false;
+
+    std::ofstream file(m_filepath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return false;
+    file.write(data.data(), static_cast<std::streamsize>(size));
+    return file.good();
+}
+
+std::vector<char> PipelineCache::readFile(const std::string& filename)
+{
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open file.");
+
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    std::vector<char> buffer(fileSize);
+
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+    file.close();
+
+    return buffer;
+}
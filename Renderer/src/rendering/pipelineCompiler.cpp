@@ -0,0 +1,60 @@
+/** \file pipelineCompiler.cpp */
+
+#include "rendering/pipelineCompiler.hpp"
+
+std::future<Pipeline*> PipelineCompiler::compileGraphics(const VkPipelineLayoutCreateInfo& ci, std::unique_ptr<PipelineSettings> settings, const std::string& vertFilepath, const std::string& fragFilepath)
+{
+    std::shared_ptr<LayoutInfo> layoutInfo = copyLayoutInfo(ci);
+    std::shared_ptr<PipelineSettings> sharedSettings(std::move(settings));
+    Device* device = m_device;
+    return submit([device, layoutInfo, sharedSettings, vertFilepath, fragFilepath]() {
+        return new Pipeline(device, layoutInfo->ci, *sharedSettings, vertFilepath, fragFilepath);
+    });
+}
+
+std::future<Pipeline*> PipelineCompiler::compileCompute(const VkPipelineLayoutCreateInfo& ci, const std::string& compFilepath)
+{
+    std::shared_ptr<LayoutInfo> layoutInfo = copyLayoutInfo(ci);
+    Device* device = m_device;
+    return submit([device, layoutInfo, compFilepath]() {
+        PipelineSettings settings{};
+        return new Pipeline(device, layoutInfo->ci, settings, compFilepath);
+    });
+}
+
+std::future<Pipeline*> PipelineCompiler::compileGraphics(std::unique_ptr<PipelineSettings> settings, const std::string& vertFilepath, const std::string& fragFilepath, const LayoutOverrides& overrides)
+{
+    std::shared_ptr<PipelineSettings> sharedSettings(std::move(settings));
+    Device* device = m_device;
+    return submit([device, sharedSettings, vertFilepath, fragFilepath, overrides]() {
+        return new Pipeline(device, *sharedSettings, vertFilepath, fragFilepath, overrides);
+    });
+}
+
+std::future<Pipeline*> PipelineCompiler::compileCompute(const std::string& compFilepath, const LayoutOverrides& overrides)
+{
+    Device* device = m_device;
+    return submit([device, compFilepath, overrides]() {
+        return new Pipeline(device, compFilepath, overrides);
+    });
+}
+
+std::shared_ptr<PipelineCompiler::LayoutInfo> PipelineCompiler::copyLayoutInfo(const VkPipelineLayoutCreateInfo& ci)
+{
+    std::shared_ptr<LayoutInfo> layoutInfo = std::make_shared<LayoutInfo>();
+    layoutInfo->setLayouts.assign(ci.pSetLayouts, ci.pSetLayouts + ci.setLayoutCount);
+    layoutInfo->pushConstantRanges.assign(ci.pPushConstantRanges, ci.pPushConstantRanges + ci.pushConstantRangeCount);
+    layoutInfo->ci = ci;
+    layoutInfo->ci.pSetLayouts = layoutInfo->setLayouts.data();
+    layoutInfo->ci.pPushConstantRanges = layoutInfo->pushConstantRanges.data();
+    return layoutInfo;
+}
+
+std::future<Pipeline*> PipelineCompiler::submit(std::function<Pipeline*()> job)
+{
+    // ThreadPool jobs return void, so the result travels through a task of our own
+    auto task = std::make_shared<std::packaged_task<Pipeline*()>>(std::move(job));
+    std::future<Pipeline*> future = task->get_future();
+    m_threadPool->submit([task]() { (*task)(); });
+    return future;
+}
@@ -0,0 +1,134 @@
+/** \file pngWriter.cpp */
+
+#include "rendering/pngWriter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    void appendBigEndian(std::vector<uint8_t>& data, uint32_t value)
+    {
+        data.push_back(static_cast<uint8_t>(value >> 24));
+        data.push_back(static_cast<uint8_t>(value >> 16));
+        data.push_back(static_cast<uint8_t>(value >> 8));
+        data.push_back(static_cast<uint8_t>(value));
+    }
+}
+
+namespace Rock
+{
+    std::vector<uint8_t> PngWriter::encode(uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba)
+    {
+        if (width == 0 || height == 0 || rgba.size() != static_cast<size_t>(width) * height * 4)
+            throw std::runtime_error("PNG pixel data does not match its size.");
+
+        // each row is prefixed with filter type 0; rows are stored rather than compressed, which keeps the writer small and fast enough for test output
+        size_t rowSize = static_cast<size_t>(width) * 4;
+        std::vector<uint8_t> raw;
+        raw.reserve((rowSize + 1) * height);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            raw.push_back(0);
+            raw.insert(raw.end(), rgba.begin() + y * rowSize, rgba.begin() + (y + 1) * rowSize);
+        }
+
+        const size_t MAX_BLOCK = 65535;
+        std::vector<uint8_t> zlib = { 0x78, 0x01 };
+        zlib.reserve(raw.size() + raw.size() / MAX_BLOCK * 5 + 16);
+        for (size_t offset = 0; offset < raw.size(); offset += MAX_BLOCK)
+        {
+            uint16_t length = static_cast<uint16_t>(std::min(MAX_BLOCK, raw.size() - offset));
+            zlib.push_back(offset + length >= raw.size() ? 1 : 0); // BFINAL on the last block, BTYPE 00 stored
+            zlib.push_back(static_cast<uint8_t>(length));
+            zlib.push_back(static_cast<uint8_t>(length >> 8));
+            zlib.push_back(static_cast<uint8_t>(~length));
+            zlib.push_back(static_cast<uint8_t>(~length >> 8));
+            zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+        }
+
+        uint32_t a = 1;
+        uint32_t b = 0;
+        for (uint8_t byte : raw)
+        {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        appendBigEndian(zlib, (b << 16) | a);
+
+        std::vector<uint8_t> header;
+        appendBigEndian(header, width);
+        appendBigEndian(header, height);
+        header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit depth, RGBA, deflate, adaptive filtering, no interlace
+
+        std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        appendChunk(png, "IHDR", header);
+        appendChunk(png, "IDAT", zlib);
+        appendChunk(png, "IEND", {});
+        return png;
+    }
+
+    void PngWriter::write(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba)
+    {
+        std::vector<uint8_t> png = encode(width, height, rgba);
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open())
+            throw std::runtime_error("Failed to open PNG file for writing.");
+        file.write(reinterpret_cast<const char*>(png.data()), png.size());
+        if (!file)
+            throw std::runtime_error("Failed to write PNG file.");
+    }
+
+    size_t PngWriter::countDifferingPixels(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, uint8_t tolerance)
+    {
+        if (a.size() != b.size() || a.size() % 4 != 0)
+            throw std::runtime_error("Compared images have different sizes.");
+
+        size_t count = 0;
+        for (size_t i = 0; i < a.size(); i += 4)
+        {
+            for (size_t channel = 0; channel < 4; channel++)
+            {
+                if (std::abs(static_cast<int>(a[i + channel]) - static_cast<int>(b[i + channel])) > tolerance)
+                {
+                    count++;
+                    break;
+                }
+            }
+        }
+        return count;
+    }
+
+    uint32_t PngWriter::crc32(const uint8_t* data, size_t size, uint32_t crc)
+    {
+        static const std::array<uint32_t, 256> table = []()
+        {
+            std::array<uint32_t, 256> values{};
+            for (uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; bit++)
+                    value = value & 1 ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+                values[i] = value;
+            }
+            return values;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void PngWriter::appendChunk(std::vector<uint8_t>& png, const char type[4], const std::vector<uint8_t>& data)
+    {
+        appendBigEndian(png, static_cast<uint32_t>(data.size()));
+        size_t typeOffset = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data.begin(), data.end());
+        appendBigEndian(png, crc32(png.data() + typeOffset, data.size() + 4));
+    }
+}
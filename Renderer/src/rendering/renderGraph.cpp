@@ -0,0 +1,500 @@
+/** \file renderGraph.cpp */
+
+#include "rendering/renderGraph.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+}
+
+const RenderGraph::Access RenderGraph::COLOUR_ATTACHMENT = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+const RenderGraph::Access RenderGraph::DEPTH_ATTACHMENT = { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+const RenderGraph::Access RenderGraph::DEPTH_READ_COMPUTE = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+const RenderGraph::Access RenderGraph::SAMPLED_FRAGMENT = { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+const RenderGraph::Access RenderGraph::SAMPLED_COMPUTE = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+const RenderGraph::Access RenderGraph::STORAGE_READ_COMPUTE = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+const RenderGraph::Access RenderGraph::STORAGE_WRITE_COMPUTE = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+const RenderGraph::Access RenderGraph::STORAGE_BUFFER_COMPUTE = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+const RenderGraph::Access RenderGraph::STORAGE_BUFFER_VERTEX = { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+const RenderGraph::Access RenderGraph::STORAGE_BUFFER_FRAGMENT = { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+const RenderGraph::Access RenderGraph::INDIRECT_BUFFER = { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+const RenderGraph::Access RenderGraph::TRANSFER_SRC = { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL };
+const RenderGraph::Access RenderGraph::TRANSFER_DST = { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+
+bool RenderGraph::ImageDesc::operator==(const ImageDesc& other) const
+{
+    return extent.width == other.extent.width && extent.height == other.extent.height && format == other.format &&
+        usage == other.usage && aspect == other.aspect && samples == other.samples;
+}
+
+void RenderGraph::PassBuilder::read(Resource resource, const Access& access)
+{
+    m_graph.declare(m_pass, resource, access, false);
+}
+
+void RenderGraph::PassBuilder::write(Resource resource, const Access& access)
+{
+    m_graph.declare(m_pass, resource, access, true);
+}
+
+void RenderGraph::PassBuilder::sideEffect()
+{
+    m_graph.m_passes[m_pass].sideEffect = true;
+}
+
+RenderGraph::RenderGraph(Device* device, uint32_t framesInFlight) : m_device(device), m_framesInFlight(framesInFlight)
+{
+}
+
+RenderGraph::~RenderGraph()
+{
+    retireTransients();
+    destroyRetired(true);
+    m_device = nullptr;
+}
+
+std::vector<uint32_t> RenderGraph::assignAliasSlots(const std::vector<std::pair<uint32_t, uint32_t>>& lifetimes)
+{
+    std::vector<size_t> order(lifetimes.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return lifetimes[a].first < lifetimes[b].first; });
+
+    // greedy interval colouring: an interval reuses the first slot whose last occupant has finished
+    std::vector<uint32_t> slots(lifetimes.size());
+    std::vector<uint32_t> slotEnds;
+    for (size_t i : order)
+    {
+        uint32_t slot = 0;
+        while (slot < slotEnds.size() && slotEnds[slot] >= lifetimes[i].first)
+            slot++;
+        if (slot == slotEnds.size())
+            slotEnds.push_back(0);
+        slotEnds[slot] = lifetimes[i].second;
+        slots[i] = slot;
+    }
+    return slots;
+}
+
+uint64_t RenderGraph::getKey(const ResourceEntry& entry)
+{
+    uint64_t key = 0;
+    if (entry.isImage)
+        memcpy(&key, &entry.image, sizeof(entry.image));
+    else
+        memcpy(&key, &entry.buffer, sizeof(entry.buffer));
+    return key;
+}
+
+void RenderGraph::reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+    m_finalStates.clear();
+    m_finalSlotStages.clear();
+    m_slotCount = 0;
+}
+
+void RenderGraph::forgetImports()
+{
+    m_importedImages.clear();
+    m_importedBuffers.clear();
+}
+
+RenderGraph::Resource RenderGraph::importImage(const std::string& name, VkImage image, VkImageAspectFlags aspect, uint32_t levels)
+{
+    ResourceEntry entry;
+    entry.name = name;
+    entry.imported = true;
+    entry.isImage = true;
+    entry.image = image;
+    entry.aspect = aspect;
+    entry.levels = levels;
+    m_resources.push_back(entry);
+    return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importBuffer(const std::string& name, VkBuffer buffer)
+{
+    ResourceEntry entry;
+    entry.name = name;
+    entry.imported = true;
+    entry.isImage = false;
+    entry.buffer = buffer;
+    entry.aspect = 0;
+    entry.levels = 0;
+    m_resources.push_back(entry);
+    return static_cast<Resource>(m_resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::createImage(const std::string& name, const ImageDesc& desc)
+{
+    ResourceEntry entry;
+    entry.name = name;
+    entry.imported = false;
+    entry.isImage = true;
+    entry.aspect = desc.aspect;
+    entry.levels = 1;
+    entry.desc = desc;
+    m_resources.push_back(entry);
+    return static_cast<Resource>(m_resources.size() - 1);
+}
+
+void RenderGraph::addPass(const std::string& name, PassType type, std::function<void(PassBuilder&)> setup, std::function<void(VkCommandBuffer)> execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.type = type;
+    pass.execute = std::move(execute);
+    m_passes.push_back(std::move(pass));
+
+    PassBuilder builder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+    setup(builder);
+}
+
+void RenderGraph::declare(uint32_t pass, Resource resource, const Access& access, bool write)
+{
+    if (resource >= m_resources.size())
+        throw std::runtime_error("Pass uses a resource that was not declared.");
+    for (PassAccess& existing : m_passes[pass].accesses)
+    {
+        if (existing.resource != resource)
+            continue;
+        if (m_resources[resource].isImage && existing.access.layout != access.layout)
+            throw std::runtime_error("Pass uses an image in two layouts.");
+        existing.access.stages |= access.stages;
+        existing.access.access |= access.access;
+        existing.write = existing.write || write;
+        return;
+    }
+    m_passes[pass].accesses.push_back({ resource, access, write });
+}
+
+void RenderGraph::compile()
+{
+    cullPasses();
+    assignMemory();
+    computeBarriers();
+}
+
+void RenderGraph::cullPasses()
+{
+    // walk backwards from the passes that must run, keeping every pass that produces something they consume
+    std::vector<bool> consumed(m_resources.size(), false);
+    for (size_t i = m_passes.size(); i-- > 0;)
+    {
+        Pass& pass = m_passes[i];
+        bool keep = pass.sideEffect;
+        for (const PassAccess& access : pass.accesses)
+            keep = keep || (access.write && (m_resources[access.resource].imported || consumed[access.resource]));
+        pass.culled = !keep;
+        if (pass.culled)
+            continue;
+        for (const PassAccess& access : pass.accesses)
+        {
+            // a write that also reads, such as blending or read-modify-write storage, consumes the earlier contents
+            if (!access.write || (access.access.access & ~WRITE_ACCESS) != 0)
+                consumed[access.resource] = true;
+        }
+    }
+}
+
+void RenderGraph::assignMemory()
+{
+    std::vector<Resource> transients;
+    std::vector<std::pair<uint32_t, uint32_t>> lifetimes;
+    for (Resource resource = 0; resource < m_resources.size(); resource++)
+    {
+        m_resources[resource].slot = UINT32_MAX;
+        if (m_resources[resource].imported)
+            continue;
+        uint32_t first = UINT32_MAX;
+        uint32_t last = 0;
+        for (uint32_t i = 0; i < m_passes.size(); i++)
+        {
+            if (m_passes[i].culled)
+                continue;
+            for (const PassAccess& access : m_passes[i].accesses)
+            {
+                if (access.resource != resource)
+                    continue;
+                first = std::min(first, i);
+                last = std::max(last, i);
+            }
+        }
+        if (first == UINT32_MAX)
+            continue; // only used by culled passes, so never created
+        transients.push_back(resource);
+        lifetimes.emplace_back(first, last);
+    }
+
+    std::vector<uint32_t> slots = assignAliasSlots(lifetimes);
+    m_slotCount = 0;
+    for (size_t i = 0; i < transients.size(); i++)
+    {
+        m_resources[transients[i]].slot = slots[i];
+        m_slotCount = std::max(m_slotCount, slots[i] + 1);
+    }
+}
+
+void RenderGraph::computeBarriers()
+{
+    std::vector<ResourceState> states(m_resources.size());
+    for (Resource resource = 0; resource < m_resources.size(); resource++)
+    {
+        const ResourceEntry& entry = m_resources[resource];
+        if (!entry.imported)
+            continue;
+        auto& imported = getImportedStates(entry);
+        auto it = imported.find(getKey(entry));
+        if (it != imported.end())
+            states[resource] = it->second;
+    }
+    std::vector<VkPipelineStageFlags> slotStages(m_slotCount, 0);
+    for (size_t slot = 0; slot < std::min(slotStages.size(), m_slotStages.size()); slot++)
+        slotStages[slot] = m_slotStages[slot];
+    std::vector<bool> placed(m_resources.size(), false);
+
+    for (Pass& pass : m_passes)
+    {
+        pass.barriers.clear();
+        if (pass.culled)
+            continue;
+        for (const PassAccess& use : pass.accesses)
+        {
+            const ResourceEntry& entry = m_resources[use.resource];
+            ResourceState& state = states[use.resource];
+            if (!entry.imported && !placed[use.resource])
+            {
+                // the image takes over memory its slot's previous occupant may still be using, and starts with undefined contents
+                state = ResourceState();
+                state.srcStages = slotStages[entry.slot];
+                placed[use.resource] = true;
+            }
+
+            const Access& access = use.access;
+            bool transition = entry.isImage && state.layout != access.layout;
+            if (use.write || transition)
+            {
+                // write after read or write, or a layout transition, waits for every earlier access
+                VkPipelineStageFlags srcStages = state.srcStages | state.readStages;
+                if (srcStages != 0 || transition)
+                    pass.barriers.push_back({ use.resource, srcStages, state.srcAccess, access.stages, access.access, state.layout, entry.isImage ? access.layout : state.layout });
+                state.srcStages = access.stages;
+                state.srcAccess = use.write ? access.access & WRITE_ACCESS : 0;
+                state.readStages = use.write ? 0 : access.stages;
+                state.visibleStages = use.write ? 0 : access.stages;
+                state.visibleAccess = use.write ? 0 : access.access;
+                if (entry.isImage)
+                    state.layout = access.layout;
+            }
+            else
+            {
+                // read after write only needs a barrier the first time each stage and access reads it
+                if (state.srcStages != 0 && ((access.stages & ~state.visibleStages) != 0 || (access.access & ~state.visibleAccess) != 0))
+                {
+                    pass.barriers.push_back({ use.resource, state.srcStages, state.srcAccess, access.stages, access.access, state.layout, state.layout });
+                    state.visibleStages |= access.stages;
+                    state.visibleAccess |= access.access;
+                }
+                state.readStages |= access.stages;
+            }
+            if (!entry.imported)
+                slotStages[entry.slot] = state.srcStages | state.readStages;
+        }
+    }
+
+    m_finalStates = states;
+    m_finalSlotStages = slotStages;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+    realiseTransients();
+
+    for (Pass& pass : m_passes)
+    {
+        if (pass.culled)
+            continue;
+        if (!pass.barriers.empty())
+        {
+            VkPipelineStageFlags srcStages = 0;
+            VkPipelineStageFlags dstStages = 0;
+            std::vector<VkImageMemoryBarrier> imageBarriers;
+            std::vector<VkBufferMemoryBarrier> bufferBarriers;
+            for (const Barrier& barrier : pass.barriers)
+            {
+                const ResourceEntry& entry = m_resources[barrier.resource];
+                srcStages |= barrier.srcStages;
+                dstStages |= barrier.dstStages;
+                if (entry.isImage)
+                {
+                    VkImageMemoryBarrier imageBarrier{};
+                    imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                    imageBarrier.srcAccessMask = barrier.srcAccess;
+                    imageBarrier.dstAccessMask = barrier.dstAccess;
+                    imageBarrier.oldLayout = barrier.oldLayout;
+                    imageBarrier.newLayout = barrier.newLayout;
+                    imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    imageBarrier.image = getImage(barrier.resource);
+                    imageBarrier.subresourceRange.aspectMask = entry.aspect;
+                    imageBarrier.subresourceRange.baseMipLevel = 0;
+                    imageBarrier.subresourceRange.levelCount = entry.levels;
+                    imageBarrier.subresourceRange.baseArrayLayer = 0;
+                    imageBarrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+                    imageBarriers.push_back(imageBarrier);
+                }
+                else
+                {
+                    VkBufferMemoryBarrier bufferBarrier{};
+                    bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                    bufferBarrier.srcAccessMask = barrier.srcAccess;
+                    bufferBarrier.dstAccessMask = barrier.dstAccess;
+                    bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                    bufferBarrier.buffer = entry.buffer;
+                    bufferBarrier.offset = 0;
+                    bufferBarrier.size = VK_WHOLE_SIZE;
+                    bufferBarriers.push_back(bufferBarrier);
+                }
+            }
+            // every barrier before a pass goes into one call; a first use has nothing to wait for
+            vkCmdPipelineBarrier(commandBuffer, srcStages != 0 ? srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT), dstStages, 0, 0, nullptr,
+                static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+        }
+        GpuProfiler::Scope scope(m_profiler, commandBuffer, pass.name);
+        pass.execute(commandBuffer);
+    }
+
+    for (Resource resource = 0; resource < m_resources.size(); resource++)
+    {
+        const ResourceEntry& entry = m_resources[resource];
+        if (entry.imported)
+            getImportedStates(entry)[getKey(entry)] = m_finalStates[resource];
+    }
+    m_slotStages = m_finalSlotStages;
+    destroyRetired(false);
+}
+
+VkImage RenderGraph::getImage(Resource resource) const
+{
+    const ResourceEntry& entry = m_resources[resource];
+    if (entry.imported)
+        return entry.image;
+    return entry.physical < m_transients.size() ? m_transients[entry.physical].image : VK_NULL_HANDLE;
+}
+
+VkImageView RenderGraph::getImageView(Resource resource) const
+{
+    const ResourceEntry& entry = m_resources[resource];
+    if (entry.imported || entry.physical >= m_transients.size())
+        return VK_NULL_HANDLE;
+    return m_transients[entry.physical].view;
+}
+
+void RenderGraph::realiseTransients()
+{
+    std::vector<std::pair<ImageDesc, uint32_t>> wanted;
+    for (ResourceEntry& entry : m_resources)
+    {
+        entry.physical = UINT32_MAX;
+        if (entry.imported || entry.slot == UINT32_MAX)
+            continue;
+        entry.physical = static_cast<uint32_t>(wanted.size());
+        wanted.emplace_back(entry.desc, entry.slot);
+    }
+    if (wanted == m_realised)
+        return; // the same frame shape as last time, so the images are reused
+
+    retireTransients();
+    std::vector<VkDeviceSize> slotSizes(m_slotCount, 0);
+    std::vector<uint32_t> slotTypes(m_slotCount, UINT32_MAX);
+    for (const auto& image : wanted)
+    {
+        const ImageDesc& desc = image.first;
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { desc.extent.width, desc.extent.height, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = desc.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = desc.usage;
+        imageInfo.samples = desc.samples;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        Transient transient{};
+        if (vkCreateImage(m_device->getDevice(), &imageInfo, nullptr, &transient.image) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create transient image.");
+        m_transients.push_back(transient);
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(m_device->getDevice(), transient.image, &requirements);
+        VkDeviceSize& size = slotSizes[image.second];
+        size = std::max(size, requirements.size);
+        slotTypes[image.second] &= requirements.memoryTypeBits;
+    }
+
+    for (uint32_t slot = 0; slot < m_slotCount; slot++)
+    {
+        if (slotTypes[slot] == 0)
+            throw std::runtime_error("Transient images sharing a memory slot have no common memory type.");
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = slotSizes[slot];
+        allocInfo.memoryTypeIndex = m_device->findMemoryType(slotTypes[slot], VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkDeviceMemory memory;
+        if (vkAllocateMemory(m_device->getDevice(), &allocInfo, nullptr, &memory) != VK_SUCCESS)
+            throw std::runtime_error("Failed to allocate transient image memory.");
+        m_slotMemory.push_back(memory);
+    }
+
+    for (size_t i = 0; i < wanted.size(); i++)
+    {
+        // every image in a slot starts at offset 0; their lifetimes never overlap, and each first use discards the contents
+        vkBindImageMemory(m_device->getDevice(), m_transients[i].image, m_slotMemory[wanted[i].second], 0);
+        m_transients[i].view = m_device->createImageView(m_transients[i].image, wanted[i].first.format, wanted[i].first.aspect, 1);
+    }
+    m_realised = wanted;
+}
+
+void RenderGraph::retireTransients()
+{
+    if (m_transients.empty() && m_slotMemory.empty())
+        return;
+    m_retired.emplace_back(std::move(m_transients), std::move(m_slotMemory));
+    m_retiredFrames.push_back(m_framesInFlight + 1);
+    m_transients.clear();
+    m_slotMemory.clear();
+    m_realised.clear();
+}
+
+void RenderGraph::destroyRetired(bool all)
+{
+    for (size_t i = 0; i < m_retired.size();)
+    {
+        if (!all && --m_retiredFrames[i] > 0)
+        {
+            i++;
+            continue;
+        }
+        for (const Transient& transient : m_retired[i].first)
+        {
+            vkDestroyImageView(m_device->getDevice(), transient.view, nullptr);
+            vkDestroyImage(m_device->getDevice(), transient.image, nullptr);
+        }
+        for (VkDeviceMemory memory : m_retired[i].second)
+            vkFreeMemory(m_device->getDevice(), memory, nullptr);
+        m_retired.erase(m_retired.begin() + i);
+        m_retiredFrames.erase(m_retiredFrames.begin() + i);
+    }
+}
@@ -2,16 +2,32 @@
 
 #include "rendering/renderer.hpp"
 
-Renderer::Renderer(Device* device, VkSampleCountFlagBits msaaSamples, bool resources)
-	: m_device(device), m_msaaSamples(msaaSamples), m_resources(resources)
+Renderer::Renderer(Device* device, VkSampleCountFlagBits msaaSamples, bool resources, ThreadPool* threadPool)
+	: m_device(device), m_msaaSamples(msaaSamples), m_resources(resources), m_threadPool(threadPool)
 {
     m_window = m_device->getWindow();
+    m_presentMode = m_window->isVsync() ? VK_PRESENT_MODE_FIFO_KHR : VK_PRESENT_MODE_MAILBOX_KHR;
+    setFramesInFlight(m_window->getFramesInFlight());
+    m_framesInFlight = m_requestedFramesInFlight;
+    setLowLatency(m_window->isLowLatency());
 	recreateSwapchain();
 	createCommandBuffers();
+    m_gpuProfiler = new GpuProfiler(m_device, Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_renderGraph = new RenderGraph(m_device, Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_renderGraph->setProfiler(m_gpuProfiler);
+    if (m_threadPool)
+        m_commandPools = new CommandPools(m_device, m_threadPool->getThreadCount() + 1, Swapchain::MAX_FRAMES_IN_FLIGHT); // the calling thread records a batch too
 }
 
 Renderer::~Renderer()
 {
+    delete m_renderGraph;
+    m_renderGraph = nullptr;
+    delete m_gpuProfiler;
+    m_gpuProfiler = nullptr;
+    delete m_commandPools;
+    m_commandPools = nullptr;
+    vkDestroySemaphore(m_device->getDevice(), m_computeTimeline, nullptr);
     delete m_swapchain;
     m_swapchain = nullptr;
 	m_device = nullptr;
@@ -28,18 +44,38 @@ void Renderer::recreateSwapchain()
     }
 
     vkDeviceWaitIdle(m_device->getDevice());
+    if (m_renderGraph)
+        m_renderGraph->forgetImports(); // the new depth image may reuse the old handle
 
     if (m_swapchain != nullptr)
     {
         Swapchain* oldSwapchain = std::move(m_swapchain);
-        m_swapchain = new Swapchain(m_device, oldSwapchain, m_msaaSamples);
+        m_swapchain = new Swapchain(m_device, oldSwapchain, m_msaaSamples, m_presentMode, m_gpuCuller != nullptr);
         if (*oldSwapchain != m_swapchain)
             throw std::runtime_error("Swap chain image/depth format has changed.");
         delete oldSwapchain;
         oldSwapchain = nullptr;
     }
     else
-        m_swapchain = new Swapchain(m_device, m_msaaSamples, m_resources);
+        m_swapchain = new Swapchain(m_device, m_msaaSamples, m_resources, m_presentMode, m_gpuCuller != nullptr);
+    m_presentId = 0; // present ids count up per swapchain
+}
+
+void Renderer::setGpuCulling(GpuCuller* culler, Pipeline* instancedPipeline, entt::entity mesh)
+{
+    bool sampledDepth = culler != nullptr;
+    m_gpuCuller = culler;
+    m_instancedPipeline = instancedPipeline;
+    m_gpuCulledMesh = mesh;
+    // only the depth pyramid reads the depth attachment after the scene pass, so other apps keep it transient
+    if (m_resources && m_swapchain->isDepthSampled() != sampledDepth)
+        recreateSwapchain();
+}
+
+void Renderer::setPresentMode(VkPresentModeKHR presentMode)
+{
+    m_presentMode = presentMode;
+    m_presentModeChanged = true;
 }
 
 void Renderer::createCommandBuffers()
@@ -53,10 +89,35 @@ void Renderer::createCommandBuffers()
     allocInfo.commandBufferCount = static_cast<uint32_t>(m_commandBuffers.size());
     if (vkAllocateCommandBuffers(m_device->getDevice(), &allocInfo, m_commandBuffers.data()) != VK_SUCCESS)
         throw std::runtime_error("Failed to allocate graphics command buffers.");
+
+    allocInfo.commandPool = m_device->getComputeCommandPool();
+    m_computeCommandBuffers.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    allocInfo.commandBufferCount = static_cast<uint32_t>(m_computeCommandBuffers.size());
+    if (vkAllocateCommandBuffers(m_device->getDevice(), &allocInfo, m_computeCommandBuffers.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate compute command buffers.");
+
+    // one timeline counts the compute submissions, so each graphics submission waits on the value of its own frame's dispatch
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &timelineInfo;
+    if (vkCreateSemaphore(m_device->getDevice(), &semaphoreInfo, nullptr, &m_computeTimeline) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create compute timeline semaphore.");
 }
 
 void Renderer::beginFrame()
 {
+    ROCK_PROFILE_FUNCTION();
+    if (m_lowLatency && m_presentId >= m_framesInFlight)
+    {
+        // the fences only bound how far the CPU runs ahead of the GPU; this also bounds how far it runs ahead of the display
+        ROCK_PROFILE_SCOPE("wait for present");
+        m_device->waitForPresent(m_swapchain->getSwapchain(), m_presentId + 1 - m_framesInFlight, PRESENT_WAIT_TIMEOUT);
+    }
     VkResult result = vkAcquireNextImageKHR(m_device->getDevice(), m_swapchain->getSwapchain(), UINT64_MAX, m_swapchain->getImageAvailableSemaphore(m_currentFrame), VK_NULL_HANDLE, &m_imageIndex);
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR)
@@ -70,6 +131,7 @@ void Renderer::beginFrame()
 
 void Renderer::endFrame()
 {
+    ROCK_PROFILE_FUNCTION();
     VkSwapchainKHR swapchains[] = { m_swapchain->getSwapchain() };
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -80,20 +142,41 @@ void Renderer::endFrame()
     presentInfo.pImageIndices = &m_imageIndex;
     presentInfo.pResults = nullptr; // optional
 
+    VkPresentIdKHR presentIdInfo{};
+    uint64_t presentId = m_presentId + 1;
+    if (m_device->supportsPresentWait())
+    {
+        presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+        presentIdInfo.swapchainCount = 1;
+        presentIdInfo.pPresentIds = &presentId;
+        presentInfo.pNext = &presentIdInfo;
+        m_presentId = presentId;
+    }
+
     VkResult result = vkQueuePresentKHR(m_device->getPresentQueue(), &presentInfo);
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_device->getWindow()->getResized())
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_device->getWindow()->getResized() || m_presentModeChanged)
     {
         m_device->getWindow()->setResized(false);
+        m_presentModeChanged = false;
         recreateSwapchain();
     }
     else if (result != VK_SUCCESS)
         throw std::runtime_error("Failed to present swap chain image.");
 
-    m_currentFrame = (m_currentFrame + 1) % Swapchain::MAX_FRAMES_IN_FLIGHT;
+    m_currentFrame = (m_currentFrame + 1) % m_framesInFlight;
+    if (m_requestedFramesInFlight != m_framesInFlight)
+    {
+        // every frame has finished once the device is idle, so any slot can be the next
+        vkDeviceWaitIdle(m_device->getDevice());
+        m_framesInFlight = m_requestedFramesInFlight;
+        m_currentFrame = 0;
+        if (m_framesInFlightCallback)
+            m_framesInFlightCallback(m_framesInFlight);
+    }
 }
 
-void Renderer::beginSwapchainRenderPass(Pipeline* pipeline, VkCommandBuffer commandBuffer, bool depth)
+void Renderer::beginSwapchainRenderPass(Pipeline* pipeline, VkCommandBuffer commandBuffer, bool depth, VkSubpassContents contents)
 {
     std::vector<VkClearValue> clearColours = { {{ 0.f, 0.f, 0.f, 1.f }} };
     if (depth) clearColours.push_back({ {{1.f, 0}} });
@@ -106,23 +189,12 @@ void Renderer::beginSwapchainRenderPass(Pipeline* pipeline, VkCommandBuffer comm
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearColours.size());
     renderPassInfo.pClearValues = clearColours.data();
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    pipeline->bindGraphics(commandBuffer);
-
-    VkViewport viewport{};
-    viewport.x = 0.f;
-    viewport.y = 0.f;
-    viewport.width = static_cast<float>(m_swapchain->getSwapchainExtent().width);
-    viewport.height = static_cast<float>(m_swapchain->getSwapchainExtent().height);
-    viewport.minDepth = 0.f;
-    viewport.maxDepth = 1.f;
-
-    VkRect2D scissor{};
-    scissor.offset = { 0, 0 };
-    scissor.extent = m_swapchain->getSwapchainExtent();
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+    if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+        return; // only vkCmdExecuteCommands may follow; each secondary binds its own state
 
-    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    pipeline->bindGraphics(commandBuffer);
+    setViewportAndScissor(commandBuffer);
 }
 
 void Renderer::beginSwapchainRenderPass(VkClearValue& clearColour)
@@ -155,10 +227,11 @@ void Renderer::beginSwapchainRenderPass(VkClearValue& clearColour)
     vkCmdSetScissor(m_commandBuffers[m_currentFrame], 0, 1, &scissor);
 }
 
-void Renderer::recordCommandBuffer(bool compute, Pipeline* pipeline, const uint32_t m_particleCount, std::vector<VkBuffer> shaderStorageBuffers, std::vector<VkDescriptorSet> descriptorSets)
+void Renderer::recordCommandBuffer(bool compute, ParticleSystem* particleSystem, float deltaTime)
 {
+    ROCK_PROFILE_FUNCTION();
     VkCommandBuffer commandBuffer;
-    commandBuffer = m_commandBuffers[m_currentFrame];
+    commandBuffer = compute ? m_computeCommandBuffers[m_currentFrame] : m_commandBuffers[m_currentFrame];
 
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -168,19 +241,23 @@ void Renderer::recordCommandBuffer(bool compute, Pipeline* pipeline, const uint3
     if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
         throw std::runtime_error("Failed to begin recording command buffer.");
 
+    // queries are recorded on the graphics queue only: a dedicated compute family may lack timestamps and never supports pipeline statistics
+    bool profileCompute = !m_device->hasAsyncCompute();
     if (compute)
     {
-        pipeline->bindCompute(commandBuffer);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 0, 1, &descriptorSets[m_currentFrame], 0, nullptr);
-        vkCmdDispatch(commandBuffer, m_particleCount / 256, 1, 1);
+        // the compute and graphics halves of a frame share a query slot, so only the first resets it
+        if (profileCompute)
+            m_gpuProfiler->beginFrame(commandBuffer, m_currentFrame);
+        GpuProfiler::Scope scope(profileCompute ? m_gpuProfiler : nullptr, commandBuffer, "particle simulation");
+        particleSystem->recordUpdate(commandBuffer, m_currentFrame, deltaTime);
     }
     else
     {
-        beginSwapchainRenderPass(pipeline, commandBuffer);
-
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &shaderStorageBuffers[m_currentFrame], offsets);
-        vkCmdDraw(commandBuffer, m_particleCount, 1, 0, 0);
+        if (!profileCompute)
+            m_gpuProfiler->beginFrame(commandBuffer, m_currentFrame);
+        GpuProfiler::Scope scope(m_gpuProfiler, commandBuffer, "particles");
+        beginSwapchainRenderPass(particleSystem->getGraphicsPipeline(), commandBuffer);
+        particleSystem->recordDraw(commandBuffer, m_currentFrame);
         vkCmdEndRenderPass(commandBuffer);
     }
 
@@ -190,6 +267,7 @@ void Renderer::recordCommandBuffer(bool compute, Pipeline* pipeline, const uint3
 
 void Renderer::recordCommandBuffer(Pipeline* pipeline, entt::registry& m_registry, std::vector<entt::entity> entities, std::vector<VkDescriptorSet> descriptorSets)
 {
+    ROCK_PROFILE_FUNCTION();
     VkCommandBuffer commandBuffer = m_commandBuffers[m_currentFrame];
 
     VkCommandBufferBeginInfo beginInfo{};
@@ -200,25 +278,23 @@ void Renderer::recordCommandBuffer(Pipeline* pipeline, entt::registry& m_registr
     if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
         throw std::runtime_error("Failed to begin recording command buffer.");
 
-    pipeline->bindGraphics(commandBuffer);
-    beginSwapchainRenderPass(pipeline, commandBuffer, true);
-
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(), 0, 1, &descriptorSets[m_currentFrame], 0, nullptr);
+    m_gpuProfiler->beginFrame(commandBuffer, m_currentFrame);
+    bool parallel = m_commandPools && entities.size() >= PARALLEL_RECORD_THRESHOLD;
+    if (m_commandPools)
+        m_commandPools->reset(m_currentFrame);
 
-    for (entt::entity& entity : entities)
+    recordFrameGraph(commandBuffer, [&](VkCommandBuffer commandBuffer)
     {
-        auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
-        auto& transformComp = m_registry.get<Rock::TransformComponent>(entity);
+        pipeline->bindGraphics(commandBuffer);
+        beginSwapchainRenderPass(pipeline, commandBuffer, true, parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(), 1, 1, &renderComp.descriptorSet, 0, nullptr);
-        vkCmdPushConstants(commandBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &transformComp.m_transform);
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &renderComp.m_vertexBuffer, offsets);
-        vkCmdBindIndexBuffer(commandBuffer, renderComp.m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(renderComp.m_indices.size()), 1, 0, 0, 0);
-    }
+        std::vector<VkCommandBuffer> secondaries;
+        recordScene(commandBuffer, parallel, pipeline, m_registry, entities, descriptorSets, secondaries);
+        if (parallel)
+            vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
 
-    vkCmdEndRenderPass(commandBuffer);
+        vkCmdEndRenderPass(commandBuffer);
+    });
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         throw std::runtime_error("Failed to record render command buffer.");
@@ -227,6 +303,7 @@ void Renderer::recordCommandBuffer(Pipeline* pipeline, entt::registry& m_registr
 void Renderer::recordCommandBuffer(Pipeline* pipeline, entt::registry& m_registry, std::vector<entt::entity> entities, std::vector<VkDescriptorSet> descriptorSets,
     float* m_translate, float* m_rotate, float* m_scale)
 {
+    ROCK_PROFILE_FUNCTION();
     VkCommandBuffer commandBuffer = m_commandBuffers[m_currentFrame];
 
     VkCommandBufferBeginInfo beginInfo{};
@@ -237,23 +314,10 @@ void Renderer::recordCommandBuffer(Pipeline* pipeline, entt::registry& m_registr
     if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
         throw std::runtime_error("Failed to begin recording command buffer.");
 
-    pipeline->bindGraphics(commandBuffer);
-    beginSwapchainRenderPass(pipeline, commandBuffer, true);
-
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(), 0, 1, &descriptorSets[m_currentFrame], 0, nullptr);
-
-    for (entt::entity& entity : entities)
-    {
-        auto& renderComp = m_registry.get<Rock::RenderComponent>(entity);
-        auto& transformComp = m_registry.get<Rock::TransformComponent>(entity);
-
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(), 1, 1, &renderComp.descriptorSet, 0, nullptr);
-        vkCmdPushConstants(commandBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &transformComp.m_transform);
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &renderComp.m_vertexBuffer, offsets);
-        vkCmdBindIndexBuffer(commandBuffer, renderComp.m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(renderComp.m_indices.size()), 1, 0, 0, 0);
-    }
+    m_gpuProfiler->beginFrame(commandBuffer, m_currentFrame);
+    bool parallel = m_commandPools && entities.size() >= PARALLEL_RECORD_THRESHOLD;
+    if (m_commandPools)
+        m_commandPools->reset(m_currentFrame);
 
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -274,7 +338,19 @@ void Renderer::recordCommandBuffer(Pipeline* pipeline, entt::registry& m_registr
     *     FpsCounter            *
     ****************************/
 
-    createOverlay(io.Framerate);
+    createOverlay(io.Framerate, m_visibleCount, m_culledCount);
+    createGpuProfilerPanel(m_gpuProfiler);
+    VkPresentModeKHR presentMode = m_presentMode;
+    uint32_t framesInFlight = m_requestedFramesInFlight;
+    bool lowLatency = m_lowLatency;
+    createFramePacingPanel(presentMode, framesInFlight, lowLatency, m_device->supportsPresentWait(), m_frameLimiter);
+    if (presentMode != m_presentMode)
+        setPresentMode(presentMode);
+    setFramesInFlight(framesInFlight);
+    setLowLatency(lowLatency);
+#ifdef ROCK_PROFILE
+    createCpuProfilerPanel();
+#endif
 
     /****************************
     *     Dockspace             *
@@ -458,46 +534,298 @@ void Renderer::recordCommandBuffer(Pipeline* pipeline, entt::registry& m_registr
     ImGui::End();
 
     ImGui::Render();
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
-    vkCmdEndRenderPass(commandBuffer);
+
+    recordFrameGraph(commandBuffer, [&](VkCommandBuffer commandBuffer)
+    {
+        pipeline->bindGraphics(commandBuffer);
+        beginSwapchainRenderPass(pipeline, commandBuffer, true, parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+
+        std::vector<VkCommandBuffer> secondaries;
+        recordScene(commandBuffer, parallel, pipeline, m_registry, entities, descriptorSets, secondaries);
+        if (parallel)
+        {
+            // the render pass only accepts secondaries, so the overlay is recorded into one after the scene
+            VkCommandBuffer overlayCommandBuffer = beginSecondary(0);
+            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), overlayCommandBuffer);
+            if (vkEndCommandBuffer(overlayCommandBuffer) != VK_SUCCESS)
+                throw std::runtime_error("Failed to record overlay command buffer.");
+            secondaries.push_back(overlayCommandBuffer);
+            vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+        }
+        else
+            ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+        vkCmdEndRenderPass(commandBuffer);
+    });
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
         throw std::runtime_error("Failed to record render command buffer.");
 }
 
-void Renderer::submitCommandBuffer(bool compute)
+void Renderer::recordFrameGraph(VkCommandBuffer commandBuffer, std::function<void(VkCommandBuffer)> recordScenePass)
 {
-    VkCommandBuffer commandBuffer;
-    commandBuffer = m_commandBuffers[m_currentFrame];
+    m_renderGraph->reset();
+
+    RenderGraph::Resource depth = 0;
+    RenderGraph::Resource pyramid = 0;
+    RenderGraph::Resource drawCommands = 0;
+    RenderGraph::Resource drawCount = 0;
+    if (m_gpuCuller)
+    {
+        VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        if (m_device->hasStencilComponent(m_swapchain->getSwapchainDepthFormat()))
+            depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+        // resize the pyramid before importing it, so the graph tracks the image the passes will use
+        m_gpuCuller->setDepthExtent(m_swapchain->getSwapchainExtent());
+        depth = m_renderGraph->importImage("depth", m_swapchain->getDepthImage(), depthAspect);
+        pyramid = m_renderGraph->importImage("depth pyramid", m_gpuCuller->getPyramidImage(), VK_IMAGE_ASPECT_COLOR_BIT, m_gpuCuller->getPyramidLevels());
+        drawCommands = m_renderGraph->importBuffer("draw commands", m_gpuCuller->getDrawCommandBuffer());
+        drawCount = m_renderGraph->importBuffer("draw count", m_gpuCuller->getDrawCountBuffer());
+
+        // the draw buffers are cleared, written by the cull and the count copied back within the pass
+        const RenderGraph::Access cullWrite = { VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED };
+        m_renderGraph->addPass("cull", RenderGraph::PassType::Compute, [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.read(pyramid, RenderGraph::STORAGE_READ_COMPUTE);
+            builder.write(drawCommands, cullWrite);
+            builder.write(drawCount, cullWrite);
+        }, [this](VkCommandBuffer commandBuffer) { m_gpuCuller->recordCull(commandBuffer, m_currentFrame, m_swapchain->getSwapchainExtent()); });
+    }
+
+    // each frame in flight has its own cluster buffer, so only this frame's scene pass reads what the dispatch writes
+    RenderGraph::Resource lightClusters = 0;
+    if (m_lightClusterer)
+    {
+        lightClusters = m_renderGraph->importBuffer("light clusters", m_lightClusterer->getClusterBuffer(m_currentFrame));
+        m_renderGraph->addPass("light clusters", RenderGraph::PassType::Compute, [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.write(lightClusters, RenderGraph::STORAGE_BUFFER_COMPUTE);
+        }, [this](VkCommandBuffer commandBuffer) { m_lightClusterer->recordCluster(commandBuffer, m_currentFrame, m_swapchain->getSwapchainExtent()); });
+    }
+
+    RenderGraph::Resource shadowMap = 0;
+    if (m_shadowMapper)
+    {
+        shadowMap = m_renderGraph->importImage("shadow map", m_shadowMapper->getImage(), VK_IMAGE_ASPECT_DEPTH_BIT);
+        m_renderGraph->addPass("shadows", RenderGraph::PassType::Graphics, [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.write(shadowMap, RenderGraph::DEPTH_ATTACHMENT);
+        }, [this](VkCommandBuffer commandBuffer) { m_shadowMapper->recordShadows(commandBuffer, m_currentFrame); });
+    }
+
+    m_renderGraph->addPass("scene", RenderGraph::PassType::Graphics, [&](RenderGraph::PassBuilder& builder)
+    {
+        builder.sideEffect(); // presents
+        if (m_lightClusterer)
+            builder.read(lightClusters, RenderGraph::STORAGE_BUFFER_FRAGMENT);
+        if (m_shadowMapper)
+            builder.read(shadowMap, RenderGraph::SAMPLED_FRAGMENT);
+        if (!m_gpuCuller)
+            return; // the render pass's own dependencies cover the depth attachment when nothing else reads it
+        builder.write(depth, RenderGraph::DEPTH_ATTACHMENT);
+        builder.read(drawCommands, RenderGraph::INDIRECT_BUFFER);
+        builder.read(drawCount, RenderGraph::INDIRECT_BUFFER);
+    }, recordScenePass);
+
+    if (m_gpuCuller)
+    {
+        m_renderGraph->addPass("depth pyramid", RenderGraph::PassType::Compute, [&](RenderGraph::PassBuilder& builder)
+        {
+            builder.read(depth, RenderGraph::DEPTH_READ_COMPUTE);
+            builder.write(pyramid, RenderGraph::STORAGE_WRITE_COMPUTE);
+        }, [this](VkCommandBuffer commandBuffer) { m_gpuCuller->recordDepthPyramid(commandBuffer, m_swapchain->getDepthImageView()); });
+    }
+
+    m_renderGraph->compile();
+    m_renderGraph->execute(commandBuffer);
+}
+
+void Renderer::recordGpuCulledDraw(VkCommandBuffer commandBuffer, entt::registry& m_registry, const std::vector<VkDescriptorSet>& descriptorSets)
+{
+    auto& renderComp = m_registry.get<Rock::RenderComponent>(m_gpuCulledMesh);
+    VkDescriptorSet sets[] = { descriptorSets[m_currentFrame], m_textureTable ? m_textureTable->getDescriptorSet() : renderComp.descriptorSet, m_gpuCuller->getInstanceDescriptorSet() };
+
+    VkDeviceSize offsets[] = { 0 };
+    m_instancedPipeline->bindGraphics(commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_instancedPipeline->getPipelineLayout(), 0, 3, sets, static_cast<uint32_t>(m_dynamicOffsets.size()), m_dynamicOffsets.data());
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &renderComp.m_vertexBuffer, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, renderComp.m_indexBuffer, 0, renderComp.m_indexType);
+    m_gpuCuller->recordDraw(commandBuffer);
+}
+
+void Renderer::setViewportAndScissor(VkCommandBuffer commandBuffer)
+{
+    VkViewport viewport{};
+    viewport.x = 0.f;
+    viewport.y = 0.f;
+    viewport.width = static_cast<float>(m_swapchain->getSwapchainExtent().width);
+    viewport.height = static_cast<float>(m_swapchain->getSwapchainExtent().height);
+    viewport.minDepth = 0.f;
+    viewport.maxDepth = 1.f;
+
+    VkRect2D scissor{};
+    scissor.offset = { 0, 0 };
+    scissor.extent = m_swapchain->getSwapchainExtent();
+
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void Renderer::bindFrameSets(VkCommandBuffer commandBuffer, Pipeline* pipeline, const std::vector<VkDescriptorSet>& descriptorSets)
+{
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(), 0, 1, &descriptorSets[m_currentFrame], static_cast<uint32_t>(m_dynamicOffsets.size()), m_dynamicOffsets.data());
+    if (m_textureTable)
+    {
+        VkDescriptorSet textureSet = m_textureTable->getDescriptorSet();
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(), 1, 1, &textureSet, 0, nullptr);
+    }
+}
 
+void Renderer::recordEntityDraws(VkCommandBuffer commandBuffer, Pipeline* pipeline, entt::registry& m_registry, const std::vector<entt::entity>& entities, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        auto& renderComp = m_registry.get<Rock::RenderComponent>(entities[i]);
+        auto& transformComp = m_registry.get<Rock::TransformComponent>(entities[i]);
+
+        VkDeviceSize offsets[] = { 0 };
+        if (!m_textureTable)
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(), 1, 1, &renderComp.descriptorSet, 0, nullptr);
+        vkCmdPushConstants(commandBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &transformComp.m_transform);
+        if (renderComp.m_vertexFormat == Rock::VertexFormat::Compact)
+            vkCmdPushConstants(commandBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4), sizeof(glm::mat4), &renderComp.m_dequantise);
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &renderComp.m_vertexBuffer, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, renderComp.m_indexBuffer, 0, renderComp.m_indexType);
+        vkCmdDrawIndexed(commandBuffer, renderComp.m_indexCount, 1, 0, 0, m_textureTable ? renderComp.m_textureIndex : 0); // bindless shaders read the texture index from gl_InstanceIndex
+    }
+}
+
+VkCommandBuffer Renderer::beginSecondary(uint32_t thread)
+{
+    VkCommandBuffer commandBuffer = m_commandPools->acquireSecondary(m_currentFrame, thread);
+
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = m_swapchain->getRenderPass();
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = m_swapchain->getFramebuffer(m_imageIndex);
+    inheritanceInfo.pipelineStatistics = m_gpuProfiler->getInheritedStatistics(); // the scene pass's profiler scope may be counting statistics
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("Failed to begin recording secondary command buffer.");
+    return commandBuffer;
+}
+
+void Renderer::recordScene(VkCommandBuffer commandBuffer, bool parallel, Pipeline* pipeline, entt::registry& m_registry, const std::vector<entt::entity>& entities, const std::vector<VkDescriptorSet>& descriptorSets, std::vector<VkCommandBuffer>& secondaries)
+{
+    if (!parallel)
+    {
+        bindFrameSets(commandBuffer, pipeline, descriptorSets);
+        recordEntityDraws(commandBuffer, pipeline, m_registry, entities, 0, entities.size());
+        if (m_gpuCuller)
+            recordGpuCulledDraw(commandBuffer, m_registry, descriptorSets);
+        return;
+    }
+
+    // one contiguous batch per thread, so each pool is only ever touched by the thread recording its batch
+    size_t batchCount = std::min<size_t>(m_commandPools->getThreadCount(), (entities.size() + MIN_RECORD_BATCH - 1) / MIN_RECORD_BATCH);
+    size_t batchSize = (entities.size() + batchCount - 1) / batchCount;
+    secondaries.resize(batchCount);
+
+    auto recordBatch = [&](uint32_t thread)
+    {
+        size_t begin = thread * batchSize;
+        size_t end = std::min(begin + batchSize, entities.size());
+        VkCommandBuffer secondary = beginSecondary(thread);
+        pipeline->bindGraphics(secondary);
+        setViewportAndScissor(secondary);
+        bindFrameSets(secondary, pipeline, descriptorSets);
+        recordEntityDraws(secondary, pipeline, m_registry, entities, begin, end);
+        if (vkEndCommandBuffer(secondary) != VK_SUCCESS)
+            throw std::runtime_error("Failed to record secondary command buffer.");
+        secondaries[thread] = secondary;
+    };
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(batchCount - 1);
+    for (uint32_t thread = 1; thread < batchCount; thread++)
+        futures.push_back(m_threadPool->submit([&recordBatch, thread]() { recordBatch(thread); }));
+
+    // the calling thread records the first batch instead of idling
+    recordBatch(0);
+    for (std::future<void>& future : futures)
+        future.get();
+
+    if (m_gpuCuller)
+    {
+        VkCommandBuffer secondary = beginSecondary(0);
+        setViewportAndScissor(secondary);
+        recordGpuCulledDraw(secondary, m_registry, descriptorSets);
+        if (vkEndCommandBuffer(secondary) != VK_SUCCESS)
+            throw std::runtime_error("Failed to record secondary command buffer.");
+        secondaries.push_back(secondary);
+    }
+}
+
+void Renderer::submitCommandBuffer(bool compute)
+{
+    ROCK_PROFILE_FUNCTION();
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
 
-    if (!compute)
+    if (compute)
     {
-        VkSemaphore waitSemaphores[] = { m_swapchain->getGraphicsFinishedSemaphore(m_currentFrame), m_swapchain->getImageAvailableSemaphore(m_currentFrame) };
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-
-        submitInfo.waitSemaphoreCount = 2;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
+        // no fence: the graphics submission of the same frame waits on the timeline, and its fence covers both
+        VkCommandBuffer commandBuffer = m_computeCommandBuffers[m_currentFrame];
+        uint64_t signalValue = ++m_computeTimelineValue;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &m_computeTimeline;
+
+        if (vkQueueSubmit(m_device->getComputeQueue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+            throw std::runtime_error("Failed to submit compute command buffer.");
+        return;
     }
 
-    VkSemaphore semaphore = m_swapchain->getGraphicsFinishedSemaphore(m_currentFrame);
-    VkQueue queue = m_device->getGraphicsQueue();
-    VkFence fence = m_swapchain->getFence(m_currentFrame);
+    // the compute timeline is waited on at draw indirect, not vertex input: the particle draw reads its arguments written by the dispatch,
+    // and every later stage, including the vertex fetch of the particle buffer, waits too; the graphics queue is free to start the frame while compute runs
+    VkCommandBuffer commandBuffer = m_commandBuffers[m_currentFrame];
+    VkSemaphore waitSemaphores[] = { m_swapchain->getImageAvailableSemaphore(m_currentFrame), m_computeTimeline };
+    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT };
+    uint64_t waitValues[] = { 0, m_computeTimelineValue }; // binary semaphores ignore their value
+    timelineInfo.waitSemaphoreValueCount = 2;
+    timelineInfo.pWaitSemaphoreValues = waitValues;
+
+    submitInfo.waitSemaphoreCount = 2;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.pWaitDstStageMask = waitStages;
 
+    VkSemaphore semaphore = m_swapchain->getGraphicsFinishedSemaphore(m_currentFrame);
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = &semaphore;
 
-    if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS)
+    if (vkQueueSubmit(m_device->getGraphicsQueue(), 1, &submitInfo, m_swapchain->getFence(m_currentFrame)) != VK_SUCCESS)
         throw std::runtime_error("Failed to submit command buffer.");
 }
 
 void Renderer::submitCommandBuffer()
 {
+    ROCK_PROFILE_FUNCTION();
     VkCommandBuffer commandBuffer = m_commandBuffers[m_currentFrame];
 
     VkSemaphore waitSemaphores[] = { m_swapchain->getImageAvailableSemaphore(m_currentFrame) };
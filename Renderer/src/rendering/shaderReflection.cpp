@@ -0,0 +1,300 @@
+/** \file shaderReflection.cpp */
+
+#include "rendering/shaderReflection.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+    // the subset of the SPIR-V specification needed to find resource variables and size push constant blocks
+    const uint32_t SPIRV_MAGIC = 0x07230203;
+    enum Op : uint32_t
+    {
+        OpEntryPoint = 15,
+        OpTypeInt = 21, OpTypeFloat = 22, OpTypeVector = 23, OpTypeMatrix = 24, OpTypeImage = 25, OpTypeSampler = 26, OpTypeSampledImage = 27,
+        OpTypeArray = 28, OpTypeRuntimeArray = 29, OpTypeStruct = 30, OpTypePointer = 32,
+        OpConstant = 43, OpVariable = 59, OpDecorate = 71, OpMemberDecorate = 72
+    };
+    enum Decoration : uint32_t { Block = 2, BufferBlock = 3, ArrayStride = 6, MatrixStride = 7, BindingDecoration = 33, DescriptorSet = 34, Offset = 35 };
+    enum StorageClass : uint32_t { UniformConstant = 0, Uniform = 2, PushConstant = 9, StorageBuffer = 12 };
+    enum Dim : uint32_t { DimBuffer = 5, DimSubpassData = 6 };
+
+    struct Type
+    {
+        uint32_t op = 0;
+        std::vector<uint32_t> operands; // the instruction's words after its result id
+    };
+
+    struct Module
+    {
+        std::unordered_map<uint32_t, Type> types;
+        std::unordered_map<uint32_t, uint32_t> constants;
+        std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> decorations; // id -> decoration -> literal
+        std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> memberOffsets; // struct id -> member -> offset
+        std::unordered_map<uint32_t, std::unordered_map<uint32_t, uint32_t>> memberMatrixStrides; // struct id -> member -> stride
+
+        bool hasDecoration(uint32_t id, uint32_t decoration) const
+        {
+            auto it = decorations.find(id);
+            return it != decorations.end() && it->second.count(decoration);
+        }
+
+        uint32_t getDecoration(uint32_t id, uint32_t decoration) const
+        {
+            return decorations.at(id).at(decoration);
+        }
+
+        uint32_t getSize(uint32_t typeId, uint32_t matrixStride = 0) const
+        {
+            const Type& type = types.at(typeId);
+            switch (type.op)
+            {
+            case OpTypeInt:
+            case OpTypeFloat:
+                return type.operands[0] / 8;
+            case OpTypeVector:
+                return getSize(type.operands[0]) * type.operands[1];
+            case OpTypeMatrix:
+                return (matrixStride ? matrixStride : getSize(type.operands[0])) * type.operands[1];
+            case OpTypeArray:
+            {
+                uint32_t stride = hasDecoration(typeId, ArrayStride) ? getDecoration(typeId, ArrayStride) : getSize(type.operands[0], matrixStride);
+                return stride * constants.at(type.operands[1]);
+            }
+            case OpTypeRuntimeArray:
+                return 0; // only the members before a trailing runtime sized array have a fixed size
+            case OpTypeStruct:
+            {
+                uint32_t size = 0;
+                for (uint32_t member = 0; member < type.operands.size(); member++)
+                {
+                    uint32_t offset = getMemberOffset(typeId, member);
+                    auto strides = memberMatrixStrides.find(typeId);
+                    uint32_t stride = strides != memberMatrixStrides.end() && strides->second.count(member) ? strides->second.at(member) : 0;
+                    size = std::max(size, offset + getSize(type.operands[member], stride));
+                }
+                return size;
+            }
+            default:
+                throw std::runtime_error("Block contains a type without a defined size.");
+            }
+        }
+
+        uint32_t getMemberOffset(uint32_t structId, uint32_t member) const
+        {
+            auto it = memberOffsets.find(structId);
+            if (it == memberOffsets.end() || !it->second.count(member))
+                throw std::runtime_error("Block member has no offset decoration.");
+            return it->second.at(member);
+        }
+    };
+
+    VkShaderStageFlagBits getExecutionStage(uint32_t executionModel)
+    {
+        switch (executionModel)
+        {
+        case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+        case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+        case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+        case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+        case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+        case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+        default: throw std::runtime_error("Unsupported shader execution model.");
+        }
+    }
+
+    VkDescriptorType getDescriptorType(const Module& module, uint32_t storageClass, uint32_t typeId)
+    {
+        const Type& type = module.types.at(typeId);
+        if (storageClass == StorageBuffer || (storageClass == Uniform && module.hasDecoration(typeId, BufferBlock)))
+            return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        if (storageClass == Uniform)
+            return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        switch (type.op)
+        {
+        case OpTypeSampler:
+            return VK_DESCRIPTOR_TYPE_SAMPLER;
+        case OpTypeSampledImage:
+            return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        case OpTypeImage:
+        {
+            bool storage = type.operands[5] == 2; // sampled operand: 1 for sampling, 2 for read/write
+            if (type.operands[1] == DimBuffer)
+                return storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            if (type.operands[1] == DimSubpassData)
+                return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            return storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+        default:
+            throw std::runtime_error("Unsupported descriptor resource type.");
+        }
+    }
+}
+
+ShaderReflection::ShaderReflection(const std::vector<char>& code)
+{
+    if (code.size() < 5 * sizeof(uint32_t) || code.size() % sizeof(uint32_t) != 0)
+        throw std::runtime_error("Shader code is not a SPIR-V module.");
+    std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+    memcpy(words.data(), code.data(), code.size());
+    if (words[0] != SPIRV_MAGIC)
+        throw std::runtime_error("Shader code is not a SPIR-V module.");
+
+    Module module;
+    std::vector<std::pair<uint32_t, uint32_t>> variables; // variable id, pointer type id
+    bool foundEntryPoint = false;
+    for (size_t i = 5; i < words.size();)
+    {
+        uint32_t wordCount = words[i] >> 16;
+        uint32_t op = words[i] & 0xffff;
+        if (wordCount == 0 || i + wordCount > words.size())
+            throw std::runtime_error("Malformed SPIR-V instruction.");
+        const uint32_t* operands = &words[i + 1];
+        switch (op)
+        {
+        case OpEntryPoint:
+            if (!foundEntryPoint)
+                m_stage = getExecutionStage(operands[0]);
+            foundEntryPoint = true;
+            break;
+        case OpTypeInt: case OpTypeFloat: case OpTypeVector: case OpTypeMatrix: case OpTypeImage: case OpTypeSampler:
+        case OpTypeSampledImage: case OpTypeArray: case OpTypeRuntimeArray: case OpTypeStruct: case OpTypePointer:
+            module.types[operands[0]] = { op, std::vector<uint32_t>(operands + 1, operands + wordCount - 1) };
+            break;
+        case OpConstant:
+            module.constants[operands[1]] = operands[2]; // array lengths are 32 bit integers
+            break;
+        case OpVariable:
+            variables.emplace_back(operands[1], operands[0]);
+            break;
+        case OpDecorate:
+            module.decorations[operands[0]][operands[1]] = wordCount > 3 ? operands[2] : 0;
+            break;
+        case OpMemberDecorate:
+            if (operands[2] == Offset)
+                module.memberOffsets[operands[0]][operands[1]] = operands[3];
+            else if (operands[2] == MatrixStride)
+                module.memberMatrixStrides[operands[0]][operands[1]] = operands[3];
+            break;
+        }
+        i += wordCount;
+    }
+    if (!foundEntryPoint)
+        throw std::runtime_error("SPIR-V module has no entry point.");
+
+    for (const auto& variable : variables)
+    {
+        const Type& pointer = module.types.at(variable.second);
+        uint32_t storageClass = pointer.operands[0];
+        uint32_t typeId = pointer.operands[1];
+
+        if (storageClass == PushConstant)
+        {
+            const Type& block = module.types.at(typeId);
+            uint32_t offset = UINT32_MAX;
+            for (uint32_t member = 0; member < block.operands.size(); member++)
+                offset = std::min(offset, module.getMemberOffset(typeId, member));
+            m_pushConstantOffset = block.operands.empty() ? 0 : offset;
+            m_pushConstantSize = module.getSize(typeId) - m_pushConstantOffset;
+            continue;
+        }
+        if (storageClass != UniformConstant && storageClass != Uniform && storageClass != StorageBuffer)
+            continue;
+        if (!module.hasDecoration(variable.first, DescriptorSet) || !module.hasDecoration(variable.first, BindingDecoration))
+            continue;
+
+        Binding binding;
+        binding.set = module.getDecoration(variable.first, DescriptorSet);
+        binding.binding = module.getDecoration(variable.first, BindingDecoration);
+        binding.count = 1;
+        const Type* type = &module.types.at(typeId);
+        while (type->op == OpTypeArray || type->op == OpTypeRuntimeArray)
+        {
+            binding.count = type->op == OpTypeRuntimeArray ? 0 : binding.count * module.constants.at(type->operands[1]);
+            typeId = type->operands[0];
+            type = &module.types.at(typeId);
+        }
+        binding.type = getDescriptorType(module, storageClass, typeId);
+        if (type->op == OpTypeStruct)
+        {
+            // records the offsets the compiler chose, so C++ mirrors of the block can be checked against the shader
+            binding.blockSize = module.getSize(typeId);
+            uint32_t structId = typeId;
+            const Type* last = type->operands.empty() ? nullptr : &module.types.at(type->operands.back());
+            if (last && last->op == OpTypeRuntimeArray)
+            {
+                binding.arrayStride = module.hasDecoration(type->operands.back(), ArrayStride) ? module.getDecoration(type->operands.back(), ArrayStride) : 0;
+                if (module.types.at(last->operands[0]).op == OpTypeStruct)
+                    structId = last->operands[0];
+            }
+            for (uint32_t member = 0; member < module.types.at(structId).operands.size(); member++)
+                binding.memberOffsets.push_back(module.getMemberOffset(structId, member));
+        }
+        m_bindings.push_back(binding);
+    }
+    std::sort(m_bindings.begin(), m_bindings.end(), [](const Binding& a, const Binding& b) { return a.set != b.set ? a.set < b.set : a.binding < b.binding; });
+}
+
+const ShaderReflection::Binding* ShaderReflection::findBinding(uint32_t set, uint32_t binding) const
+{
+    for (const Binding& b : m_bindings)
+        if (b.set == set && b.binding == binding)
+            return &b;
+    return nullptr;
+}
+
+ReflectedLayout ShaderReflection::merge(const std::vector<const ShaderReflection*>& stages, uint32_t dynamicSets)
+{
+    ReflectedLayout layout;
+    uint32_t pushConstantEnd = 0;
+    for (const ShaderReflection* stage : stages)
+    {
+        for (const Binding& binding : stage->m_bindings)
+        {
+            VkDescriptorType type = binding.type;
+            if (binding.set < 32 && (dynamicSets & (1u << binding.set)))
+            {
+                if (type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+                    type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                else if (type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+                    type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            }
+
+            if (layout.sets.size() <= binding.set)
+                layout.sets.resize(binding.set + 1);
+            std::vector<VkDescriptorSetLayoutBinding>& set = layout.sets[binding.set];
+            auto it = std::find_if(set.begin(), set.end(), [&](const VkDescriptorSetLayoutBinding& b) { return b.binding == binding.binding; });
+            if (it != set.end())
+            {
+                if (it->descriptorType != type || it->descriptorCount != binding.count)
+                    throw std::runtime_error("Shader stages declare different resources at the same set and binding.");
+                it->stageFlags |= stage->m_stage;
+                continue;
+            }
+
+            VkDescriptorSetLayoutBinding layoutBinding{};
+            layoutBinding.binding = binding.binding;
+            layoutBinding.descriptorType = type;
+            layoutBinding.descriptorCount = binding.count;
+            layoutBinding.stageFlags = stage->m_stage;
+            layoutBinding.pImmutableSamplers = nullptr;
+            set.push_back(layoutBinding);
+        }
+
+        if (stage->m_pushConstantSize == 0)
+            continue;
+        // one range covering every stage's block, so any stage may be pushed to with the combined flags
+        if (layout.pushConstants.stageFlags == 0)
+            layout.pushConstants.offset = stage->m_pushConstantOffset;
+        layout.pushConstants.offset = std::min(layout.pushConstants.offset, stage->m_pushConstantOffset);
+        pushConstantEnd = std::max(pushConstantEnd, stage->m_pushConstantOffset + stage->m_pushConstantSize);
+        layout.pushConstants.size = pushConstantEnd - layout.pushConstants.offset;
+        layout.pushConstants.stageFlags |= stage->m_stage;
+    }
+
+    for (auto& set : layout.sets)
+        std::sort(set.begin(), set.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+    return layout;
+}
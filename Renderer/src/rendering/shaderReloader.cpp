@@ -0,0 +1,228 @@
+/** \file shaderReloader.cpp */
+
+#include "rendering/shaderReloader.hpp"
+#include "rendering/pipelineCache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+ShaderReloader::ShaderReloader(Device* device, ThreadPool* threadPool, uint32_t framesInFlight)
+    : m_device(device), m_threadPool(threadPool), m_framesInFlight(framesInFlight), m_compiler(getCompilerPath()), m_lastPoll(std::chrono::steady_clock::now())
+{
+}
+
+ShaderReloader::~ShaderReloader()
+{
+    for (Shader& shader : m_shaders)
+    {
+        if (shader.compile.valid())
+            shader.compile.wait();
+    }
+    for (WatchedPipeline& watched : m_pipelines)
+    {
+        if (!watched.pending.valid())
+            continue;
+        try
+        {
+            Pipeline* pipeline = watched.pending.get();
+            pipeline->destroyPipelineLayout();
+            delete pipeline;
+        }
+        catch (const std::exception&)
+        {
+        }
+    }
+    for (auto& retired : m_retired)
+    {
+        retired.first->destroyPipelineLayout();
+        delete retired.first;
+    }
+    m_device = nullptr;
+}
+
+std::string ShaderReloader::getCompilerPath()
+{
+    const char* sdk = std::getenv("VULKAN_SDK");
+    if (sdk == nullptr)
+        return "glslc";
+#ifdef _WIN32
+    return std::string(sdk) + "/Bin/glslc.exe";
+#else
+    return std::string(sdk) + "/bin/glslc";
+#endif
+}
+
+std::string ShaderReloader::getCompileCommand(const std::string& compiler, const std::string& sourcePath, const std::string& spvPath, const std::string& defines)
+{
+    std::string command = "\"" + compiler + "\" ";
+    if (!defines.empty())
+        command += defines + " ";
+    command += "\"" + sourcePath + "\" -o \"" + spvPath + "\" 2>&1";
+#ifdef _WIN32
+    command = "\"" + command + "\""; // cmd.exe strips the outer quotes when the command starts with one
+#endif
+    return command;
+}
+
+void ShaderReloader::addShader(const std::string& sourcePath, const std::string& spvPath, const std::string& defines)
+{
+    Shader shader;
+    shader.sourcePath = sourcePath;
+    shader.spvPath = spvPath;
+    shader.defines = defines;
+    std::error_code error;
+    shader.lastWrite = std::filesystem::last_write_time(sourcePath, error);
+    m_shaders.push_back(std::move(shader));
+}
+
+void ShaderReloader::watchPipeline(Pipeline*& pipeline, std::function<std::future<Pipeline*>()> rebuild, std::function<void(Pipeline*)> onSwap)
+{
+    WatchedPipeline watched;
+    watched.slot = &pipeline;
+    watched.rebuild = std::move(rebuild);
+    watched.onSwap = std::move(onSwap);
+    m_pipelines.push_back(std::move(watched));
+}
+
+void ShaderReloader::update()
+{
+    poll();
+
+    std::vector<std::string> changed;
+    for (Shader& shader : m_shaders)
+    {
+        if (!shader.compile.valid() || shader.compile.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+        if (shader.compile.get())
+        {
+            std::cout << "[ShaderReloader] Recompiled " << shader.sourcePath << std::endl;
+            m_device->getPipelineCache()->invalidateShaderModule(shader.spvPath);
+            changed.push_back(shader.spvPath);
+        }
+    }
+    if (!changed.empty())
+        rebuildPipelines(changed);
+
+    for (WatchedPipeline& watched : m_pipelines)
+    {
+        if (!watched.pending.valid() || watched.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+        try
+        {
+            Pipeline* pipeline = watched.pending.get();
+            // frames already recorded keep the old pipeline alive through the retire queue, so no device wait is needed
+            retire(*watched.slot);
+            *watched.slot = pipeline;
+            if (watched.onSwap)
+                watched.onSwap(pipeline);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "[ShaderReloader] Keeping the previous pipeline: " << e.what() << std::endl;
+        }
+        if (watched.stale)
+        {
+            watched.stale = false;
+            watched.pending = watched.rebuild();
+        }
+    }
+
+    for (auto it = m_retired.begin(); it != m_retired.end();)
+    {
+        if (--it->second > 0)
+        {
+            ++it;
+            continue;
+        }
+        it->first->destroyPipelineLayout();
+        delete it->first;
+        it = m_retired.erase(it);
+    }
+}
+
+void ShaderReloader::poll()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastPoll < std::chrono::milliseconds(POLL_INTERVAL_MS))
+        return;
+    m_lastPoll = now;
+
+    for (Shader& shader : m_shaders)
+    {
+        if (shader.compile.valid())
+            continue;
+        std::error_code error;
+        std::filesystem::file_time_type lastWrite = std::filesystem::last_write_time(shader.sourcePath, error);
+        if (error || lastWrite == shader.lastWrite)
+            continue;
+        shader.lastWrite = lastWrite;
+
+        auto task = std::make_shared<std::packaged_task<bool()>>(std::bind(&ShaderReloader::compileShader, m_compiler, shader.sourcePath, shader.spvPath, shader.defines));
+        shader.compile = task->get_future();
+        m_threadPool->submit([task]() { (*task)(); });
+    }
+}
+
+void ShaderReloader::rebuildPipelines(const std::vector<std::string>& changed)
+{
+    for (WatchedPipeline& watched : m_pipelines)
+    {
+        Pipeline* pipeline = *watched.slot;
+        if (pipeline == nullptr)
+            continue;
+        bool affected = false;
+        for (const std::string& filepath : pipeline->getShaderFilepaths())
+            affected = affected || std::find(changed.begin(), changed.end(), filepath) != changed.end();
+        if (!affected)
+            continue;
+
+        if (watched.pending.valid())
+            watched.stale = true;
+        else
+            watched.pending = watched.rebuild();
+    }
+}
+
+void ShaderReloader::retire(Pipeline* pipeline)
+{
+    if (pipeline != nullptr)
+        m_retired.emplace_back(pipeline, m_framesInFlight + 1);
+}
+
+bool ShaderReloader::compileShader(const std::string& compiler, const std::string& sourcePath, const std::string& spvPath, const std::string& defines)
+{
+    // glslc writes to a temporary file so a failed compile never leaves a broken .spv for the next pipeline build
+    std::string tempPath = spvPath + ".tmp";
+    FILE* pipe = popen(getCompileCommand(compiler, sourcePath, tempPath, defines).c_str(), "r");
+    if (pipe == nullptr)
+    {
+        std::cerr << "[ShaderReloader] Failed to run " << compiler << std::endl;
+        return false;
+    }
+    std::string output;
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+        output += buffer;
+    if (pclose(pipe) != 0)
+    {
+        std::cerr << "[ShaderReloader] " << sourcePath << " failed to compile:" << std::endl << output;
+        std::error_code error;
+        std::filesystem::remove(tempPath, error);
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, spvPath, error);
+    if (error)
+    {
+        std::cerr << "[ShaderReloader] Failed to replace " << spvPath << ": " << error.message() << std::endl;
+        return false;
+    }
+    return true;
+}
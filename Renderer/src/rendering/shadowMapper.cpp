@@ -0,0 +1,446 @@
+/** \file shadowMapper.cpp */
+
+#include "rendering/shadowMapper.hpp"
+#include "rendering/compactVertex.hpp"
+#include "rendering/gpuLayout.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static_assert(sizeof(ShadowMapper::ShadowUniforms) == 304, "ShadowUniforms must match the std140 ShadowUBO block in main.frag");
+GPU_LAYOUT_MEMBER(Std140, ShadowMapper::ShadowUniforms, viewProjections, splitDepths);
+GPU_LAYOUT_MEMBER(Std140, ShadowMapper::ShadowUniforms, splitDepths, texelWorldSizes);
+GPU_LAYOUT_MEMBER(Std140, ShadowMapper::ShadowUniforms, texelWorldSizes, filtering);
+
+ShadowMapper::ShadowMapper(Device* device, uint32_t maxCasters, uint32_t resolution, const std::string& shaderDirectory)
+    : m_device(device), m_maxCasters(maxCasters), m_resolution(resolution)
+{
+    if (m_maxCasters == 0)
+        throw std::runtime_error("Shadow mapper capacity must be at least one caster.");
+
+    for (Cascade& cascade : m_cascades)
+        cascade = { glm::mat4(1.f), 0.f, 0.f };
+    createImage();
+    createRenderPass();
+    createDescriptorSetLayout();
+    createPipelines(shaderDirectory);
+    createBuffers();
+    createDescriptorSets();
+}
+
+ShadowMapper::~ShadowMapper()
+{
+    for (size_t i = 0; i < Swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        vkDestroyBuffer(m_device->getDevice(), m_instanceBuffers[i], nullptr);
+        vkFreeMemory(m_device->getDevice(), m_instanceBuffersMemory[i], nullptr);
+    }
+
+    vkDestroyDescriptorPool(m_device->getDevice(), m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device->getDevice(), m_setLayout, nullptr);
+
+    for (Pipeline*& pipeline : m_pipelines)
+    {
+        pipeline->destroyPipelineLayout();
+        delete pipeline;
+        pipeline = nullptr;
+    }
+
+    for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++)
+    {
+        vkDestroyFramebuffer(m_device->getDevice(), m_framebuffers[cascade], nullptr);
+        vkDestroyImageView(m_device->getDevice(), m_layerViews[cascade], nullptr);
+    }
+    vkDestroyRenderPass(m_device->getDevice(), m_renderPass, nullptr);
+    vkDestroySampler(m_device->getDevice(), m_sampler, nullptr);
+    vkDestroyImageView(m_device->getDevice(), m_arrayView, nullptr);
+    vkDestroyImage(m_device->getDevice(), m_image, nullptr);
+    vkFreeMemory(m_device->getDevice(), m_imageMemory, nullptr);
+    m_device = nullptr;
+}
+
+std::vector<float> ShadowMapper::getSplitDepths(float zNear, float zFar, uint32_t count, float lambda)
+{
+    // logarithmic splits keep the texel density constant in screen space, but leave the first cascade tiny, so they are blended with uniform splits
+    std::vector<float> splits(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        float fraction = static_cast<float>(i + 1) / static_cast<float>(count);
+        float logarithmic = zNear * std::pow(zFar / zNear, fraction);
+        float uniform = zNear + (zFar - zNear) * fraction;
+        splits[i] = lambda * logarithmic + (1.f - lambda) * uniform;
+    }
+    splits[count - 1] = zFar;
+    return splits;
+}
+
+ShadowMapper::Cascade ShadowMapper::fitCascade(const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar, float splitNear, float splitFar, const glm::vec3& lightDirection, uint32_t resolution, float casterDistance)
+{
+    // the corners of the slice lie along the edges of the frustum, between its near and far corners
+    glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+    glm::vec3 corners[8];
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        glm::vec2 ndc((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f);
+        glm::vec4 nearCorner = inverseViewProjection * glm::vec4(ndc, 0.f, 1.f);
+        glm::vec4 farCorner = inverseViewProjection * glm::vec4(ndc, 1.f, 1.f);
+        glm::vec3 nearPoint = glm::vec3(nearCorner) / nearCorner.w;
+        glm::vec3 edge = glm::vec3(farCorner) / farCorner.w - nearPoint;
+        corners[i] = nearPoint + edge * ((splitNear - zNear) / (zFar - zNear));
+        corners[i + 4] = nearPoint + edge * ((splitFar - zNear) / (zFar - zNear));
+    }
+
+    // a sphere keeps the same size however the camera turns, so the projection only ever moves, never scales
+    glm::vec3 centre(0.f);
+    for (const glm::vec3& corner : corners)
+        centre += corner;
+    centre /= 8.f;
+    float radius = 0.f;
+    for (const glm::vec3& corner : corners)
+        radius = std::max(radius, glm::length(corner - centre));
+    radius = std::ceil(radius * 16.f) / 16.f;
+
+    // the light view never moves with the camera, so snapping the centre to whole texels in it keeps every texel on the same world positions
+    glm::vec3 direction = glm::normalize(lightDirection);
+    glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+    glm::mat4 lightView = glm::lookAt(glm::vec3(0.f), direction, up);
+    float texelWorldSize = 2.f * radius / static_cast<float>(resolution);
+    glm::vec3 lightCentre = glm::vec3(lightView * glm::vec4(centre, 1.f));
+    lightCentre.x = std::floor(lightCentre.x / texelWorldSize) * texelWorldSize;
+    lightCentre.y = std::floor(lightCentre.y / texelWorldSize) * texelWorldSize;
+
+    // casters between the light and the slice still shadow it, so the near plane is pulled back towards the light; depth is zero to one whether or not this file sees GLM_FORCE_DEPTH_ZERO_TO_ONE
+    glm::mat4 lightProjection = glm::orthoRH_ZO(lightCentre.x - radius, lightCentre.x + radius, lightCentre.y - radius, lightCentre.y + radius,
+        -lightCentre.z - radius - casterDistance, -lightCentre.z + radius);
+
+    Cascade cascade{};
+    cascade.viewProjection = lightProjection * lightView;
+    cascade.splitDepth = splitFar;
+    cascade.texelWorldSize = texelWorldSize;
+    return cascade;
+}
+
+void ShadowMapper::batchCasters(entt::registry& registry, const std::vector<entt::entity>& casters, std::vector<glm::mat4>& instances, std::vector<Batch>& batches)
+{
+    // sorting by mesh turns every caster sharing a vertex buffer into one instanced draw
+    std::vector<entt::entity> sorted = casters;
+    std::sort(sorted.begin(), sorted.end(), [&registry](entt::entity a, entt::entity b) {
+        return registry.get<Rock::RenderComponent>(a).m_vertexBuffer < registry.get<Rock::RenderComponent>(b).m_vertexBuffer;
+    });
+
+    size_t firstBatch = batches.size();
+    for (entt::entity entity : sorted)
+    {
+        const Rock::RenderComponent& renderComp = registry.get<Rock::RenderComponent>(entity);
+        if (batches.size() == firstBatch || batches.back().vertexBuffer != renderComp.m_vertexBuffer)
+            batches.push_back({ renderComp.m_vertexBuffer, renderComp.m_indexBuffer, renderComp.m_indexType, renderComp.m_indexCount, renderComp.m_vertexFormat, static_cast<uint32_t>(instances.size()), 0 });
+        batches.back().instanceCount++;
+
+        // compact positions are dequantised by the model matrix, so both formats share shadow.vert
+        glm::mat4 model = registry.get<Rock::TransformComponent>(entity).m_transform;
+        instances.push_back(renderComp.m_vertexFormat == Rock::VertexFormat::Compact ? model * renderComp.m_dequantise : model);
+    }
+}
+
+ShadowMapper::ShadowUniforms ShadowMapper::getUniforms() const
+{
+    ShadowUniforms uniforms{};
+    for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++)
+    {
+        uniforms.viewProjections[cascade] = m_cascades[cascade].viewProjection;
+        uniforms.splitDepths[cascade] = m_cascades[cascade].splitDepth;
+        uniforms.texelWorldSizes[cascade] = m_cascades[cascade].texelWorldSize;
+    }
+    uniforms.filtering = glm::vec4(1.f / static_cast<float>(m_resolution), 1.5f, 1.f, 0.f);
+    return uniforms;
+}
+
+void ShadowMapper::update(const glm::mat4& view, const glm::mat4& projection, float zNear, float zFar, const glm::vec3& lightDirection)
+{
+    std::vector<float> splits = getSplitDepths(zNear, zFar, CASCADE_COUNT, m_splitLambda);
+    for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++)
+        m_cascades[cascade] = fitCascade(view, projection, zNear, zFar, cascade == 0 ? zNear : splits[cascade - 1], splits[cascade], lightDirection, m_resolution, m_casterDistance);
+}
+
+void ShadowMapper::setCasters(uint32_t frame, entt::registry& registry, const std::vector<entt::entity>& casters, ThreadPool* threadPool)
+{
+    if (casters.size() > m_maxCasters)
+        throw std::runtime_error("Too many shadow casters for the instance buffer.");
+
+    // the bounds are transformed once and tested against every cascade
+    m_culling.gather(registry, casters);
+    m_instances.clear();
+    for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++)
+    {
+        m_culling.cull(Rock::Frustum::fromMatrix(m_cascades[cascade].viewProjection), m_cascadeCasters[cascade], threadPool);
+        m_batches[cascade].clear();
+        batchCasters(registry, m_cascadeCasters[cascade], m_instances, m_batches[cascade]);
+    }
+    memcpy(m_instanceBuffersMapped[frame], m_instances.data(), sizeof(glm::mat4) * m_instances.size());
+}
+
+void ShadowMapper::recordShadows(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    VkViewport viewport{ 0.f, 0.f, static_cast<float>(m_resolution), static_cast<float>(m_resolution), 0.f, 1.f };
+    VkRect2D scissor{ { 0, 0 }, { m_resolution, m_resolution } };
+    VkClearValue clearValue{};
+    clearValue.depthStencil = { 1.f, 0 };
+
+    for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++)
+    {
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = m_renderPass;
+        renderPassInfo.framebuffer = m_framebuffers[cascade];
+        renderPassInfo.renderArea = scissor;
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearValue;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        Pipeline* bound = nullptr;
+        for (const Batch& batch : m_batches[cascade])
+        {
+            Pipeline* pipeline = m_pipelines[batch.vertexFormat == Rock::VertexFormat::Compact ? 1 : 0];
+            if (pipeline != bound)
+            {
+                pipeline->bindGraphics(commandBuffer);
+                vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineLayout(), 0, 1, &m_sets[frame], 0, nullptr);
+                vkCmdPushConstants(commandBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &m_cascades[cascade].viewProjection);
+                bound = pipeline;
+            }
+
+            VkDeviceSize offsets[] = { 0 };
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &batch.vertexBuffer, offsets);
+            vkCmdBindIndexBuffer(commandBuffer, batch.indexBuffer, 0, batch.indexType);
+            vkCmdDrawIndexed(commandBuffer, batch.indexCount, batch.instanceCount, 0, 0, batch.firstInstance); // shadow.vert reads the model matrix at gl_InstanceIndex
+        }
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+void ShadowMapper::createImage()
+{
+    // linear filtering lets the comparison sampler blend four depth tests per fetch
+    m_format = m_device->findSupportedFormat({ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM }, VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = { m_resolution, m_resolution, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = CASCADE_COUNT;
+    imageInfo.format = m_format;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateImage(m_device->getDevice(), &imageInfo, nullptr, &m_image) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow map.");
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(m_device->getDevice(), m_image, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = m_device->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (vkAllocateMemory(m_device->getDevice(), &allocInfo, nullptr, &m_imageMemory) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate shadow map memory.");
+    vkBindImageMemory(m_device->getDevice(), m_image, m_imageMemory, 0);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = m_image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format = m_format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = CASCADE_COUNT;
+    if (vkCreateImageView(m_device->getDevice(), &viewInfo, nullptr, &m_arrayView) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow map view.");
+
+    for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++)
+    {
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.subresourceRange.baseArrayLayer = cascade;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(m_device->getDevice(), &viewInfo, nullptr, &m_layerViews[cascade]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create shadow cascade view.");
+    }
+
+    // outside the map counts as lit, so the border is the far plane
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.minLod = 0.f;
+    samplerInfo.maxLod = 0.f;
+    if (vkCreateSampler(m_device->getDevice(), &samplerInfo, nullptr, &m_sampler) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow map sampler.");
+}
+
+void ShadowMapper::createRenderPass()
+{
+    // the render graph moves the map between the attachment and sampled layouts within a frame, so the pass never transitions it
+    VkAttachmentDescription depthAttachment{};
+    depthAttachment.format = m_format;
+    depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference depthAttachmentRef{};
+    depthAttachmentRef.attachment = 0;
+    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 0;
+    subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+    // every frame in flight shares the map, so the writes wait for the previous frame's scene pass to finish sampling it
+    VkSubpassDependency dependency{};
+    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependency.dstSubpass = 0;
+    dependency.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    dependency.srcAccessMask = 0;
+    dependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    dependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+    VkRenderPassCreateInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &depthAttachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+    renderPassInfo.dependencyCount = 1;
+    renderPassInfo.pDependencies = &dependency;
+    if (vkCreateRenderPass(m_device->getDevice(), &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow render pass.");
+
+    for (uint32_t cascade = 0; cascade < CASCADE_COUNT; cascade++)
+    {
+        VkFramebufferCreateInfo framebufferInfo{};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = m_renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &m_layerViews[cascade];
+        framebufferInfo.width = m_resolution;
+        framebufferInfo.height = m_resolution;
+        framebufferInfo.layers = 1;
+        if (vkCreateFramebuffer(m_device->getDevice(), &framebufferInfo, nullptr, &m_framebuffers[cascade]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create shadow framebuffer.");
+    }
+}
+
+void ShadowMapper::createDescriptorSetLayout()
+{
+    VkDescriptorSetLayoutBinding binding{ 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT, nullptr };
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+    if (vkCreateDescriptorSetLayout(m_device->getDevice(), &layoutInfo, nullptr, &m_setLayout) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow descriptor set layout.");
+}
+
+void ShadowMapper::createPipelines(const std::string& shaderDirectory)
+{
+    VkPushConstantRange pushConstantRange{ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4) };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    for (uint32_t format = 0; format < 2; format++)
+    {
+        PipelineSettings pipelineSettings;
+        Pipeline::defaultPipelineSettings(pipelineSettings);
+        Pipeline::enableDepthOnly(pipelineSettings);
+        // only the position is read, which shadow.vert takes as a vec3 from either format
+        pipelineSettings.bindingDescription = format == 0 ? Vertex::getBindingDescription() : CompactVertex::getBindingDescription();
+        pipelineSettings.attributeDescriptions = { (format == 0 ? Vertex::getAttributeDescriptions() : CompactVertex::getAttributeDescriptions())[0] };
+        // both faces cast, and the slope scaled bias keeps surfaces facing the light from shadowing themselves
+        pipelineSettings.rasteriser.cullMode = VK_CULL_MODE_NONE;
+        pipelineSettings.rasteriser.depthBiasEnable = VK_TRUE;
+        pipelineSettings.rasteriser.depthBiasConstantFactor = 1.25f;
+        pipelineSettings.rasteriser.depthBiasSlopeFactor = 1.75f;
+        pipelineSettings.renderPass = m_renderPass;
+        pipelineSettings.subpass = 0;
+        m_pipelines[format] = new Pipeline(m_device, pipelineLayoutInfo, pipelineSettings, shaderDirectory + "shadow.spv", "");
+    }
+}
+
+void ShadowMapper::createBuffers()
+{
+    m_instanceBuffers.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_instanceBuffersMemory.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    m_instanceBuffersMapped.resize(Swapchain::MAX_FRAMES_IN_FLIGHT);
+
+    // a caster can be in every cascade, and the casters move every frame, so each frame writes its own host visible copy
+    VkDeviceSize size = sizeof(glm::mat4) * m_maxCasters * CASCADE_COUNT;
+    for (size_t i = 0; i < Swapchain::MAX_FRAMES_IN_FLIGHT; i++)
+    {
+        m_device->createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_instanceBuffers[i], m_instanceBuffersMemory[i]);
+        vkMapMemory(m_device->getDevice(), m_instanceBuffersMemory[i], 0, size, 0, &m_instanceBuffersMapped[i]);
+    }
+}
+
+void ShadowMapper::createDescriptorSets()
+{
+    uint32_t frames = static_cast<uint32_t>(Swapchain::MAX_FRAMES_IN_FLIGHT);
+    VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frames };
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = frames;
+    if (vkCreateDescriptorPool(m_device->getDevice(), &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow descriptor pool.");
+
+    std::vector<VkDescriptorSetLayout> layouts(frames, m_setLayout);
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = frames;
+    allocInfo.pSetLayouts = layouts.data();
+    m_sets.resize(frames);
+    if (vkAllocateDescriptorSets(m_device->getDevice(), &allocInfo, m_sets.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate shadow descriptor sets.");
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        VkDescriptorBufferInfo instanceInfo{ m_instanceBuffers[i], 0, VK_WHOLE_SIZE };
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = m_sets[i];
+        write.dstBinding = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.pBufferInfo = &instanceInfo;
+        vkUpdateDescriptorSets(m_device->getDevice(), 1, &write, 0, nullptr);
+    }
+}
@@ -2,9 +2,9 @@
 
 #include "rendering/swapchain.hpp"
 
-Swapchain::Swapchain(Device* device, VkSampleCountFlagBits msaaSamples, bool resources) : m_device(device), m_resources(resources)
+Swapchain::Swapchain(Device* device, VkSampleCountFlagBits msaaSamples, bool resources, VkPresentModeKHR presentMode, bool sampledDepth) : m_device(device), m_resources(resources), m_sampledDepth(sampledDepth)
 {
-    createSwapchain();
+    createSwapchain(presentMode);
     createImageViews();
     if (m_resources)
         createResources(msaaSamples);
@@ -13,10 +13,10 @@ Swapchain::Swapchain(Device* device, VkSampleCountFlagBits msaaSamples, bool res
     createSyncObjects();
 }
 
-Swapchain::Swapchain(Device* device, Swapchain* oldSwapchain, VkSampleCountFlagBits msaaSamples) : m_device(device)
+Swapchain::Swapchain(Device* device, Swapchain* oldSwapchain, VkSampleCountFlagBits msaaSamples, VkPresentModeKHR presentMode, bool sampledDepth) : m_device(device), m_sampledDepth(sampledDepth)
 {
     m_resources = oldSwapchain->getResources();
-    createSwapchain(oldSwapchain->getSwapchain());
+    createSwapchain(presentMode, oldSwapchain->getSwapchain());
     createImageViews();
     if (m_resources)
         createResources(msaaSamples);
@@ -63,12 +63,12 @@ Swapchain::~Swapchain()
     m_device = nullptr;
 }
 
-void Swapchain::createSwapchain(VkSwapchainKHR oldSwapchain)
+void Swapchain::createSwapchain(VkPresentModeKHR presentMode, VkSwapchainKHR oldSwapchain)
 {
     SwapChainSupportDetails swapchainSupport = m_device->getSwapChainSupport();
 
     VkSurfaceFormatKHR surfaceFormat = chooseSurfaceFormat(swapchainSupport.formats);
-    VkPresentModeKHR presentMode = choosePresentMode(swapchainSupport.presentModes);
+    presentMode = choosePresentMode(swapchainSupport.presentModes, presentMode);
     VkExtent2D extent = chooseExtent(swapchainSupport.capabilities);
 
     uint32_t imageCount = swapchainSupport.capabilities.minImageCount + 1;
@@ -115,6 +115,7 @@ void Swapchain::createSwapchain(VkSwapchainKHR oldSwapchain)
     vkGetSwapchainImagesKHR(m_device->getDevice(), m_swapchain, &imageCount, m_swapchainImages.data());
 
     m_swapchainImageFormat = surfaceFormat.format;
+    m_presentMode = presentMode;
     m_swapchainExtent = extent;
     m_swapchainDepthFormat = findDepthFormat();
 }
@@ -138,8 +139,11 @@ void Swapchain::createResources(VkSampleCountFlagBits msaaSamples)
     m_colourImageView = m_device->createImageView(m_colourImage, format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 
     format = m_swapchainDepthFormat;
+    VkImageUsageFlags depthUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    if (m_sampledDepth)
+        depthUsage |= VK_IMAGE_USAGE_SAMPLED_BIT; // sampled when building the depth pyramid for occlusion culling
     m_device->createImage(m_swapchainExtent.width, m_swapchainExtent.height, 1, msaaSamples, format, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
+        depthUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImage, m_depthImageMemory);
     m_depthImageView = m_device->createImageView(m_depthImage, format, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 }
 
@@ -182,7 +186,7 @@ void Swapchain::createRenderPass(VkSampleCountFlagBits msaaSamples)
         depthAttachment.format = m_swapchainDepthFormat;
         depthAttachment.samples = msaaSamples;
         depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.storeOp = m_sampledDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE; // kept for the depth pyramid
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -292,20 +296,19 @@ VkSurfaceFormatKHR Swapchain::chooseSurfaceFormat(const std::vector<VkSurfaceFor
     return availableFormats[0];
 }
 
-VkPresentModeKHR Swapchain::choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes)
+VkPresentModeKHR Swapchain::choosePresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes, VkPresentModeKHR preferred)
 {
-#ifdef FRAMERATE_CAP
-    return VK_PRESENT_MODE_FIFO_KHR;
-#endif
-    for (const auto& availablePresentMode : availablePresentModes)
-    {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-            return availablePresentMode;
-    }
-    for (const auto& availablePresentMode : availablePresentModes)
+    // uncapped modes fall back to each other before vsync, and relaxed vsync falls back to vsync
+    std::vector<VkPresentModeKHR> candidates = { preferred };
+    if (preferred == VK_PRESENT_MODE_MAILBOX_KHR)
+        candidates.push_back(VK_PRESENT_MODE_IMMEDIATE_KHR);
+    else if (preferred == VK_PRESENT_MODE_IMMEDIATE_KHR)
+        candidates.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+
+    for (VkPresentModeKHR candidate : candidates)
     {
-        if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR)
-            return availablePresentMode;
+        if (std::find(availablePresentModes.begin(), availablePresentModes.end(), candidate) != availablePresentModes.end())
+            return candidate;
     }
 
     return VK_PRESENT_MODE_FIFO_KHR;
@@ -16,6 +16,7 @@
 #include <fstream>
 #include <random>
 #include <chrono>
+#include <atomic>
 
 // Vulkan header
 #include <vulkan/vulkan.h>
@@ -54,9 +55,29 @@
 #include "core/device.hpp"
 #include "rendering/swapchain.hpp"
 #include "rendering/pipeline.hpp"
+#include "rendering/pipelineCache.hpp"
+#include "rendering/shaderReflection.hpp"
+#include "rendering/renderGraph.hpp"
+#include "rendering/gpuProfiler.hpp"
+#include "rendering/pngWriter.hpp"
+#include "rendering/offscreenTarget.hpp"
+#include "rendering/particleSystem.hpp"
+#include "rendering/gpuPhysics.hpp"
+#include "rendering/lightClusterer.hpp"
+#include "rendering/shadowMapper.hpp"
+#include "rendering/gpuCuller.hpp"
 #include "core/descriptors.hpp"
 #include "rendering/renderer.hpp"
 #include "core/application.hpp"
+#include "rendering/meshBuilder.hpp"
+#include "rendering/meshOptimiser.hpp"
+#include "rendering/meshFile.hpp"
+#include "rendering/compactVertex.hpp"
+#include "rendering/culling.hpp"
+#include "core/threadPool.hpp"
+#include "core/cpuProfiler.hpp"
+#include "core/frameLimiter.hpp"
+#include "core/frameAllocator.hpp"
 #include "examples/computeApp.hpp"
 #include "examples/engineApp.hpp"
 
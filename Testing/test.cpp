@@ -46,6 +46,29 @@ std::vector<VkFramebuffer> m_framebuffers;
 std::vector<VkSemaphore> m_semaphores;
 std::vector<VkFence> m_fences;
 
+// shaders are compiled by setup.bat and read relative to Testing/; a file that has not been built reads as empty
+std::vector<char> readShader(const std::string& filepath)
+{
+    std::ifstream file(filepath, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+        return {};
+    std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(buffer.data(), buffer.size());
+    return buffer;
+}
+
+// names the first shader setup.bat has not built, so a test fails clearly rather than throwing from pipeline creation
+testing::AssertionResult shadersCompiled(const std::string& directory, std::initializer_list<const char*> names)
+{
+    for (const char* name : names)
+    {
+        if (!std::ifstream(directory + name + ".spv").is_open())
+            return testing::AssertionFailure() << directory << name << ".spv has not been compiled; run setup.bat";
+    }
+    return testing::AssertionSuccess();
+}
+
 Test::~Test()
 {
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
@@ -349,6 +372,1565 @@ TEST(PhysicsEngine, TestRigidbodyComponent)
     ASSERT_LT(transformComp.m_translation.y, 0.f);
 }
 
+TEST(MeshTests, TestMeshBuilder)
+{
+    Rock::MeshBuilder builder(6);
+    Vertex a{ glm::vec3(0.f, 0.f, 0.f), glm::vec2(0.f, 0.f), glm::vec3(0.f, 1.f, 0.f) };
+    Vertex b{ glm::vec3(1.f, 0.f, 0.f), glm::vec2(1.f, 0.f), glm::vec3(0.f, 1.f, 0.f) };
+    Vertex c{ glm::vec3(0.f, 0.f, 1.f), glm::vec2(0.f, 1.f), glm::vec3(0.f, 1.f, 0.f) };
+    Vertex negativeZero{ glm::vec3(-0.f, 0.f, -0.f), glm::vec2(0.f, -0.f), glm::vec3(-0.f, 1.f, 0.f) };
+
+    ASSERT_EQ(builder.addVertex(a), 0u);
+    ASSERT_EQ(builder.addVertex(b), 1u);
+    ASSERT_EQ(builder.addVertex(c), 2u);
+    ASSERT_EQ(builder.addVertex(c), 2u);
+    ASSERT_EQ(builder.addVertex(b), 1u);
+    ASSERT_EQ(builder.addVertex(negativeZero), 0u);
+    ASSERT_EQ(builder.getVertices().size(), 3u);
+    ASSERT_EQ(builder.getIndices(), std::vector<uint32_t>({ 0, 1, 2, 2, 1, 0 }));
+
+    // grow well past the reserved capacity to exercise rehashing
+    for (int i = 0; i < 10000; i++)
+        builder.addVertex(Vertex{ glm::vec3(static_cast<float>(i % 100), static_cast<float>(i / 100), 0.f), glm::vec2(0.f), glm::vec3(0.f) });
+    ASSERT_EQ(builder.getVertices().size(), 10003u);
+
+    std::vector<Vertex> serialVertices, parallelVertices;
+    std::vector<uint32_t> serialIndices, parallelIndices;
+    Rock::MeshBuilder::loadObj("../Renderer/res/models/cube.obj", serialVertices, serialIndices, false);
+    Rock::MeshBuilder::loadObj("../Renderer/res/models/cube.obj", parallelVertices, parallelIndices, true);
+    ASSERT_EQ(serialVertices.size(), 24u);
+    ASSERT_EQ(serialIndices.size(), 36u);
+    ASSERT_EQ(serialVertices, parallelVertices);
+    ASSERT_EQ(serialIndices, parallelIndices);
+}
+
+TEST(MeshTests, BenchmarkMeshBuilder)
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    ASSERT_TRUE(tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, "../Renderer/res/models/ironGolem.obj"));
+
+    const int iterations = 200;
+    std::vector<Vertex> referenceVertices;
+    std::vector<uint32_t> referenceIndices;
+
+    // previous implementation: node based unordered_map keyed on the vertex
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+        referenceVertices.clear();
+        referenceIndices.clear();
+        for (const auto& shape : shapes)
+        {
+            for (const auto& index : shape.mesh.indices)
+            {
+                Vertex vertex{};
+                vertex.pos = { attrib.vertices[3 * index.vertex_index + 0], attrib.vertices[3 * index.vertex_index + 1], attrib.vertices[3 * index.vertex_index + 2] };
+                vertex.norm = { attrib.normals[3 * index.normal_index + 0], attrib.normals[3 * index.normal_index + 1], attrib.normals[3 * index.normal_index + 2] };
+                vertex.texCoord = { attrib.texcoords[2 * index.texcoord_index], 1.f - attrib.texcoords[2 * index.texcoord_index + 1] };
+                auto result = uniqueVertices.emplace(vertex, static_cast<uint32_t>(referenceVertices.size()));
+                if (result.second)
+                    referenceVertices.push_back(vertex);
+                referenceIndices.push_back(result.first->second);
+            }
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    float mapTime = std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count() / iterations;
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++)
+        Rock::MeshBuilder::fromObj(attrib, shapes, vertices, indices, false);
+    end = std::chrono::high_resolution_clock::now();
+    float builderTime = std::chrono::duration<float, std::chrono::milliseconds::period>(end - start).count() / iterations;
+
+    std::cout << "[ BENCH    ] ironGolem.obj unordered_map: " << mapTime << " ms, MeshBuilder: " << builderTime << " ms" << std::endl;
+
+    ASSERT_EQ(vertices, referenceVertices);
+    ASSERT_EQ(indices, referenceIndices);
+}
+
+TEST(MeshTests, TestMeshOptimiser)
+{
+    // 64x64 quad grid with its triangles shuffled
+    const uint32_t size = 64;
+    std::vector<Vertex> vertices;
+    for (uint32_t y = 0; y <= size; y++)
+        for (uint32_t x = 0; x <= size; x++)
+            vertices.push_back(Vertex{ glm::vec3(static_cast<float>(x), static_cast<float>(y), 0.f), glm::vec2(0.f), glm::vec3(0.f, 0.f, 1.f) });
+
+    std::vector<glm::uvec3> triangles;
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            uint32_t i = y * (size + 1) + x;
+            triangles.push_back(glm::uvec3(i, i + 1, i + size + 1));
+            triangles.push_back(glm::uvec3(i + 1, i + size + 2, i + size + 1));
+        }
+    }
+    std::shuffle(triangles.begin(), triangles.end(), std::mt19937(42));
+
+    std::vector<uint32_t> indices;
+    for (const glm::uvec3& triangle : triangles)
+        indices.insert(indices.end(), { triangle.x, triangle.y, triangle.z });
+
+    float shuffledACMR = Rock::MeshOptimiser::analyseVertexCache(indices.data(), indices.size(), vertices.size());
+    std::vector<uint32_t> optimised(indices.size());
+    Rock::MeshOptimiser::optimiseVertexCache(optimised.data(), indices.data(), indices.size(), vertices.size());
+    float optimisedACMR = Rock::MeshOptimiser::analyseVertexCache(optimised.data(), optimised.size(), vertices.size());
+    ASSERT_GT(shuffledACMR, 2.f);
+    ASSERT_LT(optimisedACMR, 0.8f);
+
+    std::vector<uint32_t> sorted(indices.size());
+    Rock::MeshOptimiser::optimiseOverdraw(sorted.data(), optimised.data(), optimised.size(), vertices.data(), vertices.size());
+    ASSERT_LT(Rock::MeshOptimiser::analyseVertexCache(sorted.data(), sorted.size(), vertices.size()), optimisedACMR * 1.1f);
+
+    // every pass must keep the same set of triangles
+    auto triangleSet = [](const std::vector<uint32_t>& list, const std::vector<Vertex>& verts)
+    {
+        std::multiset<std::vector<float>> set;
+        for (size_t i = 0; i < list.size(); i += 3)
+        {
+            std::vector<float> key;
+            for (int k = 0; k < 3; k++)
+                key.insert(key.end(), { verts[list[i + k]].pos.x, verts[list[i + k]].pos.y });
+            set.insert(key);
+        }
+        return set;
+    };
+    auto original = triangleSet(indices, vertices);
+    ASSERT_EQ(triangleSet(sorted, vertices), original);
+
+    std::vector<Vertex> fetched(vertices.size());
+    size_t vertexCount = Rock::MeshOptimiser::optimiseVertexFetch(fetched.data(), sorted.data(), sorted.size(), vertices.data(), vertices.size());
+    ASSERT_EQ(vertexCount, vertices.size());
+    ASSERT_EQ(triangleSet(sorted, fetched), original);
+    uint32_t highest = 0;
+    for (uint32_t index : sorted)
+    {
+        ASSERT_LE(index, highest + 1);
+        highest = std::max(highest, index);
+    }
+}
+
+TEST(MeshTests, TestVertexQuantisation)
+{
+    Rock::MeshBounds bounds{};
+    bounds.min = glm::vec3(-2.f, 0.f, -0.5f);
+    bounds.max = glm::vec3(2.f, 8.f, 0.5f);
+    glm::vec3 tolerance = (bounds.max - bounds.min) * 0.5f / 32767.f;
+
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::uniform_real_distribution<float> signedUnit(-1.f, 1.f);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        Vertex vertex{};
+        vertex.pos = bounds.min + (bounds.max - bounds.min) * glm::vec3(unit(generator), unit(generator), unit(generator));
+        vertex.texCoord = glm::vec2(unit(generator), unit(generator));
+        vertex.norm = glm::normalize(glm::vec3(signedUnit(generator), signedUnit(generator), signedUnit(generator)));
+
+        Vertex decoded = CompactVertex::encode(vertex, bounds).decode(bounds);
+        for (int k = 0; k < 3; k++)
+            ASSERT_LE(std::abs(decoded.pos[k] - vertex.pos[k]), tolerance[k] * 1.01f);
+        ASSERT_NEAR(decoded.texCoord.x, vertex.texCoord.x, 1e-3f);
+        ASSERT_NEAR(decoded.texCoord.y, vertex.texCoord.y, 1e-3f);
+        ASSERT_GT(glm::dot(decoded.norm, vertex.norm), 0.99999f);
+    }
+
+    // axis aligned normals, including the octahedron's folded corners, must survive exactly
+    const glm::vec3 axes[] = { glm::vec3(1.f, 0.f, 0.f), glm::vec3(-1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, 0.f, -1.f) };
+    for (const glm::vec3& axis : axes)
+        ASSERT_GT(glm::dot(CompactVertex::decodeOctahedral(CompactVertex::encodeOctahedral(axis)), axis), 0.99999f);
+
+    ASSERT_EQ(sizeof(CompactVertex) * 2, sizeof(Vertex));
+}
+
+TEST(MeshTests, TestMeshFile)
+{
+    ASSERT_EQ(Rock::MeshFile::getCookedPath("../Renderer/res/models/cube.obj"), "../Renderer/res/models/cube.rmesh");
+    ASSERT_EQ(Rock::MeshFile::getCookedPath("../Renderer/res/models/cube"), "../Renderer/res/models/cube.rmesh");
+
+    // up to UINT16_MAX vertices cook with 16 bit indices, any more need 32 bit indices
+    std::vector<char> cooked;
+    for (size_t vertexCount : { static_cast<size_t>(100), static_cast<size_t>(UINT16_MAX) + 2 })
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            float f = static_cast<float>(i);
+            vertices.push_back(Vertex{ glm::vec3(f, -0.5f * f, 1.f), glm::vec2(f / vertexCount, 1.f), glm::vec3(0.f, 1.f, 0.f) });
+            indices.push_back(static_cast<uint32_t>(vertexCount - 1 - i));
+            indices.push_back(static_cast<uint32_t>(i));
+        }
+
+        Rock::MeshFile::write("meshFileTest.rmesh", vertices, indices);
+        ASSERT_TRUE(Rock::MeshFile::exists("meshFileTest.rmesh"));
+        {
+            Rock::MeshFile file("meshFileTest.rmesh");
+            ASSERT_EQ(file.getIndexType(), vertexCount <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32);
+            ASSERT_EQ(file.getHeader().vertexCount, vertexCount);
+            ASSERT_EQ(file.getVertexDataSize(), vertexCount * sizeof(Vertex));
+            ASSERT_EQ(std::vector<Vertex>(static_cast<const Vertex*>(file.getVertexData()), static_cast<const Vertex*>(file.getVertexData()) + vertexCount), vertices);
+
+            std::vector<uint32_t> loadedIndices;
+            for (uint32_t i = 0; i < file.getHeader().indexCount; i++)
+                loadedIndices.push_back(file.getIndexType() == VK_INDEX_TYPE_UINT16 ? static_cast<const uint16_t*>(file.getIndexData())[i] : static_cast<const uint32_t*>(file.getIndexData())[i]);
+            ASSERT_EQ(loadedIndices, indices);
+
+            Rock::MeshBounds bounds = Rock::MeshBounds::calculate(vertices.data(), vertices.size());
+            ASSERT_EQ(file.getBounds().min, bounds.min);
+            ASSERT_EQ(file.getBounds().max, bounds.max);
+            ASSERT_EQ(file.getBounds().centre, bounds.centre);
+            ASSERT_EQ(file.getBounds().radius, bounds.radius);
+        }
+
+        if (cooked.empty())
+        {
+            std::ifstream file("meshFileTest.rmesh", std::ios::binary);
+            cooked.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+    }
+
+    // a bad magic, an older version and truncated files must be rejected rather than mapped
+    auto writeBytes = [](const std::vector<char>& bytes) {
+        std::ofstream file("meshFileTest.rmesh", std::ios::binary | std::ios::trunc);
+        file.write(bytes.data(), bytes.size());
+    };
+    std::vector<char> bytes = cooked;
+    reinterpret_cast<Rock::MeshFileHeader*>(bytes.data())->magic = 0;
+    writeBytes(bytes);
+    ASSERT_THROW(Rock::MeshFile("meshFileTest.rmesh"), std::runtime_error);
+
+    bytes = cooked;
+    reinterpret_cast<Rock::MeshFileHeader*>(bytes.data())->version = Rock::MESH_FILE_VERSION + 1;
+    writeBytes(bytes);
+    ASSERT_THROW(Rock::MeshFile("meshFileTest.rmesh"), std::runtime_error);
+
+    bytes.assign(cooked.begin(), cooked.end() - 1);
+    writeBytes(bytes);
+    ASSERT_THROW(Rock::MeshFile("meshFileTest.rmesh"), std::runtime_error);
+
+    bytes.assign(cooked.begin(), cooked.begin() + sizeof(Rock::MeshFileHeader) / 2);
+    writeBytes(bytes);
+    ASSERT_THROW(Rock::MeshFile("meshFileTest.rmesh"), std::runtime_error);
+
+    std::remove("meshFileTest.rmesh");
+    ASSERT_THROW(Rock::MeshFile("meshFileTest.rmesh"), std::runtime_error);
+}
+
+TEST(ThreadPoolTests, TestNestedParallelFor)
+{
+    // a parallelFor inside a job runs inline, so it cannot wait on workers that are all blocked in it
+    ThreadPool threadPool(2);
+    std::vector<std::atomic<uint32_t>> counts(64);
+    threadPool.parallelFor(8, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            threadPool.parallelFor(8, 1, [&](size_t innerBegin, size_t innerEnd) {
+                for (size_t j = innerBegin; j < innerEnd; j++)
+                    counts[i * 8 + j]++;
+            });
+        }
+    });
+    for (const std::atomic<uint32_t>& count : counts)
+        ASSERT_EQ(count.load(), 1);
+}
+
+TEST(CullingTests, TestFrustumCulling)
+{
+    glm::mat4 view = glm::lookAt(glm::vec3(2.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 proj = glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, 10.f);
+    proj[1][1] *= -1.f;
+    Rock::Frustum frustum = Rock::Frustum::fromMatrix(proj * view);
+
+    ASSERT_TRUE(frustum.intersectsSphere(glm::vec3(0.f), 0.5f));
+    ASSERT_FALSE(frustum.intersectsSphere(glm::vec3(4.f), 0.5f)); // behind the camera
+    ASSERT_FALSE(frustum.intersectsSphere(glm::vec3(-4.35f), 0.5f)); // 11 units along the view direction, beyond the far plane
+    ASSERT_TRUE(frustum.intersectsSphere(glm::vec3(-4.35f), 2.f)); // straddling the far plane
+
+    entt::registry registry;
+    std::vector<entt::entity> entities;
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<float> position(-12.f, 12.f);
+    std::uniform_real_distribution<float> scale(0.1f, 2.f);
+    for (int i = 0; i < 10001; i++)
+    {
+        entt::entity entity = registry.create();
+        auto& renderComp = registry.emplace<Rock::RenderComponent>(entity);
+        renderComp.m_bounds.centre = glm::vec3(0.f, 0.5f, 0.f);
+        renderComp.m_bounds.radius = 0.75f;
+        registry.emplace<Rock::TransformComponent>(entity, glm::vec3(position(generator), position(generator), position(generator)), glm::vec3(0.f), glm::vec3(scale(generator)));
+        entities.push_back(entity);
+    }
+
+    std::vector<entt::entity> expected;
+    for (entt::entity entity : entities)
+    {
+        const auto& transformComp = registry.get<Rock::TransformComponent>(entity);
+        glm::vec3 centre = glm::vec3(transformComp.m_transform * glm::vec4(0.f, 0.5f, 0.f, 1.f));
+        if (frustum.intersectsSphere(centre, 0.75f * transformComp.m_scale.x))
+            expected.push_back(entity);
+    }
+    ASSERT_GT(expected.size(), 0);
+    ASSERT_LT(expected.size(), entities.size());
+
+    Rock::CullingSystem culling;
+    std::vector<entt::entity> visible;
+    culling.gather(registry, entities);
+    culling.cull(frustum, visible);
+    ASSERT_EQ(visible, expected);
+    ASSERT_EQ(culling.getVisibleCount(), expected.size());
+    ASSERT_EQ(culling.getCulledCount(), entities.size() - expected.size());
+
+    ThreadPool threadPool(4);
+    culling.cull(frustum, visible, &threadPool);
+    ASSERT_EQ(visible, expected);
+}
+
+TEST(CullingTests, TestHiZOcclusion)
+{
+    const uint32_t width = 250, height = 141;
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 proj = glm::perspective(glm::radians(60.f), static_cast<float>(width) / height, 0.1f, 100.f);
+    proj[1][1] *= -1.f;
+    auto depthAt = [&proj](float distance) { return (proj[2][2] * -distance + proj[3][2]) / distance; };
+
+    // projected bounds must contain every projected surface point and be tight around them
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    for (int i = 0; i < 200; i++)
+    {
+        glm::vec3 centre(unit(generator) * 4.f, unit(generator) * 4.f, -6.f + unit(generator) * 4.f);
+        float radius = 0.2f + 0.5f * (unit(generator) + 1.f);
+        glm::vec4 uv;
+        ASSERT_TRUE(Rock::CullingReference::projectSphere(centre, radius, 0.1f, proj[0][0], proj[1][1], uv));
+
+        glm::vec4 sampled(1e9f, 1e9f, -1e9f, -1e9f);
+        for (int k = 0; k < 4000; k++)
+        {
+            glm::vec3 direction(unit(generator), unit(generator), unit(generator));
+            if (glm::length(direction) < 1e-3f)
+                continue;
+            glm::vec4 clip = proj * glm::vec4(centre + glm::normalize(direction) * radius, 1.f);
+            glm::vec2 point = glm::vec2(clip) / clip.w * 0.5f + 0.5f;
+            sampled = glm::vec4(glm::min(glm::vec2(sampled), point), glm::max(glm::vec2(sampled.z, sampled.w), point));
+        }
+        ASSERT_LE(uv.x, sampled.x + 1e-4f);
+        ASSERT_LE(uv.y, sampled.y + 1e-4f);
+        ASSERT_GE(uv.z, sampled.z - 1e-4f);
+        ASSERT_GE(uv.w, sampled.w - 1e-4f);
+        ASSERT_LT(glm::length(uv - sampled), 0.02f);
+    }
+    glm::vec4 uv;
+    ASSERT_FALSE(Rock::CullingReference::projectSphere(glm::vec3(0.f, 0.f, -0.5f), 1.f, 0.1f, proj[0][0], proj[1][1], uv));
+
+    // a wall 5 units away covering the left half of the screen
+    std::vector<float> depth(width * height, 1.f);
+    for (uint32_t y = 0; y < height; y++)
+        for (uint32_t x = 0; x < width / 2; x++)
+            depth[y * width + x] = depthAt(5.f);
+
+    Rock::DepthPyramid pyramid;
+    pyramid.build(depth.data(), width, height);
+    ASSERT_EQ(pyramid.getLevelWidth(0), 128);
+    ASSERT_EQ(pyramid.getLevelHeight(0), 128);
+    ASSERT_EQ(pyramid.getLevelCount(), Rock::DepthPyramid::getLevelCount(width, height));
+    ASSERT_EQ(pyramid.getLevelWidth(pyramid.getLevelCount() - 1), 1);
+    ASSERT_EQ(pyramid.fetch(pyramid.getLevelCount() - 1, 0, 0), 1.f);
+
+    glm::vec3 left = glm::normalize(glm::vec3(-0.4f, 0.f, -1.f));
+    glm::vec3 right = glm::normalize(glm::vec3(0.4f, 0.f, -1.f));
+    ASSERT_TRUE(Rock::CullingReference::isOccluded(pyramid, glm::vec4(left * 10.f, 0.5f), view, proj));
+    ASSERT_FALSE(Rock::CullingReference::isOccluded(pyramid, glm::vec4(left * 3.f, 0.5f), view, proj));
+    ASSERT_FALSE(Rock::CullingReference::isOccluded(pyramid, glm::vec4(right * 10.f, 0.5f), view, proj));
+    ASSERT_FALSE(Rock::CullingReference::isOccluded(pyramid, glm::vec4(left * 10.f, 6.f), view, proj)); // straddles the wall
+
+    // occlusion must be conservative: every pixel under an occluded sphere is nearer than the sphere
+    std::vector<Rock::GpuInstance> instances;
+    Rock::MeshBounds bounds{};
+    bounds.radius = 0.5f;
+    for (int i = 0; i < 2000; i++)
+    {
+        glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(unit(generator) * 12.f, unit(generator) * 6.f, -8.f + unit(generator) * 7.f));
+        instances.push_back(Rock::GpuInstance::create(model, bounds, 36));
+    }
+
+    uint32_t occluded = 0;
+    for (const Rock::GpuInstance& instance : instances)
+    {
+        if (!Rock::CullingReference::isOccluded(pyramid, instance.sphere, view, proj))
+            continue;
+        occluded++;
+
+        glm::vec3 centre = glm::vec3(view * glm::vec4(glm::vec3(instance.sphere), 1.f));
+        float nearestDepth = depthAt(-centre.z - instance.sphere.w);
+        Rock::CullingReference::projectSphere(centre, instance.sphere.w, 0.1f, proj[0][0], proj[1][1], uv);
+        uv = glm::clamp(uv, glm::vec4(0.f), glm::vec4(1.f));
+        for (uint32_t y = static_cast<uint32_t>(uv.y * height); y < std::min(height, static_cast<uint32_t>(uv.w * height) + 1); y++)
+            for (uint32_t x = static_cast<uint32_t>(uv.x * width); x < std::min(width, static_cast<uint32_t>(uv.z * width) + 1); x++)
+                ASSERT_LT(depth[y * width + x], nearestDepth);
+    }
+    ASSERT_GT(occluded, 0);
+
+    Rock::Frustum frustum = Rock::Frustum::fromMatrix(proj * view);
+    uint32_t inFrustum = 0, occludedInFrustum = 0;
+    for (const Rock::GpuInstance& instance : instances)
+    {
+        if (!frustum.intersectsSphere(glm::vec3(instance.sphere), instance.sphere.w))
+            continue;
+        inFrustum++;
+        occludedInFrustum += Rock::CullingReference::isOccluded(pyramid, instance.sphere, view, proj);
+    }
+    ASSERT_GT(occludedInFrustum, 0);
+    ASSERT_EQ(Rock::CullingReference::countVisible(instances, frustum), inFrustum);
+    ASSERT_EQ(Rock::CullingReference::countVisible(instances, frustum, &pyramid, view, proj), inFrustum - occludedInFrustum);
+}
+
+TEST(CullingTests, TestGpuMatchesCpu)
+{
+    // runs headless, so lavapipe can check cull.comp's frustum test against the CPU reference
+    ASSERT_TRUE(shadersCompiled("../Renderer/res/shaders/culling/", { "cull", "hiz", "hizMultisample" }));
+    Device device(nullptr);
+    {
+        glm::mat4 view = glm::lookAt(glm::vec3(0.f, 2.f, 6.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 50.f);
+        projection[1][1] *= -1.f;
+        VkExtent2D extent = { 256, 144 };
+
+        std::default_random_engine engine(11);
+        std::uniform_real_distribution<float> position(-20.f, 20.f);
+        std::vector<Rock::GpuInstance> instances;
+        Rock::MeshBounds bounds{};
+        bounds.radius = 0.5f;
+        for (int i = 0; i < 2000; i++)
+        {
+            glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(position(engine), position(engine), position(engine)));
+            instances.push_back(Rock::GpuInstance::create(model, bounds, 36));
+        }
+
+        GpuCuller culler(&device, static_cast<uint32_t>(instances.size()), extent, VK_SAMPLE_COUNT_1_BIT, "../Renderer/res/shaders/culling/");
+        culler.setInstances(instances);
+        culler.setCamera(view, projection);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = device.getCommandPool();
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        ASSERT_EQ(vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &commandBuffer), VK_SUCCESS);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        // no pyramid has been built, so the cull skips occlusion, but the pyramid is still bound in the general layout
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = culler.getPyramidImage();
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, culler.getPyramidLevels(), 0, 1 };
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        culler.recordCull(commandBuffer, 0, extent);
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        ASSERT_EQ(vkQueueSubmit(device.getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE), VK_SUCCESS);
+        vkQueueWaitIdle(device.getGraphicsQueue());
+        vkFreeCommandBuffers(device.getDevice(), device.getCommandPool(), 1, &commandBuffer);
+
+        uint32_t expected = Rock::CullingReference::countVisible(instances, Rock::Frustum::fromMatrix(projection * view));
+        ASSERT_GT(expected, 0);
+        ASSERT_LT(expected, instances.size());
+        ASSERT_EQ(culler.getFrustumCount(0), expected);
+        ASSERT_EQ(culler.getVisibleCount(0), expected);
+    }
+    vkDeviceWaitIdle(device.getDevice());
+}
+
+TEST(CullingTests, TestGpuOcclusionMatchesCpu)
+{
+    // builds the depth pyramid on the GPU from a known depth buffer, then checks every instance cull.comp draws against the CPU reference
+    ASSERT_TRUE(shadersCompiled("../Renderer/res/shaders/culling/", { "cull", "hiz", "hizMultisample" }));
+    Device device(nullptr);
+    {
+        const uint32_t width = 256, height = 144;
+        VkExtent2D extent = { width, height };
+        glm::mat4 view = glm::lookAt(glm::vec3(0.f), glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.f), static_cast<float>(width) / height, 0.1f, 100.f);
+        projection[1][1] *= -1.f;
+        float wallDepth = (projection[2][2] * -5.f + projection[3][2]) / 5.f;
+
+        // a wall 5 units away covering the left half of the screen
+        std::vector<float> depth(width * height, 1.f);
+        for (uint32_t y = 0; y < height; y++)
+            for (uint32_t x = 0; x < width / 2; x++)
+                depth[y * width + x] = wallDepth;
+        Rock::DepthPyramid pyramid;
+        pyramid.build(depth.data(), width, height);
+
+        // known instances behind the wall, in front of it, beside it and straddling it, followed by a random spread
+        glm::vec3 left = glm::normalize(glm::vec3(-0.4f, 0.f, -1.f));
+        glm::vec3 right = glm::normalize(glm::vec3(0.4f, 0.f, -1.f));
+        Rock::MeshBounds bounds{};
+        bounds.radius = 0.5f;
+        std::vector<Rock::GpuInstance> instances;
+        instances.push_back(Rock::GpuInstance::create(glm::translate(glm::mat4(1.f), left * 10.f), bounds, 36));
+        instances.push_back(Rock::GpuInstance::create(glm::translate(glm::mat4(1.f), left * 3.f), bounds, 36));
+        instances.push_back(Rock::GpuInstance::create(glm::translate(glm::mat4(1.f), right * 10.f), bounds, 36));
+        instances.push_back(Rock::GpuInstance::create(glm::scale(glm::translate(glm::mat4(1.f), left * 10.f), glm::vec3(12.f)), bounds, 36));
+
+        std::mt19937 generator(11);
+        std::uniform_real_distribution<float> unit(-1.f, 1.f);
+        for (int i = 0; i < 1000; i++)
+        {
+            glm::mat4 model = glm::translate(glm::mat4(1.f), glm::vec3(unit(generator) * 12.f, unit(generator) * 6.f, -8.f + unit(generator) * 7.f));
+            instances.push_back(Rock::GpuInstance::create(model, bounds, 36));
+        }
+
+        Rock::Frustum frustum = Rock::Frustum::fromMatrix(projection * view);
+        std::vector<uint32_t> expected;
+        uint32_t occluded = 0;
+        for (uint32_t i = 0; i < instances.size(); i++)
+        {
+            if (!frustum.intersectsSphere(glm::vec3(instances[i].sphere), instances[i].sphere.w))
+                continue;
+            if (Rock::CullingReference::isOccluded(pyramid, instances[i].sphere, view, projection))
+                occluded++;
+            else
+                expected.push_back(i);
+        }
+        ASSERT_GT(occluded, 1);
+        ASSERT_EQ(expected[0], 1); // the first instance is behind the wall
+        ASSERT_EQ(expected[1], 2);
+        ASSERT_EQ(expected[2], 3);
+
+        GpuCuller culler(&device, static_cast<uint32_t>(instances.size()), extent, VK_SAMPLE_COUNT_1_BIT, "../Renderer/res/shaders/culling/");
+        culler.setInstances(instances);
+        culler.setCamera(view, projection);
+
+        VkImage depthImage;
+        VkDeviceMemory depthImageMemory;
+        device.createImage(width, height, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_D32_SFLOAT, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+        VkImageView depthImageView = device.createImageView(depthImage, VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+
+        VkDeviceSize depthSize = sizeof(float) * depth.size();
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        device.createBuffer(depthSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+        void* data;
+        vkMapMemory(device.getDevice(), stagingBufferMemory, 0, depthSize, 0, &data);
+        memcpy(data, depth.data(), static_cast<size_t>(depthSize));
+        vkUnmapMemory(device.getDevice(), stagingBufferMemory);
+
+        VkDeviceSize commandsSize = sizeof(VkDrawIndexedIndirectCommand) * instances.size();
+        VkBuffer readbackBuffer;
+        VkDeviceMemory readbackBufferMemory;
+        device.createBuffer(commandsSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackBuffer, readbackBufferMemory);
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = device.getCommandPool();
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        ASSERT_EQ(vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &commandBuffer), VK_SUCCESS);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        // upload the depth buffer and leave it where recordDepthPyramid expects it
+        VkImageMemoryBarrier barriers[2]{};
+        barriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[0].image = depthImage;
+        barriers[0].subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+        barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barriers[0]);
+
+        VkBufferImageCopy region{};
+        region.imageSubresource = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0, 1 };
+        region.imageExtent = { width, height, 1 };
+        vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, depthImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[1].image = culler.getPyramidImage();
+        barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, culler.getPyramidLevels(), 0, 1 };
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 2, barriers);
+        culler.recordDepthPyramid(commandBuffer, depthImageView);
+
+        // the cull samples the last pyramid level written
+        VkMemoryBarrier memoryBarrier{};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+        culler.recordCull(commandBuffer, 0, extent);
+
+        // recordCull ends with the cull's writes made visible to transfers
+        VkBufferCopy copyRegion{};
+        copyRegion.size = commandsSize;
+        vkCmdCopyBuffer(commandBuffer, culler.getDrawCommandBuffer(), readbackBuffer, 1, &copyRegion);
+        memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        ASSERT_EQ(vkQueueSubmit(device.getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE), VK_SUCCESS);
+        vkQueueWaitIdle(device.getGraphicsQueue());
+        vkFreeCommandBuffers(device.getDevice(), device.getCommandPool(), 1, &commandBuffer);
+
+        // survivors are compacted in any order; firstInstance names the instance each command draws
+        std::vector<uint32_t> visible;
+        vkMapMemory(device.getDevice(), readbackBufferMemory, 0, commandsSize, 0, &data);
+        const VkDrawIndexedIndirectCommand* commands = static_cast<const VkDrawIndexedIndirectCommand*>(data);
+        for (uint32_t i = 0; i < culler.getVisibleCount(0); i++)
+            visible.push_back(commands[i].firstInstance);
+        vkUnmapMemory(device.getDevice(), readbackBufferMemory);
+        std::sort(visible.begin(), visible.end());
+
+        vkDestroyBuffer(device.getDevice(), readbackBuffer, nullptr);
+        vkFreeMemory(device.getDevice(), readbackBufferMemory, nullptr);
+        vkDestroyBuffer(device.getDevice(), stagingBuffer, nullptr);
+        vkFreeMemory(device.getDevice(), stagingBufferMemory, nullptr);
+        vkDestroyImageView(device.getDevice(), depthImageView, nullptr);
+        vkDestroyImage(device.getDevice(), depthImage, nullptr);
+        vkFreeMemory(device.getDevice(), depthImageMemory, nullptr);
+
+        ASSERT_EQ(culler.getFrustumCount(0), expected.size() + occluded);
+        ASSERT_EQ(visible, expected);
+    }
+    vkDeviceWaitIdle(device.getDevice());
+}
+
+TEST(FrameAllocatorTests, TestAlignUp)
+{
+    // dynamic offsets must be multiples of minUniformBufferOffsetAlignment, a power of two between 1 and 256
+    for (VkDeviceSize alignment = 1; alignment <= 256; alignment *= 2)
+    {
+        for (VkDeviceSize offset = 0; offset < 1024; offset++)
+        {
+            VkDeviceSize aligned = FrameAllocator::alignUp(offset, alignment);
+            ASSERT_EQ(aligned % alignment, 0);
+            ASSERT_GE(aligned, offset);
+            ASSERT_LT(aligned - offset, alignment);
+        }
+    }
+}
+
+TEST(FrameAllocatorTests, TestAllocate)
+{
+    Device device(nullptr);
+    FrameAllocator allocator(&device, 4096, 2);
+    ASSERT_EQ(allocator.getAlignment() & (allocator.getAlignment() - 1), 0);
+
+    // mixed sizes and alignments land aligned, in order and without overlapping
+    const VkDeviceSize sizes[] = { 192, 96, 16, 1, 300, 64 };
+    const VkDeviceSize alignments[] = { 0, 512, 0, 16, 1024, 0 };
+    VkDeviceSize end = 0;
+    char* first = nullptr;
+    for (int i = 0; i < 6; i++)
+    {
+        void* mapped = nullptr;
+        VkDeviceSize offset = allocator.allocate(0, sizes[i], &mapped, alignments[i]);
+        ASSERT_EQ(offset % std::max(allocator.getAlignment(), alignments[i]), 0);
+        ASSERT_GE(offset, end);
+        ASSERT_LT(offset - end, std::max(allocator.getAlignment(), alignments[i]));
+        if (i == 0)
+            first = static_cast<char*>(mapped);
+        ASSERT_EQ(static_cast<char*>(mapped), first + offset);
+        end = offset + sizes[i];
+    }
+    ASSERT_EQ(allocator.getUsed(0), end);
+
+    // frames are independent, a reset starts the frame over and running out throws
+    ASSERT_EQ(allocator.getUsed(1), 0);
+    ASSERT_EQ(allocator.allocate(1, 16), 0);
+    allocator.reset(0);
+    ASSERT_EQ(allocator.push(0, glm::mat4(1.f)), 0);
+    ASSERT_THROW(allocator.allocate(0, 4096), std::runtime_error);
+    ASSERT_THROW(allocator.allocate(0, 16, nullptr, 48), std::runtime_error);
+}
+
+TEST(DescriptorTests, TestLayoutKey)
+{
+    VkDescriptorSetLayoutBinding camera{};
+    camera.binding = 0;
+    camera.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    camera.descriptorCount = 1;
+    camera.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    VkDescriptorSetLayoutBinding texture{};
+    texture.binding = 1;
+    texture.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    texture.descriptorCount = 1;
+    texture.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    // the same bindings in any order must share a cached layout
+    DescriptorLayoutCache::LayoutKey a = DescriptorLayoutCache::LayoutKey::create({ camera, texture });
+    DescriptorLayoutCache::LayoutKey b = DescriptorLayoutCache::LayoutKey::create({ texture, camera });
+    ASSERT_TRUE(a == b);
+    ASSERT_EQ(a.hash(), b.hash());
+    ASSERT_EQ(a.bindings[0].binding, 0);
+
+    texture.stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+    DescriptorLayoutCache::LayoutKey c = DescriptorLayoutCache::LayoutKey::create({ camera, texture });
+    ASSERT_FALSE(a == c);
+    ASSERT_FALSE(a == DescriptorLayoutCache::LayoutKey::create({ camera }));
+}
+
+TEST(DescriptorTests, TestPoolSizes)
+{
+    std::vector<DescriptorAllocator::PoolRatio> ratios = { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.f }, { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.1f } };
+    std::vector<VkDescriptorPoolSize> sizes = DescriptorAllocator::getPoolSizes(ratios, 64);
+    ASSERT_EQ(sizes.size(), 2);
+    ASSERT_EQ(sizes[0].type, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    ASSERT_EQ(sizes[0].descriptorCount, 128);
+    ASSERT_EQ(sizes[1].descriptorCount, 6);
+    // every type keeps at least one descriptor however small the pool
+    ASSERT_EQ(DescriptorAllocator::getPoolSizes(ratios, 1)[1].descriptorCount, 1);
+}
+
+TEST(PipelineCacheTests, TestHeaderValidation)
+{
+    VkPhysicalDeviceProperties properties{};
+    properties.vendorID = 0x10de;
+    properties.deviceID = 0x2684;
+    for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+        properties.pipelineCacheUUID[i] = static_cast<uint8_t>(i);
+
+    // VkPipelineCacheHeaderVersionOne followed by driver data
+    std::vector<char> blob(64, 0);
+    uint32_t header[4] = { 16 + VK_UUID_SIZE, VK_PIPELINE_CACHE_HEADER_VERSION_ONE, properties.vendorID, properties.deviceID };
+    memcpy(blob.data(), header, sizeof(header));
+    memcpy(blob.data() + sizeof(header), properties.pipelineCacheUUID, VK_UUID_SIZE);
+    ASSERT_TRUE(PipelineCache::isCompatible(blob, properties));
+
+    // a blob from another driver version, another device or a truncated file must be discarded
+    VkPhysicalDeviceProperties updatedDriver = properties;
+    updatedDriver.pipelineCacheUUID[0] ^= 1;
+    ASSERT_FALSE(PipelineCache::isCompatible(blob, updatedDriver));
+    VkPhysicalDeviceProperties otherDevice = properties;
+    otherDevice.deviceID++;
+    ASSERT_FALSE(PipelineCache::isCompatible(blob, otherDevice));
+    ASSERT_FALSE(PipelineCache::isCompatible(std::vector<char>(blob.begin(), blob.begin() + 20), properties));
+    ASSERT_FALSE(PipelineCache::isCompatible({}, properties));
+}
+
+TEST(ShaderReflectionTests, TestEngineAppLayout)
+{
+    ASSERT_TRUE(shadersCompiled("../Renderer/res/shaders/engineApp/", { "vert", "frag" }));
+    ShaderReflection vert(readShader("../Renderer/res/shaders/engineApp/vert.spv"));
+    ShaderReflection frag(readShader("../Renderer/res/shaders/engineApp/frag.spv"));
+    ASSERT_EQ(vert.getStage(), VK_SHADER_STAGE_VERTEX_BIT);
+    ASSERT_EQ(frag.getStage(), VK_SHADER_STAGE_FRAGMENT_BIT);
+    ASSERT_EQ(vert.getPushConstantSize(), sizeof(glm::mat4));
+    ASSERT_EQ(frag.getPushConstantSize(), 0);
+
+    // dynamic UBOs, the clustered light SSBOs and the shadow map in set 0, a combined image sampler in set 1 and a vertex mat4 push constant
+    ReflectedLayout layout = ShaderReflection::merge({ &vert, &frag }, 1);
+    ASSERT_EQ(layout.sets.size(), 2);
+    ASSERT_EQ(layout.sets[0].size(), 8);
+    const VkDescriptorType set0Types[] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER };
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        ASSERT_EQ(layout.sets[0][i].binding, i);
+        ASSERT_EQ(layout.sets[0][i].descriptorType, set0Types[i]);
+        ASSERT_EQ(layout.sets[0][i].descriptorCount, 1);
+        ASSERT_EQ(layout.sets[0][i].stageFlags, i == 0 ? VK_SHADER_STAGE_VERTEX_BIT : VK_SHADER_STAGE_FRAGMENT_BIT);
+    }
+    ASSERT_EQ(layout.sets[1].size(), 1);
+    ASSERT_EQ(layout.sets[1][0].descriptorType, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    ASSERT_EQ(layout.sets[1][0].stageFlags, VK_SHADER_STAGE_FRAGMENT_BIT);
+    ASSERT_EQ(layout.pushConstants.stageFlags, VK_SHADER_STAGE_VERTEX_BIT);
+    ASSERT_EQ(layout.pushConstants.offset, 0);
+    ASSERT_EQ(layout.pushConstants.size, sizeof(glm::mat4));
+
+    // without dynamic sets the buffers keep their declared type, and non-SPIR-V input is rejected
+    ASSERT_EQ(ShaderReflection::merge({ &vert }).sets[0][0].descriptorType, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+    ASSERT_THROW(ShaderReflection(std::vector<char>(32, 0)), std::runtime_error);
+}
+
+TEST(ShaderReflectionTests, TestParticleLayout)
+{
+    ASSERT_TRUE(shadersCompiled("../Renderer/res/shaders/particles/", { "simulate", "emit", "compact", "vert" }));
+    typedef ParticleSystem::GpuParticle GpuParticle;
+    typedef ParticleSystem::ParticleUniforms ParticleUniforms;
+    const std::vector<uint32_t> particleOffsets = { offsetof(GpuParticle, position), offsetof(GpuParticle, life), offsetof(GpuParticle, velocity), offsetof(GpuParticle, colour) };
+
+    // every stage that reads or writes particles must lay them out exactly as the C++ struct, with no padding between elements
+    for (const char* name : { "simulate", "emit", "compact" })
+    {
+        ShaderReflection compute(readShader(std::string("../Renderer/res/shaders/particles/") + name + ".spv"));
+        const ShaderReflection::Binding* particles = compute.findBinding(0, 2);
+        ASSERT_NE(particles, nullptr);
+        ASSERT_EQ(particles->type, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+        ASSERT_EQ(particles->arrayStride, sizeof(GpuParticle));
+        ASSERT_EQ(particles->memberOffsets, particleOffsets);
+
+        const ShaderReflection::Binding* uniforms = compute.findBinding(0, 0);
+        ASSERT_NE(uniforms, nullptr);
+        ASSERT_EQ(uniforms->blockSize, sizeof(ParticleUniforms));
+        ASSERT_EQ(uniforms->memberOffsets.back(), offsetof(ParticleUniforms, pointSize));
+    }
+    ShaderReflection vert(readShader("../Renderer/res/shaders/particles/vert.spv"));
+    ASSERT_EQ(vert.findBinding(0, 1)->arrayStride, sizeof(GpuParticle));
+    ASSERT_EQ(vert.findBinding(0, 1)->memberOffsets, particleOffsets);
+    ASSERT_EQ(vert.findBinding(0, 2)->arrayStride, sizeof(glm::uvec2));
+    ASSERT_EQ(vert.findBinding(1, 0), nullptr);
+}
+
+TEST(RenderGraphTests, TestCompile)
+{
+    // intervals that do not overlap share a slot
+    std::vector<uint32_t> slots = RenderGraph::assignAliasSlots({ { 0, 1 }, { 2, 3 }, { 1, 2 } });
+    ASSERT_EQ(slots[0], 0);
+    ASSERT_EQ(slots[1], 0);
+    ASSERT_EQ(slots[2], 1);
+
+    RenderGraph graph(nullptr, 2);
+    RenderGraph::ImageDesc colourDesc{ { 800, 600 }, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT };
+    RenderGraph::ImageDesc depthDesc{ { 800, 600 }, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT };
+    RenderGraph::Resource backbuffer = graph.importImage("backbuffer", VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT);
+    RenderGraph::Resource albedo = graph.createImage("albedo", colourDesc);
+    RenderGraph::Resource depth = graph.createImage("depth", depthDesc);
+    RenderGraph::Resource debug = graph.createImage("debug", colourDesc);
+    RenderGraph::Resource hdr = graph.createImage("hdr", colourDesc);
+    RenderGraph::Resource bloom = graph.createImage("bloom", colourDesc);
+    auto record = [](VkCommandBuffer) {};
+
+    graph.addPass("gbuffer", RenderGraph::PassType::Graphics, [&](RenderGraph::PassBuilder& builder) {
+        builder.write(albedo, RenderGraph::COLOUR_ATTACHMENT);
+        builder.write(depth, RenderGraph::DEPTH_ATTACHMENT);
+    }, record);
+    graph.addPass("debug", RenderGraph::PassType::Compute, [&](RenderGraph::PassBuilder& builder) {
+        builder.read(albedo, RenderGraph::SAMPLED_COMPUTE);
+        builder.write(debug, RenderGraph::STORAGE_WRITE_COMPUTE);
+    }, record);
+    graph.addPass("lighting", RenderGraph::PassType::Compute, [&](RenderGraph::PassBuilder& builder) {
+        builder.read(albedo, RenderGraph::SAMPLED_COMPUTE);
+        builder.read(depth, RenderGraph::DEPTH_READ_COMPUTE);
+        builder.write(hdr, RenderGraph::STORAGE_WRITE_COMPUTE);
+    }, record);
+    graph.addPass("bloom", RenderGraph::PassType::Compute, [&](RenderGraph::PassBuilder& builder) {
+        builder.read(hdr, RenderGraph::SAMPLED_COMPUTE);
+        builder.write(bloom, RenderGraph::STORAGE_WRITE_COMPUTE);
+    }, record);
+    graph.addPass("tonemap", RenderGraph::PassType::Graphics, [&](RenderGraph::PassBuilder& builder) {
+        builder.read(hdr, RenderGraph::SAMPLED_FRAGMENT);
+        builder.read(bloom, RenderGraph::SAMPLED_FRAGMENT);
+        builder.write(backbuffer, RenderGraph::COLOUR_ATTACHMENT);
+    }, record);
+    graph.compile();
+
+    // nothing reads the debug image, so its pass is culled and the image never gets memory
+    ASSERT_EQ(graph.getPassCount(), 5);
+    ASSERT_FALSE(graph.isCulled(0));
+    ASSERT_TRUE(graph.isCulled(1));
+    ASSERT_FALSE(graph.isCulled(2));
+    ASSERT_FALSE(graph.isCulled(3));
+    ASSERT_FALSE(graph.isCulled(4));
+    ASSERT_TRUE(graph.getBarriers(1).empty());
+    ASSERT_EQ(graph.getAliasSlot(debug), UINT32_MAX);
+
+    // bloom starts after albedo's last use, so it takes albedo's memory
+    ASSERT_EQ(graph.getSlotCount(), 3);
+    ASSERT_EQ(graph.getAliasSlot(bloom), graph.getAliasSlot(albedo));
+    ASSERT_NE(graph.getAliasSlot(hdr), graph.getAliasSlot(albedo));
+    ASSERT_NE(graph.getAliasSlot(depth), graph.getAliasSlot(albedo));
+
+    // first uses only transition from undefined
+    const std::vector<RenderGraph::Barrier>& gbuffer = graph.getBarriers(0);
+    ASSERT_EQ(gbuffer.size(), 2);
+    ASSERT_EQ(gbuffer[0].srcStages, 0);
+    ASSERT_EQ(gbuffer[0].oldLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+    ASSERT_EQ(gbuffer[0].newLayout, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    ASSERT_EQ(gbuffer[1].newLayout, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+    // lighting waits for the attachment writes and transitions both images for reading
+    const std::vector<RenderGraph::Barrier>& lighting = graph.getBarriers(2);
+    ASSERT_EQ(lighting.size(), 3);
+    ASSERT_EQ(lighting[0].resource, albedo);
+    ASSERT_EQ(lighting[0].srcStages, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    ASSERT_EQ(lighting[0].srcAccess, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    ASSERT_EQ(lighting[0].newLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    ASSERT_EQ(lighting[1].resource, depth);
+    ASSERT_EQ(lighting[1].srcAccess, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+    ASSERT_EQ(lighting[1].newLayout, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    ASSERT_EQ(lighting[2].resource, hdr);
+    ASSERT_EQ(lighting[2].newLayout, VK_IMAGE_LAYOUT_GENERAL);
+
+    // bloom's first use of the shared memory waits for lighting's reads of albedo
+    const std::vector<RenderGraph::Barrier>& bloomBarriers = graph.getBarriers(3);
+    ASSERT_EQ(bloomBarriers.size(), 2);
+    ASSERT_EQ(bloomBarriers[0].resource, hdr);
+    ASSERT_EQ(bloomBarriers[0].srcAccess, VK_ACCESS_SHADER_WRITE_BIT);
+    ASSERT_EQ(bloomBarriers[1].resource, bloom);
+    ASSERT_EQ(bloomBarriers[1].srcStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    ASSERT_EQ(bloomBarriers[1].srcAccess, 0);
+    ASSERT_EQ(bloomBarriers[1].oldLayout, VK_IMAGE_LAYOUT_UNDEFINED);
+
+    // hdr is already read only, so the fragment read only needs an execution dependency on the transition
+    const std::vector<RenderGraph::Barrier>& tonemap = graph.getBarriers(4);
+    ASSERT_EQ(tonemap.size(), 3);
+    ASSERT_EQ(tonemap[0].resource, hdr);
+    ASSERT_EQ(tonemap[0].oldLayout, tonemap[0].newLayout);
+    ASSERT_EQ(tonemap[0].dstStages, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    ASSERT_EQ(tonemap[1].resource, bloom);
+    ASSERT_EQ(tonemap[1].newLayout, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    ASSERT_EQ(tonemap[2].resource, backbuffer);
+
+    // an image can only be in one layout within a pass
+    graph.reset();
+    RenderGraph::Resource image = graph.createImage("image", colourDesc);
+    ASSERT_THROW(graph.addPass("invalid", RenderGraph::PassType::Compute, [&](RenderGraph::PassBuilder& builder) {
+        builder.read(image, RenderGraph::SAMPLED_COMPUTE);
+        builder.write(image, RenderGraph::STORAGE_WRITE_COMPUTE);
+    }, record), std::runtime_error);
+}
+
+TEST(LightClusterTests, TestCpuClusters)
+{
+    // the range is where the brightest channel attenuates to the threshold, and lights that never fall off have no range
+    glm::vec3 constants(1.f, 0.5f, 2.f);
+    float range = LightClusterer::getRange(glm::vec3(0.2f, 1.f, 0.5f), constants);
+    ASSERT_NEAR(1.f / (constants.x + constants.y * range + constants.z * range * range), LightClusterer::LIGHT_THRESHOLD, 1e-6f);
+    ASSERT_EQ(LightClusterer::getRange(glm::vec3(0.f), constants), 0.f);
+    ASSERT_EQ(LightClusterer::getRange(glm::vec3(1.f), glm::vec3(1.f, 0.f, 0.f)), FLT_MAX);
+
+    // a spot light's sphere holds its apex, the tip of its axis and its rim, whether the cone is narrow, wide or wider than a hemisphere
+    for (float cosine : { 0.95f, 0.5f, -0.2f })
+    {
+        SpotLight spot;
+        spot.position = glm::vec3(1.f, 2.f, 3.f);
+        spot.direction = glm::vec3(0.f, -2.f, 0.f);
+        spot.outerCutOffCosine = cosine;
+        spot.innerCutOffCosine = std::min(1.f, cosine + 0.05f);
+        LightClusterer::GpuLight light = LightClusterer::GpuLight::create(spot);
+        glm::vec4 sphere = LightClusterer::getBoundingSphere(light);
+        float sine = std::sqrt(1.f - cosine * cosine);
+        for (glm::vec3 point : { light.position, light.position + light.direction * light.range, light.position + light.range * glm::vec3(sine, -cosine, 0.f) })
+            ASSERT_LE(glm::length(point - glm::vec3(sphere)), sphere.w * 1.0001f);
+    }
+
+    glm::mat4 view = glm::lookAt(glm::vec3(0.f, 2.f, 6.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 50.f);
+    projection[1][1] *= -1.f;
+    VkExtent2D extent = { 1280, 720 };
+    std::default_random_engine engine(3);
+    std::uniform_real_distribution<float> position(-10.f, 10.f);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::vector<LightClusterer::GpuLight> lights;
+    for (int i = 0; i < 1000; i++)
+    {
+        glm::vec3 colour(unit(engine), unit(engine), unit(engine));
+        glm::vec3 lightConstants(1.f, 0.f, 50.f + 400.f * unit(engine));
+        if (i % 4 == 0)
+        {
+            SpotLight spot{ colour, glm::vec3(position(engine), position(engine), position(engine)), glm::vec3(position(engine), position(engine), position(engine)), lightConstants };
+            spot.outerCutOffCosine = 0.2f + 0.7f * unit(engine);
+            spot.innerCutOffCosine = spot.outerCutOffCosine + 0.05f;
+            lights.push_back(LightClusterer::GpuLight::create(spot));
+        }
+        else
+            lights.push_back(LightClusterer::GpuLight::create(PointLight{ colour, glm::vec3(position(engine), position(engine), position(engine)), lightConstants }));
+    }
+    LightClusterer::ClusterUniforms uniforms = LightClusterer::createUniforms(view, projection, extent, 0.1f, 50.f, static_cast<uint32_t>(lights.size()));
+    std::vector<uint32_t> clusters = LightClusterer::assign(lights, uniforms);
+    ASSERT_EQ(clusters.size(), static_cast<size_t>(LightClusterer::CLUSTER_STRIDE) * LightClusterer::CLUSTER_COUNT);
+
+    // every point a light reaches must find that light in its cluster's list
+    glm::mat4 inverseView = glm::inverse(view);
+    std::uniform_real_distribution<float> logDepth(std::log(0.1f), std::log(50.f));
+    uint32_t lit = 0;
+    for (int sample = 0; sample < 5000; sample++)
+    {
+        glm::vec2 fragCoord(unit(engine) * extent.width, unit(engine) * extent.height);
+        float depth = std::exp(logDepth(engine));
+        glm::vec4 onNear = uniforms.inverseProjection * glm::vec4(fragCoord / uniforms.screenSize * 2.f - 1.f, 0.f, 1.f);
+        glm::vec3 ray = glm::vec3(onNear) / onNear.w;
+        glm::vec3 world = glm::vec3(inverseView * glm::vec4(ray * (depth / -ray.z), 1.f));
+        const uint32_t* list = &clusters[LightClusterer::getCluster(uniforms, fragCoord, depth) * LightClusterer::CLUSTER_STRIDE];
+        for (uint32_t i = 0; i < lights.size(); i++)
+        {
+            glm::vec3 offset = world - lights[i].position;
+            float distance = glm::length(offset);
+            if (distance >= lights[i].range * 0.999f || (lights[i].type == LightClusterer::SPOT && glm::dot(offset / distance, lights[i].direction) <= lights[i].outerCutOffCosine))
+                continue;
+            lit++;
+            ASSERT_NE(std::find(list + 1, list + 1 + list[0], i), list + 1 + list[0]);
+        }
+    }
+    ASSERT_GT(lit, 100);
+}
+
+TEST(LightClusterTests, TestGpuMatchesCpu)
+{
+    // runs headless, so lavapipe can check cluster.comp against the CPU binning
+    ASSERT_TRUE(shadersCompiled("../Renderer/res/shaders/lighting/", { "cluster" }));
+    Device device(nullptr);
+    {
+        glm::mat4 view = glm::lookAt(glm::vec3(0.f, 2.f, 6.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 50.f);
+        projection[1][1] *= -1.f;
+        VkExtent2D extent = { 1280, 720 };
+
+        std::default_random_engine engine(7);
+        std::uniform_real_distribution<float> position(-10.f, 10.f);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        std::vector<LightClusterer::GpuLight> lights;
+        for (int i = 0; i < 2000; i++)
+        {
+            glm::vec3 colour(unit(engine), unit(engine), unit(engine));
+            glm::vec3 constants(1.f, 0.f, 20.f + 200.f * unit(engine));
+            if (i % 4 == 0)
+            {
+                SpotLight spot{ colour, glm::vec3(position(engine), position(engine), position(engine)), glm::vec3(position(engine), position(engine), position(engine)), constants };
+                spot.outerCutOffCosine = 0.2f + 0.7f * unit(engine);
+                spot.innerCutOffCosine = spot.outerCutOffCosine + 0.05f;
+                lights.push_back(LightClusterer::GpuLight::create(spot));
+            }
+            else
+                lights.push_back(LightClusterer::GpuLight::create(PointLight{ colour, glm::vec3(position(engine), position(engine), position(engine)), constants }));
+        }
+
+        LightClusterer clusterer(&device, static_cast<uint32_t>(lights.size()), "../Renderer/res/shaders/lighting/");
+        clusterer.setLights(0, lights);
+        clusterer.setCamera(view, projection, 0.1f, 50.f);
+        ASSERT_EQ(clusterer.getLightCount(0), lights.size());
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = device.getCommandPool();
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        ASSERT_EQ(vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &commandBuffer), VK_SUCCESS);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        clusterer.recordCluster(commandBuffer, 0, extent);
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        ASSERT_EQ(vkQueueSubmit(device.getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE), VK_SUCCESS);
+        vkQueueWaitIdle(device.getGraphicsQueue());
+        vkFreeCommandBuffers(device.getDevice(), device.getCommandPool(), 1, &commandBuffer);
+
+        // the lists are written in light order on both sides, so only spheres grazing a cluster's box may differ by rounding
+        std::vector<uint32_t> expected = LightClusterer::assign(lights, LightClusterer::createUniforms(view, projection, extent, 0.1f, 50.f, static_cast<uint32_t>(lights.size())));
+        std::vector<uint32_t> clusters = clusterer.readClusters(0);
+        ASSERT_EQ(clusters.size(), expected.size());
+        uint32_t mismatched = 0;
+        size_t listed = 0;
+        for (uint32_t cluster = 0; cluster < LightClusterer::CLUSTER_COUNT; cluster++)
+        {
+            auto begin = clusters.begin() + static_cast<size_t>(cluster) * LightClusterer::CLUSTER_STRIDE;
+            auto expectedBegin = expected.begin() + static_cast<size_t>(cluster) * LightClusterer::CLUSTER_STRIDE;
+            listed += *begin;
+            if (*begin != *expectedBegin || !std::equal(begin + 1, begin + 1 + *begin, expectedBegin + 1))
+                mismatched++;
+        }
+        ASSERT_GT(listed, 0);
+        ASSERT_LE(mismatched, LightClusterer::CLUSTER_COUNT / 100);
+    }
+    vkDeviceWaitIdle(device.getDevice());
+}
+
+TEST(ShadowTests, TestCascades)
+{
+    // the last split is the far plane, lambda 0 splits uniformly and lambda 1 logarithmically
+    std::vector<float> splits = ShadowMapper::getSplitDepths(0.1f, 10.f, ShadowMapper::CASCADE_COUNT, 0.75f);
+    ASSERT_EQ(splits.size(), ShadowMapper::CASCADE_COUNT);
+    for (uint32_t i = 1; i < ShadowMapper::CASCADE_COUNT; i++)
+        ASSERT_GT(splits[i], splits[i - 1]);
+    ASSERT_FLOAT_EQ(splits.back(), 10.f);
+    ASSERT_NEAR(ShadowMapper::getSplitDepths(0.1f, 10.f, 4, 0.f)[1], 5.05f, 1e-4f);
+    ASSERT_NEAR(ShadowMapper::getSplitDepths(0.1f, 10.f, 4, 1.f)[1], 1.f, 1e-4f);
+
+    glm::mat4 view = glm::lookAt(glm::vec3(2.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.f), 16.f / 9.f, 0.1f, 10.f);
+    projection[1][1] *= -1.f;
+    glm::vec3 lightDirection(-1.f, -1.f, -1.f);
+    glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+    float splitNear = 0.1f;
+    for (uint32_t cascade = 0; cascade < ShadowMapper::CASCADE_COUNT; cascade++)
+    {
+        ShadowMapper::Cascade fitted = ShadowMapper::fitCascade(view, projection, 0.1f, 10.f, splitNear, splits[cascade], lightDirection, 2048, 20.f);
+        ASSERT_EQ(fitted.splitDepth, splits[cascade]);
+
+        // every corner of the slice lands inside the cascade
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec4 ndc((corner & 1) ? 1.f : -1.f, (corner & 2) ? 1.f : -1.f, 0.f, 1.f);
+            glm::vec4 nearCorner = inverseViewProjection * ndc;
+            ndc.z = 1.f;
+            glm::vec4 farCorner = inverseViewProjection * ndc;
+            glm::vec3 nearPoint = glm::vec3(nearCorner) / nearCorner.w;
+            glm::vec3 edge = glm::vec3(farCorner) / farCorner.w - nearPoint;
+            float depth = (corner & 4) ? splits[cascade] : splitNear;
+            glm::vec4 lightClip = fitted.viewProjection * glm::vec4(nearPoint + edge * ((depth - 0.1f) / (10.f - 0.1f)), 1.f);
+            ASSERT_LE(std::abs(lightClip.x), 1.f);
+            ASSERT_LE(std::abs(lightClip.y), 1.f);
+            ASSERT_GE(lightClip.z, 0.f);
+            ASSERT_LE(lightClip.z, 1.f);
+        }
+
+        // moving the camera shifts a fixed point in the cascade by whole texels, so the map doesn't shimmer
+        glm::vec3 offset(0.013f, 0.007f, -0.021f);
+        glm::mat4 movedView = glm::lookAt(glm::vec3(2.f) + offset, offset, glm::vec3(0.f, 1.f, 0.f));
+        ShadowMapper::Cascade moved = ShadowMapper::fitCascade(movedView, projection, 0.1f, 10.f, splitNear, splits[cascade], lightDirection, 2048, 20.f);
+        ASSERT_EQ(moved.texelWorldSize, fitted.texelWorldSize);
+        glm::vec2 texels = (glm::vec2(moved.viewProjection * glm::vec4(0.3f, -0.2f, 0.5f, 1.f)) - glm::vec2(fitted.viewProjection * glm::vec4(0.3f, -0.2f, 0.5f, 1.f))) * 1024.f;
+        ASSERT_NEAR(texels.x, std::round(texels.x), 1e-2f);
+        ASSERT_NEAR(texels.y, std::round(texels.y), 1e-2f);
+        splitNear = splits[cascade];
+    }
+
+    // interleaved casters of two meshes become one instanced draw each, with contiguous model matrices
+    entt::registry registry;
+    std::vector<entt::entity> casters;
+    VkBuffer meshes[] = { reinterpret_cast<VkBuffer>(uintptr_t(0x20)), reinterpret_cast<VkBuffer>(uintptr_t(0x10)) };
+    for (int i = 0; i < 6; i++)
+    {
+        entt::entity entity = registry.create();
+        auto& renderComp = registry.emplace<Rock::RenderComponent>(entity);
+        renderComp.m_vertexBuffer = meshes[i % 2];
+        renderComp.m_indexCount = 36 * (i % 2 + 1);
+        registry.emplace<Rock::TransformComponent>(entity, glm::vec3(static_cast<float>(i), 0.f, 0.f), glm::vec3(0.f), glm::vec3(1.f));
+        casters.push_back(entity);
+    }
+    std::vector<glm::mat4> instances;
+    std::vector<ShadowMapper::Batch> batches;
+    ShadowMapper::batchCasters(registry, casters, instances, batches);
+    ASSERT_EQ(instances.size(), 6);
+    ASSERT_EQ(batches.size(), 2);
+    uint32_t firstInstance = 0;
+    for (const ShadowMapper::Batch& batch : batches)
+    {
+        ASSERT_EQ(batch.firstInstance, firstInstance);
+        ASSERT_EQ(batch.instanceCount, 3);
+        ASSERT_EQ(batch.indexCount, batch.vertexBuffer == meshes[0] ? 36 : 72);
+        for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; i++)
+            ASSERT_EQ(static_cast<int>(instances[i][3].x) % 2, batch.vertexBuffer == meshes[0] ? 0 : 1);
+        firstInstance += batch.instanceCount;
+    }
+
+    // a second call appends rather than extending the last batch
+    ShadowMapper::batchCasters(registry, { casters[0] }, instances, batches);
+    ASSERT_EQ(batches.size(), 3);
+    ASSERT_EQ(batches[2].firstInstance, 6);
+}
+
+TEST(GpuPhysicsTests, TestCpuGrid)
+{
+    ASSERT_EQ(GpuPhysics::getTableSize(1), 1);
+    ASSERT_EQ(GpuPhysics::getTableSize(1000), 1024);
+    ASSERT_EQ(GpuPhysics::getTableSize(1024), 1024);
+
+    // without gravity or walls the change in each velocity is the contact force alone, which the hash grid must sum over the same neighbours as an all pairs search
+    PhysicsSettings settings;
+    settings.maxBodies = 2000;
+    settings.maxRadius = 0.05f;
+    settings.gravity = glm::vec3(0.f);
+    settings.boundsMin = glm::vec3(-10.f);
+    settings.boundsMax = glm::vec3(10.f);
+
+    std::default_random_engine engine(11);
+    std::uniform_real_distribution<float> position(-0.5f, 0.5f);
+    std::uniform_real_distribution<float> radius(0.02f, 0.05f);
+    std::vector<GpuPhysics::Body> bodies(settings.maxBodies);
+    for (uint32_t i = 0; i < settings.maxBodies; i++)
+    {
+        bool isStatic = i % 10 == 0;
+        glm::vec3 velocity(position(engine), position(engine), position(engine));
+        bodies[i] = { glm::vec3(position(engine), position(engine), position(engine)), radius(engine), isStatic ? glm::vec3(0.f) : velocity, isStatic ? 0.f : 0.5f };
+    }
+
+    const float deltaTime = 0.001f;
+    std::vector<GpuPhysics::Body> stepped = bodies;
+    GpuPhysics::simulate(stepped, settings, deltaTime);
+
+    uint32_t contacts = 0;
+    for (uint32_t i = 0; i < settings.maxBodies; i++)
+    {
+        glm::vec3 force(0.f);
+        for (uint32_t j = 0; j < settings.maxBodies; j++)
+        {
+            glm::vec3 offset = bodies[i].position - bodies[j].position;
+            float distance = glm::length(offset);
+            float radii = bodies[i].radius + bodies[j].radius;
+            if (j == i || distance >= radii)
+                continue;
+            glm::vec3 normal = offset / distance;
+            float approach = glm::dot(bodies[j].velocity - bodies[i].velocity, normal);
+            force += normal * std::max(settings.stiffness * (radii - distance) + settings.damping * approach, 0.f);
+            contacts++;
+        }
+        glm::vec3 velocity = bodies[i].velocity + force * bodies[i].inverseMass * deltaTime;
+        ASSERT_NEAR(glm::length(stepped[i].velocity - velocity), 0.f, 1e-3f);
+        ASSERT_NEAR(glm::length(stepped[i].position - (bodies[i].position + velocity * deltaTime)), 0.f, 1e-5f);
+    }
+    ASSERT_GT(contacts, 100);
+
+    // static bodies never move, and bodies leaving the bounds are clamped inside with their normal speed reversed and scaled
+    settings.boundsMin = glm::vec3(-1.f);
+    settings.boundsMax = glm::vec3(1.f);
+    std::vector<GpuPhysics::Body> walls = { { glm::vec3(0.f), 0.05f, glm::vec3(5.f, 0.f, 0.f), 0.f }, { glm::vec3(0.9f, 0.f, 0.f), 0.05f, glm::vec3(100.f, 0.f, 0.f), 1.f } };
+    GpuPhysics::simulate(walls, settings, 0.01f);
+    ASSERT_EQ(walls[0].position, glm::vec3(0.f));
+    ASSERT_FLOAT_EQ(walls[1].position.x, 0.95f);
+    ASSERT_FLOAT_EQ(walls[1].velocity.x, -100.f * settings.restitution);
+}
+
+TEST(GpuPhysicsTests, TestGpuMatchesCpu)
+{
+    // runs headless, so lavapipe can check the compute path against the CPU path
+    ASSERT_TRUE(shadersCompiled("../Renderer/res/shaders/physics/", { "hash", "scan", "scanAdd", "scatter", "collide", "gather" }));
+    Device device(nullptr);
+    {
+        PhysicsSettings settings;
+        settings.maxBodies = 4096;
+        settings.maxMirrored = 4;
+        settings.maxRadius = 0.03f;
+        settings.boundsMin = glm::vec3(-0.5f);
+        settings.boundsMax = glm::vec3(0.5f);
+        settings.shaderDirectory = "../Renderer/res/shaders/physics/";
+
+        // a lattice of bodies with jittered velocities falls onto the floor and piles up, so most bodies collide
+        std::default_random_engine engine(5);
+        std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+        std::vector<GpuPhysics::Body> bodies;
+        for (int z = 0; z < 16; z++)
+            for (int y = 0; y < 16; y++)
+                for (int x = 0; x < 16; x++)
+                    bodies.push_back({ glm::vec3(x, y, z) * 0.055f - 0.4125f, 0.025f, glm::vec3(jitter(engine), jitter(engine), jitter(engine)), 1.f });
+
+        entt::registry registry;
+        entt::entity entity = registry.create();
+        auto& transformComp = registry.emplace<Rock::TransformComponent>(entity, bodies[123].position, glm::vec3(0.f), glm::vec3(1.f));
+        registry.emplace<Rock::SphereComponent>(entity, 0.025f);
+        registry.emplace<Rock::RigidbodyComponent>(entity, 1.f, bodies[123].velocity);
+        bodies[123] = GpuPhysics::Body::create(transformComp, registry.get<Rock::SphereComponent>(entity), &registry.get<Rock::RigidbodyComponent>(entity));
+
+        GpuPhysics physics(&device, settings);
+        physics.setBodies(bodies);
+        physics.mirror(entity, 123);
+        ASSERT_EQ(physics.getBodyCount(), 4096);
+
+        const float deltaTime = 1.f / 480.f;
+        physics.step(deltaTime, 30);
+        physics.step(deltaTime, 30);
+        for (int i = 0; i < 60; i++)
+            GpuPhysics::simulate(bodies, settings, deltaTime);
+
+        std::vector<GpuPhysics::Body> gpuBodies = physics.getBodies();
+        ASSERT_EQ(gpuBodies.size(), bodies.size());
+        float maxError = 0.f;
+        for (size_t i = 0; i < bodies.size(); i++)
+            maxError = std::max(maxError, glm::length(gpuBodies[i].position - bodies[i].position));
+        ASSERT_LT(maxError, 1e-3f);
+
+        // only the mirrored entity is written back
+        physics.syncTransforms(registry);
+        ASSERT_NEAR(glm::length(transformComp.m_translation - gpuBodies[123].position), 0.f, 1e-6f);
+        ASSERT_NEAR(glm::length(registry.get<Rock::RigidbodyComponent>(entity).m_velocity - gpuBodies[123].velocity), 0.f, 1e-6f);
+    }
+    vkDeviceWaitIdle(device.getDevice());
+}
+
+TEST(ParticleTests, TestScanAndSort)
+{
+    ASSERT_EQ(ParticleSystem::getGroupCount(256, 256), 1);
+    ASSERT_EQ(ParticleSystem::getGroupCount(257, 256), 2);
+
+    // a level fits in one workgroup, so 256 elements scan in one pass and a million in three
+    ASSERT_EQ(ParticleSystem::getScanLevels(256).size(), 1);
+    std::vector<ParticleSystem::ScanLevel> levels = ParticleSystem::getScanLevels(1 << 20);
+    ASSERT_EQ(levels.size(), 3);
+    ASSERT_EQ(levels[1].offset, 1 << 20);
+    ASSERT_EQ(levels[1].count, 4096);
+    ASSERT_EQ(levels[2].offset, (1 << 20) + 4096);
+    ASSERT_EQ(levels[2].count, 16);
+    ASSERT_EQ(ParticleSystem::getSortPasses(1024).size(), 55); // log2(n) * (log2(n) + 1) / 2
+
+    // runs headless, so lavapipe can check the scan, compaction and sort against the particles they were built from
+    ASSERT_TRUE(shadersCompiled("../Renderer/res/shaders/particles/", { "simulate", "emit", "scan", "scanAdd", "compact", "sort", "vert", "frag" }));
+    Device device(nullptr);
+    {
+        OffscreenTarget target(&device, { 64, 64 });
+        glm::mat4 view = glm::lookAt(glm::vec3(0.f, 1.f, 4.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.f), 1.f, 0.1f, 20.f);
+        glm::mat4 viewProjection = projection * view;
+
+        // 5000 particles scan over two levels and sort in a padded list of 8192; short lifetimes leave dead particles between the alive ones
+        ParticleSettings settings{};
+        settings.maxParticles = 5000;
+        settings.emissionRate = 10000.f;
+        settings.emitterRadius = 1.f;
+        settings.lifetime = glm::vec2(0.05f, 0.5f);
+        settings.speed = glm::vec2(0.5f, 2.f);
+        for (bool sorted : { false, true })
+        {
+            settings.sorted = sorted;
+            ParticleSystem particleSystem(&device, settings, 2, target.getRenderPass(), VK_SAMPLE_COUNT_1_BIT, "../Renderer/res/shaders/particles/");
+            particleSystem.setViewProjection(viewProjection);
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandPool = device.getCommandPool();
+            allocInfo.commandBufferCount = 1;
+            VkCommandBuffer commandBuffer;
+            ASSERT_EQ(vkAllocateCommandBuffers(device.getDevice(), &allocInfo, &commandBuffer), VK_SUCCESS);
+
+            // the first update resets, and each one after emits 1000 particles into the frame it simulates
+            const uint32_t updates = 5;
+            for (uint32_t update = 0; update < updates; update++)
+            {
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                vkBeginCommandBuffer(commandBuffer, &beginInfo);
+                particleSystem.recordUpdate(commandBuffer, update % 2, 0.1f);
+                vkEndCommandBuffer(commandBuffer);
+
+                VkSubmitInfo submitInfo{};
+                submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &commandBuffer;
+                ASSERT_EQ(vkQueueSubmit(device.getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE), VK_SUCCESS);
+                vkQueueWaitIdle(device.getGraphicsQueue());
+                vkResetCommandBuffer(commandBuffer, 0);
+            }
+            vkFreeCommandBuffers(device.getDevice(), device.getCommandPool(), 1, &commandBuffer);
+
+            // the CPU reference: every particle with life left, in index order, keyed by its negated clip w
+            uint32_t frame = (updates - 1) % 2;
+            std::vector<ParticleSystem::GpuParticle> particles = particleSystem.readParticles(frame);
+            std::vector<uint32_t> expected;
+            for (uint32_t i = 0; i < settings.maxParticles; i++)
+                if ((particles[i].life & 0xFFFFu) != 0)
+                    expected.push_back(i);
+            ASSERT_GT(expected.size(), 0);
+            ASSERT_LT(expected.size(), settings.maxParticles);
+
+            VkDrawIndirectCommand command = particleSystem.readDrawCommand(frame);
+            ASSERT_EQ(command.vertexCount, expected.size());
+            ASSERT_EQ(command.instanceCount, 1);
+
+            std::vector<glm::uvec2> alive = particleSystem.readAliveList(frame);
+            std::vector<uint32_t> indices;
+            for (uint32_t i = 0; i < command.vertexCount; i++)
+            {
+                float key;
+                memcpy(&key, &alive[i].x, sizeof(key));
+                ASSERT_LT(alive[i].y, settings.maxParticles);
+                float expectedKey = -(viewProjection * glm::vec4(particles[alive[i].y].position, 1.f)).w;
+                ASSERT_NEAR(key, expectedKey, 1e-4f * std::max(1.f, std::abs(expectedKey)));
+                if (sorted && i > 0)
+                {
+                    float previousKey;
+                    memcpy(&previousKey, &alive[i - 1].x, sizeof(previousKey));
+                    ASSERT_LE(previousKey, key);
+                }
+                indices.push_back(alive[i].y);
+            }
+
+            // compaction keeps index order; the sort reorders the same particles, padding the rest of the list with FLT_MAX
+            if (sorted)
+            {
+                std::sort(indices.begin(), indices.end());
+                ASSERT_EQ(alive.size(), 8192);
+                for (size_t i = command.vertexCount; i < alive.size(); i++)
+                    ASSERT_EQ(alive[i].x, 0x7F7FFFFFu);
+            }
+            ASSERT_EQ(indices, expected);
+        }
+    }
+    vkDeviceWaitIdle(device.getDevice());
+}
+
+TEST(FramePacingTests, TestChoosePresentMode)
+{
+    std::vector<VkPresentModeKHR> all = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+    for (VkPresentModeKHR mode : all)
+        ASSERT_EQ(Swapchain::choosePresentMode(all, mode), mode);
+
+    // uncapped modes stand in for each other before falling back to vsync
+    ASSERT_EQ(Swapchain::choosePresentMode({ VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR }, VK_PRESENT_MODE_MAILBOX_KHR), VK_PRESENT_MODE_IMMEDIATE_KHR);
+    ASSERT_EQ(Swapchain::choosePresentMode({ VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR }, VK_PRESENT_MODE_IMMEDIATE_KHR), VK_PRESENT_MODE_MAILBOX_KHR);
+    ASSERT_EQ(Swapchain::choosePresentMode({ VK_PRESENT_MODE_FIFO_KHR }, VK_PRESENT_MODE_MAILBOX_KHR), VK_PRESENT_MODE_FIFO_KHR);
+    ASSERT_EQ(Swapchain::choosePresentMode({ VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR }, VK_PRESENT_MODE_FIFO_RELAXED_KHR), VK_PRESENT_MODE_FIFO_KHR);
+}
+
+TEST(FramePacingTests, TestFrameLimiter)
+{
+    FrameLimiter limiter(200.0);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 11; i++)
+        limiter.wait(); // the first wait starts timing
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ASSERT_GE(elapsed, 10 / 200.0);
+
+    limiter.setTargetFrameRate(0.0);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; i++)
+        limiter.wait();
+    ASSERT_LT(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 10 / 200.0);
+}
+
+TEST(CpuProfilerTests, TestZones)
+{
+    // zones are recorded when they close, so the inner zone precedes the outer one
+    uint64_t since = CpuProfiler::now();
+    {
+        CpuProfiler::Scope outer("outer");
+        CpuProfiler::Scope inner("inner \"zone\"");
+    }
+    std::thread worker([]() { CpuProfiler::Scope zone("worker"); });
+    worker.join();
+    CpuProfiler::markFrame();
+
+    std::vector<CpuProfiler::Zone> zones = CpuProfiler::collect(since);
+    ASSERT_EQ(zones.size(), 3);
+    ASSERT_STREQ(zones[0].name, "inner \"zone\"");
+    ASSERT_EQ(zones[0].depth, 1);
+    ASSERT_STREQ(zones[1].name, "outer");
+    ASSERT_EQ(zones[1].depth, 0);
+    ASSERT_LE(zones[1].start, zones[0].start);
+    ASSERT_GE(zones[1].end, zones[0].end);
+    ASSERT_STREQ(zones[2].name, "worker");
+    ASSERT_NE(zones[2].thread, zones[0].thread);
+
+    uint64_t frameStart, frameEnd;
+    CpuProfiler::getLastFrame(frameStart, frameEnd);
+    ASSERT_GE(frameEnd, zones[2].end);
+
+    std::string trace = CpuProfiler::toChromeTrace({ { "zone", 1500, 4250, 0, 2 } });
+    ASSERT_EQ(trace, "{\"traceEvents\":[\n{\"name\":\"zone\",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":1.5,\"dur\":2.7,\"pid\":0,\"tid\":2}\n],\"displayTimeUnit\":\"ms\"}\n");
+    ASSERT_NE(CpuProfiler::toChromeTrace(zones).find("\"name\":\"inner \\\"zone\\\"\""), std::string::npos);
+}
+
+TEST(GpuProfilerTests, TestExport)
+{
+    GpuProfiler::ScopeResult cull{ "cull", 0, 0.25, true, { 0, 0, 0, 0, 0, 4096 } };
+    GpuProfiler::ScopeResult draw{ "draw \"opaque\"", 1, 1.5, false, {} };
+    std::vector<GpuProfiler::ScopeResult> results = { cull, draw };
+
+    std::string csv = GpuProfiler::toCsv(results);
+    ASSERT_EQ(csv.substr(0, csv.find('\n')), "scope,depth,milliseconds,input assembly vertices,input assembly primitives,vertex shader invocations,"
+        "clipping primitives,fragment shader invocations,compute shader invocations");
+    ASSERT_NE(csv.find("\"cull\",0,0.25,0,0,0,0,0,4096\n"), std::string::npos);
+    ASSERT_NE(csv.find("\"draw \"\"opaque\"\"\",1,1.5,,,,,,\n"), std::string::npos); // scopes without statistics leave their columns empty
+
+    std::string json = GpuProfiler::toJson(results);
+    ASSERT_NE(json.find("\"scope\": \"cull\", \"depth\": 0, \"milliseconds\": 0.25, \"statistics\": {"), std::string::npos);
+    ASSERT_NE(json.find("\"compute shader invocations\": 4096"), std::string::npos);
+    ASSERT_NE(json.find("\"scope\": \"draw \\\"opaque\\\"\", \"depth\": 1, \"milliseconds\": 1.5 }"), std::string::npos);
+    ASSERT_EQ(GpuProfiler::toJson({}), "[]\n");
+}
+
+TEST(PngWriterTests, TestRoundTrip)
+{
+    // wider than one stored deflate block, so the encoder has to split the rows
+    const uint32_t width = 200;
+    const uint32_t height = 130;
+    std::vector<uint8_t> pixels(width * height * 4);
+    for (size_t i = 0; i < pixels.size(); i++)
+        pixels[i] = static_cast<uint8_t>(i * 7 + 3);
+
+    std::vector<uint8_t> png = Rock::PngWriter::encode(width, height, pixels);
+    int decodedWidth, decodedHeight, channels;
+    stbi_uc* decoded = stbi_load_from_memory(png.data(), static_cast<int>(png.size()), &decodedWidth, &decodedHeight, &channels, STBI_rgb_alpha);
+    ASSERT_NE(decoded, nullptr);
+    ASSERT_EQ(decodedWidth, width);
+    ASSERT_EQ(decodedHeight, height);
+    std::vector<uint8_t> roundTrip(decoded, decoded + pixels.size());
+    stbi_image_free(decoded);
+    ASSERT_EQ(Rock::PngWriter::countDifferingPixels(roundTrip, pixels), 0);
+
+    roundTrip[0] += 2;
+    roundTrip[4] += 1;
+    ASSERT_EQ(Rock::PngWriter::countDifferingPixels(roundTrip, pixels), 2);
+    ASSERT_EQ(Rock::PngWriter::countDifferingPixels(roundTrip, pixels, 1), 1);
+    ASSERT_THROW(Rock::PngWriter::encode(width, height, {}), std::runtime_error);
+}
+
+TEST(HeadlessTests, TestRenderOffscreen)
+{
+    // no window, surface or swapchain, so this runs on display-less machines and lavapipe
+    Device device(nullptr);
+    ASSERT_TRUE(device.isHeadless());
+    ASSERT_EQ(device.getSurface(), VK_NULL_HANDLE);
+    {
+        OffscreenTarget target(&device, { 64, 32 });
+        target.beginFrame({ { 1.f, 0.f, 0.f, 1.f } });
+        const std::vector<uint8_t>& pixels = target.endFrame();
+        ASSERT_EQ(pixels.size(), 64 * 32 * 4);
+
+        std::vector<uint8_t> red(pixels.size());
+        for (size_t i = 0; i < red.size(); i += 4)
+        {
+            red[i] = 255;
+            red[i + 3] = 255;
+        }
+        ASSERT_EQ(Rock::PngWriter::countDifferingPixels(pixels, red), 0);
+
+        target.saveFrame("headless.png");
+        int width, height, channels;
+        stbi_uc* saved = stbi_load("headless.png", &width, &height, &channels, STBI_rgb_alpha);
+        ASSERT_NE(saved, nullptr);
+        ASSERT_EQ(width, 64);
+        ASSERT_EQ(height, 32);
+        ASSERT_EQ(Rock::PngWriter::countDifferingPixels(std::vector<uint8_t>(saved, saved + red.size()), red), 0);
+        stbi_image_free(saved);
+        std::remove("headless.png");
+    }
+    vkDeviceWaitIdle(device.getDevice());
+}
+
 TEST(WindowTests, CreateWindow)
 {
 	ASSERT_TRUE(glfwInit());
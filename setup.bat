@@ -7,16 +7,50 @@ echo Compiling shaders...
 
 C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/engineApp/main.vert -o ./Renderer/res/shaders/engineApp/vert.spv
 C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/engineApp/main.frag -o ./Renderer/res/shaders/engineApp/frag.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/engineApp/compact.vert -o ./Renderer/res/shaders/engineApp/compact.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/engineApp/instanced.vert -o ./Renderer/res/shaders/engineApp/instanced.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe -DBINDLESS ./Renderer/res/shaders/engineApp/main.vert -o ./Renderer/res/shaders/engineApp/bindlessVert.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe -DBINDLESS ./Renderer/res/shaders/engineApp/main.frag -o ./Renderer/res/shaders/engineApp/bindlessFrag.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe -DBINDLESS ./Renderer/res/shaders/engineApp/compact.vert -o ./Renderer/res/shaders/engineApp/bindlessCompact.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe -DBINDLESS ./Renderer/res/shaders/engineApp/instanced.vert -o ./Renderer/res/shaders/engineApp/instancedBindless.spv
 C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/gameApp/main.vert -o ./Renderer/res/shaders/gameApp/vert.spv
 C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/gameApp/main.frag -o ./Renderer/res/shaders/gameApp/frag.spv
-C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/computeApp/main.vert -o ./Renderer/res/shaders/computeApp/vert.spv
-C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/computeApp/main.frag -o ./Renderer/res/shaders/computeApp/frag.spv
-C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/computeApp/main.comp -o ./Renderer/res/shaders/computeApp/comp.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/particles/simulate.comp -o ./Renderer/res/shaders/particles/simulate.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/particles/emit.comp -o ./Renderer/res/shaders/particles/emit.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/particles/scan.comp -o ./Renderer/res/shaders/particles/scan.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/particles/scanAdd.comp -o ./Renderer/res/shaders/particles/scanAdd.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/particles/compact.comp -o ./Renderer/res/shaders/particles/compact.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/particles/sort.comp -o ./Renderer/res/shaders/particles/sort.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/particles/main.vert -o ./Renderer/res/shaders/particles/vert.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/particles/main.frag -o ./Renderer/res/shaders/particles/frag.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/physics/hash.comp -o ./Renderer/res/shaders/physics/hash.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/physics/scan.comp -o ./Renderer/res/shaders/physics/scan.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/physics/scanAdd.comp -o ./Renderer/res/shaders/physics/scanAdd.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/physics/scatter.comp -o ./Renderer/res/shaders/physics/scatter.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/physics/collide.comp -o ./Renderer/res/shaders/physics/collide.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/physics/gather.comp -o ./Renderer/res/shaders/physics/gather.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/culling/cull.comp -o ./Renderer/res/shaders/culling/cull.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/culling/hiz.comp -o ./Renderer/res/shaders/culling/hiz.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe -DMULTISAMPLED ./Renderer/res/shaders/culling/hiz.comp -o ./Renderer/res/shaders/culling/hizMultisample.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/lighting/cluster.comp -o ./Renderer/res/shaders/lighting/cluster.spv
+C:/VulkanSDK/1.4.309.0/Bin/glslc.exe ./Renderer/res/shaders/shadows/shadow.vert -o ./Renderer/res/shaders/shadows/shadow.spv
 
 :: turn echo off
 @echo off
 echo:
 
+:: cook models into binary meshes (requires MeshCooker to be built)
+echo Cooking models...
+echo:
+
+if exist "./x64/Release/MeshCooker.exe" (
+    for %%f in (Renderer\res\models\*.obj) do "./x64/Release/MeshCooker.exe" "%%f"
+) else (
+    echo MeshCooker not built, models will be parsed at load time.
+)
+
+echo:
+
 :: run doxygen for documentation
 echo Running Doxygen...
 echo: